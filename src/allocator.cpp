@@ -0,0 +1,312 @@
+#include "allocator.hpp"
+#include "buffer.hpp"
+
+#include <algorithm>
+
+/* Staging buffers are sized in steps of this so that similar uploads share them. */
+#define BCN_POOL_GRANULARITY (64 * 1024)
+
+struct memory_preference {
+	VkMemoryPropertyFlags required;
+	VkMemoryPropertyFlags preferred;
+	VkMemoryPropertyFlags avoided;
+};
+
+static const struct memory_preference preferences[ALLOC_USAGE_COUNT] = {
+	/* ALLOC_GPU_ONLY */
+	{ 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT },
+	/* ALLOC_UPLOAD */
+	{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 0, VK_MEMORY_PROPERTY_HOST_CACHED_BIT },
+	/* ALLOC_READBACK */
+	{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 0 },
+};
+
+struct allocator {
+	VkPhysicalDeviceMemoryProperties props;
+	PFN_vkGetPhysicalDeviceMemoryProperties2 getMemoryProperties2;
+	VkDeviceSize heapBudget[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize allocated[VK_MAX_MEMORY_HEAPS];
+	std::vector<std::unique_ptr<struct buffer>> pool[ALLOC_USAGE_COUNT];
+	VkDeviceSize pooled;
+	VkDeviceSize poolLimit;
+};
+
+static std::mutex alloc_lock;
+static std::unordered_map<struct device *, std::unique_ptr<struct allocator>> allocatorsMap;
+
+static struct allocator *
+get_allocator(struct device *dev)
+{
+	auto it = allocatorsMap.find(dev);
+
+	if (it == allocatorsMap.end())
+		return nullptr;
+
+	return it->second.get();
+}
+
+/*
+ * Refreshes the heap budgets. Without VK_EXT_memory_budget the whole heap is
+ * the budget and only what the layer allocated itself counts as usage.
+ */
+static void
+update_budget(struct device *dev, struct allocator *a)
+{
+	if (a->getMemoryProperties2) {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+			VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT
+		};
+		VkPhysicalDeviceMemoryProperties2 props2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, &budget };
+
+		a->getMemoryProperties2(dev->physical, &props2);
+		for (uint32_t i = 0; i < a->props.memoryHeapCount; i++) {
+			a->heapBudget[i] = budget.heapBudget[i];
+			a->heapUsage[i] = budget.heapUsage[i];
+		}
+		return;
+	}
+
+	for (uint32_t i = 0; i < a->props.memoryHeapCount; i++) {
+		a->heapBudget[i] = a->props.memoryHeaps[i].size;
+		a->heapUsage[i] = a->allocated[i];
+	}
+}
+
+/* A heap is under pressure once usage would pass 90% of its budget. */
+static bool
+heap_under_pressure(struct allocator *a, uint32_t heap, VkDeviceSize size)
+{
+	return a->heapUsage[heap] + size > a->heapBudget[heap] / 10 * 9;
+}
+
+static void
+destroy_pooled_buffer(struct device *dev, struct allocator *a, std::unique_ptr<struct buffer> &buf)
+{
+	dev->table.DestroyBuffer(dev->handle, buf->handle, nullptr);
+	dev->table.FreeMemory(dev->handle, buf->memory, nullptr);
+	a->allocated[a->props.memoryTypes[buf->typeIndex].heapIndex] -= buf->memorySize;
+	a->pooled -= buf->capacity;
+	buf.reset();
+}
+
+static void
+trim_pools(struct device *dev, struct allocator *a)
+{
+	if (!a->pooled)
+		return;
+
+	Logger::log("info", "Trimming staging pools, %llu bytes released", (unsigned long long)a->pooled);
+
+	for (auto &pool : a->pool) {
+		for (auto &buf : pool)
+			destroy_pooled_buffer(dev, a, buf);
+		pool.clear();
+	}
+}
+
+void
+allocator_init(struct device *dev,
+			   const VkPhysicalDeviceMemoryProperties &props,
+			   PFN_vkGetPhysicalDeviceMemoryProperties2 getMemoryProperties2)
+{
+	auto a = std::make_unique<struct allocator>();
+
+	a->props = props;
+	a->getMemoryProperties2 = getMemoryProperties2;
+	a->pooled = 0;
+	a->poolLimit = (VkDeviceSize)(getenv("BCN_POOL_SIZE_MB") ? atoi(getenv("BCN_POOL_SIZE_MB")) : 64) << 20;
+	memset(a->allocated, 0, sizeof(a->allocated));
+
+	update_budget(dev, a.get());
+
+	scoped_lock l(alloc_lock);
+	allocatorsMap[dev] = std::move(a);
+}
+
+void
+allocator_destroy(struct device *dev)
+{
+	scoped_lock l(alloc_lock);
+
+	struct allocator *a = get_allocator(dev);
+	if (!a)
+		return;
+
+	trim_pools(dev, a);
+	allocatorsMap.erase(dev);
+}
+
+/*
+ * Allocates memory for a layer owned resource. The memory types allowed by
+ * the requirements are tried from the best match for the usage down; a heap
+ * close to its budget first gets the staging pools trimmed and is skipped
+ * if that is not enough, unless nothing else is left.
+ */
+VkResult
+allocator_allocate(struct device *dev,
+				   const VkMemoryRequirements &reqs,
+				   enum alloc_usage usage,
+				   VkDeviceMemory *memory,
+				   uint32_t *typeIndex)
+{
+	const struct memory_preference &pref = preferences[usage];
+	std::vector<std::pair<int, uint32_t>> candidates;
+	VkResult result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+	scoped_lock l(alloc_lock);
+
+	struct allocator *a = get_allocator(dev);
+	if (!a)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	for (uint32_t i = 0; i < a->props.memoryTypeCount; i++) {
+		VkMemoryPropertyFlags flags = a->props.memoryTypes[i].propertyFlags;
+
+		if (!(reqs.memoryTypeBits & (1u << i)) || (flags & pref.required) != pref.required)
+			continue;
+
+		int score = 2 * __builtin_popcount(flags & pref.preferred) - __builtin_popcount(flags & pref.avoided);
+		candidates.push_back({ -score, i });
+	}
+
+	std::stable_sort(candidates.begin(), candidates.end());
+	update_budget(dev, a);
+
+	for (size_t c = 0; c < candidates.size(); c++) {
+		uint32_t type = candidates[c].second;
+		uint32_t heap = a->props.memoryTypes[type].heapIndex;
+		bool last = c + 1 == candidates.size();
+
+		if (heap_under_pressure(a, heap, reqs.size)) {
+			trim_pools(dev, a);
+			update_budget(dev, a);
+			if (heap_under_pressure(a, heap, reqs.size) && !last)
+				continue;
+		}
+
+		VkMemoryAllocateInfo allocate_info = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.pNext = nullptr,
+			.allocationSize = reqs.size,
+			.memoryTypeIndex = type
+		};
+
+		result = dev->table.AllocateMemory(dev->handle, &allocate_info, nullptr, memory);
+		if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) {
+			trim_pools(dev, a);
+			result = dev->table.AllocateMemory(dev->handle, &allocate_info, nullptr, memory);
+		}
+
+		if (result == VK_SUCCESS) {
+			a->allocated[heap] += reqs.size;
+			*typeIndex = type;
+			return VK_SUCCESS;
+		}
+	}
+
+	return result;
+}
+
+void
+allocator_free(struct device *dev, VkDeviceMemory memory, VkDeviceSize size, uint32_t typeIndex)
+{
+	scoped_lock l(alloc_lock);
+
+	dev->table.FreeMemory(dev->handle, memory, nullptr);
+
+	struct allocator *a = get_allocator(dev);
+	if (a)
+		a->allocated[a->props.memoryTypes[typeIndex].heapIndex] -= size;
+}
+
+/*
+ * Hands out the smallest pooled buffer of the same usage that fits, as long
+ * as it is not more than twice the size asked for.
+ */
+std::unique_ptr<struct buffer>
+allocator_reuse(struct device *dev, VkDeviceSize size, enum alloc_usage usage)
+{
+	scoped_lock l(alloc_lock);
+
+	struct allocator *a = get_allocator(dev);
+	if (!a)
+		return nullptr;
+
+	auto &pool = a->pool[usage];
+	auto best = pool.end();
+	VkDeviceSize limit = 2 * size + BCN_POOL_GRANULARITY;
+
+	for (auto it = pool.begin(); it != pool.end(); ++it) {
+		if ((*it)->capacity >= size && (*it)->capacity <= limit &&
+			(best == pool.end() || (*it)->capacity < (*best)->capacity))
+			best = it;
+	}
+
+	if (best == pool.end())
+		return nullptr;
+
+	auto buf = std::move(*best);
+	pool.erase(best);
+	a->pooled -= buf->capacity;
+
+	buf->size = size;
+	buf->cache_pending = false;
+
+	return buf;
+}
+
+/*
+ * Takes back a staging buffer the GPU is done with. Returns false if the
+ * buffer was not kept, in which case the caller destroys it: pools never
+ * grow past BCN_POOL_SIZE_MB, oldest buffers going first, and nothing is
+ * kept on a heap under pressure.
+ */
+bool
+allocator_recycle(struct device *dev, std::unique_ptr<struct buffer> &buf)
+{
+	scoped_lock l(alloc_lock);
+
+	struct allocator *a = get_allocator(dev);
+	if (!a || buf->capacity > a->poolLimit)
+		return false;
+
+	uint32_t heap = a->props.memoryTypes[buf->typeIndex].heapIndex;
+	if (heap_under_pressure(a, heap, 0)) {
+		trim_pools(dev, a);
+		return false;
+	}
+
+	auto &pool = a->pool[buf->usage];
+	while (a->pooled + buf->capacity > a->poolLimit) {
+		auto &victims = pool.empty() ? *std::max_element(std::begin(a->pool), std::end(a->pool),
+			[](const auto &x, const auto &y) { return x.size() < y.size(); }) : pool;
+
+		destroy_pooled_buffer(dev, a, victims.front());
+		victims.erase(victims.begin());
+	}
+
+	a->pooled += buf->capacity;
+	pool.push_back(std::move(buf));
+
+	return true;
+}
+
+VkDeviceSize
+allocator_round_size(VkDeviceSize size)
+{
+	return (size + BCN_POOL_GRANULARITY - 1) & ~(VkDeviceSize)(BCN_POOL_GRANULARITY - 1);
+}
+
+/* Property flags of one of the device's memory types. */
+VkMemoryPropertyFlags
+allocator_memory_flags(struct device *dev, uint32_t typeIndex)
+{
+	scoped_lock l(alloc_lock);
+
+	struct allocator *a = get_allocator(dev);
+	if (!a || typeIndex >= a->props.memoryTypeCount)
+		return 0;
+
+	return a->props.memoryTypes[typeIndex].propertyFlags;
+}
@@ -0,0 +1,27 @@
+#ifndef __ALLOCATOR_HPP
+#define __ALLOCATOR_HPP
+
+#include "bcn_layer.hpp"
+
+struct buffer;
+
+/* Who touches the memory of a layer owned buffer. */
+enum alloc_usage {
+	ALLOC_GPU_ONLY,		/* written and read by the GPU only */
+	ALLOC_UPLOAD,		/* written by the host, read by the GPU */
+	ALLOC_READBACK,		/* written by the GPU, read back by the host */
+	ALLOC_USAGE_COUNT
+};
+
+void allocator_init(struct device *dev, const VkPhysicalDeviceMemoryProperties &props,
+					PFN_vkGetPhysicalDeviceMemoryProperties2 getMemoryProperties2);
+void allocator_destroy(struct device *dev);
+VkResult allocator_allocate(struct device *dev, const VkMemoryRequirements &reqs, enum alloc_usage usage,
+							VkDeviceMemory *memory, uint32_t *typeIndex);
+void allocator_free(struct device *dev, VkDeviceMemory memory, VkDeviceSize size, uint32_t typeIndex);
+std::unique_ptr<struct buffer> allocator_reuse(struct device *dev, VkDeviceSize size, enum alloc_usage usage);
+bool allocator_recycle(struct device *dev, std::unique_ptr<struct buffer> &buf);
+VkDeviceSize allocator_round_size(VkDeviceSize size);
+VkMemoryPropertyFlags allocator_memory_flags(struct device *dev, uint32_t typeIndex);
+
+#endif
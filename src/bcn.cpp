@@ -1,6 +1,12 @@
 #include "bcn.hpp"
 #include "buffer.hpp"
 #include "image.hpp"
+#include "pipeline_cache.hpp"
+#include "pipeline_stats.hpp"
+#include "command_buffer.hpp"
+
+#include <chrono>
+#include <algorithm>
 #include "s3tc_spv.h"
 #include "s3tc_iv_spv.h"
 #include "bc6_spv.h"
@@ -10,76 +16,7 @@
 #include "rgtc_spv.h"
 #include "rgtc_iv_spv.h"
 
-bool is_s3tc(VkFormat format) {
-	switch (format) {
-		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
-		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
-		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
-		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
-		case VK_FORMAT_BC2_UNORM_BLOCK:
-		case VK_FORMAT_BC2_SRGB_BLOCK:
-		case VK_FORMAT_BC3_UNORM_BLOCK:
-		case VK_FORMAT_BC3_SRGB_BLOCK:
-			return true;
-		default:
-			return false;
-	}
-}
-
-bool is_rgtc(VkFormat format) {
-	switch (format) {
-		case VK_FORMAT_BC4_UNORM_BLOCK:
-		case VK_FORMAT_BC4_SNORM_BLOCK:
-		case VK_FORMAT_BC5_UNORM_BLOCK:
-		case VK_FORMAT_BC5_SNORM_BLOCK:
-			return true;
-		default:
-		    return false;
-	}
-}
-
-bool is_bc6(VkFormat format) {
-	switch(format) {
-		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
-		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
-			return true;
-		default:
-			return false;
-	}
-}
-
-bool is_bc7(VkFormat format) {
-	switch (format) {
-		case VK_FORMAT_BC7_SRGB_BLOCK:
-		case VK_FORMAT_BC7_UNORM_BLOCK:
-			return true;
-		default:
-			return false;
-	}
-}
-
-VkFormat get_format_for_bcn(VkFormat format) {
-	switch (format) {
-		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
-		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
-		case VK_FORMAT_BC2_SRGB_BLOCK:
-		case VK_FORMAT_BC3_SRGB_BLOCK:
-		case VK_FORMAT_BC7_SRGB_BLOCK:
-		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
-		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
-		case VK_FORMAT_BC2_UNORM_BLOCK:
-		case VK_FORMAT_BC3_UNORM_BLOCK:
-		case VK_FORMAT_BC4_UNORM_BLOCK:
-		case VK_FORMAT_BC5_UNORM_BLOCK:
-		case VK_FORMAT_BC7_UNORM_BLOCK:
-			return VK_FORMAT_R8G8B8A8_UNORM;
-		case VK_FORMAT_BC4_SNORM_BLOCK:
-		case VK_FORMAT_BC5_SNORM_BLOCK:
-			return VK_FORMAT_R8G8B8A8_SNORM;
-		default:
-			return VK_FORMAT_R16G16B16A16_SFLOAT;
-	}
-}
+static std::mutex descriptor_lock;
 
 bool is_supported_bcn_format(struct device *device, VkFormat format) {
     VkPhysicalDeviceProperties2 props2 = device->props2;
@@ -135,96 +72,190 @@ create_new_pool(struct device *device) {
 	}
 
 	device->pools.push_back(descriptorPool);
+	stats_add(BCN_STAT_DESCRIPTOR_POOLS, 1);
 
 	return VK_SUCCESS;
 }
 
-VkResult
-create_bcn_compute_pipelines(struct device *dev)
+void
+get_bcn_spirv(struct device *dev, enum bcn_family family, const uint32_t **code, size_t *size)
+{
+	switch (family) {
+		case BCN_FAMILY_S3TC:
+			*code = (dev->use_image_view) ? (const uint32_t *)s3tc_iv_spv : (const uint32_t *)s3tc_spv;
+			*size = (dev->use_image_view) ? s3tc_iv_spv_len : s3tc_spv_len;
+			break;
+		case BCN_FAMILY_RGTC:
+			*code = (dev->use_image_view) ? (const uint32_t *)rgtc_iv_spv : (const uint32_t *)rgtc_spv;
+			*size = (dev->use_image_view) ? rgtc_iv_spv_len : rgtc_spv_len;
+			break;
+		case BCN_FAMILY_BC6:
+			*code = (dev->use_image_view) ? (const uint32_t *)bc6_iv_spv : (const uint32_t *)bc6_spv;
+			*size = (dev->use_image_view) ? bc6_iv_spv_len : bc6_spv_len;
+			break;
+		default:
+			*code = (dev->use_image_view) ? (const uint32_t *)bc7_iv_spv : (const uint32_t *)bc7_spv;
+			*size = (dev->use_image_view) ? bc7_iv_spv_len : bc7_spv_len;
+			break;
+	}
+}
+
+/*
+ * Creates the pipeline of one family. With shader module identifiers from a
+ * previous run the pipeline is first requested from the pipeline cache
+ * alone, without touching the SPIR-V; if the driver would have to compile
+ * it, or there is no identifier yet, it is built from the SPIR-V and the
+ * identifier is recorded for the next run.
+ */
+static VkResult
+create_bcn_pipeline(struct device *dev, enum bcn_family family, bool *compiled)
 {
 	VkResult result;
 	VkLayerDispatchTable table = dev->table;
 	VkDevice device = dev->handle;
 
-	VkShaderModule s3tcShaderModule;
-	VkShaderModuleCreateInfo s3tc_shader_info = {
-		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+	VkComputePipelineCreateInfo pipeline_create_info = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
 		.pNext = nullptr,
-		.flags = 0,
-		.codeSize = (dev->use_image_view) ? s3tc_iv_spv_len : s3tc_spv_len,
-		.pCode = (dev->use_image_view) ? (const uint32_t *)s3tc_iv_spv : (const uint32_t *)s3tc_spv
+		.flags = pipeline_stats_flags(dev),
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = VK_NULL_HANDLE,
+			.pName = "main",
+			.pSpecializationInfo = nullptr
+		},
+		.layout = dev->layout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
 	};
 
-	VkShaderModule rgtcShaderModule;
-	VkShaderModuleCreateInfo rgtc_shader_info = {
+	if (dev->use_module_identifiers && !dev->moduleIdentifiers[family].empty()) {
+		VkPipelineShaderStageModuleIdentifierCreateInfoEXT identifier_info = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_MODULE_IDENTIFIER_CREATE_INFO_EXT,
+			.pNext = nullptr,
+			.identifierSize = (uint32_t)dev->moduleIdentifiers[family].size(),
+			.pIdentifier = dev->moduleIdentifiers[family].data()
+		};
+
+		pipeline_create_info.flags |= VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+		pipeline_create_info.stage.pNext = &identifier_info;
+
+		result = table.CreateComputePipelines(device,
+			dev->pipelineCache, 1, &pipeline_create_info, NULL, &dev->pipelines[family]);
+
+		if (result == VK_SUCCESS)
+			return VK_SUCCESS;
+
+		pipeline_create_info.flags &= ~VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+		pipeline_create_info.stage.pNext = nullptr;
+	}
+
+	VkShaderModuleCreateInfo shader_info = {
 		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
 		.pNext = nullptr,
 		.flags = 0,
-		.codeSize = (dev->use_image_view) ? rgtc_iv_spv_len : rgtc_spv_len,
-		.pCode = (dev->use_image_view) ? (const uint32_t *)rgtc_iv_spv : (const uint32_t *)rgtc_spv
+		.codeSize = 0,
+		.pCode = nullptr
 	};
 
-	VkShaderModule bc6ShaderModule;
-	VkShaderModuleCreateInfo bc6_shader_info = {
-	    .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-	    .pNext = nullptr,
-	    .flags = 0,
-	    .codeSize = (dev->use_image_view) ? bc6_iv_spv_len : bc6_spv_len,
-	    .pCode = (dev->use_image_view) ? (const uint32_t *)bc6_iv_spv : (const uint32_t *)bc6_spv
-	};
+	get_bcn_spirv(dev, family, &shader_info.pCode, &shader_info.codeSize);
 
-	VkShaderModule bc7ShaderModule;
-	VkShaderModuleCreateInfo bc7_shader_info = {
-		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-	    .pNext = nullptr,
-	    .flags = 0,
-	    .codeSize = (dev->use_image_view) ? bc7_iv_spv_len : bc7_spv_len,
-	    .pCode = (dev->use_image_view) ? (const uint32_t *)bc7_iv_spv : (const uint32_t *)bc7_spv
-	};
+	result = table.CreateShaderModule(device, &shader_info, nullptr, &pipeline_create_info.stage.module);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to create shader module, res %d", result);
+		return result;
+	}
 
-	table.CreateShaderModule(device, &s3tc_shader_info, nullptr, &s3tcShaderModule);
-	table.CreateShaderModule(device, &bc6_shader_info, nullptr, &bc6ShaderModule);
-	table.CreateShaderModule(device, &bc7_shader_info, nullptr, &bc7ShaderModule);
-	table.CreateShaderModule(device, &rgtc_shader_info, nullptr, &rgtcShaderModule);
+	if (dev->use_module_identifiers) {
+		VkShaderModuleIdentifierEXT identifier = {
+			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT,
+			.pNext = nullptr
+		};
+
+		table.GetShaderModuleIdentifierEXT(device, pipeline_create_info.stage.module, &identifier);
+		dev->moduleIdentifiers[family].assign(identifier.identifier, identifier.identifier + identifier.identifierSize);
+	}
+
+	result = table.CreateComputePipelines(device,
+		dev->pipelineCache, 1, &pipeline_create_info, NULL, &dev->pipelines[family]);
+
+	table.DestroyShaderModule(device, pipeline_create_info.stage.module, nullptr);
+
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to create compute pipeline, res %d", result);
+		return result;
+	}
+
+	*compiled = true;
+
+	return VK_SUCCESS;
+}
+
+/*
+ * Runs on a background thread started at device creation, so apps that
+ * never touch a BC texture do not wait for the compiles. Families that were
+ * requested are built first, the rest in order.
+ */
+static void
+compile_bcn_pipelines(struct device *dev)
+{
+	auto start = std::chrono::steady_clock::now();
+	bool compiled = false;
+
+	pipeline_cache_load(dev);
+
+	for (;;) {
+		int family = -1;
 
-	VkPipelineShaderStageCreateInfo shader_stage_infos[] = {
-		{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
-			.module = s3tcShaderModule,
-			.pName = "main",
-			.pSpecializationInfo = nullptr
-		},
-		{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
-			.module = rgtcShaderModule,
-			.pName = "main",
-			.pSpecializationInfo = nullptr
-		},
 		{
-		    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-		    .pNext = nullptr,
-		    .flags = 0,
-		    .stage = VK_SHADER_STAGE_COMPUTE_BIT,                                                   
-		    .module = bc6ShaderModule,                                                              
-		    .pName = "main",
-		    .pSpecializationInfo = nullptr                                                      
-		},
+			std::lock_guard<std::mutex> l(dev->pipelineLock);
+
+			for (int i = 0; i < BCN_FAMILY_COUNT && family < 0; i++) {
+				if (dev->pipelineState[i] == BCN_PIPELINE_PENDING && dev->pipelineWanted[i])
+					family = i;
+			}
+
+			for (int i = 0; i < BCN_FAMILY_COUNT && family < 0; i++) {
+				if (dev->pipelineState[i] == BCN_PIPELINE_PENDING)
+					family = i;
+			}
+
+			if (family < 0)
+				break;
+
+			dev->pipelineState[family] = BCN_PIPELINE_BUILDING;
+		}
+
+		if (create_bcn_pipeline(dev, (enum bcn_family)family, &compiled) != VK_SUCCESS)
+			dev->pipelines[family] = VK_NULL_HANDLE;
+
 		{
-		    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-		    .pNext = nullptr,
-		    .flags = 0,
-		    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
-		    .module = bc7ShaderModule,
-		    .pName = "main",
-		    .pSpecializationInfo = nullptr
+			std::lock_guard<std::mutex> l(dev->pipelineLock);
+			dev->pipelineState[family] = BCN_PIPELINE_READY;
 		}
-	};
+		dev->pipelineCond.notify_all();
+
+		/* After the pipeline is published, waiting decodes do not pay for the logging. */
+		pipeline_stats_log(dev, get_bcn_family_name((enum bcn_family)family), dev->pipelines[family]);
+	}
+
+	/* Persist right away so a crash before DestroyDevice keeps the work. */
+	if (compiled)
+		pipeline_cache_save(dev);
+
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+	Logger::log("info", "Decode pipelines ready in %.2f ms", elapsed.count());
+}
+
+VkResult
+create_bcn_compute_pipelines(struct device *dev)
+{
+	VkResult result;
+	VkLayerDispatchTable table = dev->table;
+	VkDevice device = dev->handle;
 
 	VkDescriptorSetLayoutBinding bindings[] = {
 		{
@@ -283,76 +314,125 @@ create_bcn_compute_pipelines(struct device *dev)
 		return result;
 	}
 
-	VkComputePipelineCreateInfo pipeline_create_info[] = {
-	    {
-			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.stage = shader_stage_infos[0],
-			.layout = dev->layout,
-			.basePipelineHandle = VK_NULL_HANDLE,
-			.basePipelineIndex = -1
-		},
-		{
-			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.stage = shader_stage_infos[1],
-			.layout = dev->layout,
-			.basePipelineHandle = VK_NULL_HANDLE,
-			.basePipelineIndex = -1
-		},
-		{
-		    .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-		    .pNext = nullptr,
-		    .flags = 0,
-		    .stage = shader_stage_infos[2],
-		    .layout = dev->layout,
-		    .basePipelineHandle = VK_NULL_HANDLE,                                                   
-		    .basePipelineIndex = -1                                                             
-		},
-		{
-		    .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-		    .pNext = nullptr,
-		    .flags = 0,
-		    .stage = shader_stage_infos[3],
-		    .layout = dev->layout,
-		    .basePipelineHandle = VK_NULL_HANDLE,
-		    .basePipelineIndex = -1
-		}
+	result = create_new_pool(dev);
+
+	if (result != VK_SUCCESS)
+		return result;
+
+	for (int family = 0; family < BCN_FAMILY_COUNT; family++)
+		dev->pipelineState[family] = BCN_PIPELINE_PENDING;
+
+	if (dev->use_async_pipelines)
+		dev->pipelineThread = std::thread(compile_bcn_pipelines, dev);
+	else
+		compile_bcn_pipelines(dev);
+	
+	return VK_SUCCESS;
+}
+
+/*
+ * Makes the family jump the compile queue, used as soon as the application
+ * creates an image that will need it.
+ */
+void
+request_bcn_pipeline(struct device *dev, enum bcn_family family)
+{
+	std::lock_guard<std::mutex> l(dev->pipelineLock);
+
+	dev->pipelineWanted[family] = true;
+}
+
+/* Blocks until the pipeline of the family has been compiled. */
+VkPipeline
+get_bcn_pipeline(struct device *dev, enum bcn_family family)
+{
+	std::unique_lock<std::mutex> l(dev->pipelineLock);
+
+	dev->pipelineWanted[family] = true;
+	dev->pipelineCond.wait(l, [&]() {
+		return dev->pipelineState[family] == BCN_PIPELINE_READY;
+	});
+
+	return dev->pipelines[family];
+}
+
+void
+wait_bcn_pipelines(struct device *dev)
+{
+	if (dev->pipelineThread.joinable())
+		dev->pipelineThread.join();
+}
+
+/*
+ * Descriptor sets are handed back by the retirement tracker once the GPU is
+ * done with them, so any pool may have room again: they are all tried, most
+ * recent first, before a new one is created.
+ */
+VkResult
+allocate_bcn_descriptor_set(struct device *dev, VkDescriptorSetLayout setLayout, VkDescriptorPool *pool, VkDescriptorSet *set)
+{
+	VkResult result = VK_ERROR_OUT_OF_POOL_MEMORY;
+
+	scoped_lock l(descriptor_lock);
+
+	VkDescriptorSetAllocateInfo desc_alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = VK_NULL_HANDLE,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &setLayout
 	};
 
-	VkPipeline pipelines[4];
+	for (auto it = dev->pools.rbegin(); it != dev->pools.rend(); ++it) {
+		desc_alloc_info.descriptorPool = *it;
+		result = dev->table.AllocateDescriptorSets(dev->handle, &desc_alloc_info, set);
+		if (result == VK_SUCCESS) {
+			*pool = *it;
+			stats_gauge_add(BCN_STAT_DESCRIPTOR_SETS, BCN_STAT_DESCRIPTOR_PEAK, 1);
+			return VK_SUCCESS;
+		}
+	}
 
-	result = table.CreateComputePipelines(device,
-		VK_NULL_HANDLE, 4, pipeline_create_info, NULL, pipelines);
+	if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+		return result;
 
-	if (result != VK_SUCCESS) {
-		Logger::log("error", "Failed to create compute pipeline, res %d", result);
+	result = create_new_pool(dev);
+	if (result != VK_SUCCESS)
 		return result;
+
+	desc_alloc_info.descriptorPool = dev->pools.back();
+	result = dev->table.AllocateDescriptorSets(dev->handle, &desc_alloc_info, set);
+	if (result == VK_SUCCESS) {
+		*pool = dev->pools.back();
+		stats_gauge_add(BCN_STAT_DESCRIPTOR_SETS, BCN_STAT_DESCRIPTOR_PEAK, 1);
 	}
 
-	dev->s3tcPipeline = pipelines[0];
-	dev->rgtcPipeline = pipelines[1];
-	dev->bc6Pipeline = pipelines[2];
-	dev->bc7Pipeline = pipelines[3];
+	return result;
+}
 
-	table.DestroyShaderModule(device, s3tcShaderModule, nullptr);
-	table.DestroyShaderModule(device, bc6ShaderModule, nullptr);
-	table.DestroyShaderModule(device, bc7ShaderModule, nullptr);
-	table.DestroyShaderModule(device, rgtcShaderModule, nullptr);
+/* Frees retired descriptor sets, with one call per pool. */
+void
+free_bcn_descriptor_sets(struct device *dev, std::vector<std::pair<VkDescriptorPool, VkDescriptorSet>> &sets)
+{
+	scoped_lock l(descriptor_lock);
 
-	result = create_new_pool(dev);
+	stats_sub(BCN_STAT_DESCRIPTOR_SETS, sets.size());
+	std::sort(sets.begin(), sets.end());
 
-	if (result != VK_SUCCESS)
-		return result;
-	
-	return VK_SUCCESS;
+	for (size_t i = 0; i < sets.size();) {
+		std::vector<VkDescriptorSet> batch;
+		VkDescriptorPool pool = sets[i].first;
+
+		for (; i < sets.size() && sets[i].first == pool; i++)
+			batch.push_back(sets[i].second);
+
+		dev->table.FreeDescriptorSets(dev->handle, pool, batch.size(), batch.data());
+	}
 }
 
 VkResult
 decompress_bcn_compute(struct device *dev,
-		       		   VkCommandBuffer commandbuffer,
+		       		   struct command_buffer *cb,
 		       		   VkFormat format,
 		       		   VkBufferImageCopy *copy_region,
 		       		   struct buffer *srcBuffer,
@@ -363,6 +443,7 @@ decompress_bcn_compute(struct device *dev,
 	VkResult result;
 	VkLayerDispatchTable table;
 	VkDevice device;
+	VkCommandBuffer commandbuffer = cb->handle;
 
 	table = dev->table;
 	device = dev->handle;
@@ -385,32 +466,24 @@ decompress_bcn_compute(struct device *dev,
 		.offsetY = offsetY
 	};
 
+	VkDescriptorPool descriptorPool;
 	VkDescriptorSet descriptorSet;
-	VkDescriptorSetAllocateInfo desc_alloc_info = {
-		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-		.pNext = nullptr,
-		.descriptorPool = dev->pools.back(),
-		.descriptorSetCount = 1,
-		.pSetLayouts = &dev->setLayout
-	};
-
-	result = table.AllocateDescriptorSets(device,
-		&desc_alloc_info, &descriptorSet);
-
-	if (result == VK_ERROR_OUT_OF_POOL_MEMORY) {
-		create_new_pool(dev);
 
-		desc_alloc_info.descriptorPool = dev->pools.back();
-
-		result = table.AllocateDescriptorSets(device,
-			&desc_alloc_info, &descriptorSet);
+	result = allocate_bcn_descriptor_set(dev, dev->setLayout, &descriptorPool, &descriptorSet);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to allocate descriptor set, res %d", result);
+		return result;
 	}
 
+	cb->transients.descriptorSets.push_back({ descriptorPool, descriptorSet });
+
 	VkWriteDescriptorSet desc_writes[2];
+	VkDescriptorBufferInfo dst_info;
+	VkDescriptorImageInfo image_info;
 	
 	VkDescriptorBufferInfo src_info = {
 		.buffer = srcBuffer->handle,
-		.offset = static_cast<VkDeviceSize>(offset),
+		.offset = copy_region->bufferOffset,
 		.range = VK_WHOLE_SIZE
 	};
 	
@@ -433,7 +506,7 @@ decompress_bcn_compute(struct device *dev,
 	desc_writes[1].descriptorCount = 1;
 
 	if (!use_image_view) {
-		VkDescriptorBufferInfo dst_info = {
+		dst_info = {
 			.buffer = stagingBuffer->handle,
 			.offset = 0,
 			.range = VK_WHOLE_SIZE
@@ -470,9 +543,15 @@ decompress_bcn_compute(struct device *dev,
 		};
 
 		VkImageView dstImageView;
-		table.CreateImageView(dev->handle, &viewCreateInfo, nullptr, &dstImageView);
+		result = table.CreateImageView(dev->handle, &viewCreateInfo, nullptr, &dstImageView);
+		if (result != VK_SUCCESS) {
+			Logger::log("error", "Failed to create decode image view, res %d", result);
+			return result;
+		}
+
+		cb->transients.imageViews.push_back(dstImageView);
 
-		VkDescriptorImageInfo image_info = {
+		image_info = {
 			.sampler = VK_NULL_HANDLE,
 			.imageView = dstImageView,
 			.imageLayout = VK_IMAGE_LAYOUT_GENERAL
@@ -487,20 +566,10 @@ decompress_bcn_compute(struct device *dev,
 	table.UpdateDescriptorSets(device,
 		2, desc_writes, 0, NULL);
   
-    VkPipeline bcnPipeline;
-    if (is_s3tc(format)) {
-    	bcnPipeline = dev->s3tcPipeline;
-    }
-    else if (is_rgtc(format)) {
-    	bcnPipeline = dev->rgtcPipeline;
-    }
-    else if(is_bc6(format)) {
-    	bcnPipeline = dev->bc6Pipeline;
-    }
-    else {
-    	bcnPipeline = dev->bc7Pipeline;
-    }
-    
+    VkPipeline bcnPipeline = get_bcn_pipeline(dev, get_bcn_family(format));
+    if (bcnPipeline == VK_NULL_HANDLE)
+    	return VK_ERROR_INITIALIZATION_FAILED;
+
 	table.CmdBindPipeline(commandbuffer,
 		VK_PIPELINE_BIND_POINT_COMPUTE, bcnPipeline);
 
@@ -526,6 +595,7 @@ decompress_bcn_compute(struct device *dev,
 		table.CmdPipelineBarrier(commandbuffer, 
 			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 
 			0, 0, nullptr, 0, nullptr, 1, &first_barrier);
+		stats_add(BCN_STAT_BARRIERS, 1);
 	}
 
 	table.CmdPushConstants(commandbuffer,
@@ -538,6 +608,7 @@ decompress_bcn_compute(struct device *dev,
 
 	table.CmdDispatch(commandbuffer,
 		(width + 7) / 8, (height + 7) / 8, 1);
+	stats_add(BCN_STAT_DISPATCHES, 1);
 
 	if (use_image_view) {
 		VkImageMemoryBarrier second_barrier = {
@@ -563,6 +634,7 @@ decompress_bcn_compute(struct device *dev,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
 		    0, 0, nullptr, 0, nullptr, 1, &second_barrier);
+		stats_add(BCN_STAT_BARRIERS, 1);
 	}
 
 	return VK_SUCCESS;
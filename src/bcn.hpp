@@ -2,6 +2,11 @@
 #define __BCN_HPP
 
 #include "bcn_layer.hpp"
+#include "format.hpp"
+
+struct command_buffer;
+struct buffer;
+struct image;
 
 struct push_constants {
 	int format;
@@ -14,15 +19,16 @@ struct push_constants {
 	int use_image_view;
 };
 
-bool is_s3tc(VkFormat);
-bool is_rgtc(VkFormat);
-bool is_bc6(VkFormat);
-bool is_bc7(VkFormat);
 bool is_supported_bcn_format(struct device *, VkFormat);
-VkFormat get_format_for_bcn(VkFormat);
+void get_bcn_spirv(struct device *dev, enum bcn_family family, const uint32_t **code, size_t *size);
 VkResult create_bcn_compute_pipelines(struct device *dev);
+void request_bcn_pipeline(struct device *dev, enum bcn_family family);
+VkPipeline get_bcn_pipeline(struct device *dev, enum bcn_family family);
+void wait_bcn_pipelines(struct device *dev);
+VkResult allocate_bcn_descriptor_set(struct device *dev, VkDescriptorSetLayout setLayout, VkDescriptorPool *pool, VkDescriptorSet *set);
+void free_bcn_descriptor_sets(struct device *dev, std::vector<std::pair<VkDescriptorPool, VkDescriptorSet>> &sets);
 VkResult decompress_bcn_compute(struct device *dev,
-                       			VkCommandBuffer commandbuffer,
+                       			struct command_buffer *cb,
                        			VkFormat format,
                        			VkBufferImageCopy *copy_region,
                        			struct buffer *srcBuffer,
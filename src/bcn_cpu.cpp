@@ -0,0 +1,1506 @@
+/* Copyright (c) 2020-2024 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * CPU ports of the decode shaders. They follow the GLSL closely, float math
+ * included, so the output matches what the compute path writes in buffer
+ * mode: packed RGBA8 for BC1-5 and BC7, RGBA16F for BC6H.
+ */
+
+#include "bcn_cpu.hpp"
+#include "format.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+struct bc_payload {
+	uint32_t x, y, z, w;
+
+	uint32_t operator[](int i) const {
+		return i == 0 ? x : i == 1 ? y : i == 2 ? z : w;
+	}
+};
+
+struct ivec2 {
+	int x, y;
+	constexpr ivec2(int x, int y) : x(x), y(y) {}
+};
+
+template <int N>
+struct ivec {
+	int v[N];
+
+	ivec() : v{} {}
+	ivec(int s) { for (int i = 0; i < N; i++) v[i] = s; }
+	ivec(const ivec<3> &rgb, int a) : v{rgb.v[0], rgb.v[1], rgb.v[2], a} {}
+	template <typename A, typename B, typename... T>
+	ivec(A a, B b, T... rest) : v{(int)a, (int)b, (int)rest...} {}
+
+	int &operator[](int i) { return v[i]; }
+	int operator[](int i) const { return v[i]; }
+};
+
+typedef ivec<3> ivec3;
+typedef ivec<4> ivec4;
+typedef ivec<4> uvec4;
+
+#define IVEC_OP(op) \
+template <int N> inline ivec<N> operator op(const ivec<N> &a, const ivec<N> &b) { \
+	ivec<N> r; for (int i = 0; i < N; i++) r.v[i] = a.v[i] op b.v[i]; return r; } \
+template <int N> inline ivec<N> operator op(const ivec<N> &a, int b) { \
+	ivec<N> r; for (int i = 0; i < N; i++) r.v[i] = a.v[i] op b; return r; } \
+template <int N> inline ivec<N> operator op(int a, const ivec<N> &b) { \
+	ivec<N> r; for (int i = 0; i < N; i++) r.v[i] = a op b.v[i]; return r; }
+
+IVEC_OP(+)
+IVEC_OP(-)
+IVEC_OP(*)
+IVEC_OP(<<)
+IVEC_OP(>>)
+IVEC_OP(&)
+IVEC_OP(|)
+
+#undef IVEC_OP
+
+template <int N>
+inline ivec<N> &operator+=(ivec<N> &a, const ivec<N> &b) {
+	for (int i = 0; i < N; i++)
+		a.v[i] += b.v[i];
+	return a;
+}
+
+static uint32_t
+extract_field(const bc_payload &payload, int offset, int bits)
+{
+	if (bits <= 0)
+		return 0;
+
+	uint64_t lo = payload[offset >> 5];
+	uint64_t hi = (offset >> 5) < 3 ? payload[(offset >> 5) + 1] : 0;
+	uint64_t value = (lo | (hi << 32)) >> (offset & 31);
+
+	return (uint32_t)(value & ((1ull << bits) - 1));
+}
+
+static int
+extract_bits(const bc_payload &payload, int offset, int bits)
+{
+	return (int)extract_field(payload, offset, bits);
+}
+
+static int
+extract_bits_sign(const bc_payload &payload, int offset, int bits)
+{
+	if (bits <= 0)
+		return 0;
+
+	return (int)(extract_field(payload, offset, bits) << (32 - bits)) >> (32 - bits);
+}
+
+static int
+extract_bits_reverse(const bc_payload &payload, int offset, int bits)
+{
+	uint32_t value = extract_field(payload, offset, bits);
+	uint32_t result = 0;
+
+	for (int i = 0; i < bits; i++)
+		result |= ((value >> i) & 1) << (bits - 1 - i);
+
+	return (int)result;
+}
+
+static float
+srgb_decode(float c)
+{
+	return c < 0.04045f ? (1.0f / 12.92f) * c : powf((c + 0.055f) * (1.0f / 1.055f), 2.4f);
+}
+
+static uint32_t
+pack_unorm4x8(const float c[4])
+{
+	uint32_t packed = 0;
+
+	for (int i = 0; i < 4; i++) {
+		float v = std::min(std::max(c[i], 0.0f), 1.0f);
+		packed |= (uint32_t)lrintf(v * 255.0f) << (8 * i);
+	}
+
+	return packed;
+}
+
+static float
+mixf(float a, float b, float t)
+{
+	return a * (1.0f - t) + b * t;
+}
+
+/* rgtc.h */
+static float
+decode_alpha_rgtc(uint32_t x, uint32_t y, int linear_pixel)
+{
+	float ep0 = float(x & 0xffu) / 255.0f;
+	float ep1 = float((x >> 8) & 0xffu) / 255.0f;
+	bool range7 = ep0 > ep1;
+	bc_payload payload = { x, y, 0, 0 };
+	uint32_t bits = extract_field(payload, 16 + linear_pixel * 3, 3);
+
+	if (bits < 2)
+		return bits != 0 ? ep1 : ep0;
+	else if (range7)
+		return mixf(ep0, ep1, (1.0f / 7.0f) * float(bits - 1));
+	else if (bits > 5)
+		return float(bits & 1);
+
+	return mixf(ep0, ep1, (1.0f / 5.0f) * float(bits - 1));
+}
+
+/* s3tc.comp */
+static uint32_t
+decode_s3tc_texel(VkFormat format, const bc_payload &payload, int linear_pixel)
+{
+	bool is_bc1 = format <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+	uint32_t color0_word = is_bc1 ? payload.x : payload.z;
+	uint32_t color_bits = is_bc1 ? payload.y : payload.w;
+	uint32_t color0 = color0_word & 0xffffu;
+	uint32_t color1 = color0_word >> 16;
+	bool opaque_mode = format > VK_FORMAT_BC1_RGBA_SRGB_BLOCK || color0 > color1;
+	int bits = (color_bits >> (2 * linear_pixel)) & 3;
+	float ep0[3] = { float((color0 >> 11) & 31) / 31.0f, float((color0 >> 5) & 63) / 63.0f, float(color0 & 31) / 31.0f };
+	float ep1[3] = { float((color1 >> 11) & 31) / 31.0f, float((color1 >> 5) & 63) / 63.0f, float(color1 & 31) / 31.0f };
+	float decoded[4];
+
+	for (int i = 0; i < 3; i++) {
+		if (opaque_mode)
+			decoded[i] = bits < 2 ? (bits != 0 ? ep1[i] : ep0[i]) : mixf(ep0[i], ep1[i], (1.0f / 3.0f) * float(bits - 1));
+		else if (bits == 3)
+			decoded[i] = 0.0f;
+		else
+			decoded[i] = bits == 0 ? ep0[i] : bits == 1 ? ep1[i] : 0.5f * (ep0[i] + ep1[i]);
+	}
+	decoded[3] = (!opaque_mode && bits == 3) ? 0.0f : 1.0f;
+
+	switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			decoded[3] = 1.0f;
+			break;
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK: {
+			uint32_t offset = linear_pixel * 4;
+			decoded[3] = float((payload[offset >> 5] >> (offset & 31)) & 0xf) / 15.0f;
+			break;
+		}
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			decoded[3] = decode_alpha_rgtc(payload.x, payload.y, linear_pixel);
+			break;
+		default:
+			break;
+	}
+
+	switch (format) {
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			for (int i = 0; i < 3; i++)
+				decoded[i] = srgb_decode(decoded[i]);
+			break;
+		default:
+			break;
+	}
+
+	return pack_unorm4x8(decoded);
+}
+
+/* rgtc.comp */
+static uint32_t
+decode_rgtc_texel(VkFormat format, const bc_payload &payload, int linear_pixel)
+{
+	float rg[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	rg[0] = decode_alpha_rgtc(payload.x, payload.y, linear_pixel);
+	if (format == VK_FORMAT_BC5_UNORM_BLOCK || format == VK_FORMAT_BC5_SNORM_BLOCK)
+		rg[1] = decode_alpha_rgtc(payload.z, payload.w, linear_pixel);
+
+	return pack_unorm4x8(rg);
+}
+
+namespace bc6 {
+
+static thread_local bool is_signed = false;
+
+static const int weight_table3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const int weight_table4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+#define P2(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p) \
+	(((a) << 0) | ((b) << 1) | ((c) << 2) | ((d) << 3) | \
+	((e) << 4) | ((f) << 5) | ((g) << 6) | ((h) << 7) | \
+	((i) << 8) | ((j) << 9) | ((k) << 10) | ((l) << 11) | \
+	((m) << 12) | ((n) << 13) | ((o) << 14) | ((p) << 15))
+
+static const int partition_table2[32] = {
+	P2(0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1),
+	P2(0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1),
+	P2(0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1),
+	P2(0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1),
+	P2(0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1),
+
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1),
+	P2(0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1),
+	P2(0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1),
+
+	P2(0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1),
+	P2(0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0),
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0),
+	P2(0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0),
+	P2(0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0),
+	P2(0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0),
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0),
+	P2(0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1),
+
+	P2(0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0),
+	P2(0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0),
+	P2(0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0),
+	P2(0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0),
+	P2(0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0),
+	P2(0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0),
+	P2(0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0),
+	P2(0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0)};
+
+static const int anchor_table2[32] = {
+	15, 15, 15, 15, 15, 15, 15, 15,
+	15, 15, 15, 15, 15, 15, 15, 15,
+	15, 2, 8, 2, 2, 8, 8, 15,
+	2, 8, 2, 2, 8, 8, 2, 2};
+
+struct DecodedInterpolation
+{
+	ivec3 ep0, ep1;
+	int weight;
+
+	DecodedInterpolation(ivec3 ep0, ivec3 ep1, int weight) : ep0(ep0), ep1(ep1), weight(weight) {}
+};
+
+static ivec3
+interpolate_endpoint(const DecodedInterpolation &interp)
+{
+	return ((64 - interp.weight) * interp.ep0 + interp.weight * interp.ep1 + 32) >> 6;
+}
+
+static ivec3
+unquantize_endpoint(ivec3 ep, int bits)
+{
+	ivec3 unq;
+
+	for (int i = 0; i < 3; i++) {
+		int e = ep[i];
+
+		if (is_signed) {
+			e = (int)((uint32_t)e << (32 - bits)) >> (32 - bits);
+			if (bits < 16) {
+				int sgn = 1 - ((e >> 30) & 2);
+				int abs_e = std::abs(e);
+				int u = ((abs_e << 15) + 0x4000) >> (bits - 1);
+				if (e == 0)
+					u = 0;
+				if (abs_e >= (1 << (bits - 1)) - 1)
+					u = 0x7fff;
+				unq[i] = u * sgn;
+			}
+			else
+				unq[i] = e;
+		}
+		else {
+			e = (int)((uint32_t)e & ((1u << bits) - 1));
+			if (bits < 15) {
+				int u = ((e << 15) + 0x4000) >> (bits - 1);
+				if (e == 0)
+					u = 0;
+				if (e == (1 << bits) - 1)
+					u = 0xffff;
+				unq[i] = u;
+			}
+			else
+				unq[i] = e;
+		}
+	}
+
+	return unq;
+}
+
+static DecodedInterpolation decode_bc6_mode0(const bc_payload &payload, int linear_pixel, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 10);
+	int g0 = extract_bits(payload, 15, 10);
+	int b0 = extract_bits(payload, 25, 10);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 5);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits_sign(payload, 2, 1) << 4);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits_sign(payload, 3, 1) << 4);
+
+		int r3 = extract_bits_sign(payload, 71, 5);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 40, 1) << 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 60, 1) << 1) | (extract_bits(payload, 70, 1) << 2) |
+				(extract_bits(payload, 76, 1) << 3) | (extract_bits_sign(payload, 4, 1) << 4);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 5);
+		int g1 = extract_bits_sign(payload, 45, 5);
+		int b1 = extract_bits_sign(payload, 55, 5);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 10);
+	ep1 = unquantize_endpoint(ep1, 10);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode1(const bc_payload &payload, int linear_pixel, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 7);
+	int g0 = extract_bits(payload, 15, 7);
+	int b0 = extract_bits(payload, 25, 7);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 6);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits(payload, 24, 1) << 4) | (extract_bits_sign(payload, 2, 1) << 5);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits(payload, 14, 1) << 4) | (extract_bits_sign(payload, 22, 1) << 5);
+
+		int r3 = extract_bits_sign(payload, 71, 6);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 3, 2) << 4);
+		int b3 = extract_bits(payload, 12, 2) | (extract_bits(payload, 23, 1) << 2) | (extract_bits(payload, 32, 1) << 3) |
+				(extract_bits(payload, 34, 1) << 4) | (extract_bits_sign(payload, 33, 1) << 5);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 6);
+		int g1 = extract_bits_sign(payload, 45, 6);
+		int b1 = extract_bits_sign(payload, 55, 6);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 7);
+	ep1 = unquantize_endpoint(ep1, 7);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode2(const bc_payload &payload, int linear_pixel, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits(payload, 40, 1) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits(payload, 49, 1) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits(payload, 59, 1) << 10);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 5);
+		int g2 = extract_bits_sign(payload, 41, 4);
+		int b2 = extract_bits_sign(payload, 61, 4);
+
+		int r3 = extract_bits_sign(payload, 71, 5);
+		int g3 = extract_bits_sign(payload, 51, 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 60, 1) << 1) |
+				(extract_bits(payload, 70, 1) << 2) | (extract_bits_sign(payload, 76, 1) << 3);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 5);
+		int g1 = extract_bits_sign(payload, 45, 4);
+		int b1 = extract_bits_sign(payload, 55, 4);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 11);
+	ep1 = unquantize_endpoint(ep1, 11);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode3(const bc_payload &payload, int linear_pixel)
+{
+	int r0 = extract_bits(payload, 5, 10);
+	int g0 = extract_bits(payload, 15, 10);
+	int b0 = extract_bits(payload, 25, 10);
+	int r1 = extract_bits(payload, 35, 10);
+	int g1 = extract_bits(payload, 45, 10);
+	int b1 = extract_bits(payload, 55, 10);
+
+	ivec3 ep0 = ivec3(r0, g0, b0);
+	ivec3 ep1 = ivec3(r1, g1, b1);
+	ep0 = unquantize_endpoint(ep0, 10);
+	ep1 = unquantize_endpoint(ep1, 10);
+
+	int index = extract_bits(
+		payload,
+		std::max(64 + linear_pixel * 4, 65),
+		linear_pixel == 0 ? 3 : 4);
+
+	int w = weight_table4[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode6(const bc_payload &payload, int linear_pixel, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits(payload, 39, 1) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits(payload, 50, 1) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits(payload, 59, 1) << 10);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 4);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits_sign(payload, 75, 1) << 4);
+		int b2 = extract_bits_sign(payload, 61, 4);
+
+		int r3 = extract_bits_sign(payload, 71, 4);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 40, 1) << 4);
+		int b3 = extract_bits(payload, 69, 1) | (extract_bits(payload, 60, 1) << 1) |
+				(extract_bits(payload, 70, 1) << 2) | (extract_bits_sign(payload, 76, 1) << 3);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 4);
+		int g1 = extract_bits_sign(payload, 45, 5);
+		int b1 = extract_bits_sign(payload, 55, 4);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 11);
+	ep1 = unquantize_endpoint(ep1, 11);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode7(const bc_payload &payload, int linear_pixel)
+{
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits(payload, 44, 1) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits(payload, 54, 1) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits(payload, 64, 1) << 10);
+
+	int r1 = extract_bits_sign(payload, 35, 9);
+	int g1 = extract_bits_sign(payload, 45, 9);
+	int b1 = extract_bits_sign(payload, 55, 9);
+
+	r1 += r0;
+	g1 += g0;
+	b1 += b0;
+
+	ivec3 ep0 = ivec3(r0, g0, b0);
+	ivec3 ep1 = ivec3(r1, g1, b1);
+	ep0 = unquantize_endpoint(ep0, 11);
+	ep1 = unquantize_endpoint(ep1, 11);
+
+	int index = extract_bits(
+		payload,
+		std::max(64 + linear_pixel * 4, 65),
+		linear_pixel == 0 ? 3 : 4);
+
+	int w = weight_table4[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode10(const bc_payload &payload, int linear_pixel, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits(payload, 39, 1) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits(payload, 49, 1) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits(payload, 60, 1) << 10);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 4);
+		int g2 = extract_bits_sign(payload, 41, 4);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits_sign(payload, 40, 1) << 4);
+
+		int r3 = extract_bits_sign(payload, 71, 4);
+		int g3 = extract_bits_sign(payload, 51, 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 69, 2) << 1) |
+				(extract_bits(payload, 76, 1) << 3) | (extract_bits_sign(payload, 75, 1) << 4);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 4);
+		int g1 = extract_bits_sign(payload, 45, 4);
+		int b1 = extract_bits_sign(payload, 55, 5);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 11);
+	ep1 = unquantize_endpoint(ep1, 11);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode11(const bc_payload &payload, int linear_pixel)
+{
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits_reverse(payload, 43, 2) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits_reverse(payload, 53, 2) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits_reverse(payload, 63, 2) << 10);
+
+	int r1 = extract_bits_sign(payload, 35, 8);
+	int g1 = extract_bits_sign(payload, 45, 8);
+	int b1 = extract_bits_sign(payload, 55, 8);
+
+	r1 += r0;
+	g1 += g0;
+	b1 += b0;
+
+	ivec3 ep0 = ivec3(r0, g0, b0);
+	ivec3 ep1 = ivec3(r1, g1, b1);
+	ep0 = unquantize_endpoint(ep0, 12);
+	ep1 = unquantize_endpoint(ep1, 12);
+
+	int index = extract_bits(
+		payload,
+		std::max(64 + linear_pixel * 4, 65),
+		linear_pixel == 0 ? 3 : 4);
+
+	int w = weight_table4[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode14(const bc_payload &payload, int linear_pixel, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 9);
+	int g0 = extract_bits(payload, 15, 9);
+	int b0 = extract_bits(payload, 25, 9);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 5);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits_sign(payload, 24, 1) << 4);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits_sign(payload, 14, 1) << 4);
+
+		int r3 = extract_bits_sign(payload, 71, 5);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 40, 1) << 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 60, 1) << 1) |
+				(extract_bits(payload, 70, 1) << 2) |
+				(extract_bits(payload, 76, 1) << 3) | (extract_bits_sign(payload, 34, 1) << 4);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 5);
+		int g1 = extract_bits_sign(payload, 45, 5);
+		int b1 = extract_bits_sign(payload, 55, 5);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 9);
+	ep1 = unquantize_endpoint(ep1, 9);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode15(const bc_payload &payload, int linear_pixel)
+{
+	int r0 = extract_bits(payload, 5, 10) | (extract_bits_reverse(payload, 39, 6) << 10);
+	int g0 = extract_bits(payload, 15, 10) | (extract_bits_reverse(payload, 49, 6) << 10);
+	int b0 = extract_bits(payload, 25, 10) | (extract_bits_reverse(payload, 59, 6) << 10);
+
+	int r1 = extract_bits_sign(payload, 35, 4);
+	int g1 = extract_bits_sign(payload, 45, 4);
+	int b1 = extract_bits_sign(payload, 55, 4);
+
+	r1 += r0;
+	g1 += g0;
+	b1 += b0;
+
+	ivec3 ep0 = ivec3(r0, g0, b0);
+	ivec3 ep1 = ivec3(r1, g1, b1);
+	ep0 = unquantize_endpoint(ep0, 16);
+	ep1 = unquantize_endpoint(ep1, 16);
+
+	int index = extract_bits(
+		payload,
+		std::max(64 + linear_pixel * 4, 65),
+		linear_pixel == 0 ? 3 : 4);
+
+	int w = weight_table4[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode18(const bc_payload &payload, int linear_pixel, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 8);
+	int g0 = extract_bits(payload, 15, 8);
+	int b0 = extract_bits(payload, 25, 8);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 6);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits_sign(payload, 24, 1) << 4);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits_sign(payload, 14, 1) << 4);
+
+		int r3 = extract_bits_sign(payload, 71, 6);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 13, 1) << 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 60, 1) << 1) |
+				(extract_bits(payload, 23, 1) << 2) | (extract_bits_sign(payload, 33, 2) << 3);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 6);
+		int g1 = extract_bits_sign(payload, 45, 5);
+		int b1 = extract_bits_sign(payload, 55, 5);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 8);
+	ep1 = unquantize_endpoint(ep1, 8);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode22(const bc_payload &payload, int linear_pixel, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 8);
+	int g0 = extract_bits(payload, 15, 8);
+	int b0 = extract_bits(payload, 25, 8);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 5);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits(payload, 24, 1) << 4) | (extract_bits_sign(payload, 23, 1) << 5);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits_sign(payload, 14, 1) << 4);
+
+		int r3 = extract_bits_sign(payload, 71, 5);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits(payload, 40, 1) << 4) | (extract_bits_sign(payload, 33, 1) << 5);
+		int b3 = extract_bits(payload, 13, 1) | (extract_bits(payload, 60, 1) << 1) |
+				(extract_bits(payload, 70, 1) << 2) | (extract_bits(payload, 76, 1) << 3) |
+				(extract_bits_sign(payload, 34, 1) << 4);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 5);
+		int g1 = extract_bits_sign(payload, 45, 6);
+		int b1 = extract_bits_sign(payload, 55, 5);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 8);
+	ep1 = unquantize_endpoint(ep1, 8);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode26(const bc_payload &payload, int linear_pixel, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	int r0 = extract_bits(payload, 5, 8);
+	int g0 = extract_bits(payload, 15, 8);
+	int b0 = extract_bits(payload, 25, 8);
+	ep0 = ivec3(r0, g0, b0);
+
+	if (part != 0)
+	{
+		int r2 = extract_bits_sign(payload, 65, 5);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits_sign(payload, 24, 1) << 4);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits(payload, 14, 1) << 4) | (extract_bits_sign(payload, 23, 1) << 5);
+
+		int r3 = extract_bits_sign(payload, 71, 5);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits_sign(payload, 40, 1) << 4);
+		int b3 = extract_bits(payload, 50, 1) | (extract_bits(payload, 13, 1) << 1) |
+				(extract_bits(payload, 70, 1) << 2) | (extract_bits(payload, 76, 1) << 3) |
+				(extract_bits(payload, 34, 1) << 4) | (extract_bits_sign(payload, 33, 1) << 5);
+
+		ep1 = ivec3(r3, g3, b3) + ep0;
+		ep0 += ivec3(r2, g2, b2);
+	}
+	else
+	{
+		int r1 = extract_bits_sign(payload, 35, 5);
+		int g1 = extract_bits_sign(payload, 45, 5);
+		int b1 = extract_bits_sign(payload, 55, 6);
+		ep1 = ivec3(r1, g1, b1) + ep0;
+	}
+
+	ep0 = unquantize_endpoint(ep0, 8);
+	ep1 = unquantize_endpoint(ep1, 8);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static DecodedInterpolation decode_bc6_mode30(const bc_payload &payload, int linear_pixel, int part, int anchor_pixel)
+{
+	ivec3 ep0, ep1;
+
+	if (part != 0)
+	{
+		int r2 = extract_bits(payload, 65, 6);
+		int g2 = extract_bits(payload, 41, 4) | (extract_bits(payload, 24, 1) << 4) | (extract_bits(payload, 21, 1) << 5);
+		int b2 = extract_bits(payload, 61, 4) | (extract_bits(payload, 14, 1) << 4) | (extract_bits(payload, 22, 1) << 5);
+
+		int r3 = extract_bits(payload, 71, 6);
+		int g3 = extract_bits(payload, 51, 4) | (extract_bits(payload, 11, 1) << 4) | (extract_bits(payload, 31, 1) << 5);
+		int b3 = extract_bits(payload, 12, 2) | (extract_bits(payload, 23, 1) << 2) |
+			(extract_bits(payload, 32, 1) << 3) | (extract_bits(payload, 34, 1) << 4) | (extract_bits(payload, 33, 1) << 5);
+
+		ep0 = ivec3(r2, g2, b2);
+		ep1 = ivec3(r3, g3, b3);
+	}
+	else
+	{
+		int r0 = extract_bits(payload, 5, 6);
+		int g0 = extract_bits(payload, 15, 6);
+		int b0 = extract_bits(payload, 25, 6);
+
+		int r1 = extract_bits(payload, 35, 6);
+		int g1 = extract_bits(payload, 45, 6);
+		int b1 = extract_bits(payload, 55, 6);
+
+		ep0 = ivec3(r0, g0, b0);
+		ep1 = ivec3(r1, g1, b1);
+	}
+
+	ep0 = unquantize_endpoint(ep0, 6);
+	ep1 = unquantize_endpoint(ep1, 6);
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == 0 || linear_pixel == anchor_pixel) ? 2 : 3);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(ep0, ep1, w);
+}
+
+static uint64_t
+decode_texel(VkFormat format, const bc_payload &payload, int linear_pixel)
+{
+	is_signed = (format == VK_FORMAT_BC6H_SFLOAT_BLOCK);
+
+	int mode = extract_bits(payload, 0, 5);
+	int part_index = extract_bits(payload, 77, 5);
+	int part = (partition_table2[part_index] >> linear_pixel) & 1;
+	int anchor_pixel = anchor_table2[part_index];
+	DecodedInterpolation interp(ivec3(0), ivec3(0), 0);
+
+	if ((mode & 2) == 0) {
+		if ((mode & 1) != 0)
+			interp = decode_bc6_mode1(payload, linear_pixel, part, anchor_pixel);
+		else
+			interp = decode_bc6_mode0(payload, linear_pixel, part, anchor_pixel);
+	}
+	else {
+		switch (mode) {
+			case 2: interp = decode_bc6_mode2(payload, linear_pixel, part, anchor_pixel); break;
+			case 3: interp = decode_bc6_mode3(payload, linear_pixel); break;
+			case 6: interp = decode_bc6_mode6(payload, linear_pixel, part, anchor_pixel); break;
+			case 7: interp = decode_bc6_mode7(payload, linear_pixel); break;
+			case 10: interp = decode_bc6_mode10(payload, linear_pixel, part, anchor_pixel); break;
+			case 11: interp = decode_bc6_mode11(payload, linear_pixel); break;
+			case 14: interp = decode_bc6_mode14(payload, linear_pixel, part, anchor_pixel); break;
+			case 15: interp = decode_bc6_mode15(payload, linear_pixel); break;
+			case 18: interp = decode_bc6_mode18(payload, linear_pixel, part, anchor_pixel); break;
+			case 22: interp = decode_bc6_mode22(payload, linear_pixel, part, anchor_pixel); break;
+			case 26: interp = decode_bc6_mode26(payload, linear_pixel, part, anchor_pixel); break;
+			case 30: interp = decode_bc6_mode30(payload, linear_pixel, part, anchor_pixel); break;
+			default: break;
+		}
+	}
+
+	ivec3 rgb = interpolate_endpoint(interp);
+	uint64_t packed = 0;
+
+	/* Squeeze range. */
+	for (int i = 0; i < 3; i++) {
+		int c = rgb[i];
+
+		if (is_signed) {
+			c = c < 0 ? (0x8000 | (((-c) * 31) >> 5)) : ((c * 31) >> 5);
+			/* Fixup for -0.0. */
+			if (c == 0x8000)
+				c = 0;
+		}
+		else
+			c = (c * 31) >> 6;
+
+		packed |= (uint64_t)(c & 0xffff) << (16 * i);
+	}
+
+	return packed | (0x3c00ull << 48);
+}
+
+} /* namespace bc6 */
+
+namespace bc7 {
+
+#undef P2
+
+static const int weight_table2[4] = {0, 21, 43, 64};
+static const int weight_table3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const int weight_table4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+#define P3(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p) \
+	(((a) << 0) | ((b) << 2) | ((c) << 4) | ((d) << 6) | \
+	((e) << 8) | ((f) << 10) | ((g) << 12) | ((h) << 14) | \
+	((i) << 16) | ((j) << 18) | ((k) << 20) | ((l) << 22) | \
+	((m) << 24) | ((n) << 26) | ((o) << 28) | ((p) << 30))
+
+static const int partition_table3[64] = {
+	P3(0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2),
+	P3(0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1),
+	P3(0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1),
+	P3(0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1),
+	P3(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2),
+	P3(0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2),
+	P3(0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1),
+	P3(0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1),
+
+	P3(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2),
+	P3(0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2),
+	P3(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2),
+	P3(0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2),
+	P3(0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2),
+	P3(0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2),
+	P3(0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2),
+	P3(0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0),
+
+	P3(0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2),
+	P3(0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0),
+	P3(0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2),
+	P3(0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1),
+	P3(0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2),
+	P3(0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1),
+	P3(0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2),
+	P3(0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0),
+
+	P3(0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0),
+	P3(0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2),
+	P3(0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0),
+	P3(0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1),
+	P3(0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2),
+	P3(0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2),
+	P3(0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1),
+	P3(0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1),
+
+	P3(0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2),
+	P3(0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1),
+	P3(0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2),
+	P3(0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0),
+	P3(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0),
+	P3(0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0),
+	P3(0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0),
+	P3(0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1),
+
+	P3(0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1),
+	P3(0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2),
+	P3(0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1),
+	P3(0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2),
+	P3(0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1),
+	P3(0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1),
+	P3(0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1),
+	P3(0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1),
+
+	P3(0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2),
+	P3(0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1),
+	P3(0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2),
+	P3(0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2),
+	P3(0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2),
+	P3(0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2),
+	P3(0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2),
+	P3(0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2),
+
+	P3(0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2),
+	P3(0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2),
+	P3(0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2),
+	P3(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2),
+	P3(0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1),
+	P3(0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2),
+	P3(0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2),
+	P3(0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0)};
+
+#define P2(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p) \
+	(((a) << 0) | ((b) << 1) | ((c) << 2) | ((d) << 3) | \
+	((e) << 4) | ((f) << 5) | ((g) << 6) | ((h) << 7) | \
+	((i) << 8) | ((j) << 9) | ((k) << 10) | ((l) << 11) | \
+	((m) << 12) | ((n) << 13) | ((o) << 14) | ((p) << 15))
+static const int partition_table2[64] = {
+	P2(0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1),
+	P2(0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1),
+	P2(0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1),
+	P2(0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1),
+	P2(0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1),
+
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1),
+	P2(0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1),
+	P2(0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1),
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1),
+
+	P2(0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1),
+	P2(0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0),
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0),
+	P2(0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0),
+	P2(0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0),
+	P2(0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0),
+	P2(0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0),
+	P2(0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1),
+
+	P2(0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0),
+	P2(0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0),
+	P2(0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0),
+	P2(0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0),
+	P2(0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0),
+	P2(0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0),
+	P2(0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0),
+	P2(0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0),
+
+	P2(0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1),
+	P2(0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1),
+	P2(0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0),
+	P2(0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0),
+	P2(0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0),
+	P2(0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0),
+	P2(0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1),
+	P2(0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1),
+
+	P2(0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0),
+	P2(0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0),
+	P2(0, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0),
+	P2(0, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0),
+	P2(0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0),
+	P2(0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1),
+	P2(0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1),
+	P2(0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0),
+
+	P2(0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0),
+	P2(0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0),
+	P2(0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0),
+	P2(0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0),
+	P2(0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1),
+	P2(0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1),
+	P2(0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0),
+	P2(0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 0),
+
+	P2(0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 1),
+	P2(0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1),
+	P2(0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1),
+	P2(0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1),
+	P2(0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1),
+	P2(0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0),
+	P2(0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0),
+	P2(0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1)};
+
+static const int anchor_table2[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15,
+	15, 15, 15, 15, 15, 15, 15, 15,
+	15, 2, 8, 2, 2, 8, 8, 15,
+	2, 8, 2, 2, 8, 8, 2, 2,
+	15, 15, 6, 8, 2, 8, 15, 15,
+	2, 8, 2, 2, 2, 15, 15, 6,
+	6, 2, 6, 8, 15, 15, 2, 2,
+	15, 15, 15, 15, 15, 2, 2, 15};
+
+static const ivec2 anchor_table3[64] = {
+	ivec2(3, 15), ivec2(3, 8), ivec2(15, 8), ivec2(15, 3), ivec2(8, 15), ivec2(3, 15), ivec2(15, 3), ivec2(15, 8),
+	ivec2(8, 15), ivec2(8, 15), ivec2(6, 15), ivec2(6, 15), ivec2(6, 15), ivec2(5, 15), ivec2(3, 15), ivec2(3, 8),
+	ivec2(3, 15), ivec2(3, 8), ivec2(8, 15), ivec2(15, 3), ivec2(3, 15), ivec2(3, 8), ivec2(6, 15), ivec2(10, 8),
+	ivec2(5, 3), ivec2(8, 15), ivec2(8, 6), ivec2(6, 10), ivec2(8, 15), ivec2(5, 15), ivec2(15, 10), ivec2(15, 8),
+	ivec2(8, 15), ivec2(15, 3), ivec2(3, 15), ivec2(5, 10), ivec2(6, 10), ivec2(10, 8), ivec2(8, 9), ivec2(15, 10),
+	ivec2(15, 6), ivec2(3, 15), ivec2(15, 8), ivec2(5, 15), ivec2(15, 3), ivec2(15, 6), ivec2(15, 6), ivec2(15, 8),
+	ivec2(3, 15), ivec2(15, 3), ivec2(5, 15), ivec2(5, 15), ivec2(5, 15), ivec2(8, 15), ivec2(5, 15), ivec2(10, 15),
+	ivec2(5, 15), ivec2(10, 15), ivec2(8, 15), ivec2(13, 15), ivec2(15, 3), ivec2(12, 15), ivec2(3, 15), ivec2(3, 8)
+};
+
+struct DecodedInterpolation
+{
+	uvec4 ep0, ep1;
+	int color_weight;
+	int alpha_weight;
+	int rotation;
+
+	DecodedInterpolation(uvec4 ep0, uvec4 ep1, int cw, int aw, int rot) :
+		ep0(ep0), ep1(ep1), color_weight(cw), alpha_weight(aw), rotation(rot) {}
+};
+
+static DecodedInterpolation decode_bc7_mode0(const bc_payload &payload, int linear_pixel)
+{
+	int part_index = extract_bits(payload, 1, 4);
+	int part = (partition_table3[part_index] >> (2 * linear_pixel)) & 3;
+	int bit_offset = part * 8;
+
+	int r0 = extract_bits(payload, 5 + bit_offset, 4);
+	int r1 = extract_bits(payload, 9 + bit_offset, 4);
+	int g0 = extract_bits(payload, 29 + bit_offset, 4);
+	int g1 = extract_bits(payload, 33 + bit_offset, 4);
+	int b0 = extract_bits(payload, 53 + bit_offset, 4);
+	int b1 = extract_bits(payload, 57 + bit_offset, 4);
+
+	int sep0 = extract_bits(payload, 77 + part * 2, 1);
+	int sep1 = extract_bits(payload, 78 + part * 2, 1);
+
+	ivec2 anchor_pixels = anchor_table3[part_index];
+	int index = extract_bits(
+			payload,
+			std::max(82 + linear_pixel * 3 - int(linear_pixel > anchor_pixels.x) - int(linear_pixel > anchor_pixels.y), 83),
+			(linear_pixel == anchor_pixels.y || linear_pixel == anchor_pixels.x || linear_pixel == 0) ? 2 : 3);
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 4) | (sep0 << 3) | (rgb0 >> 1);
+	rgb1 = (rgb1 << 4) | (sep1 << 3) | (rgb1 >> 1);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(uvec4(rgb0, 0xff), uvec4(rgb1, 0xff), w, w, 0);
+}
+
+static DecodedInterpolation decode_bc7_mode1(const bc_payload &payload, int linear_pixel)
+{
+	int part_index = extract_bits(payload, 2, 6);
+	int part = (partition_table2[part_index] >> linear_pixel) & 1;
+	int bit_offset = part * 12;
+
+	int r0 = extract_bits(payload, 8 + bit_offset, 6);
+	int r1 = extract_bits(payload, 14 + bit_offset, 6);
+	int g0 = extract_bits(payload, 32 + bit_offset, 6);
+	int g1 = extract_bits(payload, 38 + bit_offset, 6);
+	int b0 = extract_bits(payload, 56 + bit_offset, 6);
+	int b1 = extract_bits(payload, 62 + bit_offset, 6);
+	int sep = extract_bits(payload, 80 + part, 1) << 1;
+
+	int anchor_pixel = anchor_table2[part_index];
+
+	int index = extract_bits(
+		payload,
+		std::max(81 + linear_pixel * 3 - int(linear_pixel > anchor_pixel), 82),
+		(linear_pixel == anchor_pixel || linear_pixel == 0) ? 2 : 3);
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 2) | sep | (rgb0 >> 5);
+	rgb1 = (rgb1 << 2) | sep | (rgb1 >> 5);
+
+	int w = weight_table3[index];
+	return DecodedInterpolation(uvec4(rgb0, 0xff), uvec4(rgb1, 0xff), w, w, 0);
+}
+
+static DecodedInterpolation decode_bc7_mode2(const bc_payload &payload, int linear_pixel)
+{
+	int part_index = extract_bits(payload, 3, 6);
+	int part = (partition_table3[part_index] >> (2 * linear_pixel)) & 3;
+	int bit_offset = part * 10;
+
+	int r0 = extract_bits(payload, 9 + bit_offset, 5);
+	int r1 = extract_bits(payload, 14 + bit_offset, 5);
+	int g0 = extract_bits(payload, 39 + bit_offset, 5);
+	int g1 = extract_bits(payload, 44 + bit_offset, 5);
+	int b0 = extract_bits(payload, 69 + bit_offset, 5);
+	int b1 = extract_bits(payload, 74 + bit_offset, 5);
+
+	ivec2 anchor_pixels = anchor_table3[part_index];
+	int index = extract_bits(
+			payload,
+			std::max(98 + linear_pixel * 2 - int(linear_pixel > anchor_pixels.x) - int(linear_pixel > anchor_pixels.y), 99),
+			(linear_pixel == anchor_pixels.y || linear_pixel == anchor_pixels.x || linear_pixel == 0) ? 1 : 2);
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 3) | (rgb0 >> 2);
+	rgb1 = (rgb1 << 3) | (rgb1 >> 2);
+
+	int w = weight_table2[index];
+	return DecodedInterpolation(uvec4(rgb0, 0xff), uvec4(rgb1, 0xff), w, w, 0);
+}
+
+static DecodedInterpolation decode_bc7_mode3(const bc_payload &payload, int linear_pixel)
+{
+	int part_index = extract_bits(payload, 4, 6);
+	int part = (partition_table2[part_index] >> linear_pixel) & 1;
+	int bit_offset = part * 14;
+
+	int r0 = extract_bits(payload, 10 + bit_offset, 7);
+	int r1 = extract_bits(payload, 17 + bit_offset, 7);
+	int g0 = extract_bits(payload, 38 + bit_offset, 7);
+	int g1 = extract_bits(payload, 45 + bit_offset, 7);
+	int b0 = extract_bits(payload, 66 + bit_offset, 7);
+	int b1 = extract_bits(payload, 73 + bit_offset, 7);
+
+	int sep0 = extract_bits(payload, 94 + part * 2, 1);
+	int sep1 = extract_bits(payload, 95 + part * 2, 1);
+
+	int anchor_pixel = anchor_table2[part_index];
+
+	int index = extract_bits(
+		payload,
+		std::max(97 + linear_pixel * 2 - int(linear_pixel > anchor_pixel), 98),
+		(linear_pixel == anchor_pixel || linear_pixel == 0) ? 1 : 2);
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 1) | sep0;
+	rgb1 = (rgb1 << 1) | sep1;
+
+	int w = weight_table2[index];
+	return DecodedInterpolation(uvec4(rgb0, 0xff), uvec4(rgb1, 0xff), w, w, 0);
+}
+
+static DecodedInterpolation decode_bc7_mode4(const bc_payload &payload, int linear_pixel)
+{
+	int rot = extract_bits(payload, 5, 2);
+	bool isb = (payload.x & 0x80u) != 0u;
+	int r0 = extract_bits(payload, 8, 5);
+	int r1 = extract_bits(payload, 13, 5);
+	int g0 = extract_bits(payload, 18, 5);
+	int g1 = extract_bits(payload, 23, 5);
+	int b0 = extract_bits(payload, 28, 5);
+	int b1 = extract_bits(payload, 33, 5);
+	int a0 = extract_bits(payload, 38, 6);
+	int a1 = extract_bits(payload, 44, 6);
+
+	int primary_index = extract_bits(
+			payload,
+			std::max(49 + linear_pixel * 2, 50),
+			linear_pixel == 0 ? 1 : 2);
+	int secondary_index = extract_bits(
+			payload,
+			std::max(80 + linear_pixel * 3, 81),
+			linear_pixel == 0 ? 2 : 3);
+
+	int color_weight = weight_table2[primary_index];
+	int alpha_weight = weight_table3[secondary_index];
+
+	if (isb)
+	{
+		int tmp = color_weight;
+		color_weight = alpha_weight;
+		alpha_weight = tmp;
+	}
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 3) | (rgb0 >> 2);
+	rgb1 = (rgb1 << 3) | (rgb1 >> 2);
+	a0 = (a0 << 2) | (a0 >> 4);
+	a1 = (a1 << 2) | (a1 >> 4);
+	return DecodedInterpolation(uvec4(rgb0, a0), uvec4(rgb1, a1), color_weight, alpha_weight, rot);
+}
+
+static DecodedInterpolation decode_bc7_mode5(const bc_payload &payload, int linear_pixel)
+{
+	int rot = extract_bits(payload, 6, 2);
+	int r0 = extract_bits(payload, 8, 7);
+	int r1 = extract_bits(payload, 15, 7);
+	int g0 = extract_bits(payload, 22, 7);
+	int g1 = extract_bits(payload, 29, 7);
+	int b0 = extract_bits(payload, 36, 7);
+	int b1 = extract_bits(payload, 43, 7);
+	int a0 = extract_bits(payload, 50, 8);
+	int a1 = extract_bits(payload, 58, 8);
+
+	int primary_index = extract_bits(
+			payload,
+			std::max(65 + linear_pixel * 2, 66),
+			linear_pixel == 0 ? 1 : 2);
+	int secondary_index = extract_bits(
+			payload,
+			std::max(96 + linear_pixel * 2, 97),
+			linear_pixel == 0 ? 1 : 2);
+
+	int color_weight = weight_table2[primary_index];
+	int alpha_weight = weight_table2[secondary_index];
+
+	ivec3 rgb0 = ivec3(r0, g0, b0);
+	ivec3 rgb1 = ivec3(r1, g1, b1);
+	rgb0 = (rgb0 << 1) | (rgb0 >> 6);
+	rgb1 = (rgb1 << 1) | (rgb1 >> 6);
+	return DecodedInterpolation(uvec4(rgb0, a0), uvec4(rgb1, a1), color_weight, alpha_weight, rot);
+}
+
+static DecodedInterpolation decode_bc7_mode6(const bc_payload &payload, int linear_pixel)
+{
+	int sep0 = extract_bits(payload, 63, 1);
+	int sep1 = extract_bits(payload, 64, 1);
+	int r0 = extract_bits(payload, 7, 7);
+	int r1 = extract_bits(payload, 14, 7);
+	int g0 = extract_bits(payload, 21, 7);
+	int g1 = extract_bits(payload, 28, 7);
+	int b0 = extract_bits(payload, 35, 7);
+	int b1 = extract_bits(payload, 42, 7);
+	int a0 = extract_bits(payload, 49, 7);
+	int a1 = extract_bits(payload, 56, 7);
+
+	ivec4 ep0 = ivec4(r0, g0, b0, a0) * 2 + sep0;
+	ivec4 ep1 = ivec4(r1, g1, b1, a1) * 2 + sep1;
+
+	int index = extract_bits(
+			payload,
+			std::max(64 + linear_pixel * 4, 65),
+			linear_pixel == 0 ? 3 : 4);
+
+	int w = weight_table4[index];
+	return DecodedInterpolation(ep0, ep1, w, w, 0);
+}
+
+static DecodedInterpolation decode_bc7_mode7(const bc_payload &payload, int linear_pixel)
+{
+	int part_index = extract_bits(payload, 8, 6);
+	int part = (partition_table2[part_index] >> linear_pixel) & 1;
+	int bit_offset = part * 10;
+
+	int r0 = extract_bits(payload, 14 + bit_offset, 5);
+	int r1 = extract_bits(payload, 19 + bit_offset, 5);
+	int g0 = extract_bits(payload, 34 + bit_offset, 5);
+	int g1 = extract_bits(payload, 39 + bit_offset, 5);
+	int b0 = extract_bits(payload, 54 + bit_offset, 5);
+	int b1 = extract_bits(payload, 59 + bit_offset, 5);
+	int a0 = extract_bits(payload, 74 + bit_offset, 5);
+	int a1 = extract_bits(payload, 79 + bit_offset, 5);
+
+	int sep0 = extract_bits(payload, 94 + part * 2, 1);
+	int sep1 = extract_bits(payload, 95 + part * 2, 1);
+
+	int anchor_pixel = anchor_table2[part_index];
+
+	int index = extract_bits(
+		payload,
+		std::max(97 + linear_pixel * 2 - int(linear_pixel > anchor_pixel), 98),
+		(linear_pixel == anchor_pixel || linear_pixel == 0) ? 1 : 2);
+
+	ivec4 rgba0 = ivec4(r0, g0, b0, a0);
+	ivec4 rgba1 = ivec4(r1, g1, b1, a1);
+	rgba0 = (rgba0 << 3) | (rgba0 >> 3) | (sep0 << 2);
+	rgba1 = (rgba1 << 3) | (rgba1 >> 3) | (sep1 << 2);
+
+	int w = weight_table2[index];
+	return DecodedInterpolation(rgba0, rgba1, w, w, 0);
+}
+
+static uint32_t
+decode_texel(VkFormat format, const bc_payload &payload, int linear_pixel)
+{
+	DecodedInterpolation interp(uvec4(0), uvec4(0), 0, 0, 0);
+	int mode = payload.x ? __builtin_ctz(payload.x) : -1;
+
+	switch (mode) {
+		case 0: interp = decode_bc7_mode0(payload, linear_pixel); break;
+		case 1: interp = decode_bc7_mode1(payload, linear_pixel); break;
+		case 2: interp = decode_bc7_mode2(payload, linear_pixel); break;
+		case 3: interp = decode_bc7_mode3(payload, linear_pixel); break;
+		case 4: interp = decode_bc7_mode4(payload, linear_pixel); break;
+		case 5: interp = decode_bc7_mode5(payload, linear_pixel); break;
+		case 6: interp = decode_bc7_mode6(payload, linear_pixel); break;
+		case 7: interp = decode_bc7_mode7(payload, linear_pixel); break;
+		default: break;
+	}
+
+	int rgba[4];
+	for (int i = 0; i < 4; i++) {
+		int w = i < 3 ? interp.color_weight : interp.alpha_weight;
+		rgba[i] = ((64 - w) * interp.ep0[i] + w * interp.ep1[i] + 32) >> 6;
+	}
+
+	switch (interp.rotation) {
+		case 1: std::swap(rgba[0], rgba[3]); break;
+		case 2: std::swap(rgba[1], rgba[3]); break;
+		case 3: std::swap(rgba[2], rgba[3]); break;
+		default: break;
+	}
+
+	float color[4];
+	for (int i = 0; i < 4; i++)
+		color[i] = float(rgba[i]) / 255.0f;
+
+	if (format == VK_FORMAT_BC7_SRGB_BLOCK) {
+		for (int i = 0; i < 3; i++)
+			color[i] = srgb_decode(color[i]);
+	}
+
+	return pack_unorm4x8(color);
+}
+
+} /* namespace bc7 */
+
+} /* namespace */
+
+void
+decode_bcn_block(VkFormat format, const uint8_t *block, uint8_t *dst, size_t dstRowPitch,
+				 uint32_t width, uint32_t height)
+{
+	bc_payload payload = { 0, 0, 0, 0 };
+	memcpy(&payload, block, get_block_size(format));
+
+	uint32_t texel_size = get_texel_size(format);
+
+	for (uint32_t y = 0; y < std::min(height, 4u); y++) {
+		uint8_t *row = dst + y * dstRowPitch;
+
+		for (uint32_t x = 0; x < std::min(width, 4u); x++) {
+			int linear_pixel = 4 * y + x;
+
+			if (is_bc6(format)) {
+				uint64_t texel = bc6::decode_texel(format, payload, linear_pixel);
+				memcpy(row + x * texel_size, &texel, sizeof(texel));
+			}
+			else {
+				uint32_t texel;
+				if (is_s3tc(format))
+					texel = decode_s3tc_texel(format, payload, linear_pixel);
+				else if (is_rgtc(format))
+					texel = decode_rgtc_texel(format, payload, linear_pixel);
+				else
+					texel = bc7::decode_texel(format, payload, linear_pixel);
+				memcpy(row + x * texel_size, &texel, sizeof(texel));
+			}
+		}
+	}
+}
+
+void
+decode_bcn_region(VkFormat format, const uint8_t *src, size_t srcRowPitch,
+				  uint32_t width, uint32_t height, uint8_t *dst, size_t dstRowPitch)
+{
+	uint32_t block_size = get_block_size(format);
+	uint32_t texel_size = get_texel_size(format);
+
+	for (uint32_t by = 0; by < (height + 3) / 4; by++) {
+		for (uint32_t bx = 0; bx < (width + 3) / 4; bx++) {
+			decode_bcn_block(format,
+				src + by * srcRowPitch + bx * block_size,
+				dst + by * 4 * dstRowPitch + bx * 4 * texel_size, dstRowPitch,
+				width - bx * 4, height - by * 4);
+		}
+	}
+}
@@ -0,0 +1,13 @@
+#ifndef __BCN_CPU_HPP
+#define __BCN_CPU_HPP
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <cstddef>
+
+void decode_bcn_block(VkFormat format, const uint8_t *block, uint8_t *dst, size_t dstRowPitch,
+					  uint32_t width, uint32_t height);
+void decode_bcn_region(VkFormat format, const uint8_t *src, size_t srcRowPitch,
+					   uint32_t width, uint32_t height, uint8_t *dst, size_t dstRowPitch);
+
+#endif
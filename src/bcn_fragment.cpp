@@ -0,0 +1,511 @@
+#include "bcn_fragment.hpp"
+#include "bcn.hpp"
+#include "buffer.hpp"
+#include "image.hpp"
+#include "command_buffer.hpp"
+
+#include "fullscreen_spv.h"
+#include "s3tc_fs_spv.h"
+#include "rgtc_fs_spv.h"
+#include "bc6_fs_spv.h"
+#include "bc7_fs_spv.h"
+
+/*
+ * Graphics variant of the decoders: a full-screen triangle per subresource
+ * layer, the fragment shader reading the blocks from the source buffer and
+ * writing the texel as a color attachment through dynamic rendering. On
+ * tilers this keeps the writes in tile memory and the image compressed.
+ */
+struct fragment_state {
+	VkDescriptorSetLayout setLayout;
+	VkPipelineLayout layout;
+	VkShaderModule vertexModule;
+	std::unordered_map<VkFormat, bool> attachmentFormats;
+	std::unordered_map<uint64_t, VkPipeline> pipelines;
+	std::mutex lock;
+};
+
+static std::mutex fragment_lock;
+static std::unordered_map<struct device *, std::unique_ptr<struct fragment_state>> fragmentMap;
+
+static struct fragment_state *
+get_fragment_state(struct device *dev)
+{
+	scoped_lock l(fragment_lock);
+
+	auto it = fragmentMap.find(dev);
+
+	if (it == fragmentMap.end())
+		return nullptr;
+
+	return it->second.get();
+}
+
+static void
+get_fragment_spirv(enum bcn_family family, const uint32_t **code, size_t *size)
+{
+	switch (family) {
+		case BCN_FAMILY_S3TC:
+			*code = (const uint32_t *)s3tc_fs_spv;
+			*size = s3tc_fs_spv_len;
+			break;
+		case BCN_FAMILY_RGTC:
+			*code = (const uint32_t *)rgtc_fs_spv;
+			*size = rgtc_fs_spv_len;
+			break;
+		case BCN_FAMILY_BC6:
+			*code = (const uint32_t *)bc6_fs_spv;
+			*size = bc6_fs_spv_len;
+			break;
+		default:
+			*code = (const uint32_t *)bc7_fs_spv;
+			*size = bc7_fs_spv_len;
+			break;
+	}
+}
+
+static void
+destroy_fragment_state(struct device *dev, struct fragment_state *state)
+{
+	for (const auto &it : state->pipelines)
+		dev->table.DestroyPipeline(dev->handle, it.second, nullptr);
+
+	dev->table.DestroyShaderModule(dev->handle, state->vertexModule, nullptr);
+	dev->table.DestroyPipelineLayout(dev->handle, state->layout, nullptr);
+	dev->table.DestroyDescriptorSetLayout(dev->handle, state->setLayout, nullptr);
+}
+
+VkResult
+fragment_decode_init(struct device *dev, PFN_vkGetPhysicalDeviceFormatProperties getFormatProperties)
+{
+	VkResult result;
+	VkLayerDispatchTable table = dev->table;
+	VkDevice device = dev->handle;
+
+	auto state = std::make_unique<struct fragment_state>();
+	state->setLayout = VK_NULL_HANDLE;
+	state->layout = VK_NULL_HANDLE;
+	state->vertexModule = VK_NULL_HANDLE;
+
+	for (VkFormat format : { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SNORM, VK_FORMAT_R16G16B16A16_SFLOAT }) {
+		VkFormatProperties props = {};
+		getFormatProperties(dev->physical, format, &props);
+		state->attachmentFormats[format] = (props.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) != 0;
+	}
+
+	VkDescriptorSetLayoutBinding binding = {
+		.binding = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.pImmutableSamplers = nullptr
+	};
+
+	VkDescriptorSetLayoutCreateInfo descriptor_set_create_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.bindingCount = 1,
+		.pBindings = &binding
+	};
+
+	result = table.CreateDescriptorSetLayout(device, &descriptor_set_create_info, nullptr, &state->setLayout);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to create fragment decode set layout, res %d", result);
+		return result;
+	}
+
+	VkPushConstantRange push_constant = {
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.offset = 0,
+		.size = sizeof(struct push_constants)
+	};
+
+	VkPipelineLayoutCreateInfo layout_create_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.setLayoutCount = 1,
+		.pSetLayouts = &state->setLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constant
+	};
+
+	result = table.CreatePipelineLayout(device, &layout_create_info, nullptr, &state->layout);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to create fragment decode pipeline layout, res %d", result);
+		destroy_fragment_state(dev, state.get());
+		return result;
+	}
+
+	VkShaderModuleCreateInfo shader_info = {
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.codeSize = fullscreen_spv_len,
+		.pCode = (const uint32_t *)fullscreen_spv
+	};
+
+	result = table.CreateShaderModule(device, &shader_info, nullptr, &state->vertexModule);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to create vertex shader module, res %d", result);
+		destroy_fragment_state(dev, state.get());
+		return result;
+	}
+
+	scoped_lock l(fragment_lock);
+	fragmentMap[dev] = std::move(state);
+
+	return VK_SUCCESS;
+}
+
+void
+fragment_decode_destroy(struct device *dev)
+{
+	scoped_lock l(fragment_lock);
+
+	auto it = fragmentMap.find(dev);
+	if (it == fragmentMap.end())
+		return;
+
+	destroy_fragment_state(dev, it->second.get());
+	fragmentMap.erase(it);
+}
+
+/* Whether uploads of this format go through the fragment decoders. */
+bool
+fragment_decode_supported(struct device *dev, VkFormat format)
+{
+	if (!dev->use_fragment)
+		return false;
+
+	struct fragment_state *state = get_fragment_state(dev);
+	if (!state)
+		return false;
+
+	auto it = state->attachmentFormats.find(get_format_for_bcn(format));
+	return it != state->attachmentFormats.end() && it->second;
+}
+
+/*
+ * Pipelines depend on the attachment format as well as the family, they are
+ * built on first use and go through the shared pipeline cache.
+ */
+static VkPipeline
+get_fragment_pipeline(struct device *dev, struct fragment_state *state, enum bcn_family family, VkFormat attachmentFormat)
+{
+	VkResult result;
+	VkPipeline pipeline;
+	uint64_t key = ((uint64_t)family << 32) | attachmentFormat;
+
+	std::lock_guard<std::mutex> l(state->lock);
+
+	auto it = state->pipelines.find(key);
+	if (it != state->pipelines.end())
+		return it->second;
+
+	VkShaderModuleCreateInfo shader_info = {
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.codeSize = 0,
+		.pCode = nullptr
+	};
+
+	get_fragment_spirv(family, &shader_info.pCode, &shader_info.codeSize);
+
+	VkShaderModule fragmentModule;
+	result = dev->table.CreateShaderModule(dev->handle, &shader_info, nullptr, &fragmentModule);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to create fragment shader module, res %d", result);
+		return VK_NULL_HANDLE;
+	}
+
+	VkPipelineShaderStageCreateInfo stages[2] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.stage = VK_SHADER_STAGE_VERTEX_BIT,
+			.module = state->vertexModule,
+			.pName = "main",
+			.pSpecializationInfo = nullptr
+		},
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.module = fragmentModule,
+			.pName = "main",
+			.pSpecializationInfo = nullptr
+		}
+	};
+
+	VkPipelineVertexInputStateCreateInfo vertex_input = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewport_state = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+	viewport_state.viewportCount = 1;
+	viewport_state.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterization = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+	rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterization.cullMode = VK_CULL_MODE_NONE;
+	rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterization.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+	multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState blend_attachment = {};
+	blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+									  VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo color_blend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+	color_blend.attachmentCount = 1;
+	color_blend.pAttachments = &blend_attachment;
+
+	VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamic_state = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+	dynamic_state.dynamicStateCount = 2;
+	dynamic_state.pDynamicStates = dynamic_states;
+
+	VkPipelineRenderingCreateInfo rendering_info = { VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO };
+	rendering_info.colorAttachmentCount = 1;
+	rendering_info.pColorAttachmentFormats = &attachmentFormat;
+
+	VkGraphicsPipelineCreateInfo pipeline_create_info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+	pipeline_create_info.pNext = &rendering_info;
+	pipeline_create_info.stageCount = 2;
+	pipeline_create_info.pStages = stages;
+	pipeline_create_info.pVertexInputState = &vertex_input;
+	pipeline_create_info.pInputAssemblyState = &input_assembly;
+	pipeline_create_info.pViewportState = &viewport_state;
+	pipeline_create_info.pRasterizationState = &rasterization;
+	pipeline_create_info.pMultisampleState = &multisample;
+	pipeline_create_info.pColorBlendState = &color_blend;
+	pipeline_create_info.pDynamicState = &dynamic_state;
+	pipeline_create_info.layout = state->layout;
+	pipeline_create_info.basePipelineIndex = -1;
+
+	result = dev->table.CreateGraphicsPipelines(dev->handle, dev->pipelineCache, 1, &pipeline_create_info, nullptr, &pipeline);
+	dev->table.DestroyShaderModule(dev->handle, fragmentModule, nullptr);
+
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to create fragment decode pipeline, res %d", result);
+		pipeline = VK_NULL_HANDLE;
+	}
+
+	state->pipelines[key] = pipeline;
+
+	return pipeline;
+}
+
+static void
+transition_layer(struct device *dev,
+				 VkCommandBuffer commandBuffer,
+				 VkImage image,
+				 const VkImageSubresourceRange &range,
+				 VkImageLayout oldLayout,
+				 VkImageLayout newLayout,
+				 bool toAttachment)
+{
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = toAttachment ? (VkAccessFlags)VK_ACCESS_TRANSFER_WRITE_BIT : (VkAccessFlags)VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		.dstAccessMask = toAttachment ? (VkAccessFlags)(VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT) :
+										(VkAccessFlags)(VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT),
+		.oldLayout = oldLayout,
+		.newLayout = newLayout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = range
+	};
+
+	VkPipelineStageFlags srcStage = toAttachment ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	VkPipelineStageFlags dstStage = toAttachment ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT :
+		(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	dev->table.CmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	stats_add(BCN_STAT_BARRIERS, 1);
+}
+
+/*
+ * Records the decode as one full screen triangle per layer, rendered into
+ * the image. cb must come from a pool whose queue family has GRAPHICS.
+ *
+ * Like the compute decode does with compute bindings, this leaves the
+ * graphics bindings of cb disturbed: the bound graphics pipeline, viewport
+ * and scissor 0, descriptor set 0 and the fragment push constants are
+ * those of the decode afterwards. Vulkan has no way to read them back, and
+ * tracking every bind of the application to replay them would cost on its
+ * hottest commands, so nothing is restored: bindings do not survive a
+ * copy into an emulated attachment image.
+ *
+ * On failure the image is back in dstImageLayout, with the layers rendered
+ * so far decoded, so the caller can decode the region another way.
+ */
+VkResult
+decompress_bcn_fragment(struct device *dev,
+						struct command_buffer *cb,
+						VkFormat format,
+						const VkBufferImageCopy *copy_region,
+						struct buffer *srcBuffer,
+						struct image *dstImage,
+						VkImageLayout dstImageLayout)
+{
+	VkResult result = VK_SUCCESS;
+	VkLayerDispatchTable table = dev->table;
+	VkCommandBuffer commandBuffer = cb->handle;
+	VkFormat attachmentFormat = get_format_for_bcn(format);
+
+	struct fragment_state *state = get_fragment_state(dev);
+	if (!state)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	VkPipeline pipeline = get_fragment_pipeline(dev, state, get_bcn_family(format), attachmentFormat);
+	if (pipeline == VK_NULL_HANDLE)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	uint32_t width = copy_region->imageExtent.width;
+	uint32_t height = copy_region->imageExtent.height;
+	uint32_t rowExtent = std::max(copy_region->bufferRowLength, width);
+	uint32_t imageHeight = std::max(copy_region->bufferImageHeight, height);
+	VkDeviceSize layerSize = (VkDeviceSize)((rowExtent + 3) / 4) * ((imageHeight + 3) / 4) * get_block_size(format);
+	uint32_t mip = copy_region->imageSubresource.mipLevel;
+	bool whole = copy_region->imageOffset.x == 0 && copy_region->imageOffset.y == 0 &&
+				 width == std::max(dstImage->extent.width >> mip, 1u) &&
+				 height == std::max(dstImage->extent.height >> mip, 1u);
+
+	VkImageSubresourceRange range = {
+		.aspectMask = copy_region->imageSubresource.aspectMask,
+		.baseMipLevel = mip,
+		.levelCount = 1,
+		.baseArrayLayer = copy_region->imageSubresource.baseArrayLayer,
+		.layerCount = copy_region->imageSubresource.layerCount
+	};
+
+	transition_layer(dev, commandBuffer, dstImage->handle, range,
+		whole ? VK_IMAGE_LAYOUT_UNDEFINED : dstImageLayout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true);
+
+	VkViewport viewport = {
+		.x = (float)copy_region->imageOffset.x,
+		.y = (float)copy_region->imageOffset.y,
+		.width = (float)width,
+		.height = (float)height,
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f
+	};
+
+	VkRect2D area = {
+		.offset = { copy_region->imageOffset.x, copy_region->imageOffset.y },
+		.extent = { width, height }
+	};
+
+	struct push_constants constants = {
+		.format = format,
+		.width = (int)width,
+		.height = (int)height,
+		.offset = 0,
+		.bufferRowLength = (int)copy_region->bufferRowLength,
+		.offsetX = copy_region->imageOffset.x,
+		.offsetY = copy_region->imageOffset.y
+	};
+
+	for (uint32_t layer = 0; layer < range.layerCount; layer++) {
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+		VkImageView view;
+
+		result = allocate_bcn_descriptor_set(dev, state->setLayout, &descriptorPool, &descriptorSet);
+		if (result != VK_SUCCESS) {
+			Logger::log("error", "Failed to allocate descriptor set, res %d", result);
+			break;
+		}
+
+		cb->transients.descriptorSets.push_back({ descriptorPool, descriptorSet });
+
+		VkDescriptorBufferInfo src_info = {
+			.buffer = srcBuffer->handle,
+			.offset = copy_region->bufferOffset + layer * layerSize,
+			.range = VK_WHOLE_SIZE
+		};
+
+		VkWriteDescriptorSet desc_write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = nullptr,
+			.dstSet = descriptorSet,
+			.dstBinding = 1,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pImageInfo = nullptr,
+			.pBufferInfo = &src_info,
+			.pTexelBufferView = nullptr
+		};
+
+		table.UpdateDescriptorSets(dev->handle, 1, &desc_write, 0, nullptr);
+
+		VkImageViewCreateInfo viewCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.image = dstImage->handle,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = attachmentFormat,
+			.components = {
+				VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+				VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY
+			},
+			.subresourceRange = {
+				.aspectMask = range.aspectMask,
+				.baseMipLevel = mip,
+				.levelCount = 1,
+				.baseArrayLayer = range.baseArrayLayer + layer,
+				.layerCount = 1
+			}
+		};
+
+		result = table.CreateImageView(dev->handle, &viewCreateInfo, nullptr, &view);
+		if (result != VK_SUCCESS) {
+			Logger::log("error", "Failed to create decode attachment view, res %d", result);
+			break;
+		}
+
+		cb->transients.imageViews.push_back(view);
+
+		VkRenderingAttachmentInfo attachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
+		attachment.imageView = view;
+		attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachment.loadOp = whole ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+		VkRenderingInfo rendering_info = { VK_STRUCTURE_TYPE_RENDERING_INFO };
+		rendering_info.renderArea = area;
+		rendering_info.layerCount = 1;
+		rendering_info.colorAttachmentCount = 1;
+		rendering_info.pColorAttachments = &attachment;
+
+		table.CmdBeginRendering(commandBuffer, &rendering_info);
+		table.CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		table.CmdSetViewport(commandBuffer, 0, 1, &viewport);
+		table.CmdSetScissor(commandBuffer, 0, 1, &area);
+		table.CmdPushConstants(commandBuffer, state->layout, VK_SHADER_STAGE_FRAGMENT_BIT,
+			0, sizeof(constants), &constants);
+		table.CmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, state->layout,
+			0, 1, &descriptorSet, 0, nullptr);
+		table.CmdDraw(commandBuffer, 3, 1, 0, 0);
+		stats_add(BCN_STAT_DRAWS, 1);
+		table.CmdEndRendering(commandBuffer);
+	}
+
+	transition_layer(dev, commandBuffer, dstImage->handle, range,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, dstImageLayout, false);
+
+	return result;
+}
@@ -0,0 +1,21 @@
+#ifndef __BCN_FRAGMENT_HPP
+#define __BCN_FRAGMENT_HPP
+
+#include "bcn_layer.hpp"
+
+struct command_buffer;
+struct buffer;
+struct image;
+
+VkResult fragment_decode_init(struct device *dev, PFN_vkGetPhysicalDeviceFormatProperties getFormatProperties);
+void fragment_decode_destroy(struct device *dev);
+bool fragment_decode_supported(struct device *dev, VkFormat format);
+VkResult decompress_bcn_fragment(struct device *dev,
+								 struct command_buffer *cb,
+								 VkFormat format,
+								 const VkBufferImageCopy *copy_region,
+								 struct buffer *srcBuffer,
+								 struct image *dstImage,
+								 VkImageLayout dstImageLayout);
+
+#endif
@@ -1,8 +1,20 @@
 #include "bcn_layer.hpp"
 #include "bcn.hpp"
+#include "cache.hpp"
+#include "pack.hpp"
+#include "pipeline_cache.hpp"
+#include "allocator.hpp"
+#include "retire.hpp"
+#include "bcn_fragment.hpp"
+#include "lazy.hpp"
+#include "profile.hpp"
+#include "census.hpp"
+#include "capture.hpp"
 #include "vulkan/vk_layer.h"
 
 #include <unistd.h>
+#include <chrono>
+#include <algorithm>
 
 std::unordered_map<void *, VkLayerInstanceDispatchTable> instanceDispatch;
 std::unordered_map<void *, VkInstance> instanceMap;
@@ -19,6 +31,14 @@ std::mutex global_lock;
 if (!strcmp(pName, "vk" #func)) \
 	return (PFN_vkVoidFunction)&BCnLayer_##func;
 
+/* Entry points the driver may not have: NULL to an application probing for them, not a null table call later. */
+#define GETPROCADDR_OPTIONAL(name, func) \
+if (!strcmp(pName, name)) { \
+	scoped_lock l(global_lock); \
+	struct device *dev = get_device(device); \
+	return dev && dev->table.func ? (PFN_vkVoidFunction)&BCnLayer_##func : NULL; \
+}
+
 struct device *
 get_device(VkDevice device)
 {
@@ -30,6 +50,18 @@ get_device(VkDevice device)
 	return it->second.get();
 }
 
+/* A queue shares the dispatch key of its device, also one the layer never handed out. */
+struct device *
+get_queue_device(VkQueue queue)
+{
+	auto it = deviceMap.find(GetKey(queue));
+
+	if (it == deviceMap.end())
+		return nullptr;
+
+	return it->second.get();
+}
+
 VK_LAYER_EXPORT VkResult VKAPI_CALL
 BCnLayer_CreateInstance(const VkInstanceCreateInfo *pCreateInfo,
 						const VkAllocationCallbacks *pAllocator,
@@ -60,12 +92,16 @@ BCnLayer_CreateInstance(const VkInstanceCreateInfo *pCreateInfo,
     }
 
     bcn_compute_auto = getenv("BCN_COMPUTE_AUTO") && atoi(getenv("BCN_COMPUTE_AUTO"));
+    Logger::init();
+    trace_init();
+    stats_init();
 
     VkLayerInstanceDispatchTable table;
     table.GetInstanceProcAddr = (PFN_vkGetInstanceProcAddr)gip(*pInstance, "vkGetInstanceProcAddr");
     table.DestroyInstance = (PFN_vkDestroyInstance)gip(*pInstance, "vkDestroyInstance");
     table.EnumeratePhysicalDevices = (PFN_vkEnumeratePhysicalDevices)gip(*pInstance, "vkEnumeratePhysicalDevices");
     table.GetPhysicalDeviceMemoryProperties = (PFN_vkGetPhysicalDeviceMemoryProperties)gip(*pInstance, "vkGetPhysicalDeviceMemoryProperties");
+    table.GetPhysicalDeviceMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2)gip(*pInstance, "vkGetPhysicalDeviceMemoryProperties2");
     table.GetPhysicalDeviceFormatProperties = (PFN_vkGetPhysicalDeviceFormatProperties)gip(*pInstance, "vkGetPhysicalDeviceFormatProperties");
     table.GetPhysicalDeviceProperties = (PFN_vkGetPhysicalDeviceProperties)gip(*pInstance, "vkGetPhysicalDeviceProperties");
     table.GetPhysicalDeviceProperties2 = (PFN_vkGetPhysicalDeviceProperties2)gip(*pInstance, "vkGetPhysicalDeviceProperties2");
@@ -74,6 +110,7 @@ BCnLayer_CreateInstance(const VkInstanceCreateInfo *pCreateInfo,
     table.GetPhysicalDeviceFeatures = (PFN_vkGetPhysicalDeviceFeatures)gip(*pInstance, "vkGetPhysicalDeviceFeatures");
     table.GetPhysicalDeviceFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2)gip(*pInstance, "vkGetPhysicalDeviceFeatures2");
     table.GetPhysicalDeviceQueueFamilyProperties = (PFN_vkGetPhysicalDeviceQueueFamilyProperties)gip(*pInstance, "vkGetPhysicalDeviceQueueFamilyProperties");
+    table.EnumerateDeviceExtensionProperties = (PFN_vkEnumerateDeviceExtensionProperties)gip(*pInstance, "vkEnumerateDeviceExtensionProperties");
 
     {
     	scoped_lock l(global_lock);
@@ -360,12 +397,321 @@ BCnLayer_GetPhysicalDeviceFormatProperties(VkPhysicalDevice physicalDevice,
    }
 }
 
+static bool
+has_device_extension(VkInstance instance, VkPhysicalDevice physicalDevice, const char *name)
+{
+	VkLayerInstanceDispatchTable &table = instanceDispatch[GetKey(instance)];
+	uint32_t count = 0;
+
+	if (!table.EnumerateDeviceExtensionProperties ||
+		table.EnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr) != VK_SUCCESS)
+		return false;
+
+	std::vector<VkExtensionProperties> extensions(count);
+	table.EnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+
+	for (const auto &extension : extensions) {
+		if (!strcmp(extension.extensionName, name))
+			return true;
+	}
+
+	return false;
+}
+
+static void
+add_device_extension(std::vector<const char *> &extensions, const char *name)
+{
+	for (const char *extension : extensions) {
+		if (!strcmp(extension, name))
+			return;
+	}
+
+	extensions.push_back(name);
+}
+
+static VkBaseInStructure *
+find_struct(const void *pNext, VkStructureType sType)
+{
+	for (auto *s = (VkBaseInStructure *)pNext; s; s = (VkBaseInStructure *)s->pNext) {
+		if (s->sType == sType)
+			return s;
+	}
+
+	return nullptr;
+}
+
+/*
+ * Turns on VK_EXT_shader_module_identifier and the pipeline creation cache
+ * control it relies on. Feature structs the application chained itself are
+ * left alone: if one of them has the feature disabled, identifiers are not
+ * used rather than overriding the application.
+ */
+static bool
+enable_shader_module_identifier(VkInstance instance,
+								VkPhysicalDevice physicalDevice,
+								VkDeviceCreateInfo *createInfo,
+								std::vector<const char *> &extensions,
+								VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT *identifierFeatures,
+								VkPhysicalDevicePipelineCreationCacheControlFeatures *cacheControlFeatures,
+								uint8_t *identifierAlgorithm)
+{
+	VkLayerInstanceDispatchTable &table = instanceDispatch[GetKey(instance)];
+
+	if (!table.GetPhysicalDeviceFeatures2 || !table.GetPhysicalDeviceProperties2 ||
+		!has_device_extension(instance, physicalDevice, VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) ||
+		!has_device_extension(instance, physicalDevice, VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME))
+		return false;
+
+	*identifierFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT };
+	*cacheControlFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES };
+	identifierFeatures->pNext = cacheControlFeatures;
+
+	VkPhysicalDeviceFeatures2 features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, identifierFeatures };
+	table.GetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+	if (!identifierFeatures->shaderModuleIdentifier || !cacheControlFeatures->pipelineCreationCacheControl)
+		return false;
+
+	auto *appIdentifier = (VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT *)
+		find_struct(createInfo->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT);
+	auto *appCacheControl = (VkPhysicalDevicePipelineCreationCacheControlFeatures *)
+		find_struct(createInfo->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES);
+	auto *appVulkan13 = (VkPhysicalDeviceVulkan13Features *)
+		find_struct(createInfo->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES);
+
+	if ((appIdentifier && !appIdentifier->shaderModuleIdentifier) ||
+		(appCacheControl && !appCacheControl->pipelineCreationCacheControl) ||
+		(appVulkan13 && !appVulkan13->pipelineCreationCacheControl))
+		return false;
+
+	identifierFeatures->pNext = nullptr;
+	cacheControlFeatures->pNext = nullptr;
+
+	if (!appIdentifier) {
+		identifierFeatures->pNext = (void *)createInfo->pNext;
+		createInfo->pNext = identifierFeatures;
+	}
+
+	if (!appCacheControl && !appVulkan13) {
+		cacheControlFeatures->pNext = (void *)createInfo->pNext;
+		createInfo->pNext = cacheControlFeatures;
+	}
+
+	add_device_extension(extensions, VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME);
+	add_device_extension(extensions, VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME);
+
+	VkPhysicalDeviceShaderModuleIdentifierPropertiesEXT identifierProps = {
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_PROPERTIES_EXT
+	};
+	VkPhysicalDeviceProperties2 props2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &identifierProps };
+	table.GetPhysicalDeviceProperties2(physicalDevice, &props2);
+	memcpy(identifierAlgorithm, identifierProps.shaderModuleIdentifierAlgorithmUUID, VK_UUID_SIZE);
+
+	return true;
+}
+
+/*
+ * Turns on VK_KHR_pipeline_executable_properties for BCN_PIPELINE_STATS.
+ * As above, a feature struct the application chained with the feature
+ * disabled is not overridden.
+ */
+static bool
+enable_pipeline_executable_properties(VkInstance instance,
+									  VkPhysicalDevice physicalDevice,
+									  VkDeviceCreateInfo *createInfo,
+									  std::vector<const char *> &extensions,
+									  VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR *executableFeatures)
+{
+	VkLayerInstanceDispatchTable &table = instanceDispatch[GetKey(instance)];
+
+	if (!table.GetPhysicalDeviceFeatures2 ||
+		!has_device_extension(instance, physicalDevice, VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME))
+		return false;
+
+	*executableFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR };
+
+	VkPhysicalDeviceFeatures2 features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, executableFeatures };
+	table.GetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+	if (!executableFeatures->pipelineExecutableInfo)
+		return false;
+
+	auto *appExecutable = (VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR *)
+		find_struct(createInfo->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR);
+
+	if (appExecutable && !appExecutable->pipelineExecutableInfo)
+		return false;
+
+	executableFeatures->pNext = nullptr;
+
+	if (!appExecutable) {
+		executableFeatures->pNext = (void *)createInfo->pNext;
+		createInfo->pNext = executableFeatures;
+	}
+
+	add_device_extension(extensions, VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME);
+
+	return true;
+}
+
+/*
+ * Turns on dynamic rendering for the fragment decode path, from the core
+ * feature or VK_KHR_dynamic_rendering. As above, a feature struct the
+ * application chained with the feature disabled is not overridden.
+ */
+static bool
+enable_dynamic_rendering(VkInstance instance,
+						 VkPhysicalDevice physicalDevice,
+						 VkDeviceCreateInfo *createInfo,
+						 std::vector<const char *> &extensions,
+						 VkPhysicalDeviceDynamicRenderingFeatures *renderingFeatures)
+{
+	VkLayerInstanceDispatchTable &table = instanceDispatch[GetKey(instance)];
+	bool has_extension = has_device_extension(instance, physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+
+	if (!table.GetPhysicalDeviceFeatures2 ||
+		(!has_extension && propertiesMap[GetKey(physicalDevice)].properties.apiVersion < VK_API_VERSION_1_3))
+		return false;
+
+	*renderingFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES };
+
+	VkPhysicalDeviceFeatures2 features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, renderingFeatures };
+	table.GetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+	if (!renderingFeatures->dynamicRendering)
+		return false;
+
+	auto *appRendering = (VkPhysicalDeviceDynamicRenderingFeatures *)
+		find_struct(createInfo->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES);
+	auto *appVulkan13 = (VkPhysicalDeviceVulkan13Features *)
+		find_struct(createInfo->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES);
+
+	if ((appRendering && !appRendering->dynamicRendering) ||
+		(appVulkan13 && !appVulkan13->dynamicRendering))
+		return false;
+
+	renderingFeatures->pNext = nullptr;
+
+	if (!appRendering && !appVulkan13) {
+		renderingFeatures->pNext = (void *)createInfo->pNext;
+		createInfo->pNext = renderingFeatures;
+	}
+
+	if (has_extension)
+		add_device_extension(extensions, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+
+	return true;
+}
+
+/*
+ * Turns on timeline semaphores, from the core feature or
+ * VK_KHR_timeline_semaphore, so the layer can tell when a submission the
+ * application passed its own fence to has completed without submitting
+ * again. As above, a feature struct the application chained with the
+ * feature disabled is not overridden.
+ */
+static bool
+enable_timeline_semaphore(VkInstance instance,
+						  VkPhysicalDevice physicalDevice,
+						  VkDeviceCreateInfo *createInfo,
+						  std::vector<const char *> &extensions,
+						  VkPhysicalDeviceTimelineSemaphoreFeatures *timelineFeatures)
+{
+	VkLayerInstanceDispatchTable &table = instanceDispatch[GetKey(instance)];
+	bool has_extension = has_device_extension(instance, physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+	if (!table.GetPhysicalDeviceFeatures2 ||
+		(!has_extension && propertiesMap[GetKey(physicalDevice)].properties.apiVersion < VK_API_VERSION_1_2))
+		return false;
+
+	*timelineFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES };
+
+	VkPhysicalDeviceFeatures2 features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, timelineFeatures };
+	table.GetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+	if (!timelineFeatures->timelineSemaphore)
+		return false;
+
+	auto *appTimeline = (VkPhysicalDeviceTimelineSemaphoreFeatures *)
+		find_struct(createInfo->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES);
+	auto *appVulkan12 = (VkPhysicalDeviceVulkan12Features *)
+		find_struct(createInfo->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES);
+
+	if ((appTimeline && !appTimeline->timelineSemaphore) ||
+		(appVulkan12 && !appVulkan12->timelineSemaphore))
+		return false;
+
+	timelineFeatures->pNext = nullptr;
+
+	if (!appTimeline && !appVulkan12) {
+		timelineFeatures->pNext = (void *)createInfo->pNext;
+		createInfo->pNext = timelineFeatures;
+	}
+
+	if (has_extension)
+		add_device_extension(extensions, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+	return true;
+}
+
+/*
+ * Adreno (UBWC) and Mali (AFBC) drop lossless compression for images with
+ * storage usage. On those, decoding goes through a staging buffer by default
+ * so that emulated images are created with transfer and sampled usage only.
+ */
+static bool
+has_framebuffer_compression(VkDriverId driverID)
+{
+	switch (driverID) {
+		case VK_DRIVER_ID_QUALCOMM_PROPRIETARY:
+		case VK_DRIVER_ID_MESA_TURNIP:
+		case VK_DRIVER_ID_ARM_PROPRIETARY:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Storage usage changes placement and alignment of vertex, index and uniform
+ * buffers on some drivers, by default it only goes on buffers that can be
+ * the source of an upload.
+ */
+static enum bcn_buffer_storage
+get_buffer_storage_mode(const char *mode)
+{
+	if (mode && !strcmp(mode, "all"))
+		return BCN_BUFFER_STORAGE_ALL;
+
+	if (mode && !strcmp(mode, "none"))
+		return BCN_BUFFER_STORAGE_NONE;
+
+	return BCN_BUFFER_STORAGE_TRANSFER_SRC;
+}
+
+/*
+ * Largest decoded extent per format family, 0 for no cap. BCN_MAX_EXTENT
+ * applies to every family, BCN_MAX_EXTENT_<family> overrides it.
+ */
+static void
+get_max_extents(uint32_t *maxExtent)
+{
+	static const char *names[BCN_FAMILY_COUNT] = {
+		"BCN_MAX_EXTENT_S3TC", "BCN_MAX_EXTENT_RGTC", "BCN_MAX_EXTENT_BC6", "BCN_MAX_EXTENT_BC7"
+	};
+	uint32_t fallback = getenv("BCN_MAX_EXTENT") ? atoi(getenv("BCN_MAX_EXTENT")) : 0;
+
+	for (int family = 0; family < BCN_FAMILY_COUNT; family++)
+		maxExtent[family] = getenv(names[family]) ? atoi(getenv(names[family])) : fallback;
+}
+
 VK_LAYER_EXPORT VkResult VKAPI_CALL
 BCnLayer_CreateDevice(VkPhysicalDevice physicalDevice,
 					  const VkDeviceCreateInfo *pCreateInfo,
 					  const VkAllocationCallbacks *pAllocator,
 					  VkDevice *pDevice)
 {
+	auto start = std::chrono::steady_clock::now();
 	VkResult result;
 	VkLayerDeviceCreateInfo *layerCreateInfo = (VkLayerDeviceCreateInfo *)pCreateInfo->pNext;
 	VkDeviceCreateInfo createInfo = *pCreateInfo;
@@ -380,6 +726,13 @@ BCnLayer_CreateDevice(VkPhysicalDevice physicalDevice,
 		return VK_ERROR_INITIALIZATION_FAILED;
 	}
 
+	VkLayerDeviceCreateInfo *loaderDataInfo = (VkLayerDeviceCreateInfo *)pCreateInfo->pNext;
+	while (loaderDataInfo && (loaderDataInfo->sType != VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO ||
+							  loaderDataInfo->function != VK_LOADER_DATA_CALLBACK))
+	{
+		loaderDataInfo = (VkLayerDeviceCreateInfo *)loaderDataInfo->pNext;
+	}
+
 	PFN_vkGetInstanceProcAddr gipa = layerCreateInfo->u.pLayerInfo->pfnNextGetInstanceProcAddr;
     PFN_vkGetDeviceProcAddr gdpa = layerCreateInfo->u.pLayerInfo->pfnNextGetDeviceProcAddr;
 	layerCreateInfo->u.pLayerInfo = layerCreateInfo->u.pLayerInfo->pNext;
@@ -389,16 +742,8 @@ BCnLayer_CreateDevice(VkPhysicalDevice physicalDevice,
     	return VK_ERROR_INITIALIZATION_FAILED;
 
     VkPhysicalDeviceMemoryProperties memoryProps{};
-    uint32_t idx;
-    uint32_t memoryIndex;
 
     instanceDispatch[GetKey(instance)].GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
-    for (idx = 0; idx < memoryProps.memoryTypeCount; idx++) {
-    	if (memoryProps.memoryTypes[idx].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-        	break;
-    }
-
-    memoryIndex = idx < memoryProps.memoryTypeCount ? idx : UINT32_MAX;
 
     if (createInfo.pEnabledFeatures) {
     	VkPhysicalDeviceFeatures enabledFeatures = *createInfo.pEnabledFeatures;
@@ -406,6 +751,57 @@ BCnLayer_CreateDevice(VkPhysicalDevice physicalDevice,
     	createInfo.pEnabledFeatures = &enabledFeatures;
     }
 
+    bool use_pipeline_cache = getenv("BCN_PIPELINE_CACHE") ? atoi(getenv("BCN_PIPELINE_CACHE")) : 1;
+    bool use_module_identifiers = false;
+    uint8_t identifierAlgorithm[VK_UUID_SIZE] = {};
+    std::vector<const char *> extensions(createInfo.ppEnabledExtensionNames,
+    									 createInfo.ppEnabledExtensionNames + createInfo.enabledExtensionCount);
+    VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT identifierFeatures;
+    VkPhysicalDevicePipelineCreationCacheControlFeatures cacheControlFeatures;
+
+    if (use_pipeline_cache) {
+    	use_module_identifiers = enable_shader_module_identifier(instance, physicalDevice, &createInfo, extensions,
+    		&identifierFeatures, &cacheControlFeatures, identifierAlgorithm);
+    }
+
+    bool use_memory_budget = instanceDispatch[GetKey(instance)].GetPhysicalDeviceMemoryProperties2 &&
+    	has_device_extension(instance, physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    if (use_memory_budget)
+    	add_device_extension(extensions, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    /*
+     * The fragment path renders into the emulated images, which keeps them
+     * eligible for framebuffer compression on the drivers that have it.
+     */
+    const char *decode_path = getenv("BCN_DECODE_PATH");
+    bool use_fragment = false;
+    VkPhysicalDeviceDynamicRenderingFeatures renderingFeatures;
+
+    if (!decode_path || !strcmp(decode_path, "auto"))
+    	use_fragment = has_framebuffer_compression(driverPropertiesMap[GetKey(physicalDevice)].driverID);
+    else
+    	use_fragment = !strcmp(decode_path, "fragment");
+
+    if (use_fragment)
+    	use_fragment = enable_dynamic_rendering(instance, physicalDevice, &createInfo, extensions, &renderingFeatures);
+
+    /* 1 writes out the compiler statistics of the decode pipelines, 2 adds their internal representations. */
+    int pipeline_stats = getenv("BCN_PIPELINE_STATS") ? atoi(getenv("BCN_PIPELINE_STATS")) : 0;
+    VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR executableFeatures;
+
+    if (pipeline_stats > 0 &&
+    	!enable_pipeline_executable_properties(instance, physicalDevice, &createInfo, extensions, &executableFeatures)) {
+    	Logger::log("error", "BCN_PIPELINE_STATS needs VK_KHR_pipeline_executable_properties, which is not available");
+    	pipeline_stats = 0;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures;
+    bool use_timeline = enable_timeline_semaphore(instance, physicalDevice, &createInfo, extensions, &timelineFeatures);
+
+    createInfo.enabledExtensionCount = extensions.size();
+    createInfo.ppEnabledExtensionNames = extensions.data();
+
     PFN_vkCreateDevice createDevice = (PFN_vkCreateDevice)gipa(instance, "vkCreateDevice");
     result = createDevice(physicalDevice, &createInfo, pAllocator, pDevice);
 
@@ -419,15 +815,28 @@ BCnLayer_CreateDevice(VkPhysicalDevice physicalDevice,
     table.DestroyDevice = (PFN_vkDestroyDevice)gdpa(*pDevice, "vkDestroyDevice");
     table.AllocateMemory = (PFN_vkAllocateMemory)gdpa(*pDevice, "vkAllocateMemory");
     table.FreeMemory = (PFN_vkFreeMemory)gdpa(*pDevice, "vkFreeMemory");
+    table.MapMemory = (PFN_vkMapMemory)gdpa(*pDevice, "vkMapMemory");
+    table.UnmapMemory = (PFN_vkUnmapMemory)gdpa(*pDevice, "vkUnmapMemory");
+    table.FlushMappedMemoryRanges = (PFN_vkFlushMappedMemoryRanges)gdpa(*pDevice, "vkFlushMappedMemoryRanges");
+    table.InvalidateMappedMemoryRanges = (PFN_vkInvalidateMappedMemoryRanges)gdpa(*pDevice, "vkInvalidateMappedMemoryRanges");
     table.CreateImage = (PFN_vkCreateImage)gdpa(*pDevice, "vkCreateImage");
+    table.GetImageMemoryRequirements = (PFN_vkGetImageMemoryRequirements)gdpa(*pDevice, "vkGetImageMemoryRequirements");
+    table.GetImageSubresourceLayout = (PFN_vkGetImageSubresourceLayout)gdpa(*pDevice, "vkGetImageSubresourceLayout");
+    table.BindImageMemory = (PFN_vkBindImageMemory)gdpa(*pDevice, "vkBindImageMemory");
+    table.BindImageMemory2 = (PFN_vkBindImageMemory2)gdpa(*pDevice, "vkBindImageMemory2");
+    if (!table.BindImageMemory2)
+    	table.BindImageMemory2 = (PFN_vkBindImageMemory2)gdpa(*pDevice, "vkBindImageMemory2KHR");
     table.CreateImageView = (PFN_vkCreateImageView)gdpa(*pDevice, "vkCreateImageView");
+    table.DestroyImageView = (PFN_vkDestroyImageView)gdpa(*pDevice, "vkDestroyImageView");
     table.DestroyImage = (PFN_vkDestroyImage)gdpa(*pDevice, "vkDestroyImage");
     table.CreateBuffer = (PFN_vkCreateBuffer)gdpa(*pDevice, "vkCreateBuffer");
     table.BindBufferMemory = (PFN_vkBindBufferMemory)gdpa(*pDevice, "vkBindBufferMemory");
+    table.GetBufferMemoryRequirements = (PFN_vkGetBufferMemoryRequirements)gdpa(*pDevice, "vkGetBufferMemoryRequirements");
     table.DestroyBuffer = (PFN_vkDestroyBuffer)gdpa(*pDevice, "vkDestroyBuffer");
     table.AllocateCommandBuffers = (PFN_vkAllocateCommandBuffers)gdpa(*pDevice, "vkAllocateCommandBuffers");
     table.CreateCommandPool = (PFN_vkCreateCommandPool)gdpa(*pDevice, "vkCreateCommandPool");
     table.GetDeviceQueue = (PFN_vkGetDeviceQueue)gdpa(*pDevice, "vkGetDeviceQueue");
+    table.GetDeviceQueue2 = (PFN_vkGetDeviceQueue2)gdpa(*pDevice, "vkGetDeviceQueue2");
     table.CreateFence = (PFN_vkCreateFence)gdpa(*pDevice, "vkCreateFence");
     table.DestroyFence = (PFN_vkDestroyFence)gdpa(*pDevice, "vkDestroyFence");
     table.WaitForFences = (PFN_vkWaitForFences)gdpa(*pDevice, "vkWaitForFences");
@@ -437,6 +846,22 @@ BCnLayer_CreateDevice(VkPhysicalDevice physicalDevice,
     table.EndCommandBuffer = (PFN_vkEndCommandBuffer)gdpa(*pDevice, "vkEndCommandBuffer");
     table.QueueSubmit = (PFN_vkQueueSubmit)gdpa(*pDevice, "vkQueueSubmit");
     table.QueueSubmit2 = (PFN_vkQueueSubmit2)gdpa(*pDevice, "vkQueueSubmit2");
+    if (!table.QueueSubmit2)
+    	table.QueueSubmit2 = (PFN_vkQueueSubmit2)gdpa(*pDevice, "vkQueueSubmit2KHR");
+    table.QueueWaitIdle = (PFN_vkQueueWaitIdle)gdpa(*pDevice, "vkQueueWaitIdle");
+    table.GetFenceStatus = (PFN_vkGetFenceStatus)gdpa(*pDevice, "vkGetFenceStatus");
+    table.ResetFences = (PFN_vkResetFences)gdpa(*pDevice, "vkResetFences");
+    table.WaitSemaphores = (PFN_vkWaitSemaphores)gdpa(*pDevice, "vkWaitSemaphores");
+    if (!table.WaitSemaphores)
+    	table.WaitSemaphores = (PFN_vkWaitSemaphores)gdpa(*pDevice, "vkWaitSemaphoresKHR");
+    table.GetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)gdpa(*pDevice, "vkGetSemaphoreCounterValue");
+    if (!table.GetSemaphoreCounterValue)
+    	table.GetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)gdpa(*pDevice, "vkGetSemaphoreCounterValueKHR");
+    table.CreateSemaphore = (PFN_vkCreateSemaphore)gdpa(*pDevice, "vkCreateSemaphore");
+    table.DestroySemaphore = (PFN_vkDestroySemaphore)gdpa(*pDevice, "vkDestroySemaphore");
+    table.ResetCommandPool = (PFN_vkResetCommandPool)gdpa(*pDevice, "vkResetCommandPool");
+    table.DestroyCommandPool = (PFN_vkDestroyCommandPool)gdpa(*pDevice, "vkDestroyCommandPool");
+    table.CmdExecuteCommands = (PFN_vkCmdExecuteCommands)gdpa(*pDevice, "vkCmdExecuteCommands");
     table.FreeCommandBuffers = (PFN_vkFreeCommandBuffers)gdpa(*pDevice, "vkFreeCommandBuffers");
     table.CreateDescriptorSetLayout = (PFN_vkCreateDescriptorSetLayout)gdpa(*pDevice, "vkCreateDescriptorSetLayout");
     table.CreateShaderModule = (PFN_vkCreateShaderModule)gdpa(*pDevice, "vkCreateShaderModule");
@@ -445,17 +870,65 @@ BCnLayer_CreateDevice(VkPhysicalDevice physicalDevice,
     table.CreateDescriptorPool = (PFN_vkCreateDescriptorPool)gdpa(*pDevice, "vkCreateDescriptorPool");
     table.AllocateDescriptorSets = (PFN_vkAllocateDescriptorSets)gdpa(*pDevice, "vkAllocateDescriptorSets");
     table.UpdateDescriptorSets = (PFN_vkUpdateDescriptorSets)gdpa(*pDevice, "vkUpdateDescriptorSets");
+    table.FreeDescriptorSets = (PFN_vkFreeDescriptorSets)gdpa(*pDevice, "vkFreeDescriptorSets");
     table.CmdBindPipeline = (PFN_vkCmdBindPipeline)gdpa(*pDevice, "vkCmdBindPipeline");
     table.CmdPushConstants = (PFN_vkCmdPushConstants)gdpa(*pDevice, "vkCmdPushConstants");
     table.CmdBindDescriptorSets = (PFN_vkCmdBindDescriptorSets)gdpa(*pDevice, "vkCmdBindDescriptorSets");
     table.CmdDispatch = (PFN_vkCmdDispatch)gdpa(*pDevice, "vkCmdDispatch");
     table.CmdCopyBufferToImage = (PFN_vkCmdCopyBufferToImage)gdpa(*pDevice, "vkCmdCopyBufferToImage");
+    table.CmdCopyBuffer = (PFN_vkCmdCopyBuffer)gdpa(*pDevice, "vkCmdCopyBuffer");
+    table.CmdPushDescriptorSetKHR = (PFN_vkCmdPushDescriptorSetKHR)gdpa(*pDevice, "vkCmdPushDescriptorSetKHR");
     table.CmdPipelineBarrier = (PFN_vkCmdPipelineBarrier)gdpa(*pDevice, "vkCmdPipelineBarrier");
+    table.CmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2)gdpa(*pDevice, "vkCmdPipelineBarrier2");
+    if (!table.CmdPipelineBarrier2)
+    	table.CmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2)gdpa(*pDevice, "vkCmdPipelineBarrier2KHR");
+    table.CmdWaitEvents = (PFN_vkCmdWaitEvents)gdpa(*pDevice, "vkCmdWaitEvents");
+    table.CmdCopyImage = (PFN_vkCmdCopyImage)gdpa(*pDevice, "vkCmdCopyImage");
+    table.CmdCopyImageToBuffer = (PFN_vkCmdCopyImageToBuffer)gdpa(*pDevice, "vkCmdCopyImageToBuffer");
+    table.CmdBlitImage = (PFN_vkCmdBlitImage)gdpa(*pDevice, "vkCmdBlitImage");
+    table.CmdCopyBufferToImage2 = (PFN_vkCmdCopyBufferToImage2)gdpa(*pDevice, "vkCmdCopyBufferToImage2");
+    if (!table.CmdCopyBufferToImage2)
+    	table.CmdCopyBufferToImage2 = (PFN_vkCmdCopyBufferToImage2)gdpa(*pDevice, "vkCmdCopyBufferToImage2KHR");
+    table.CmdCopyImageToBuffer2 = (PFN_vkCmdCopyImageToBuffer2)gdpa(*pDevice, "vkCmdCopyImageToBuffer2");
+    if (!table.CmdCopyImageToBuffer2)
+    	table.CmdCopyImageToBuffer2 = (PFN_vkCmdCopyImageToBuffer2)gdpa(*pDevice, "vkCmdCopyImageToBuffer2KHR");
+    table.CmdCopyImage2 = (PFN_vkCmdCopyImage2)gdpa(*pDevice, "vkCmdCopyImage2");
+    if (!table.CmdCopyImage2)
+    	table.CmdCopyImage2 = (PFN_vkCmdCopyImage2)gdpa(*pDevice, "vkCmdCopyImage2KHR");
+    table.CmdBlitImage2 = (PFN_vkCmdBlitImage2)gdpa(*pDevice, "vkCmdBlitImage2");
+    if (!table.CmdBlitImage2)
+    	table.CmdBlitImage2 = (PFN_vkCmdBlitImage2)gdpa(*pDevice, "vkCmdBlitImage2KHR");
     table.DestroyDescriptorPool = (PFN_vkDestroyDescriptorPool)gdpa(*pDevice, "vkDestroyDescriptorPool");
     table.DestroyDescriptorSetLayout = (PFN_vkDestroyDescriptorSetLayout)gdpa(*pDevice, "vkDestroyDescriptorSetLayout");
     table.DestroyPipelineLayout = (PFN_vkDestroyPipelineLayout)gdpa(*pDevice, "vkDestroyPipelineLayout");
     table.DestroyPipeline = (PFN_vkDestroyPipeline)gdpa(*pDevice, "vkDestroyPipeline");
     table.DestroyShaderModule = (PFN_vkDestroyShaderModule)gdpa(*pDevice, "vkDestroyShaderModule");
+    table.CreatePipelineCache = (PFN_vkCreatePipelineCache)gdpa(*pDevice, "vkCreatePipelineCache");
+    table.DestroyPipelineCache = (PFN_vkDestroyPipelineCache)gdpa(*pDevice, "vkDestroyPipelineCache");
+    table.GetPipelineCacheData = (PFN_vkGetPipelineCacheData)gdpa(*pDevice, "vkGetPipelineCacheData");
+    table.GetShaderModuleIdentifierEXT = (PFN_vkGetShaderModuleIdentifierEXT)gdpa(*pDevice, "vkGetShaderModuleIdentifierEXT");
+    table.GetPipelineExecutablePropertiesKHR = (PFN_vkGetPipelineExecutablePropertiesKHR)gdpa(*pDevice, "vkGetPipelineExecutablePropertiesKHR");
+    table.GetPipelineExecutableStatisticsKHR = (PFN_vkGetPipelineExecutableStatisticsKHR)gdpa(*pDevice, "vkGetPipelineExecutableStatisticsKHR");
+    table.GetPipelineExecutableInternalRepresentationsKHR = (PFN_vkGetPipelineExecutableInternalRepresentationsKHR)gdpa(*pDevice, "vkGetPipelineExecutableInternalRepresentationsKHR");
+    table.CreateGraphicsPipelines = (PFN_vkCreateGraphicsPipelines)gdpa(*pDevice, "vkCreateGraphicsPipelines");
+    table.CmdSetViewport = (PFN_vkCmdSetViewport)gdpa(*pDevice, "vkCmdSetViewport");
+    table.CmdSetScissor = (PFN_vkCmdSetScissor)gdpa(*pDevice, "vkCmdSetScissor");
+    table.CmdDraw = (PFN_vkCmdDraw)gdpa(*pDevice, "vkCmdDraw");
+    table.CmdBeginRendering = (PFN_vkCmdBeginRendering)gdpa(*pDevice, "vkCmdBeginRendering");
+    if (!table.CmdBeginRendering)
+    	table.CmdBeginRendering = (PFN_vkCmdBeginRendering)gdpa(*pDevice, "vkCmdBeginRenderingKHR");
+    table.CmdEndRendering = (PFN_vkCmdEndRendering)gdpa(*pDevice, "vkCmdEndRendering");
+    if (!table.CmdEndRendering)
+    	table.CmdEndRendering = (PFN_vkCmdEndRendering)gdpa(*pDevice, "vkCmdEndRenderingKHR");
+    table.CreateQueryPool = (PFN_vkCreateQueryPool)gdpa(*pDevice, "vkCreateQueryPool");
+    table.DestroyQueryPool = (PFN_vkDestroyQueryPool)gdpa(*pDevice, "vkDestroyQueryPool");
+    table.GetQueryPoolResults = (PFN_vkGetQueryPoolResults)gdpa(*pDevice, "vkGetQueryPoolResults");
+    table.CmdResetQueryPool = (PFN_vkCmdResetQueryPool)gdpa(*pDevice, "vkCmdResetQueryPool");
+    table.CmdWriteTimestamp = (PFN_vkCmdWriteTimestamp)gdpa(*pDevice, "vkCmdWriteTimestamp");
+    table.CmdBeginDebugUtilsLabelEXT = (PFN_vkCmdBeginDebugUtilsLabelEXT)gdpa(*pDevice, "vkCmdBeginDebugUtilsLabelEXT");
+    table.CmdEndDebugUtilsLabelEXT = (PFN_vkCmdEndDebugUtilsLabelEXT)gdpa(*pDevice, "vkCmdEndDebugUtilsLabelEXT");
+    table.SetDebugUtilsObjectNameEXT = (PFN_vkSetDebugUtilsObjectNameEXT)gdpa(*pDevice, "vkSetDebugUtilsObjectNameEXT");
+    table.QueuePresentKHR = (PFN_vkQueuePresentKHR)gdpa(*pDevice, "vkQueuePresentKHR");
 
     uint32_t queueCount;
     VkQueue queue;
@@ -483,22 +956,78 @@ BCnLayer_CreateDevice(VkPhysicalDevice physicalDevice,
     device->features = featuresMap[GetKey(physicalDevice)];
     device->compute_bcn_auto = bcn_compute_auto;
     device->table = table;
-    device->memoryIndex = memoryIndex;
     device->queue = queue;
+    device->queueFamilies = queueProps;
+    device->setLoaderData = loaderDataInfo ? loaderDataInfo->u.pfnSetDeviceLoaderData : nullptr;
     device->alloc = pAllocator;
-    device->use_image_view = getenv("BCN_COMPUTE_IMAGE_VIEW") ? atoi(getenv("BCN_COMPUTE_IMAGE_VIEW")) : 1;
+    device->use_image_view = getenv("BCN_COMPUTE_IMAGE_VIEW") ? atoi(getenv("BCN_COMPUTE_IMAGE_VIEW")) : !has_framebuffer_compression(device->driverProps.driverID);
+    device->use_fragment = use_fragment && table.CmdBeginRendering && table.CmdEndRendering;
+    device->buffer_storage = get_buffer_storage_mode(getenv("BCN_BUFFER_STORAGE"));
+    device->use_cache = getenv("BCN_CACHE") && atoi(getenv("BCN_CACHE"));
+    device->use_pack = getenv("BCN_PACK_FILE") && pack_open(getenv("BCN_PACK_FILE"));
+    device->use_dedup = getenv("BCN_DEDUP") && atoi(getenv("BCN_DEDUP"));
+    device->use_incremental = getenv("BCN_INCREMENTAL") && atoi(getenv("BCN_INCREMENTAL"));
+    get_max_extents(device->max_extent);
+    device->use_mip_drop = std::any_of(device->max_extent, device->max_extent + BCN_FAMILY_COUNT,
+    	[](uint32_t extent) { return extent != 0; });
+    device->use_lazy = getenv("BCN_LAZY") && atoi(getenv("BCN_LAZY"));
+    device->use_timeline = use_timeline && table.GetSemaphoreCounterValue;
+    device->use_census = getenv("BCN_CENSUS_FILE") != nullptr;
+    device->use_capture = getenv("BCN_CAPTURE_FILE") != nullptr;
+    /* The census reports GPU decode time, which comes from the timestamps. */
+    device->use_profile = (getenv("BCN_PROFILE") && atoi(getenv("BCN_PROFILE"))) || device->use_census;
+    device->incremental_max_rects = getenv("BCN_INCREMENTAL_MAX_RECTS") ? atoi(getenv("BCN_INCREMENTAL_MAX_RECTS")) : 64;
+    device->staging_window = (VkDeviceSize)(getenv("BCN_STAGING_WINDOW_MB") ? atoi(getenv("BCN_STAGING_WINDOW_MB")) : 16) << 20;
+    device->dedup_budget = (VkDeviceSize)(getenv("BCN_DEDUP_SIZE_MB") ? atoi(getenv("BCN_DEDUP_SIZE_MB")) : 64) << 20;
+    device->use_pipeline_cache = use_pipeline_cache;
+    device->use_async_pipelines = getenv("BCN_ASYNC_PIPELINES") ? atoi(getenv("BCN_ASYNC_PIPELINES")) : 1;
+    device->use_module_identifiers = use_module_identifiers && table.GetShaderModuleIdentifierEXT;
+    device->pipeline_stats = (pipeline_stats > 0 && table.GetPipelineExecutablePropertiesKHR &&
+    	table.GetPipelineExecutableStatisticsKHR && table.GetPipelineExecutableInternalRepresentationsKHR) ?
+    	(pipeline_stats > 1 ? BCN_PIPELINE_STATS_INTERNAL : BCN_PIPELINE_STATS_STATISTICS) : BCN_PIPELINE_STATS_OFF;
+    memcpy(device->identifierAlgorithm, identifierAlgorithm, VK_UUID_SIZE);
+
+    if (device->use_cache)
+    	cache_init();
+
+    allocator_init(device.get(), memoryProps,
+    	use_memory_budget ? instanceDispatch[GetKey(instance)].GetPhysicalDeviceMemoryProperties2 : nullptr);
+    retire_init(device.get());
+
+    if (device->use_lazy)
+    	lazy_init(device.get());
+
+    if (device->use_profile)
+    	profile_init(device.get());
+
+    if (device->use_census)
+    	census_init(device.get());
+
+    if (device->use_capture)
+    	capture_init(device.get());
    
     result = create_bcn_compute_pipelines(device.get());
     if (result != VK_SUCCESS) {
     	Logger::log("error", "Failed to create BCn compute pipeline, res %d", result);
         return result;
     }
+
+    if (device->use_fragment) {
+    	result = fragment_decode_init(device.get(), instanceDispatch[GetKey(instance)].GetPhysicalDeviceFormatProperties);
+    	if (result != VK_SUCCESS) {
+    		Logger::log("info", "Fragment decode unavailable, falling back to compute");
+    		device->use_fragment = false;
+    	}
+    }
    
 	{
 		scoped_lock l(global_lock);
     	deviceMap[GetKey(*pDevice)] = device;
     }
 
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    Logger::log("info", "Device created in %.2f ms", elapsed.count());
+
 	return VK_SUCCESS;
 }
 
@@ -512,43 +1041,133 @@ BCnLayer_DestroyDevice(VkDevice device,
 	if (!dev)
 		return;
 		
+	/* The compile thread uses the layouts and the pipeline cache until it is done. */
+	wait_bcn_pipelines(dev);
+
 	dev->table.DeviceWaitIdle(device);
+	lazy_destroy(dev);
+	dedup_destroy(dev);
+	retire_destroy(dev);
+	profile_destroy(dev);
+	census_destroy(dev);
+	capture_destroy(dev);
 
 	for (const auto& pool : dev->pools)
 		dev->table.DestroyDescriptorPool(device, pool, nullptr);
 			
+	stats_sub(BCN_STAT_DESCRIPTOR_POOLS, dev->pools.size());
 	dev->pools.clear();
 	dev->table.DestroyDescriptorSetLayout(device, dev->setLayout, nullptr);
 	dev->table.DestroyPipelineLayout(device, dev->layout, nullptr);
-	dev->table.DestroyPipeline(device, dev->s3tcPipeline, nullptr);
-	dev->table.DestroyPipeline(device, dev->bc7Pipeline, nullptr);
-	dev->table.DestroyPipeline(device, dev->bc6Pipeline, nullptr);
-	dev->table.DestroyPipeline(device, dev->rgtcPipeline, nullptr);
+
+	for (int family = 0; family < BCN_FAMILY_COUNT; family++)
+		dev->table.DestroyPipeline(device, dev->pipelines[family], nullptr);
+
+	fragment_decode_destroy(dev);
+
+	pipeline_cache_save(dev);
+	dev->table.DestroyPipelineCache(device, dev->pipelineCache, nullptr);
+	allocator_destroy(dev);
 	if (device != VK_NULL_HANDLE)
 		dev->table.DestroyDevice(device, pAllocator);
 				
 	deviceMap.erase(GetKey(device));
 }
 
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_DeviceWaitIdle(VkDevice device)
+{
+	VkResult result;
+
+	struct device *dev = get_device(device);
+	if (!dev)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	result = dev->table.DeviceWaitIdle(device);
+	if (result == VK_SUCCESS)
+		retire_reap(dev);
+
+	return result;
+}
+
 VK_LAYER_EXPORT PFN_vkVoidFunction VKAPI_CALL
 BCnLayer_GetDeviceProcAddr(VkDevice device, 
 						   const char *pName)
 {
 	GETPROCADDR(CreateImage);
 	GETPROCADDR(CreateImageView);
+	GETPROCADDR(GetImageSubresourceLayout);
+	GETPROCADDR(BindImageMemory);
+	GETPROCADDR(BindImageMemory2);
+	if (!strcmp(pName, "vkBindImageMemory2KHR"))
+		return (PFN_vkVoidFunction)&BCnLayer_BindImageMemory2;
+	GETPROCADDR(FlushMappedMemoryRanges);
+	GETPROCADDR(DestroyImageView);
+	GETPROCADDR(UpdateDescriptorSets);
+	GETPROCADDR_OPTIONAL("vkCmdPushDescriptorSetKHR", CmdPushDescriptorSetKHR);
 	GETPROCADDR(DestroyDevice);
 	GETPROCADDR(DestroyImage);
+	if (!strcmp(pName, "vkSetDebugUtilsObjectNameEXT")) {
+		scoped_lock l(global_lock);
+		struct device *dev = get_device(device);
+		if (!dev || !dev->table.SetDebugUtilsObjectNameEXT)
+			return NULL;
+
+		return (PFN_vkVoidFunction)&BCnLayer_SetDebugUtilsObjectNameEXT;
+	}
 	GETPROCADDR(CreateBuffer);
 	GETPROCADDR(BindBufferMemory);
 	GETPROCADDR(DestroyBuffer);
+	GETPROCADDR(AllocateMemory);
+	GETPROCADDR(FreeMemory);
+	GETPROCADDR(MapMemory);
+	GETPROCADDR(UnmapMemory);
+	GETPROCADDR(CreateCommandPool);
 	GETPROCADDR(AllocateCommandBuffers);
 	GETPROCADDR(FreeCommandBuffers);
+	GETPROCADDR(ResetCommandBuffer);
+	GETPROCADDR(ResetCommandPool);
+	GETPROCADDR(DestroyCommandPool);
 	GETPROCADDR(CmdCopyBufferToImage);
+	GETPROCADDR(BeginCommandBuffer);
+	GETPROCADDR(EndCommandBuffer);
+	GETPROCADDR(CmdPipelineBarrier);
+	GETPROCADDR_OPTIONAL("vkCmdPipelineBarrier2", CmdPipelineBarrier2);
+	GETPROCADDR(CmdWaitEvents);
+	GETPROCADDR(CmdCopyImage);
+	GETPROCADDR(CmdCopyImageToBuffer);
+	GETPROCADDR(CmdBlitImage);
+	GETPROCADDR_OPTIONAL("vkCmdCopyBufferToImage2", CmdCopyBufferToImage2);
+	GETPROCADDR_OPTIONAL("vkCmdCopyBufferToImage2KHR", CmdCopyBufferToImage2);
+	GETPROCADDR_OPTIONAL("vkCmdCopyImageToBuffer2", CmdCopyImageToBuffer2);
+	GETPROCADDR_OPTIONAL("vkCmdCopyImageToBuffer2KHR", CmdCopyImageToBuffer2);
+	GETPROCADDR_OPTIONAL("vkCmdCopyImage2", CmdCopyImage2);
+	GETPROCADDR_OPTIONAL("vkCmdCopyImage2KHR", CmdCopyImage2);
+	GETPROCADDR_OPTIONAL("vkCmdBlitImage2", CmdBlitImage2);
+	GETPROCADDR_OPTIONAL("vkCmdBlitImage2KHR", CmdBlitImage2);
+	GETPROCADDR(CmdExecuteCommands);
+	GETPROCADDR_OPTIONAL("vkCmdPipelineBarrier2KHR", CmdPipelineBarrier2);
 	GETPROCADDR(GetDeviceQueue);
+	GETPROCADDR(GetDeviceQueue2);
 	GETPROCADDR(QueueSubmit);
+	GETPROCADDR_OPTIONAL("vkQueueSubmit2", QueueSubmit2);
+	GETPROCADDR_OPTIONAL("vkQueueSubmit2KHR", QueueSubmit2);
+	GETPROCADDR(QueueWaitIdle);
+	if (!strcmp(pName, "vkQueuePresentKHR")) {
+		scoped_lock l(global_lock);
+		struct device *dev = get_device(device);
+		if (dev && dev->use_capture && dev->table.QueuePresentKHR)
+			return (PFN_vkVoidFunction)&BCnLayer_QueuePresentKHR;
+
+		return dev ? dev->table.GetDeviceProcAddr(device, pName) : NULL;
+	}
+	GETPROCADDR(DeviceWaitIdle);
 	GETPROCADDR(CreateFence);
 	GETPROCADDR(DestroyFence);
 	GETPROCADDR(WaitForFences);
+	GETPROCADDR(GetFenceStatus);
+	GETPROCADDR_OPTIONAL("vkWaitSemaphores", WaitSemaphores);
+	GETPROCADDR_OPTIONAL("vkWaitSemaphoresKHR", WaitSemaphores);
 
 	{
 		scoped_lock l(global_lock);
@@ -4,6 +4,9 @@
 #include "vulkan/vk_layer.h"
 #include "vk_func.hpp"
 #include "logger.hpp"
+#include "format.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 
 #include <vulkan/vulkan.h>
 #include <unistd.h>
@@ -12,6 +15,8 @@
 #include <vector>
 #include <memory>
 #include <cstring>
+#include <thread>
+#include <condition_variable>
 
 #undef VK_LAYER_EXPORT
 #if defined(WIN32)
@@ -31,7 +36,55 @@ void* GetKey(T item) {
 }
 
 extern std::mutex global_lock;
-typedef std::lock_guard<std::mutex> scoped_lock;
+
+/* Layer locks. Waits on a contended lock are timed into the live counters. */
+struct scoped_lock {
+	explicit scoped_lock(std::mutex &m) : m(m)
+	{
+		if (m.try_lock())
+			return;
+
+		if (!bcn_stats_segment) {
+			m.lock();
+			return;
+		}
+
+		uint64_t start = stats_now_ns();
+		m.lock();
+		stats_add(BCN_STAT_LOCK_WAITS, 1);
+		stats_add(BCN_STAT_LOCK_WAIT_NS, stats_now_ns() - start);
+	}
+
+	~scoped_lock()
+	{
+		m.unlock();
+	}
+
+	scoped_lock(const scoped_lock &) = delete;
+	scoped_lock &operator=(const scoped_lock &) = delete;
+
+	std::mutex &m;
+};
+
+enum bcn_pipeline_state {
+	BCN_PIPELINE_PENDING,
+	BCN_PIPELINE_BUILDING,
+	BCN_PIPELINE_READY
+};
+
+/* Which application buffers get storage usage so they can be bound to the decoders. */
+enum bcn_buffer_storage {
+	BCN_BUFFER_STORAGE_ALL,
+	BCN_BUFFER_STORAGE_TRANSFER_SRC,
+	BCN_BUFFER_STORAGE_NONE
+};
+
+/* What BCN_PIPELINE_STATS asks the driver to report about the decode pipelines. */
+enum bcn_pipeline_stats {
+	BCN_PIPELINE_STATS_OFF,
+	BCN_PIPELINE_STATS_STATISTICS,
+	BCN_PIPELINE_STATS_INTERNAL
+};
 
 struct device {
 	VkDevice handle;
@@ -41,19 +94,46 @@ struct device {
 	VkPhysicalDeviceDriverProperties driverProps;
 	bool compute_bcn_auto;
 	VkLayerDispatchTable table;
-	VkPipeline s3tcPipeline;
-	VkPipeline rgtcPipeline;
-	VkPipeline bc6Pipeline;
-	VkPipeline bc7Pipeline;
+	VkPipeline pipelines[BCN_FAMILY_COUNT];
+	VkPipelineCache pipelineCache;
+	bool use_pipeline_cache;
+	bool use_module_identifiers;
+	enum bcn_pipeline_stats pipeline_stats;
+	uint8_t identifierAlgorithm[VK_UUID_SIZE];
+	std::vector<uint8_t> moduleIdentifiers[BCN_FAMILY_COUNT];
+	bool use_async_pipelines;
+	std::thread pipelineThread;
+	std::mutex pipelineLock;
+	std::condition_variable pipelineCond;
+	enum bcn_pipeline_state pipelineState[BCN_FAMILY_COUNT];
+	bool pipelineWanted[BCN_FAMILY_COUNT];
 	VkPipelineLayout layout;
 	VkQueue queue;
-	uint32_t memoryIndex;
+	std::vector<VkQueueFamilyProperties> queueFamilies;
+	PFN_vkSetDeviceLoaderData setLoaderData;
 	int use_image_view;
+	bool use_fragment;
+	enum bcn_buffer_storage buffer_storage;
+	bool use_cache;
+	bool use_pack;
+	bool use_dedup;
+	bool use_incremental;
+	bool use_lazy;
+	uint32_t max_extent[BCN_FAMILY_COUNT];
+	bool use_mip_drop;
+	bool use_profile;
+	bool use_census;
+	bool use_capture;
+	bool use_timeline;
+	uint32_t incremental_max_rects;
+	VkDeviceSize staging_window;
+	VkDeviceSize dedup_budget;
 	VkDescriptorSetLayout setLayout;
 	std::vector<VkDescriptorPool> pools;
 	const VkAllocationCallbacks *alloc;
 };
 
 struct device *get_device(VkDevice);
+struct device *get_queue_device(VkQueue);
 
 #endif
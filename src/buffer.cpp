@@ -1,22 +1,43 @@
 #include "buffer.hpp"
+#include "bcn.hpp"
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cstring>
 
 std::unordered_map<VkBuffer, std::unique_ptr<struct buffer>> buffersMap;
 
+/*
+ * Returns a layer owned buffer of at least size bytes for the given usage,
+ * from the allocator pools when one fits, with memory of a type picked by
+ * the allocator otherwise.
+ */
 std::unique_ptr<struct buffer>
-create_staging_buffer(struct device *dev, int size) 
+create_staging_buffer(struct device *dev, VkDeviceSize size, enum alloc_usage usage)
 {
 	VkResult result;
 	VkBuffer buffer;
 	VkDeviceMemory memory;
+	VkMemoryRequirements reqs;
+	uint32_t typeIndex;
 	VkLayerDispatchTable table = dev->table;
 	VkDevice device = dev->handle;
 
+	auto pooled = allocator_reuse(dev, size, usage);
+	if (pooled) {
+		stats_add(BCN_STAT_STAGING_BUFFERS, 1);
+		stats_gauge_add(BCN_STAT_STAGING_BYTES, BCN_STAT_STAGING_PEAK, pooled->capacity);
+		return pooled;
+	}
+
+	VkDeviceSize capacity = allocator_round_size(size);
+
 	VkBufferCreateInfo buffer_create_info = {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
 		.pNext = nullptr,
 		.flags = 0,
-		.size = static_cast<VkDeviceSize>(size),
-		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		.size = capacity,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
 		.queueFamilyIndexCount = 0,
 		.pQueueFamilyIndices = nullptr
@@ -28,43 +49,58 @@ create_staging_buffer(struct device *dev, int size)
 		Logger::log("error", "Failed to create staging buffer, res %d", result);
 		return NULL;
 	}
-/*
-	VkMemoryDedicatedAllocateInfo buffer_allocate_info = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
-		.pNext = nullptr,
-		.image = VK_NULL_HANDLE,
-		.buffer = buffer
-	};
-*/
-	VkMemoryAllocateInfo allocate_info = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.pNext = nullptr,
-		.allocationSize = static_cast<VkDeviceSize>(size),
-		.memoryTypeIndex = dev->memoryIndex
-	};
 
-	result = table.AllocateMemory(device, &allocate_info, nullptr, &memory);
+	table.GetBufferMemoryRequirements(device, buffer, &reqs);
+
+	result = allocator_allocate(dev, reqs, usage, &memory, &typeIndex);
 	if (result != VK_SUCCESS) {
 		Logger::log("error", "Failed to allocate staging buffer memory, res %d", result);
+		table.DestroyBuffer(device, buffer, nullptr);
 		return NULL;
 	}
 
 	result = table.BindBufferMemory(device, buffer, memory, 0);
 	if (result != VK_SUCCESS) {
 		Logger::log("error", "Failed to bind staging buffer memory, res %d", result);
+		table.DestroyBuffer(device, buffer, nullptr);
+		allocator_free(dev, memory, reqs.size, typeIndex);
 		return NULL;
 	}
 
 	auto staging_buf = std::make_unique<struct buffer>();
 	staging_buf->handle = buffer;
 	staging_buf->memory = memory;
+	staging_buf->size = size;
 	staging_buf->offset = 0;
 	staging_buf->device = dev;
 	staging_buf->alloc = nullptr;
+	staging_buf->cache_pending = false;
+	staging_buf->storage = true;
+	staging_buf->capacity = capacity;
+	staging_buf->memorySize = reqs.size;
+	staging_buf->typeIndex = typeIndex;
+	staging_buf->usage = usage;
+
+	stats_add(BCN_STAT_STAGING_BUFFERS, 1);
+	stats_gauge_add(BCN_STAT_STAGING_BYTES, BCN_STAT_STAGING_PEAK, capacity);
 
 	return staging_buf;
 }
 
+/* Gives a staging buffer the GPU no longer uses back to the allocator. */
+void
+release_staging_buffer(struct device *dev, std::unique_ptr<struct buffer> buf)
+{
+	stats_sub(BCN_STAT_STAGING_BUFFERS, 1);
+	stats_sub(BCN_STAT_STAGING_BYTES, buf->capacity);
+
+	if (allocator_recycle(dev, buf))
+		return;
+
+	dev->table.DestroyBuffer(dev->handle, buf->handle, nullptr);
+	allocator_free(dev, buf->memory, buf->memorySize, buf->typeIndex);
+}
+
 struct buffer *
 find_buffer(VkBuffer buffer)
 {
@@ -92,7 +128,17 @@ BCnLayer_CreateBuffer(VkDevice device,
 
 	table = dev->table;
 
-	create_info.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT; 
+	switch (dev->buffer_storage) {
+		case BCN_BUFFER_STORAGE_ALL:
+			create_info.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+			break;
+		case BCN_BUFFER_STORAGE_TRANSFER_SRC:
+			if (create_info.usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
+				create_info.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+			break;
+		default:
+			break;
+	}
 
 	result = table.CreateBuffer(device, &create_info, pAllocator, pBuffer);
 	if (result != VK_SUCCESS) {
@@ -105,6 +151,10 @@ BCnLayer_CreateBuffer(VkDevice device,
 	buf->size = pCreateInfo->size;
 	buf->device = dev;
 	buf->alloc = pAllocator;
+	buf->memory = VK_NULL_HANDLE;
+	buf->offset = 0;
+	buf->cache_pending = false;
+	buf->storage = (create_info.usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) != 0;
 
 	{
 		scoped_lock l(global_lock);
@@ -159,3 +209,91 @@ BCnLayer_DestroyBuffer(VkDevice device,
 	dev->table.DestroyBuffer(device, buffer, pAllocator);
 	buffersMap.erase(buffer);
 }
+
+/*
+ * Host pointer to the blocks of a single layer 2D upload region, rowPitch
+ * receives the distance between block rows. Returns nullptr if the source
+ * memory is not host visible.
+ */
+const uint8_t *
+get_region_blocks(struct buffer *buf, VkFormat format, const VkBufferImageCopy *region, VkDeviceSize *rowPitch)
+{
+	if (!buf || region->imageSubresource.layerCount != 1 || region->imageExtent.depth > 1)
+		return nullptr;
+
+	uint32_t width = region->imageExtent.width;
+	uint32_t height = region->imageExtent.height;
+	uint32_t rowExtent = std::max(region->bufferRowLength, width);
+	VkDeviceSize blockSize = get_block_size(format);
+	VkDeviceSize rowBytes = ((width + 3) / 4) * blockSize;
+	uint32_t rows = (height + 3) / 4;
+
+	*rowPitch = ((rowExtent + 3) / 4) * blockSize;
+
+	return (const uint8_t *)get_buffer_host_pointer(buf, region->bufferOffset, *rowPitch * (rows - 1) + rowBytes);
+}
+
+/*
+ * Hashes the compressed blocks a copy region reads, false if the source
+ * memory is not host visible.
+ */
+bool
+hash_bcn_region(struct buffer *buf, VkFormat format, const VkBufferImageCopy *region, hash128 *key)
+{
+	VkDeviceSize rowPitch;
+	const uint8_t *src = get_region_blocks(buf, format, region, &rowPitch);
+
+	if (!src)
+		return false;
+
+	*key = hash_bcn_blocks(format, region->imageExtent.width, region->imageExtent.height, src, rowPitch);
+	return true;
+}
+
+/*
+ * Copies the blocks of a single layer 2D upload region into a layer owned
+ * buffer, tightly packed, and rebases the region onto it. Whatever the
+ * application writes to its buffer afterwards, the copy holds the blocks
+ * as they were when the upload was recorded.
+ */
+std::unique_ptr<struct buffer>
+snapshot_region_blocks(struct device *dev, struct buffer *buf, VkFormat format, VkBufferImageCopy *region)
+{
+	VkDeviceSize rowPitch;
+	void *data;
+
+	const uint8_t *src = get_region_blocks(buf, format, region, &rowPitch);
+	if (!src)
+		return nullptr;
+
+	VkDeviceSize rowBytes = ((region->imageExtent.width + 3) / 4) * get_block_size(format);
+	uint32_t rows = (region->imageExtent.height + 3) / 4;
+
+	auto blocks = create_staging_buffer(dev, rowBytes * rows, ALLOC_UPLOAD);
+	if (!blocks)
+		return nullptr;
+
+	if (dev->table.MapMemory(dev->handle, blocks->memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+		release_staging_buffer(dev, std::move(blocks));
+		return nullptr;
+	}
+
+	for (uint32_t y = 0; y < rows; y++)
+		memcpy((uint8_t *)data + y * rowBytes, src + y * rowPitch, rowBytes);
+
+	VkMappedMemoryRange range = {
+		.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+		.pNext = nullptr,
+		.memory = blocks->memory,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+	dev->table.FlushMappedMemoryRanges(dev->handle, 1, &range);
+	dev->table.UnmapMemory(dev->handle, blocks->memory);
+
+	region->bufferOffset = 0;
+	region->bufferRowLength = 0;
+	region->bufferImageHeight = 0;
+
+	return blocks;
+}
@@ -2,6 +2,8 @@
 #define __BUFFER_HPP
 
 #include "bcn_layer.hpp"
+#include "hash.hpp"
+#include "allocator.hpp"
 
 struct buffer {
     VkBuffer handle;
@@ -10,9 +12,20 @@ struct buffer {
     VkDeviceSize offset;
     struct device *device;
     const VkAllocationCallbacks *alloc;
+    hash128 cache_key;
+    bool cache_pending;
+    bool storage;
+    VkDeviceSize capacity;
+    VkDeviceSize memorySize;
+    uint32_t typeIndex;
+    enum alloc_usage usage;
 };
 
 struct buffer *find_buffer(VkBuffer);
-std::unique_ptr<struct buffer> create_staging_buffer(struct device *dev, int size);
+std::unique_ptr<struct buffer> create_staging_buffer(struct device *dev, VkDeviceSize size, enum alloc_usage usage);
+void release_staging_buffer(struct device *dev, std::unique_ptr<struct buffer> buf);
+const uint8_t *get_region_blocks(struct buffer *buf, VkFormat format, const VkBufferImageCopy *region, VkDeviceSize *rowPitch);
+bool hash_bcn_region(struct buffer *buf, VkFormat format, const VkBufferImageCopy *region, hash128 *key);
+std::unique_ptr<struct buffer> snapshot_region_blocks(struct device *dev, struct buffer *buf, VkFormat format, VkBufferImageCopy *region);
 
 #endif
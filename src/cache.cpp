@@ -0,0 +1,352 @@
+#include "cache.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+
+#define BCN_CACHE_MAGIC 0x434e4342
+#define BCN_CACHE_VERSION 1
+
+struct cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key_lo;
+	uint64_t key_hi;
+	uint64_t size;
+};
+
+static std::mutex cache_lock;
+static std::string cache_dir;
+static uint64_t cache_limit;
+static uint64_t cache_used;
+static bool cache_ready = false;
+
+/*
+ * Stores are written by a background thread: writing, syncing and evicting
+ * must not stall the submission thread that retires the decode.
+ */
+struct cache_pending_store {
+	hash128 key;
+	std::vector<uint8_t> data;
+};
+
+#define BCN_CACHE_QUEUE_LIMIT (256ull << 20)
+
+static std::mutex store_lock;
+static std::condition_variable store_cond;
+static std::deque<struct cache_pending_store> store_queue;
+static uint64_t store_queued;
+static std::thread store_thread;
+static bool store_stop;
+
+std::string
+get_cache_dir()
+{
+	const char *xdg = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	std::string base;
+
+	if (xdg && *xdg)
+		base = xdg;
+	else if (home && *home)
+		base = std::string(home) + "/.cache";
+	else
+		return "";
+
+	std::string dir = base + "/bcn_layer";
+	mkdir(base.c_str(), 0755);
+	if (mkdir(dir.c_str(), 0755) && errno != EEXIST) {
+		Logger::log("error", "Failed to create cache directory %s", dir.c_str());
+		return "";
+	}
+
+	return dir;
+}
+
+/*
+ * Writes to a temporary file in the same directory, syncs it and renames it
+ * over the destination, so readers only ever see complete files.
+ */
+bool
+write_file_atomic(const std::string &path, const void *header, size_t headerSize, const void *data, size_t size)
+{
+	std::string tmp = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(gettid());
+
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return false;
+
+	const void *chunks[] = { header, data };
+	size_t sizes[] = { headerSize, size };
+	bool ok = true;
+
+	for (int i = 0; i < 2 && ok; i++) {
+		const uint8_t *ptr = (const uint8_t *)chunks[i];
+		size_t left = chunks[i] ? sizes[i] : 0;
+
+		while (left > 0) {
+			ssize_t written = write(fd, ptr, left);
+			if (written < 0 && errno == EINTR)
+				continue;
+			if (written <= 0) {
+				ok = false;
+				break;
+			}
+			ptr += written;
+			left -= written;
+		}
+	}
+
+	ok = ok && fsync(fd) == 0;
+	close(fd);
+
+	if (!ok || rename(tmp.c_str(), path.c_str())) {
+		unlink(tmp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+static std::string
+entry_path(const hash128 &key)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "/%016llx%016llx.bin",
+		(unsigned long long)key.hi, (unsigned long long)key.lo);
+	return cache_dir + name;
+}
+
+/* Drops least recently used entries until the cache fits in 90% of its limit. */
+static void
+cache_evict()
+{
+	struct file_info {
+		std::string path;
+		time_t mtime;
+		uint64_t size;
+	};
+
+	std::vector<struct file_info> files;
+	uint64_t total = 0;
+
+	DIR *dir = opendir(cache_dir.c_str());
+	if (!dir)
+		return;
+
+	while (struct dirent *ent = readdir(dir)) {
+		std::string name = ent->d_name;
+		std::string path = cache_dir + "/" + name;
+		struct stat st;
+
+		if (stat(path.c_str(), &st) || !S_ISREG(st.st_mode))
+			continue;
+
+		/* Leftovers from a crash in the middle of write_file_atomic. */
+		if (name.find(".tmp.") != std::string::npos) {
+			if (st.st_mtime + 60 < time(nullptr))
+				unlink(path.c_str());
+			continue;
+		}
+
+		if (name.size() < 4 || name.compare(name.size() - 4, 4, ".bin"))
+			continue;
+
+		files.push_back({ path, st.st_mtime, (uint64_t)st.st_size });
+		total += st.st_size;
+	}
+	closedir(dir);
+
+	if (total > cache_limit) {
+		std::sort(files.begin(), files.end(), [](const struct file_info &a, const struct file_info &b) {
+			return a.mtime < b.mtime;
+		});
+
+		for (const auto &file : files) {
+			if (total <= cache_limit / 10 * 9)
+				break;
+			if (!unlink(file.path.c_str()))
+				total -= file.size;
+		}
+	}
+
+	cache_used = total;
+}
+
+static void
+write_entry(const hash128 &key, const void *data, size_t size)
+{
+	std::string path = entry_path(key);
+	if (!access(path.c_str(), F_OK))
+		return;
+
+	struct cache_header header = {
+		.magic = BCN_CACHE_MAGIC,
+		.version = BCN_CACHE_VERSION,
+		.key_lo = key.lo,
+		.key_hi = key.hi,
+		.size = size
+	};
+
+	if (!write_file_atomic(path, &header, sizeof(header), data, size)) {
+		Logger::log("error", "Failed to write cache entry %s", path.c_str());
+		return;
+	}
+
+	std::lock_guard<std::mutex> l(cache_lock);
+
+	cache_used += sizeof(header) + size;
+	if (cache_used > cache_limit)
+		cache_evict();
+}
+
+static void
+store_loop()
+{
+	std::unique_lock<std::mutex> l(store_lock);
+
+	for (;;) {
+		store_cond.wait(l, [] { return store_stop || !store_queue.empty(); });
+
+		if (store_queue.empty())
+			break;
+
+		struct cache_pending_store store = std::move(store_queue.front());
+		store_queue.pop_front();
+
+		l.unlock();
+		write_entry(store.key, store.data.data(), store.data.size());
+		l.lock();
+
+		store_queued -= store.data.size();
+	}
+}
+
+/* Writes out what is still queued. */
+static void
+cache_shutdown()
+{
+	{
+		std::lock_guard<std::mutex> l(store_lock);
+		store_stop = true;
+	}
+
+	store_cond.notify_all();
+	store_thread.join();
+}
+
+void
+cache_init()
+{
+	std::lock_guard<std::mutex> l(cache_lock);
+
+	if (cache_ready)
+		return;
+
+	cache_dir = get_cache_dir();
+	if (cache_dir.empty())
+		return;
+
+	const char *limit_env = getenv("BCN_CACHE_SIZE_MB");
+	cache_limit = (uint64_t)(limit_env ? atoi(limit_env) : 1024) << 20;
+
+	cache_evict();
+	cache_ready = true;
+
+	store_thread = std::thread(store_loop);
+	atexit(cache_shutdown);
+
+	Logger::log("info", "Texture cache at %s, %llu/%llu MB used", cache_dir.c_str(),
+		(unsigned long long)(cache_used >> 20), (unsigned long long)(cache_limit >> 20));
+}
+
+bool
+cache_open(const hash128 &key, struct cache_entry *entry)
+{
+	if (!cache_ready)
+		return false;
+
+	std::string path = entry_path(key);
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) || (size_t)st.st_size <= sizeof(struct cache_header)) {
+		close(fd);
+		return false;
+	}
+
+	void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	/* Bump the modification time, the eviction order is by mtime. */
+	futimens(fd, nullptr);
+	close(fd);
+
+	const struct cache_header *header = (const struct cache_header *)map;
+	if (header->magic != BCN_CACHE_MAGIC || header->version != BCN_CACHE_VERSION ||
+		header->key_lo != key.lo || header->key_hi != key.hi ||
+		header->size != st.st_size - sizeof(struct cache_header))
+	{
+		munmap(map, st.st_size);
+		return false;
+	}
+
+	entry->map = map;
+	entry->mapSize = st.st_size;
+	entry->data = (const uint8_t *)map + sizeof(struct cache_header);
+	entry->size = header->size;
+
+	return true;
+}
+
+void
+cache_close(struct cache_entry *entry)
+{
+	if (entry->map)
+		munmap(entry->map, entry->mapSize);
+
+	entry->map = nullptr;
+	entry->data = nullptr;
+}
+
+/*
+ * Queues a copy of the payload for the writer thread. Past the queue limit
+ * the store is dropped, the entry is written again on a later miss.
+ */
+void
+cache_store(const hash128 &key, const void *data, size_t size)
+{
+	if (!cache_ready)
+		return;
+
+	{
+		std::lock_guard<std::mutex> l(store_lock);
+
+		if (store_stop || store_queued + size > BCN_CACHE_QUEUE_LIMIT)
+			return;
+
+		store_queued += size;
+	}
+
+	struct cache_pending_store store = {
+		.key = key,
+		.data = std::vector<uint8_t>((const uint8_t *)data, (const uint8_t *)data + size)
+	};
+
+	{
+		std::lock_guard<std::mutex> l(store_lock);
+		store_queue.push_back(std::move(store));
+	}
+
+	store_cond.notify_one();
+}
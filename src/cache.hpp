@@ -0,0 +1,23 @@
+#ifndef __CACHE_HPP
+#define __CACHE_HPP
+
+#include "bcn_layer.hpp"
+#include "hash.hpp"
+
+#include <string>
+
+struct cache_entry {
+	void *map;
+	size_t mapSize;
+	const void *data;
+	size_t size;
+};
+
+std::string get_cache_dir();
+bool write_file_atomic(const std::string &path, const void *header, size_t headerSize, const void *data, size_t size);
+void cache_init();
+bool cache_open(const hash128 &key, struct cache_entry *entry);
+void cache_close(struct cache_entry *entry);
+void cache_store(const hash128 &key, const void *data, size_t size);
+
+#endif
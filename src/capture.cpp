@@ -0,0 +1,223 @@
+#include "capture.hpp"
+#include "bcn_layer.hpp"
+#include "buffer.hpp"
+#include "image.hpp"
+
+#include <chrono>
+#include <string>
+#include <unordered_set>
+
+/*
+ * Capture of the emulated images and their uploads to BCN_CAPTURE_FILE,
+ * for tools/bcn_replay. Only blocks the host can read at record time are
+ * captured, like for the upload cache; other regions are counted as
+ * skipped. Present calls mark frame boundaries.
+ */
+struct capture_state {
+	FILE *file;
+	std::string path;
+	std::unordered_set<hash128, hash128_hasher> blobs;
+	std::unordered_set<VkImage> images;
+	uint64_t frame;
+	uint64_t uploads;
+	uint64_t skipped;
+	uint64_t blobBytes;
+};
+
+static std::mutex capture_lock;
+static std::unordered_map<struct device *, std::unique_ptr<struct capture_state>> captureMap;
+static uint32_t captureCount;
+
+static struct capture_state *
+get_capture_state(struct device *dev)
+{
+	auto it = captureMap.find(dev);
+
+	if (it == captureMap.end())
+		return nullptr;
+
+	return it->second.get();
+}
+
+static void
+write_record(struct capture_state *state, enum capture_record_type type, const void *payload, size_t size,
+			 const void *extra = nullptr, size_t extraSize = 0)
+{
+	struct capture_record record = { (uint32_t)type, (uint32_t)(size + extraSize) };
+
+	fwrite(&record, sizeof(record), 1, state->file);
+	fwrite(payload, size, 1, state->file);
+	if (extraSize)
+		fwrite(extra, extraSize, 1, state->file);
+}
+
+void
+capture_init(struct device *dev)
+{
+	scoped_lock l(capture_lock);
+
+	auto state = std::make_unique<struct capture_state>();
+	state->path = getenv("BCN_CAPTURE_FILE");
+
+	/* One file per device, the later ones get a suffix. */
+	if (captureCount++)
+		state->path += "." + std::to_string(captureCount - 1);
+
+	state->file = fopen(state->path.c_str(), "wb");
+	if (!state->file) {
+		Logger::log("error", "Failed to open capture file %s", state->path.c_str());
+		return;
+	}
+
+	setvbuf(state->file, nullptr, _IOFBF, 1 << 20);
+
+	struct capture_header header = { BCN_CAPTURE_MAGIC, BCN_CAPTURE_VERSION };
+	fwrite(&header, sizeof(header), 1, state->file);
+
+	captureMap[dev] = std::move(state);
+}
+
+void
+capture_destroy(struct device *dev)
+{
+	scoped_lock l(capture_lock);
+
+	struct capture_state *state = get_capture_state(dev);
+	if (!state)
+		return;
+
+	fclose(state->file);
+	Logger::log("info", "Captured %llu uploads over %llu frames to %s, %llu blob bytes, %llu regions skipped",
+		(unsigned long long)state->uploads, (unsigned long long)state->frame, state->path.c_str(),
+		(unsigned long long)state->blobBytes, (unsigned long long)state->skipped);
+
+	captureMap.erase(dev);
+}
+
+void
+capture_write_image(struct device *dev, VkImage image, const VkImageCreateInfo *pCreateInfo)
+{
+	scoped_lock l(capture_lock);
+
+	struct capture_state *state = get_capture_state(dev);
+	if (!state)
+		return;
+
+	struct capture_image record = {
+		.id = (uint64_t)image,
+		.format = (uint32_t)pCreateInfo->format,
+		.imageType = (uint32_t)pCreateInfo->imageType,
+		.flags = (uint32_t)pCreateInfo->flags,
+		.width = pCreateInfo->extent.width,
+		.height = pCreateInfo->extent.height,
+		.depth = pCreateInfo->extent.depth,
+		.mipLevels = pCreateInfo->mipLevels,
+		.arrayLayers = pCreateInfo->arrayLayers
+	};
+
+	write_record(state, CAPTURE_IMAGE, &record, sizeof(record));
+	state->images.insert(image);
+}
+
+/*
+ * Records an upload region as the application issued it, before any mip
+ * remapping, one record per array layer.
+ */
+void
+capture_write_upload(struct device *dev, struct buffer *buf, struct image *img, const VkBufferImageCopy &region)
+{
+	VkFormat format = img->format;
+	uint32_t width = region.imageExtent.width;
+	uint32_t height = region.imageExtent.height;
+	VkDeviceSize blockSize = get_block_size(format);
+	VkDeviceSize rowBytes = ((width + 3) / 4) * blockSize;
+	uint32_t rows = (height + 3) / 4;
+	VkDeviceSize rowPitch = ((std::max(region.bufferRowLength, width) + 3) / 4) * blockSize;
+	VkDeviceSize layerPitch = rowPitch * ((std::max(region.bufferImageHeight, height) + 3) / 4);
+
+	for (uint32_t layer = 0; layer < region.imageSubresource.layerCount; layer++) {
+		VkBufferImageCopy layer_region = region;
+		layer_region.bufferOffset += layer * layerPitch;
+		layer_region.imageSubresource.baseArrayLayer += layer;
+		layer_region.imageSubresource.layerCount = 1;
+
+		VkDeviceSize srcPitch;
+		const uint8_t *src = get_region_blocks(buf, format, &layer_region, &srcPitch);
+
+		std::vector<uint8_t> blocks;
+		hash128 key = {};
+
+		if (src) {
+			blocks.resize(rowBytes * rows);
+			for (uint32_t y = 0; y < rows; y++)
+				memcpy(blocks.data() + y * rowBytes, src + y * srcPitch, rowBytes);
+
+			key = hash_bcn_blocks(format, width, height, blocks.data(), rowBytes);
+		}
+
+		scoped_lock l(capture_lock);
+
+		struct capture_state *state = get_capture_state(dev);
+		if (!state || !state->images.count(img->handle))
+			return;
+
+		if (!src) {
+			state->skipped++;
+			continue;
+		}
+
+		if (state->blobs.insert(key).second) {
+			struct capture_blob blob = { key.lo, key.hi };
+			write_record(state, CAPTURE_BLOB, &blob, sizeof(blob), blocks.data(), blocks.size());
+			state->blobBytes += blocks.size();
+		}
+
+		struct capture_upload upload = {
+			.id = (uint64_t)img->handle,
+			.key_lo = key.lo,
+			.key_hi = key.hi,
+			.mipLevel = layer_region.imageSubresource.mipLevel,
+			.arrayLayer = layer_region.imageSubresource.baseArrayLayer,
+			.x = layer_region.imageOffset.x,
+			.y = layer_region.imageOffset.y,
+			.width = width,
+			.height = height
+		};
+
+		write_record(state, CAPTURE_UPLOAD, &upload, sizeof(upload));
+		state->uploads++;
+	}
+}
+
+void
+capture_write_destroy(struct device *dev, VkImage image)
+{
+	scoped_lock l(capture_lock);
+
+	struct capture_state *state = get_capture_state(dev);
+	if (!state || !state->images.erase(image))
+		return;
+
+	struct capture_destroy record = { (uint64_t)image };
+	write_record(state, CAPTURE_DESTROY, &record, sizeof(record));
+}
+
+/* Frame boundaries also flush the stream, a capture cut short stays readable up to there. */
+void
+capture_write_frame(struct device *dev)
+{
+	scoped_lock l(capture_lock);
+
+	struct capture_state *state = get_capture_state(dev);
+	if (!state)
+		return;
+
+	struct capture_frame record = {
+		.frame = state->frame++,
+		.timestamp = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count()
+	};
+
+	write_record(state, CAPTURE_FRAME, &record, sizeof(record));
+	fflush(state->file);
+}
@@ -0,0 +1,83 @@
+#ifndef __CAPTURE_HPP
+#define __CAPTURE_HPP
+
+#include "hash.hpp"
+
+#define BCN_CAPTURE_MAGIC 0x50414342
+#define BCN_CAPTURE_VERSION 1
+
+/*
+ * A capture is a header followed by a stream of records, each one a
+ * capture_record and size bytes of payload. Compressed blocks are stored
+ * once per key, tightly packed, in a blob record that precedes the first
+ * upload using them. Keys are computed with hash_bcn_blocks over the packed blocks.
+ */
+enum capture_record_type {
+	CAPTURE_IMAGE = 1,
+	CAPTURE_BLOB,
+	CAPTURE_UPLOAD,
+	CAPTURE_DESTROY,
+	CAPTURE_FRAME
+};
+
+struct capture_header {
+	uint32_t magic;
+	uint32_t version;
+};
+
+struct capture_record {
+	uint32_t type;
+	uint32_t size;
+};
+
+struct capture_image {
+	uint64_t id;
+	uint32_t format;
+	uint32_t imageType;
+	uint32_t flags;
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;
+	uint32_t mipLevels;
+	uint32_t arrayLayers;
+};
+
+/* Followed by the blocks. */
+struct capture_blob {
+	uint64_t key_lo;
+	uint64_t key_hi;
+};
+
+struct capture_upload {
+	uint64_t id;
+	uint64_t key_lo;
+	uint64_t key_hi;
+	uint32_t mipLevel;
+	uint32_t arrayLayer;
+	int32_t x;
+	int32_t y;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct capture_destroy {
+	uint64_t id;
+};
+
+struct capture_frame {
+	uint64_t frame;
+	uint64_t timestamp;
+};
+
+struct device;
+struct buffer;
+struct image;
+
+void capture_init(struct device *dev);
+void capture_destroy(struct device *dev);
+void capture_write_image(struct device *dev, VkImage image, const VkImageCreateInfo *pCreateInfo);
+void capture_write_upload(struct device *dev, struct buffer *buf, struct image *img, const VkBufferImageCopy &region);
+void capture_write_destroy(struct device *dev, VkImage image);
+void capture_write_frame(struct device *dev);
+
+#endif
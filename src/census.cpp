@@ -0,0 +1,277 @@
+#include "census.hpp"
+#include "image.hpp"
+
+#include <algorithm>
+#include <string>
+
+/*
+ * Census of the emulated images: what each one costs in memory compared to
+ * its compressed footprint, and how much decode work it caused. Images that
+ * were destroyed stay in the report. Written to BCN_CENSUS_FILE when the
+ * device is destroyed, as JSON if the name ends in .json and CSV otherwise.
+ */
+struct census_entry {
+	VkImage handle;
+	std::string name;
+	VkFormat format;
+	VkFormat decodedFormat;
+	VkExtent3D extent;
+	uint32_t mipLevels;
+	uint32_t arrayLayers;
+	uint32_t mipDrop;
+	uint64_t compressedBytes;
+	uint64_t emulatedBytes;
+	uint64_t uploads;
+	uint64_t decodedBytes;
+	uint64_t gpuNs;
+	bool destroyed;
+};
+
+struct census_state {
+	std::string file;
+	std::unordered_map<VkImage, struct census_entry> images;
+	std::vector<struct census_entry> destroyed;
+};
+
+static std::mutex census_lock;
+static std::unordered_map<struct device *, std::unique_ptr<struct census_state>> censusMap;
+
+static struct census_state *
+get_census_state(struct device *dev)
+{
+	auto it = censusMap.find(dev);
+
+	if (it == censusMap.end())
+		return nullptr;
+
+	return it->second.get();
+}
+
+static struct census_entry *
+find_entry(struct device *dev, VkImage image)
+{
+	struct census_state *state = get_census_state(dev);
+	if (!state)
+		return nullptr;
+
+	auto it = state->images.find(image);
+	if (it == state->images.end())
+		return nullptr;
+
+	return &it->second;
+}
+
+void
+census_init(struct device *dev)
+{
+	auto state = std::make_unique<struct census_state>();
+	state->file = getenv("BCN_CENSUS_FILE");
+
+	scoped_lock l(census_lock);
+	censusMap[dev] = std::move(state);
+}
+
+void
+census_register_image(struct device *dev, const struct image *img, const VkImageCreateInfo *pCreateInfo, VkFormat decodedFormat)
+{
+	struct census_entry entry = {};
+	entry.handle = img->handle;
+	entry.format = pCreateInfo->format;
+	entry.decodedFormat = decodedFormat;
+	entry.extent = pCreateInfo->extent;
+	entry.mipLevels = pCreateInfo->mipLevels;
+	entry.arrayLayers = pCreateInfo->arrayLayers;
+	entry.mipDrop = img->mipDrop;
+
+	for (uint32_t level = 0; level < pCreateInfo->mipLevels; level++) {
+		uint64_t w = std::max(pCreateInfo->extent.width >> level, 1u);
+		uint64_t h = std::max(pCreateInfo->extent.height >> level, 1u);
+		uint64_t d = std::max(pCreateInfo->extent.depth >> level, 1u);
+
+		entry.compressedBytes += ((w + 3) / 4) * ((h + 3) / 4) * d * get_block_size(pCreateInfo->format);
+		if (level >= img->mipDrop)
+			entry.emulatedBytes += w * h * d * get_texel_size(pCreateInfo->format);
+	}
+
+	entry.compressedBytes *= pCreateInfo->arrayLayers;
+	entry.emulatedBytes *= pCreateInfo->arrayLayers;
+
+	scoped_lock l(census_lock);
+
+	struct census_state *state = get_census_state(dev);
+	if (state)
+		state->images[img->handle] = std::move(entry);
+}
+
+void
+census_forget_image(struct device *dev, VkImage image)
+{
+	scoped_lock l(census_lock);
+
+	struct census_state *state = get_census_state(dev);
+	if (!state)
+		return;
+
+	auto it = state->images.find(image);
+	if (it == state->images.end())
+		return;
+
+	it->second.destroyed = true;
+	state->destroyed.push_back(std::move(it->second));
+	state->images.erase(it);
+}
+
+void
+census_set_name(struct device *dev, VkImage image, const char *name)
+{
+	scoped_lock l(census_lock);
+
+	struct census_entry *entry = find_entry(dev, image);
+	if (entry)
+		entry->name = name ? name : "";
+}
+
+void
+census_record_upload(struct device *dev, VkImage image, uint64_t decodedBytes)
+{
+	scoped_lock l(census_lock);
+
+	struct census_entry *entry = find_entry(dev, image);
+	if (entry) {
+		entry->uploads++;
+		entry->decodedBytes += decodedBytes;
+	}
+}
+
+void
+census_record_time(struct device *dev, VkImage image, uint64_t ns)
+{
+	scoped_lock l(census_lock);
+
+	struct census_entry *entry = find_entry(dev, image);
+	if (entry)
+		entry->gpuNs += ns;
+}
+
+static std::string
+csv_quote(const std::string &str)
+{
+	std::string out = "\"";
+
+	for (char c : str) {
+		if (c == '"')
+			out += '"';
+		out += c;
+	}
+
+	return out + "\"";
+}
+
+static std::string
+json_quote(const std::string &str)
+{
+	std::string out = "\"";
+
+	for (unsigned char c : str) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (c < 0x20) {
+			char escape[8];
+			snprintf(escape, sizeof(escape), "\\u%04x", c);
+			out += escape;
+		} else {
+			out += c;
+		}
+	}
+
+	return out + "\"";
+}
+
+static double
+get_inflation(const struct census_entry &entry)
+{
+	return entry.compressedBytes ? (double)entry.emulatedBytes / entry.compressedBytes : 0.0;
+}
+
+static void
+write_csv(FILE *f, const std::vector<struct census_entry> &entries)
+{
+	fprintf(f, "image,name,format,decoded_format,width,height,depth,mips,layers,mip_drop,"
+		"compressed_bytes,emulated_bytes,inflation,uploads,decoded_bytes,gpu_ms,destroyed\n");
+
+	for (const auto &entry : entries) {
+		fprintf(f, "%p,%s,%s,%s,%u,%u,%u,%u,%u,%u,%llu,%llu,%.2f,%llu,%llu,%.3f,%d\n",
+			(void *)entry.handle, csv_quote(entry.name).c_str(),
+			get_format_name(entry.format), get_format_name(entry.decodedFormat),
+			entry.extent.width, entry.extent.height, entry.extent.depth,
+			entry.mipLevels, entry.arrayLayers, entry.mipDrop,
+			(unsigned long long)entry.compressedBytes, (unsigned long long)entry.emulatedBytes,
+			get_inflation(entry), (unsigned long long)entry.uploads,
+			(unsigned long long)entry.decodedBytes, entry.gpuNs / 1e6, entry.destroyed);
+	}
+}
+
+static void
+write_json(FILE *f, const std::vector<struct census_entry> &entries)
+{
+	fprintf(f, "[\n");
+
+	for (size_t i = 0; i < entries.size(); i++) {
+		const struct census_entry &entry = entries[i];
+
+		fprintf(f, "  {\"image\": \"%p\", \"name\": %s, \"format\": \"%s\", \"decoded_format\": \"%s\", "
+			"\"width\": %u, \"height\": %u, \"depth\": %u, \"mips\": %u, \"layers\": %u, \"mip_drop\": %u, "
+			"\"compressed_bytes\": %llu, \"emulated_bytes\": %llu, \"inflation\": %.2f, \"uploads\": %llu, "
+			"\"decoded_bytes\": %llu, \"gpu_ms\": %.3f, \"destroyed\": %s}%s\n",
+			(void *)entry.handle, json_quote(entry.name).c_str(),
+			get_format_name(entry.format), get_format_name(entry.decodedFormat),
+			entry.extent.width, entry.extent.height, entry.extent.depth,
+			entry.mipLevels, entry.arrayLayers, entry.mipDrop,
+			(unsigned long long)entry.compressedBytes, (unsigned long long)entry.emulatedBytes,
+			get_inflation(entry), (unsigned long long)entry.uploads,
+			(unsigned long long)entry.decodedBytes, entry.gpuNs / 1e6,
+			entry.destroyed ? "true" : "false", i + 1 < entries.size() ? "," : "");
+	}
+
+	fprintf(f, "]\n");
+}
+
+/* Writes the report, the most memory hungry images first, then the most expensive to decode. */
+void
+census_destroy(struct device *dev)
+{
+	scoped_lock l(census_lock);
+
+	struct census_state *state = get_census_state(dev);
+	if (!state)
+		return;
+
+	std::vector<struct census_entry> entries = std::move(state->destroyed);
+	for (auto &it : state->images)
+		entries.push_back(std::move(it.second));
+
+	std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+		if (a.emulatedBytes != b.emulatedBytes)
+			return a.emulatedBytes > b.emulatedBytes;
+		return a.gpuNs > b.gpuNs;
+	});
+
+	FILE *f = fopen(state->file.c_str(), "w");
+	if (!f) {
+		Logger::log("error", "Failed to open census file %s", state->file.c_str());
+	} else {
+		const std::string &file = state->file;
+		bool json = file.size() >= 5 && !file.compare(file.size() - 5, 5, ".json");
+
+		if (json)
+			write_json(f, entries);
+		else
+			write_csv(f, entries);
+
+		fclose(f);
+		Logger::log("info", "Census of %zu images written to %s", entries.size(), file.c_str());
+	}
+
+	censusMap.erase(dev);
+}
@@ -0,0 +1,16 @@
+#ifndef __CENSUS_HPP
+#define __CENSUS_HPP
+
+#include "bcn_layer.hpp"
+
+struct image;
+
+void census_init(struct device *dev);
+void census_destroy(struct device *dev);
+void census_register_image(struct device *dev, const struct image *img, const VkImageCreateInfo *pCreateInfo, VkFormat decodedFormat);
+void census_forget_image(struct device *dev, VkImage image);
+void census_set_name(struct device *dev, VkImage image, const char *name);
+void census_record_upload(struct device *dev, VkImage image, uint64_t decodedBytes);
+void census_record_time(struct device *dev, VkImage image, uint64_t ns);
+
+#endif
@@ -1,8 +1,21 @@
 #include "command_buffer.hpp"
 #include "image.hpp"
 #include "bcn.hpp"
+#include "cache.hpp"
+#include "pack.hpp"
+#include "retire.hpp"
+#include "bcn_fragment.hpp"
+#include "lazy.hpp"
+#include "profile.hpp"
+#include "census.hpp"
+#include "capture.hpp"
+
+#include <algorithm>
+#include <numeric>
 
 std::unordered_map<VkCommandBuffer, std::shared_ptr<struct command_buffer>> commandBuffersMap;
+/* Queue family of each command pool, the commands the layer injects depend on it. */
+static std::unordered_map<VkCommandPool, uint32_t> commandPoolsMap;
 
 struct command_buffer *
 get_command_buffer(VkCommandBuffer commandbuffer)
@@ -15,6 +28,36 @@ get_command_buffer(VkCommandBuffer commandbuffer)
 	return it->second.get();
 }
 
+/* Properties of the queue family the command buffer's pool was created for, null if unknown. */
+const VkQueueFamilyProperties *
+command_buffer_queue_family(struct command_buffer *cb)
+{
+	if (cb->family >= cb->device->queueFamilies.size())
+		return nullptr;
+
+	return &cb->device->queueFamilies[cb->family];
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_CreateCommandPool(VkDevice device,
+						   const VkCommandPoolCreateInfo *pCreateInfo,
+						   const VkAllocationCallbacks *pAllocator,
+						   VkCommandPool *pCommandPool)
+{
+	struct device *dev = get_device(device);
+	if (!dev)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	VkResult result = dev->table.CreateCommandPool(device, pCreateInfo, pAllocator, pCommandPool);
+	if (result != VK_SUCCESS)
+		return result;
+
+	scoped_lock l(global_lock);
+	commandPoolsMap[*pCommandPool] = pCreateInfo->queueFamilyIndex;
+
+	return VK_SUCCESS;
+}
+
 VK_LAYER_EXPORT VkResult VKAPI_CALL
 BCnLayer_AllocateCommandBuffers(VkDevice device,
 								const VkCommandBufferAllocateInfo *pAllocateInfo,
@@ -40,8 +83,12 @@ BCnLayer_AllocateCommandBuffers(VkDevice device,
 		cmd->handle = pCommandBuffers[i];
 		cmd->device = dev;
 		cmd->pool = pAllocateInfo->commandPool;
+		cmd->serial = 0;
+		cmd->oneTimeSubmit = false;
 		{
 			scoped_lock l(global_lock);
+			auto pool = commandPoolsMap.find(pAllocateInfo->commandPool);
+			cmd->family = pool != commandPoolsMap.end() ? pool->second : VK_QUEUE_FAMILY_IGNORED;
 			commandBuffersMap[pCommandBuffers[i]] = cmd;
 		}
 	}
@@ -67,10 +114,521 @@ BCnLayer_FreeCommandBuffers(VkDevice device,
 			continue;
 			
 	    dev->table.FreeCommandBuffers(dev->handle, commandPool, 1, &cb->handle);
+		retire_command_buffer(cb);
 		commandBuffersMap.erase(pCommandBuffers[i]);
 	}
 }
 
+/*
+ * Ends the current recording as far as the layer is concerned: what it
+ * allocated for it goes to the retirement tracker, tagged with the serial
+ * of its last submission.
+ */
+void
+retire_command_buffer(struct command_buffer *cb)
+{
+	retire_resources(cb->device, cb->serial, cb->transients);
+	cb->secondaries.clear();
+
+	if (cb->device->use_lazy)
+		lazy_retire_command_buffer(cb);
+}
+
+/* Whether a submission of this command buffer references layer resources. */
+bool
+command_buffer_has_transients(struct command_buffer *cb)
+{
+	if (!transient_resources_empty(cb->transients))
+		return true;
+
+	for (VkCommandBuffer handle : cb->secondaries) {
+		struct command_buffer *secondary = get_command_buffer(handle);
+		if (secondary && !transient_resources_empty(secondary->transients))
+			return true;
+	}
+
+	return false;
+}
+
+static void
+mark_submitted(struct command_buffer *cb, uint64_t serial)
+{
+	if (serial)
+		cb->serial = serial;
+
+	if (cb->device->use_incremental)
+		shadow_commit(cb);
+
+	if (cb->device->use_dedup)
+		dedup_submitted(cb, serial);
+}
+
+/*
+ * Called with global_lock held once the command buffer was submitted, with
+ * the serial of the submission, 0 if it carries no layer resources: what
+ * the recording staged for the block shadows and the dedup index applies
+ * from now on.
+ */
+void
+command_buffer_submitted(struct command_buffer *cb, uint64_t serial)
+{
+	mark_submitted(cb, serial);
+
+	for (VkCommandBuffer handle : cb->secondaries) {
+		struct command_buffer *secondary = get_command_buffer(handle);
+		if (secondary)
+			mark_submitted(secondary, serial);
+	}
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_ResetCommandBuffer(VkCommandBuffer commandBuffer,
+							VkCommandBufferResetFlags flags)
+{
+	struct command_buffer *cb = get_command_buffer(commandBuffer);
+
+	dedup_reset(cb);
+	shadow_reset(cb);
+	retire_command_buffer(cb);
+
+	return cb->device->table.ResetCommandBuffer(commandBuffer, flags);
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_ResetCommandPool(VkDevice device,
+						  VkCommandPool commandPool,
+						  VkCommandPoolResetFlags flags)
+{
+	scoped_lock l(global_lock);
+
+	struct device *dev = get_device(device);
+	if (!dev)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	for (auto &it : commandBuffersMap) {
+		if (it.second->device == dev && it.second->pool == commandPool) {
+			dedup_reset(it.second.get());
+			shadow_reset(it.second.get());
+			retire_command_buffer(it.second.get());
+		}
+	}
+
+	return dev->table.ResetCommandPool(device, commandPool, flags);
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_DestroyCommandPool(VkDevice device,
+							VkCommandPool commandPool,
+							const VkAllocationCallbacks *pAllocator)
+{
+	scoped_lock l(global_lock);
+
+	struct device *dev = get_device(device);
+	if (!dev)
+		return;
+
+	for (auto it = commandBuffersMap.begin(); it != commandBuffersMap.end();) {
+		if (it->second->device != dev || it->second->pool != commandPool) {
+			++it;
+			continue;
+		}
+
+		retire_command_buffer(it->second.get());
+		it = commandBuffersMap.erase(it);
+	}
+
+	commandPoolsMap.erase(commandPool);
+	dev->table.DestroyCommandPool(device, commandPool, pAllocator);
+}
+
+/*
+ * Uploads an already decoded payload, from the texture pack or the on-disk
+ * cache: it is copied into a staging buffer and uploaded with a plain buffer
+ * to image copy, no decode dispatch is recorded.
+ */
+static bool
+upload_decoded(struct device *dev,
+			   struct command_buffer *cb,
+			   const void *payload,
+			   VkDeviceSize size,
+			   VkBufferImageCopy copy_region,
+			   struct image *img,
+			   VkImageLayout dstImageLayout)
+{
+	VkLayerDispatchTable table = dev->table;
+	void *data;
+
+	auto staging_buf = create_staging_buffer(dev, size, ALLOC_UPLOAD);
+	if (!staging_buf || table.MapMemory(dev->handle, staging_buf->memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+		return false;
+
+	memcpy(data, payload, size);
+
+	VkMappedMemoryRange range = {
+		.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+		.pNext = nullptr,
+		.memory = staging_buf->memory,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+	table.FlushMappedMemoryRanges(dev->handle, 1, &range);
+	table.UnmapMemory(dev->handle, staging_buf->memory);
+
+	copy_region.bufferOffset = 0;
+	copy_region.bufferRowLength = 0;
+	copy_region.bufferImageHeight = 0;
+
+	table.CmdCopyBufferToImage(cb->handle,
+		staging_buf->handle, img->handle, dstImageLayout, 1, &copy_region);
+
+	cb->transients.buffers.push_back(std::move(staging_buf));
+
+	return true;
+}
+
+static bool
+upload_from_pack(struct device *dev,
+				 struct command_buffer *cb,
+				 const hash128 &key,
+				 const VkBufferImageCopy &copy_region,
+				 struct image *img,
+				 VkImageLayout dstImageLayout)
+{
+	VkDeviceSize size = (VkDeviceSize)copy_region.imageExtent.width * copy_region.imageExtent.height * get_texel_size(img->format);
+	const void *data;
+	size_t packSize;
+
+	if (!pack_lookup(key, &data, &packSize) || packSize != size)
+		return false;
+
+	return upload_decoded(dev, cb, data, size, copy_region, img, dstImageLayout);
+}
+
+static bool
+upload_from_cache(struct device *dev,
+				  struct command_buffer *cb,
+				  const hash128 &key,
+				  const VkBufferImageCopy &copy_region,
+				  struct image *img,
+				  VkImageLayout dstImageLayout)
+{
+	VkDeviceSize size = (VkDeviceSize)copy_region.imageExtent.width * copy_region.imageExtent.height * get_texel_size(img->format);
+	struct cache_entry entry;
+	bool uploaded = false;
+
+	if (!cache_open(key, &entry))
+		return false;
+
+	if (entry.size == size)
+		uploaded = upload_decoded(dev, cb, entry.data, size, copy_region, img, dstImageLayout);
+
+	cache_close(&entry);
+	return uploaded;
+}
+
+/*
+ * Height in texels of the bands a large region is decoded in: as many block
+ * rows as fit in the staging window, in steps that keep the source offset of
+ * every band aligned for a storage buffer descriptor.
+ */
+static uint32_t
+get_band_height(struct device *dev, VkFormat format, const VkBufferImageCopy &copy_region)
+{
+	VkDeviceSize alignment = std::max<VkDeviceSize>(dev->props2.properties.limits.minStorageBufferOffsetAlignment, 1);
+	uint32_t rowExtent = std::max(copy_region.bufferRowLength, copy_region.imageExtent.width);
+	VkDeviceSize srcRowPitch = ((rowExtent + 3) / 4) * get_block_size(format);
+	VkDeviceSize dstRowPitch = 4 * (VkDeviceSize)copy_region.imageExtent.width * get_texel_size(format);
+	VkDeviceSize step = alignment / std::gcd(srcRowPitch, alignment);
+	VkDeviceSize blockRows = std::max<VkDeviceSize>(dev->staging_window / dstRowPitch / step, 1) * step;
+
+	return std::min<VkDeviceSize>(blockRows * 4, copy_region.imageExtent.height);
+}
+
+/*
+ * Images created as attachments are rendered to, nothing to cache from
+ * there. Pools of queues that cannot draw decode them in buffer mode.
+ */
+static bool
+use_fragment_decode(struct command_buffer *cb, struct image *img)
+{
+	const VkQueueFamilyProperties *family = command_buffer_queue_family(cb);
+
+	return img->attachment && family && (family->queueFlags & VK_QUEUE_GRAPHICS_BIT);
+}
+
+/*
+ * Records the decode of one region. In buffer mode the texels go through a
+ * staging buffer, which is also what populates the on-disk cache when
+ * cacheKey is set. Regions larger than the staging window are decoded in
+ * horizontal bands that all reuse one window sized buffer, so they are not
+ * cached.
+ */
+static void
+record_decode(struct device *dev,
+			  struct command_buffer *cb,
+			  VkFormat format,
+			  VkBufferImageCopy copy_region,
+			  struct buffer *buf,
+			  struct image *img,
+			  VkImageLayout dstImageLayout,
+			  const hash128 *cacheKey)
+{
+	VkLayerDispatchTable table = dev->table;
+	VkCommandBuffer commandBuffer = cb->handle;
+
+	/* Draws that could not be recorded get the buffer mode decode instead. */
+	if (use_fragment_decode(cb, img)) {
+		VkResult result = decompress_bcn_fragment(dev, cb, format, &copy_region, buf, img, dstImageLayout);
+		if (result == VK_SUCCESS)
+			return;
+
+		Logger::log("error", "Failed to record fragment decode, res %d, decoding through a buffer", result);
+	}
+
+	/* Attachment images are not created for storage. */
+	if (dev->use_image_view && !img->attachment) {
+		decompress_bcn_compute(dev, cb, format, &copy_region, buf, nullptr, img, dstImageLayout);
+		return;
+	}
+
+	uint32_t w = copy_region.imageExtent.width;
+	uint32_t h = copy_region.imageExtent.height;
+	VkDeviceSize size = (VkDeviceSize)w * h * get_texel_size(format);
+	uint32_t bandHeight = size > dev->staging_window ? get_band_height(dev, format, copy_region) : h;
+	uint32_t rowExtent = std::max(copy_region.bufferRowLength, w);
+	VkDeviceSize srcRowPitch = ((rowExtent + 3) / 4) * get_block_size(format);
+
+	if (bandHeight < h) {
+		size = (VkDeviceSize)w * bandHeight * get_texel_size(format);
+		cacheKey = nullptr;
+	}
+
+	auto staging_buf = create_staging_buffer(dev, size, cacheKey ? ALLOC_READBACK : ALLOC_GPU_ONLY);
+	if (!staging_buf)
+		return;
+
+	if (cacheKey) {
+		staging_buf->cache_key = *cacheKey;
+		staging_buf->cache_pending = true;
+	}
+
+	for (uint32_t y = 0; y < h; y += bandHeight) {
+		VkBufferImageCopy band_region = copy_region;
+
+		band_region.bufferOffset += (y / 4) * srcRowPitch;
+		band_region.imageOffset.y += y;
+		band_region.imageExtent.height = std::min(bandHeight, h - y);
+
+		if (y > 0) {
+			VkBufferMemoryBarrier reuseBarrier = {
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.pNext = nullptr,
+				.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = staging_buf->handle,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE
+			};
+
+			table.CmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 0, nullptr, 1, &reuseBarrier, 0, nullptr);
+			stats_add(BCN_STAT_BARRIERS, 1);
+		}
+
+		decompress_bcn_compute(dev, cb, format, &band_region, buf, staging_buf.get(), img, dstImageLayout);
+
+		VkBufferMemoryBarrier bufferBarrier = {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.pNext = nullptr,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = staging_buf->handle,
+			.offset = 0,
+			.size = VK_WHOLE_SIZE
+		};
+
+		table.CmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		stats_add(BCN_STAT_BARRIERS, 1);
+
+		band_region.bufferOffset = 0;
+		band_region.bufferRowLength = 0;
+		band_region.bufferImageHeight = 0;
+
+		table.CmdCopyBufferToImage(commandBuffer,
+			staging_buf->handle, img->handle, dstImageLayout, 1, &band_region);
+	}
+
+	cb->transients.buffers.push_back(std::move(staging_buf));
+}
+
+/* Every decode the layer injects goes through here, labelled and timed as one unit. */
+void
+decode_region(struct device *dev,
+			  struct command_buffer *cb,
+			  VkFormat format,
+			  VkBufferImageCopy copy_region,
+			  struct buffer *buf,
+			  struct image *img,
+			  VkImageLayout dstImageLayout,
+			  const hash128 *cacheKey)
+{
+	trace_span span(TRACE_DECODE, (uint64_t)img->handle, format, copy_region.imageExtent.width, copy_region.imageExtent.height);
+	uint32_t query = profile_begin(cb, format, copy_region.imageExtent, img->handle);
+	const VkExtent3D &extent = copy_region.imageExtent;
+	uint64_t texels = (uint64_t)extent.width * extent.height * extent.depth * copy_region.imageSubresource.layerCount;
+	uint64_t blocks = (uint64_t)((extent.width + 3) / 4) * ((extent.height + 3) / 4) * extent.depth * copy_region.imageSubresource.layerCount;
+
+	stats_add(BCN_STAT_REGIONS, 1);
+	stats_add_format(format - VK_FORMAT_BC1_RGB_UNORM_BLOCK, texels, blocks * get_block_size(format));
+	if (dev->use_census)
+		census_record_upload(dev, img->handle, texels * get_texel_size(format));
+
+	record_decode(dev, cb, format, copy_region, buf, img, dstImageLayout, cacheKey);
+
+	profile_end(cb, query);
+}
+
+/*
+ * Decodes only the blocks that changed since the last upload. The changed
+ * rectangles are packed into a compact staging buffer, each one tightly and
+ * suitably aligned for a storage buffer descriptor, and the regular kernels
+ * run once per rectangle.
+ */
+static bool
+decode_dirty(struct device *dev,
+			 struct command_buffer *cb,
+			 VkFormat format,
+			 const VkBufferImageCopy &copy_region,
+			 const uint8_t *blocks,
+			 VkDeviceSize rowPitch,
+			 const std::vector<VkRect2D> &dirty,
+			 struct image *img,
+			 VkImageLayout dstImageLayout)
+{
+	VkLayerDispatchTable table = dev->table;
+	VkDeviceSize alignment = std::max<VkDeviceSize>(dev->props2.properties.limits.minStorageBufferOffsetAlignment, 16);
+	uint32_t blockSize = get_block_size(format);
+	std::vector<VkDeviceSize> offsets;
+	VkDeviceSize size = 0;
+	void *data;
+
+	for (const auto &rect : dirty) {
+		offsets.push_back(size);
+		size += (rect.extent.width * rect.extent.height * blockSize + alignment - 1) & ~(alignment - 1);
+	}
+
+	auto compact = create_staging_buffer(dev, size, ALLOC_UPLOAD);
+	if (!compact || table.MapMemory(dev->handle, compact->memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+		return false;
+
+	for (size_t i = 0; i < dirty.size(); i++) {
+		const VkRect2D &rect = dirty[i];
+		uint8_t *dst = (uint8_t *)data + offsets[i];
+		VkDeviceSize rectRowBytes = rect.extent.width * blockSize;
+
+		for (uint32_t y = 0; y < rect.extent.height; y++)
+			memcpy(dst + y * rectRowBytes, blocks + (rect.offset.y + y) * rowPitch + rect.offset.x * blockSize, rectRowBytes);
+	}
+
+	VkMappedMemoryRange range = {
+		.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+		.pNext = nullptr,
+		.memory = compact->memory,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+	table.FlushMappedMemoryRanges(dev->handle, 1, &range);
+	table.UnmapMemory(dev->handle, compact->memory);
+
+	for (size_t i = 0; i < dirty.size(); i++) {
+		const VkRect2D &rect = dirty[i];
+		VkBufferImageCopy rect_region = copy_region;
+
+		rect_region.bufferOffset = offsets[i];
+		rect_region.bufferRowLength = 0;
+		rect_region.bufferImageHeight = 0;
+		rect_region.imageOffset.x += rect.offset.x * 4;
+		rect_region.imageOffset.y += rect.offset.y * 4;
+		rect_region.imageExtent.width = std::min(rect.extent.width * 4, copy_region.imageExtent.width - rect.offset.x * 4);
+		rect_region.imageExtent.height = std::min(rect.extent.height * 4, copy_region.imageExtent.height - rect.offset.y * 4);
+
+		decode_region(dev, cb, format, rect_region, compact.get(), img, dstImageLayout, nullptr);
+	}
+
+	cb->transients.buffers.push_back(std::move(compact));
+
+	return true;
+}
+
+/*
+ * Source buffers created without storage usage cannot be bound to the
+ * decoders: the blocks of the region are copied into a layer scratch buffer
+ * first and the region is rebased onto it. Only the fragment decode of
+ * attachment images reads it from the fragment stage, which queues that
+ * cannot draw do not have.
+ */
+static std::unique_ptr<struct buffer>
+copy_to_scratch(struct device *dev,
+				struct command_buffer *cb,
+				VkFormat format,
+				struct buffer *buf,
+				struct image *img,
+				VkBufferImageCopy *copy_region)
+{
+	uint32_t rowExtent = std::max(copy_region->bufferRowLength, copy_region->imageExtent.width);
+	uint32_t imageHeight = std::max(copy_region->bufferImageHeight, copy_region->imageExtent.height);
+	VkDeviceSize rowPitch = ((rowExtent + 3) / 4) * get_block_size(format);
+	VkDeviceSize size = rowPitch * ((imageHeight + 3) / 4) * copy_region->imageSubresource.layerCount;
+
+	if (copy_region->bufferOffset >= buf->size)
+		return nullptr;
+
+	size = std::min(size, buf->size - copy_region->bufferOffset);
+
+	auto scratch = create_staging_buffer(dev, size, ALLOC_GPU_ONLY);
+	if (!scratch)
+		return nullptr;
+
+	VkBufferCopy region = {
+		.srcOffset = copy_region->bufferOffset,
+		.dstOffset = 0,
+		.size = size
+	};
+
+	dev->table.CmdCopyBuffer(cb->handle, buf->handle, scratch->handle, 1, &region);
+
+	VkBufferMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = scratch->handle,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+
+	VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	if (use_fragment_decode(cb, img))
+		dstStageMask |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	dev->table.CmdPipelineBarrier(cb->handle, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask,
+		0, 0, nullptr, 1, &barrier, 0, nullptr);
+	stats_add(BCN_STAT_BARRIERS, 1);
+
+	copy_region->bufferOffset = 0;
+
+	return scratch;
+}
+
 VK_LAYER_EXPORT void VKAPI_CALL
 BCnLayer_CmdCopyBufferToImage(VkCommandBuffer commandBuffer,
 						      VkBuffer srcBuffer,
@@ -80,61 +638,542 @@ BCnLayer_CmdCopyBufferToImage(VkCommandBuffer commandBuffer,
 						      const VkBufferImageCopy *pRegions)
 {
 	VkLayerDispatchTable table;
-	VkResult result;
 
 	struct command_buffer *cb = get_command_buffer(commandBuffer);
 	struct device *dev = cb->device;
 	struct image *img = find_image(dstImage);
 	struct buffer *buf = find_buffer(srcBuffer);
-	VkFormat format = img->format;
-	int texel_size = is_bc6(format) ? 8 : 4;
 
 	table = dev->table;
 	
-	if (!img || !buf || !is_supported_bcn_format(dev, format)) {
+	if (!img || !buf || !is_supported_bcn_format(dev, img->format)) {
 		table.CmdCopyBufferToImage(commandBuffer,
 			srcBuffer, dstImage, dstImageLayout, regionCount, pRegions);
 		return;
 	}
+
+	VkFormat format = img->format;
+	trace_span span(TRACE_COPY_BUFFER_TO_IMAGE, (uint64_t)dstImage, format, regionCount);
 	
 	for (uint32_t i = 0; i < regionCount; i++) {
 		VkBufferImageCopy copy_region = pRegions[i];
 
-		if (dev->use_image_view) {
-			decompress_bcn_compute(dev, commandBuffer, format, &copy_region, buf, nullptr, img, dstImageLayout);
+		if (dev->use_capture)
+			capture_write_upload(dev, buf, img, copy_region);
+
+		if (!image_remap_mip(img, &copy_region.imageSubresource.mipLevel))
+			continue;
+
+		if (dev->use_lazy) {
+			if (!dev->use_dedup && !dev->use_incremental &&
+				lazy_defer(cb, format, copy_region, buf, img, dstImageLayout))
+				continue;
+
+			lazy_flush_image(cb, img, dstImageLayout);
 		}
-        else {
-        	int w = copy_region.imageExtent.width;                                                         
-        	int h = copy_region.imageExtent.height;
-        	int size = w * h *texel_size;
-        	auto staging_buf = create_staging_buffer(dev, size);
-
-        	decompress_bcn_compute(dev, commandBuffer, format, &copy_region, buf, staging_buf.get(), img, dstImageLayout);
-        	
-			VkBufferMemoryBarrier bufferBarrier = {
-				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				.pNext = nullptr,
-		    	.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-		    	.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-		    	.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-		    	.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-		    	.buffer = staging_buf->handle,
-		    	.offset = 0,
-		    	.size = VK_WHOLE_SIZE
-			};
-		
-			table.CmdPipelineBarrier(commandBuffer,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 
-				0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
-	    
-			copy_region.bufferOffset = 0;
-			copy_region.bufferRowLength = 0;
-			copy_region.bufferImageHeight = 0;
 
-			table.CmdCopyBufferToImage(commandBuffer,
-				staging_buf->handle, dstImage, dstImageLayout, 1, &copy_region);
+		hash128 key;
+		bool hashed = (dev->use_pack || dev->use_cache || dev->use_dedup) && hash_bcn_region(buf, format, &copy_region, &key);
+		bool cacheable = hashed && dev->use_cache;
+		std::vector<VkRect2D> dirty;
+		const uint8_t *blocks = nullptr;
+		VkDeviceSize rowPitch = 0;
+		bool incremental = false;
+
+		/*
+		 * What is skipped or decoded in part is only right against the
+		 * shadow the recording started from. A recording that may run
+		 * again, after the application changed its buffer or something
+		 * else changed the image, decodes in full at execution instead.
+		 */
+		if (dev->use_incremental) {
+			if (cb->oneTimeSubmit)
+				blocks = get_region_blocks(buf, format, &copy_region, &rowPitch);
+			if (blocks)
+				incremental = shadow_diff(cb, img, copy_region, blocks, rowPitch, &dirty);
+			else
+				shadow_discard_layers(cb, img, copy_region.imageSubresource);
+		}
+
+		bool unchanged = incremental && dirty.empty();
+
+		if (dev->use_dedup) {
+			bool copied = hashed && !unchanged && dedup_copy(cb, key, copy_region, img, dstImageLayout);
+
+			dedup_invalidate_region(cb, dstImage, copy_region.imageSubresource, copy_region.imageOffset, copy_region.imageExtent);
+			if (hashed)
+				dedup_record(cb, key, copy_region, img, dstImageLayout);
+
+			if (copied)
+				continue;
+		}
+
+		if (unchanged)
+			continue;
+
+		if (incremental && dirty.size() <= dev->incremental_max_rects &&
+			decode_dirty(dev, cb, format, copy_region, blocks, rowPitch, dirty, img, dstImageLayout))
+			continue;
+
+		if (hashed && dev->use_pack && upload_from_pack(dev, cb, key, copy_region, img, dstImageLayout))
+			continue;
+
+		if (cacheable && upload_from_cache(dev, cb, key, copy_region, img, dstImageLayout))
+			continue;
+
+		/*
+		 * The key was hashed, and the block shadow updated, from the blocks
+		 * as they are now, the decode reads them at execution. What gets
+		 * stored or indexed under the key, or recorded in the shadow, is
+		 * decoded from a copy taken now, so an application that rewrites
+		 * its buffer before submitting cannot put other contents under it.
+		 */
+		if ((hashed && (dev->use_cache || dev->use_dedup)) || blocks) {
+			auto snapshot = snapshot_region_blocks(dev, buf, format, &copy_region);
+			if (snapshot) {
+				decode_region(dev, cb, format, copy_region, snapshot.get(), img, dstImageLayout, cacheable ? &key : nullptr);
+				cb->transients.buffers.push_back(std::move(snapshot));
+				continue;
+			}
+
+			/* Nothing taken, nothing may be known about this decode. */
+			cacheable = false;
+			if (dev->use_dedup)
+				dedup_invalidate_region(cb, dstImage, copy_region.imageSubresource, copy_region.imageOffset, copy_region.imageExtent);
+			if (blocks)
+				shadow_discard_layers(cb, img, copy_region.imageSubresource);
+		}
+
+		if (!buf->storage) {
+			auto scratch = copy_to_scratch(dev, cb, format, buf, img, &copy_region);
+			if (!scratch)
+				continue;
 
-			cb->fence->staging_buffers.push_back(std::move(staging_buf));
+			decode_region(dev, cb, format, copy_region, scratch.get(), img, dstImageLayout, cacheable ? &key : nullptr);
+			cb->transients.buffers.push_back(std::move(scratch));
+			continue;
 		}
+
+		decode_region(dev, cb, format, copy_region, buf, img, dstImageLayout, cacheable ? &key : nullptr);
 	}
 }
+
+/*
+ * Layout transitions matter to upload dedup, which copies from decoded
+ * subresources, and to the block shadows: a transition from
+ * UNDEFINED leaves the decoded contents undefined.
+ */
+static void
+track_image_barrier(struct command_buffer *cb,
+					VkImage image,
+					const VkImageSubresourceRange &range,
+					VkImageLayout oldLayout,
+					VkImageLayout newLayout)
+{
+	if (cb->device->use_dedup)
+		dedup_update_layout(cb, image, range, oldLayout, newLayout);
+
+	if (cb->device->use_lazy)
+		lazy_update_layout(cb, image, range, oldLayout, newLayout);
+
+	if (cb->device->use_incremental && oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
+		struct image *img = find_image(image);
+		if (img)
+			shadow_discard(cb, img, range);
+	}
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_BeginCommandBuffer(VkCommandBuffer commandBuffer,
+							const VkCommandBufferBeginInfo *pBeginInfo)
+{
+	struct command_buffer *cb = get_command_buffer(commandBuffer);
+
+	dedup_reset(cb);
+	shadow_reset(cb);
+	retire_command_buffer(cb);
+	cb->oneTimeSubmit = (pBeginInfo->flags & VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) != 0;
+
+	return cb->device->table.BeginCommandBuffer(commandBuffer, pBeginInfo);
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_EndCommandBuffer(VkCommandBuffer commandBuffer)
+{
+	struct command_buffer *cb = get_command_buffer(commandBuffer);
+
+	if (cb->device->use_dedup)
+		dedup_capture(cb);
+
+	return cb->device->table.EndCommandBuffer(commandBuffer);
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdExecuteCommands(VkCommandBuffer commandBuffer,
+							uint32_t commandBufferCount,
+							const VkCommandBuffer *pCommandBuffers)
+{
+	struct command_buffer *cb = get_command_buffer(commandBuffer);
+
+	cb->secondaries.insert(cb->secondaries.end(), pCommandBuffers, pCommandBuffers + commandBufferCount);
+
+	cb->device->table.CmdExecuteCommands(commandBuffer, commandBufferCount, pCommandBuffers);
+}
+
+/*
+ * Barriers on images with dropped mips are remapped onto the emulated
+ * levels, the ones that only cover dropped levels go away.
+ */
+template <typename T>
+static const T *
+remap_image_barriers(struct device *dev, uint32_t *count, const T *pBarriers, std::vector<T> &remapped)
+{
+	bool remap = false;
+
+	for (uint32_t i = 0; i < *count && dev->use_mip_drop && !remap; i++) {
+		struct image *img = find_image(pBarriers[i].image);
+		remap = img && img->mipDrop;
+	}
+
+	if (!remap)
+		return pBarriers;
+
+	for (uint32_t i = 0; i < *count; i++) {
+		T barrier = pBarriers[i];
+		struct image *img = find_image(barrier.image);
+
+		if (img && !image_remap_range(img, &barrier.subresourceRange))
+			continue;
+
+		remapped.push_back(barrier);
+	}
+
+	*count = remapped.size();
+	return remapped.data();
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdPipelineBarrier(VkCommandBuffer commandBuffer,
+							VkPipelineStageFlags srcStageMask,
+							VkPipelineStageFlags dstStageMask,
+							VkDependencyFlags dependencyFlags,
+							uint32_t memoryBarrierCount,
+							const VkMemoryBarrier *pMemoryBarriers,
+							uint32_t bufferMemoryBarrierCount,
+							const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+							uint32_t imageMemoryBarrierCount,
+							const VkImageMemoryBarrier *pImageMemoryBarriers)
+{
+	struct command_buffer *cb = get_command_buffer(commandBuffer);
+	std::vector<VkImageMemoryBarrier> remapped;
+
+	pImageMemoryBarriers = remap_image_barriers(cb->device, &imageMemoryBarrierCount, pImageMemoryBarriers, remapped);
+
+	for (uint32_t i = 0; i < imageMemoryBarrierCount; i++) {
+		const VkImageMemoryBarrier &barrier = pImageMemoryBarriers[i];
+		track_image_barrier(cb, barrier.image, barrier.subresourceRange, barrier.oldLayout, barrier.newLayout);
+	}
+
+	cb->device->table.CmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+		memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount, pBufferMemoryBarriers,
+		imageMemoryBarrierCount, pImageMemoryBarriers);
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdPipelineBarrier2(VkCommandBuffer commandBuffer,
+							 const VkDependencyInfo *pDependencyInfo)
+{
+	struct command_buffer *cb = get_command_buffer(commandBuffer);
+	VkDependencyInfo dependency_info = *pDependencyInfo;
+	std::vector<VkImageMemoryBarrier2> remapped;
+
+	dependency_info.pImageMemoryBarriers = remap_image_barriers(cb->device, &dependency_info.imageMemoryBarrierCount,
+		pDependencyInfo->pImageMemoryBarriers, remapped);
+
+	for (uint32_t i = 0; i < dependency_info.imageMemoryBarrierCount; i++) {
+		const VkImageMemoryBarrier2 &barrier = dependency_info.pImageMemoryBarriers[i];
+		track_image_barrier(cb, barrier.image, barrier.subresourceRange, barrier.oldLayout, barrier.newLayout);
+	}
+
+	cb->device->table.CmdPipelineBarrier2(commandBuffer, &dependency_info);
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdWaitEvents(VkCommandBuffer commandBuffer,
+					   uint32_t eventCount,
+					   const VkEvent *pEvents,
+					   VkPipelineStageFlags srcStageMask,
+					   VkPipelineStageFlags dstStageMask,
+					   uint32_t memoryBarrierCount,
+					   const VkMemoryBarrier *pMemoryBarriers,
+					   uint32_t bufferMemoryBarrierCount,
+					   const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+					   uint32_t imageMemoryBarrierCount,
+					   const VkImageMemoryBarrier *pImageMemoryBarriers)
+{
+	struct command_buffer *cb = get_command_buffer(commandBuffer);
+	std::vector<VkImageMemoryBarrier> remapped;
+
+	pImageMemoryBarriers = remap_image_barriers(cb->device, &imageMemoryBarrierCount, pImageMemoryBarriers, remapped);
+
+	for (uint32_t i = 0; i < imageMemoryBarrierCount; i++) {
+		const VkImageMemoryBarrier &barrier = pImageMemoryBarriers[i];
+		track_image_barrier(cb, barrier.image, barrier.subresourceRange, barrier.oldLayout, barrier.newLayout);
+	}
+
+	cb->device->table.CmdWaitEvents(commandBuffer, eventCount, pEvents, srcStageMask, dstStageMask,
+		memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount, pBufferMemoryBarriers,
+		imageMemoryBarrierCount, pImageMemoryBarriers);
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdCopyImage(VkCommandBuffer commandBuffer,
+					  VkImage srcImage,
+					  VkImageLayout srcImageLayout,
+					  VkImage dstImage,
+					  VkImageLayout dstImageLayout,
+					  uint32_t regionCount,
+					  const VkImageCopy *pRegions)
+{
+	struct command_buffer *cb = get_command_buffer(commandBuffer);
+	std::vector<VkImageCopy> remapped;
+
+	if (cb->device->use_mip_drop) {
+		struct image *src = find_image(srcImage);
+		struct image *dst = find_image(dstImage);
+
+		if ((src && src->mipDrop) || (dst && dst->mipDrop)) {
+			for (uint32_t i = 0; i < regionCount; i++) {
+				VkImageCopy region = pRegions[i];
+
+				if ((src && !image_remap_mip(src, &region.srcSubresource.mipLevel)) ||
+					(dst && !image_remap_mip(dst, &region.dstSubresource.mipLevel)))
+					continue;
+
+				remapped.push_back(region);
+			}
+
+			regionCount = remapped.size();
+			pRegions = remapped.data();
+		}
+	}
+
+	if (cb->device->use_dedup) {
+		for (uint32_t i = 0; i < regionCount; i++)
+			dedup_invalidate_region(cb, dstImage, pRegions[i].dstSubresource, pRegions[i].dstOffset, pRegions[i].extent);
+	}
+
+	if (cb->device->use_lazy) {
+		struct image *dst = find_image(dstImage);
+		if (dst)
+			lazy_flush_image(cb, dst, dstImageLayout);
+		lazy_want_image(cb, srcImage, srcImageLayout);
+	}
+
+	struct image *img = cb->device->use_incremental ? find_image(dstImage) : nullptr;
+	if (img) {
+		for (uint32_t i = 0; i < regionCount; i++)
+			shadow_discard_layers(cb, img, pRegions[i].dstSubresource);
+	}
+
+	if (!regionCount)
+		return;
+
+	cb->device->table.CmdCopyImage(commandBuffer, srcImage, srcImageLayout,
+		dstImage, dstImageLayout, regionCount, pRegions);
+}
+
+/*
+ * Readbacks address the application's levels. Regions of dropped levels
+ * are left out, what they would read is not in the image anymore.
+ */
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdCopyImageToBuffer(VkCommandBuffer commandBuffer,
+							  VkImage srcImage,
+							  VkImageLayout srcImageLayout,
+							  VkBuffer dstBuffer,
+							  uint32_t regionCount,
+							  const VkBufferImageCopy *pRegions)
+{
+	struct command_buffer *cb = get_command_buffer(commandBuffer);
+	std::vector<VkBufferImageCopy> remapped;
+	struct image *src = cb->device->use_mip_drop ? find_image(srcImage) : nullptr;
+
+	if (src && src->mipDrop) {
+		for (uint32_t i = 0; i < regionCount; i++) {
+			VkBufferImageCopy region = pRegions[i];
+
+			if (image_remap_mip(src, &region.imageSubresource.mipLevel))
+				remapped.push_back(region);
+		}
+
+		regionCount = remapped.size();
+		pRegions = remapped.data();
+	}
+
+	if (cb->device->use_lazy)
+		lazy_want_image(cb, srcImage, srcImageLayout);
+
+	if (!regionCount)
+		return;
+
+	cb->device->table.CmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout, dstBuffer, regionCount, pRegions);
+}
+
+/* BC images are never blit destinations, only the source side has levels to remap. */
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdBlitImage(VkCommandBuffer commandBuffer,
+					  VkImage srcImage,
+					  VkImageLayout srcImageLayout,
+					  VkImage dstImage,
+					  VkImageLayout dstImageLayout,
+					  uint32_t regionCount,
+					  const VkImageBlit *pRegions,
+					  VkFilter filter)
+{
+	struct command_buffer *cb = get_command_buffer(commandBuffer);
+	std::vector<VkImageBlit> remapped;
+	struct image *src = cb->device->use_mip_drop ? find_image(srcImage) : nullptr;
+
+	if (src && src->mipDrop) {
+		for (uint32_t i = 0; i < regionCount; i++) {
+			VkImageBlit region = pRegions[i];
+
+			if (image_remap_mip(src, &region.srcSubresource.mipLevel))
+				remapped.push_back(region);
+		}
+
+		regionCount = remapped.size();
+		pRegions = remapped.data();
+	}
+
+	if (cb->device->use_lazy)
+		lazy_want_image(cb, srcImage, srcImageLayout);
+
+	if (!regionCount)
+		return;
+
+	cb->device->table.CmdBlitImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout,
+		regionCount, pRegions, filter);
+}
+
+/*
+ * The copy2 commands take the paths of the original ones, uploads to BC
+ * images need the decode as much as the level remapping. Regions with
+ * extension structures chained cannot be expressed that way and are passed
+ * through as they are.
+ */
+template <typename T>
+static bool
+has_chained_regions(uint32_t regionCount, const T *pRegions)
+{
+	for (uint32_t i = 0; i < regionCount; i++) {
+		if (pRegions[i].pNext)
+			return true;
+	}
+
+	return false;
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdCopyBufferToImage2(VkCommandBuffer commandBuffer,
+							   const VkCopyBufferToImageInfo2 *pCopyBufferToImageInfo)
+{
+	const VkCopyBufferToImageInfo2 *info = pCopyBufferToImageInfo;
+
+	if (info->pNext || has_chained_regions(info->regionCount, info->pRegions)) {
+		get_command_buffer(commandBuffer)->device->table.CmdCopyBufferToImage2(commandBuffer, info);
+		return;
+	}
+
+	std::vector<VkBufferImageCopy> regions(info->regionCount);
+	for (uint32_t i = 0; i < info->regionCount; i++) {
+		regions[i] = {
+			.bufferOffset = info->pRegions[i].bufferOffset,
+			.bufferRowLength = info->pRegions[i].bufferRowLength,
+			.bufferImageHeight = info->pRegions[i].bufferImageHeight,
+			.imageSubresource = info->pRegions[i].imageSubresource,
+			.imageOffset = info->pRegions[i].imageOffset,
+			.imageExtent = info->pRegions[i].imageExtent
+		};
+	}
+
+	BCnLayer_CmdCopyBufferToImage(commandBuffer, info->srcBuffer, info->dstImage, info->dstImageLayout,
+		regions.size(), regions.data());
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdCopyImageToBuffer2(VkCommandBuffer commandBuffer,
+							   const VkCopyImageToBufferInfo2 *pCopyImageToBufferInfo)
+{
+	const VkCopyImageToBufferInfo2 *info = pCopyImageToBufferInfo;
+
+	if (info->pNext || has_chained_regions(info->regionCount, info->pRegions)) {
+		get_command_buffer(commandBuffer)->device->table.CmdCopyImageToBuffer2(commandBuffer, info);
+		return;
+	}
+
+	std::vector<VkBufferImageCopy> regions(info->regionCount);
+	for (uint32_t i = 0; i < info->regionCount; i++) {
+		regions[i] = {
+			.bufferOffset = info->pRegions[i].bufferOffset,
+			.bufferRowLength = info->pRegions[i].bufferRowLength,
+			.bufferImageHeight = info->pRegions[i].bufferImageHeight,
+			.imageSubresource = info->pRegions[i].imageSubresource,
+			.imageOffset = info->pRegions[i].imageOffset,
+			.imageExtent = info->pRegions[i].imageExtent
+		};
+	}
+
+	BCnLayer_CmdCopyImageToBuffer(commandBuffer, info->srcImage, info->srcImageLayout, info->dstBuffer,
+		regions.size(), regions.data());
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdCopyImage2(VkCommandBuffer commandBuffer,
+					   const VkCopyImageInfo2 *pCopyImageInfo)
+{
+	const VkCopyImageInfo2 *info = pCopyImageInfo;
+
+	if (info->pNext || has_chained_regions(info->regionCount, info->pRegions)) {
+		get_command_buffer(commandBuffer)->device->table.CmdCopyImage2(commandBuffer, info);
+		return;
+	}
+
+	std::vector<VkImageCopy> regions(info->regionCount);
+	for (uint32_t i = 0; i < info->regionCount; i++) {
+		regions[i] = {
+			.srcSubresource = info->pRegions[i].srcSubresource,
+			.srcOffset = info->pRegions[i].srcOffset,
+			.dstSubresource = info->pRegions[i].dstSubresource,
+			.dstOffset = info->pRegions[i].dstOffset,
+			.extent = info->pRegions[i].extent
+		};
+	}
+
+	BCnLayer_CmdCopyImage(commandBuffer, info->srcImage, info->srcImageLayout, info->dstImage, info->dstImageLayout,
+		regions.size(), regions.data());
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdBlitImage2(VkCommandBuffer commandBuffer,
+					   const VkBlitImageInfo2 *pBlitImageInfo)
+{
+	const VkBlitImageInfo2 *info = pBlitImageInfo;
+
+	if (info->pNext || has_chained_regions(info->regionCount, info->pRegions)) {
+		get_command_buffer(commandBuffer)->device->table.CmdBlitImage2(commandBuffer, info);
+		return;
+	}
+
+	std::vector<VkImageBlit> regions(info->regionCount);
+	for (uint32_t i = 0; i < info->regionCount; i++) {
+		regions[i].srcSubresource = info->pRegions[i].srcSubresource;
+		regions[i].dstSubresource = info->pRegions[i].dstSubresource;
+		std::copy(info->pRegions[i].srcOffsets, info->pRegions[i].srcOffsets + 2, regions[i].srcOffsets);
+		std::copy(info->pRegions[i].dstOffsets, info->pRegions[i].dstOffsets + 2, regions[i].dstOffsets);
+	}
+
+	BCnLayer_CmdBlitImage(commandBuffer, info->srcImage, info->srcImageLayout, info->dstImage, info->dstImageLayout,
+		regions.size(), regions.data(), info->filter);
+}
@@ -3,15 +3,40 @@
 
 #include "bcn_layer.hpp"
 #include "buffer.hpp"
-#include "fence.hpp"
+#include "dedup.hpp"
+#include "retire.hpp"
+#include "shadow.hpp"
+
+#include <map>
+
+struct image;
 
 struct command_buffer {
 	VkCommandBuffer handle;
 	struct device *device;
 	VkCommandPool pool;
-	struct fence *fence;
+	uint32_t family;
+	uint64_t serial;
+	bool oneTimeSubmit;
+	struct transient_resources transients;
+	std::vector<VkCommandBuffer> secondaries;
+	std::unordered_map<hash128, struct dedup_entry, hash128_hasher> dedup;
+	std::vector<std::pair<hash128, struct dedup_texels>> dedupCaptured;
+	std::map<std::pair<VkImage, uint64_t>, struct shadow_staged> shadows;
 };
 
 struct command_buffer *get_command_buffer(VkCommandBuffer);
+void retire_command_buffer(struct command_buffer *cb);
+bool command_buffer_has_transients(struct command_buffer *cb);
+void command_buffer_submitted(struct command_buffer *cb, uint64_t serial);
+const VkQueueFamilyProperties *command_buffer_queue_family(struct command_buffer *cb);
+void decode_region(struct device *dev,
+				   struct command_buffer *cb,
+				   VkFormat format,
+				   VkBufferImageCopy copy_region,
+				   struct buffer *buf,
+				   struct image *img,
+				   VkImageLayout dstImageLayout,
+				   const hash128 *cacheKey);
 
 #endif
@@ -0,0 +1,466 @@
+#include "dedup.hpp"
+#include "command_buffer.hpp"
+#include "image.hpp"
+#include "format.hpp"
+#include "retire.hpp"
+
+#include <algorithm>
+#include <deque>
+
+extern std::unordered_map<VkCommandBuffer, std::shared_ptr<struct command_buffer>> commandBuffersMap;
+
+/*
+ * Decodes of submitted command buffers, usable from any recording once the
+ * submission retired. When a recording ends, the regions it decoded that
+ * still hold their texels are copied into layer owned buffers, and hits
+ * are served from those: whatever happens to the image afterwards, the
+ * index never reads it again. The oldest entries go once the copies take
+ * more than BCN_DEDUP_SIZE_MB.
+ */
+struct dedup_pending {
+	uint64_t serial;
+	hash128 key;
+	struct dedup_texels texels;
+};
+
+struct dedup_index {
+	std::unordered_map<hash128, struct dedup_texels, hash128_hasher> entries;
+	std::deque<hash128> order;
+	std::vector<struct dedup_pending> pending;
+	VkDeviceSize bytes;
+};
+
+/* DestroyImage may run on another thread while a command buffer is recorded. */
+static std::mutex dedup_lock;
+static std::unordered_map<struct device *, std::unique_ptr<struct dedup_index>> dedupMap;
+
+static struct dedup_index *
+get_dedup_index(struct device *dev, bool create)
+{
+	auto it = dedupMap.find(dev);
+
+	if (it != dedupMap.end())
+		return it->second.get();
+
+	if (!create)
+		return nullptr;
+
+	auto index = std::make_unique<struct dedup_index>();
+	index->bytes = 0;
+	struct dedup_index *ret = index.get();
+	dedupMap[dev] = std::move(index);
+
+	return ret;
+}
+
+/* Decodes whose submission retired become usable, the oldest make room. */
+static void
+promote_retired(struct device *dev, struct dedup_index *index)
+{
+	for (auto pending = index->pending.begin(); pending != index->pending.end();) {
+		if (!retire_completed(dev, pending->serial)) {
+			++pending;
+			continue;
+		}
+
+		if (index->entries.emplace(pending->key, pending->texels).second) {
+			index->order.push_back(pending->key);
+			index->bytes += pending->texels.buffer->size;
+		}
+
+		pending = index->pending.erase(pending);
+	}
+
+	while (index->bytes > dev->dedup_budget && !index->order.empty()) {
+		auto oldest = index->entries.find(index->order.front());
+		index->bytes -= oldest->second.buffer->size;
+		index->entries.erase(oldest);
+		index->order.pop_front();
+	}
+}
+
+static bool
+index_has(struct dedup_index *index, const hash128 &key)
+{
+	if (index->entries.count(key))
+		return true;
+
+	return std::any_of(index->pending.begin(), index->pending.end(),
+		[&key](const struct dedup_pending &pending) { return pending.key == key; });
+}
+
+static bool
+overlaps(const VkImageSubresourceLayers &a, const VkOffset3D &aOffset, const VkExtent3D &aExtent,
+		 const VkImageSubresourceLayers &b, const VkOffset3D &bOffset, const VkExtent3D &bExtent)
+{
+	if (a.mipLevel != b.mipLevel)
+		return false;
+
+	if (a.baseArrayLayer >= b.baseArrayLayer + b.layerCount || b.baseArrayLayer >= a.baseArrayLayer + a.layerCount)
+		return false;
+
+	return aOffset.x < bOffset.x + (int32_t)bExtent.width && bOffset.x < aOffset.x + (int32_t)aExtent.width &&
+		   aOffset.y < bOffset.y + (int32_t)bExtent.height && bOffset.y < aOffset.y + (int32_t)aExtent.height;
+}
+
+static bool
+same_region(const struct dedup_entry &entry, const VkBufferImageCopy &region, struct image *dst)
+{
+	return entry.img == dst &&
+		   entry.subresource.mipLevel == region.imageSubresource.mipLevel &&
+		   entry.subresource.baseArrayLayer == region.imageSubresource.baseArrayLayer &&
+		   entry.offset.x == region.imageOffset.x && entry.offset.y == region.imageOffset.y;
+}
+
+static void
+transition(struct command_buffer *cb, const struct dedup_entry &entry, VkImageLayout oldLayout, VkImageLayout newLayout,
+		   VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = srcAccess,
+		.dstAccessMask = dstAccess,
+		.oldLayout = oldLayout,
+		.newLayout = newLayout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = entry.img->handle,
+		.subresourceRange = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = entry.subresource.mipLevel,
+			.levelCount = 1,
+			.baseArrayLayer = entry.subresource.baseArrayLayer,
+			.layerCount = entry.subresource.layerCount
+		}
+	};
+
+	cb->device->table.CmdPipelineBarrier(cb->handle, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	stats_add(BCN_STAT_BARRIERS, 1);
+}
+
+/* Moves the subresource of entry to a layout it can be copied from, returns that layout. */
+static VkImageLayout
+begin_transfer_src(struct command_buffer *cb, const struct dedup_entry &entry)
+{
+	if (entry.layout == VK_IMAGE_LAYOUT_GENERAL || entry.layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+		return entry.layout;
+
+	transition(cb, entry, entry.layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+	return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+}
+
+static void
+end_transfer_src(struct command_buffer *cb, const struct dedup_entry &entry, VkImageLayout srcLayout)
+{
+	if (srcLayout == entry.layout)
+		return;
+
+	transition(cb, entry, srcLayout, entry.layout,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+}
+
+/* Copies the texels of an earlier decode in this command buffer. */
+static bool
+copy_from_entry(struct command_buffer *cb, const struct dedup_entry &entry, const VkBufferImageCopy &region,
+				struct image *dst, VkImageLayout dstImageLayout)
+{
+	/* Same data to the same place, the texels are already there. */
+	if (same_region(entry, region, dst))
+		return true;
+
+	if (entry.img == dst && overlaps(entry.subresource, entry.offset, entry.extent,
+									 region.imageSubresource, region.imageOffset, region.imageExtent))
+		return false;
+
+	VkImageLayout srcLayout = begin_transfer_src(cb, entry);
+
+	VkImageCopy copy = {
+		.srcSubresource = entry.subresource,
+		.srcOffset = entry.offset,
+		.dstSubresource = region.imageSubresource,
+		.dstOffset = region.imageOffset,
+		.extent = region.imageExtent
+	};
+
+	cb->device->table.CmdCopyImage(cb->handle,
+		entry.img->handle, srcLayout, dst->handle, dstImageLayout, 1, &copy);
+
+	end_transfer_src(cb, entry, srcLayout);
+
+	return true;
+}
+
+/* Copies the texels an earlier submission left in a layer owned buffer. */
+static bool
+copy_from_texels(struct command_buffer *cb, const struct dedup_texels &texels, const VkBufferImageCopy &region,
+				 struct image *dst, VkImageLayout dstImageLayout)
+{
+	if (texels.extent.width != region.imageExtent.width || texels.extent.height != region.imageExtent.height)
+		return false;
+
+	VkBufferMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = texels.buffer->handle,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+
+	cb->device->table.CmdPipelineBarrier(cb->handle, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 1, &barrier, 0, nullptr);
+	stats_add(BCN_STAT_BARRIERS, 1);
+
+	VkBufferImageCopy copy = {
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = region.imageSubresource,
+		.imageOffset = region.imageOffset,
+		.imageExtent = region.imageExtent
+	};
+
+	cb->device->table.CmdCopyBufferToImage(cb->handle,
+		texels.buffer->handle, dst->handle, dstImageLayout, 1, &copy);
+
+	/* The index may drop it before this recording is done with it. */
+	cb->transients.sharedBuffers.push_back(texels.buffer);
+
+	return true;
+}
+
+/*
+ * Copies the decoded texels of an identical upload, recorded earlier in this
+ * command buffer or retired from an earlier submission, instead of decoding
+ * again. A source in this recording is moved to TRANSFER_SRC_OPTIMAL for
+ * the copy and back to the layout it was in.
+ */
+bool
+dedup_copy(struct command_buffer *cb, const hash128 &key, const VkBufferImageCopy &region,
+		   struct image *dst, VkImageLayout dstImageLayout)
+{
+	struct dedup_entry entry;
+	struct dedup_texels texels;
+
+	{
+		std::lock_guard<std::mutex> l(dedup_lock);
+
+		auto local = cb->dedup.find(key);
+		if (local != cb->dedup.end()) {
+			entry = local->second;
+		} else {
+			struct dedup_index *index = get_dedup_index(cb->device, false);
+			if (!index)
+				return false;
+
+			promote_retired(cb->device, index);
+
+			auto found = index->entries.find(key);
+			if (found == index->entries.end())
+				return false;
+
+			texels = found->second;
+		}
+	}
+
+	if (texels.buffer)
+		return copy_from_texels(cb, texels, region, dst, dstImageLayout);
+
+	return copy_from_entry(cb, entry, region, dst, dstImageLayout);
+}
+
+void
+dedup_record(struct command_buffer *cb, const hash128 &key, const VkBufferImageCopy &region,
+			 struct image *dst, VkImageLayout dstImageLayout)
+{
+	if (!dst->transfer_src)
+		return;
+
+	std::lock_guard<std::mutex> l(dedup_lock);
+
+	cb->dedup[key] = {
+		.img = dst,
+		.subresource = region.imageSubresource,
+		.offset = region.imageOffset,
+		.extent = region.imageExtent,
+		.layout = dstImageLayout
+	};
+}
+
+void
+dedup_invalidate_region(struct command_buffer *cb, VkImage image, const VkImageSubresourceLayers &subresource,
+						const VkOffset3D &offset, const VkExtent3D &extent)
+{
+	std::lock_guard<std::mutex> l(dedup_lock);
+
+	for (auto it = cb->dedup.begin(); it != cb->dedup.end();) {
+		const struct dedup_entry &entry = it->second;
+
+		if (entry.img->handle == image && overlaps(entry.subresource, entry.offset, entry.extent, subresource, offset, extent))
+			it = cb->dedup.erase(it);
+		else
+			++it;
+	}
+}
+
+/* Called with global_lock held. */
+void
+dedup_invalidate_image(VkImage image)
+{
+	std::lock_guard<std::mutex> l(dedup_lock);
+
+	for (auto &it : commandBuffersMap) {
+		auto &dedup = it.second->dedup;
+
+		for (auto entry = dedup.begin(); entry != dedup.end();) {
+			if (entry->second.img->handle == image)
+				entry = dedup.erase(entry);
+			else
+				++entry;
+		}
+	}
+}
+
+/*
+ * Follows layout transitions recorded by the application so a later copy
+ * uses the layout the source is actually in. A transition from UNDEFINED
+ * discards the contents, so the entry is dropped.
+ */
+void
+dedup_update_layout(struct command_buffer *cb, VkImage image, const VkImageSubresourceRange &range,
+					VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+	if (oldLayout == newLayout)
+		return;
+
+	std::lock_guard<std::mutex> l(dedup_lock);
+
+	for (auto it = cb->dedup.begin(); it != cb->dedup.end();) {
+		struct dedup_entry &entry = it->second;
+		uint32_t levelEnd = range.levelCount == VK_REMAINING_MIP_LEVELS ? UINT32_MAX : range.baseMipLevel + range.levelCount;
+		uint32_t layerEnd = range.layerCount == VK_REMAINING_ARRAY_LAYERS ? UINT32_MAX : range.baseArrayLayer + range.layerCount;
+
+		if (entry.img->handle != image ||
+			entry.subresource.mipLevel < range.baseMipLevel || entry.subresource.mipLevel >= levelEnd ||
+			entry.subresource.baseArrayLayer < range.baseArrayLayer || entry.subresource.baseArrayLayer >= layerEnd) {
+			++it;
+			continue;
+		}
+
+		if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
+			it = cb->dedup.erase(it);
+			continue;
+		}
+
+		entry.layout = newLayout;
+		++it;
+	}
+}
+
+/*
+ * Called when the recording ends: copies the texels of the decodes it still
+ * holds, and the index does not know yet, into buffers of their own for the
+ * index to take once the submission retires. Render targets can be drawn
+ * over without the recording telling, they are left out.
+ */
+void
+dedup_capture(struct command_buffer *cb)
+{
+	struct device *dev = cb->device;
+	std::vector<std::pair<hash128, struct dedup_entry>> wanted;
+
+	{
+		std::lock_guard<std::mutex> l(dedup_lock);
+
+		struct dedup_index *index = get_dedup_index(dev, false);
+
+		for (const auto &it : cb->dedup) {
+			if (it.second.img->attachment || (index && index_has(index, it.first)))
+				continue;
+
+			wanted.push_back(it);
+		}
+	}
+
+	for (const auto &it : wanted) {
+		const struct dedup_entry &entry = it.second;
+		VkDeviceSize size = (VkDeviceSize)entry.extent.width * entry.extent.height *
+			entry.subresource.layerCount * get_texel_size(entry.img->format);
+
+		if (size > dev->dedup_budget)
+			continue;
+
+		auto staging = create_staging_buffer(dev, size, ALLOC_GPU_ONLY);
+		if (!staging)
+			continue;
+
+		std::shared_ptr<struct buffer> buffer(staging.release(), [dev](struct buffer *buf) {
+			release_staging_buffer(dev, std::unique_ptr<struct buffer>(buf));
+		});
+
+		VkImageLayout srcLayout = begin_transfer_src(cb, entry);
+
+		VkBufferImageCopy copy = {
+			.bufferOffset = 0,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = entry.subresource,
+			.imageOffset = entry.offset,
+			.imageExtent = entry.extent
+		};
+
+		dev->table.CmdCopyImageToBuffer(cb->handle, entry.img->handle, srcLayout, buffer->handle, 1, &copy);
+
+		end_transfer_src(cb, entry, srcLayout);
+
+		cb->transients.sharedBuffers.push_back(buffer);
+		cb->dedupCaptured.push_back({ it.first, { buffer, entry.extent } });
+	}
+}
+
+void
+dedup_reset(struct command_buffer *cb)
+{
+	std::lock_guard<std::mutex> l(dedup_lock);
+
+	cb->dedup.clear();
+	cb->dedupCaptured.clear();
+}
+
+/*
+ * Called with global_lock held when the recording is submitted. The texels
+ * it captured join the index once serial retires. A serial of 0 means the
+ * submission is not tracked, nothing can join.
+ */
+void
+dedup_submitted(struct command_buffer *cb, uint64_t serial)
+{
+	std::lock_guard<std::mutex> l(dedup_lock);
+
+	if (cb->dedupCaptured.empty() || !serial)
+		return;
+
+	struct dedup_index *index = get_dedup_index(cb->device, true);
+
+	/* Command buffers submitted every frame would otherwise pile up here. */
+	promote_retired(cb->device, index);
+
+	for (const auto &it : cb->dedupCaptured)
+		index->pending.push_back({ serial, it.first, it.second });
+}
+
+void
+dedup_destroy(struct device *dev)
+{
+	std::lock_guard<std::mutex> l(dedup_lock);
+
+	dedupMap.erase(dev);
+}
@@ -0,0 +1,45 @@
+#ifndef __DEDUP_HPP
+#define __DEDUP_HPP
+
+#include "bcn_layer.hpp"
+#include "hash.hpp"
+
+struct command_buffer;
+struct image;
+
+/*
+ * A subresource region decoded earlier in the same command buffer, with the
+ * layout it is in at this point of the recording.
+ */
+struct dedup_entry {
+	struct image *img;
+	VkImageSubresourceLayers subresource;
+	VkOffset3D offset;
+	VkExtent3D extent;
+	VkImageLayout layout;
+};
+
+/*
+ * The decoded texels of a region, tightly packed in a layer owned buffer
+ * nothing but the copy that filled it ever writes.
+ */
+struct dedup_texels {
+	std::shared_ptr<struct buffer> buffer;
+	VkExtent3D extent;
+};
+
+bool dedup_copy(struct command_buffer *cb, const hash128 &key, const VkBufferImageCopy &region,
+				struct image *dst, VkImageLayout dstImageLayout);
+void dedup_record(struct command_buffer *cb, const hash128 &key, const VkBufferImageCopy &region,
+				  struct image *dst, VkImageLayout dstImageLayout);
+void dedup_invalidate_region(struct command_buffer *cb, VkImage image, const VkImageSubresourceLayers &subresource,
+							 const VkOffset3D &offset, const VkExtent3D &extent);
+void dedup_invalidate_image(VkImage image);
+void dedup_update_layout(struct command_buffer *cb, VkImage image, const VkImageSubresourceRange &range,
+						 VkImageLayout oldLayout, VkImageLayout newLayout);
+void dedup_capture(struct command_buffer *cb);
+void dedup_reset(struct command_buffer *cb);
+void dedup_submitted(struct command_buffer *cb, uint64_t serial);
+void dedup_destroy(struct device *dev);
+
+#endif
@@ -1,4 +1,5 @@
 #include "fence.hpp"
+#include "retire.hpp"
 
 std::unordered_map<VkFence, std::shared_ptr<struct fence>> fencesMap;
 
@@ -57,23 +58,49 @@ BCnLayer_WaitForFences(VkDevice device,
 		return VK_ERROR_INITIALIZATION_FAILED;
 
 	result = dev->table.WaitForFences(device, fenceCount, pFences, waitAll, timeout);
-	if (result != VK_SUCCESS || dev->use_image_view)
+	if (result != VK_SUCCESS)
 		return result;
 
-	scoped_lock l(global_lock);
-    
-	for (uint32_t i = 0; i < fenceCount; i++) {
-		struct fence *fence = get_fence(pFences[i]);
-		for (auto it = fence->staging_buffers.begin(); it != fence->staging_buffers.end();) {
-			dev->table.DestroyBuffer(device, (*it)->handle, (*it)->alloc);
-			dev->table.FreeMemory(device, (*it)->memory, (*it)->alloc);
-			it = fence->staging_buffers.erase(it);
-		}
-	}
+	retire_reap(dev);
     
 	return VK_SUCCESS;
 }
 
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_GetFenceStatus(VkDevice device,
+						VkFence fence)
+{
+	VkResult result;
+
+	struct device *dev = get_device(device);
+	if (!dev)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	result = dev->table.GetFenceStatus(device, fence);
+	if (result == VK_SUCCESS)
+		retire_reap(dev);
+
+	return result;
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_WaitSemaphores(VkDevice device,
+						const VkSemaphoreWaitInfo *pWaitInfo,
+						uint64_t timeout)
+{
+	VkResult result;
+
+	struct device *dev = get_device(device);
+	if (!dev)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	result = dev->table.WaitSemaphores(device, pWaitInfo, timeout);
+	if (result == VK_SUCCESS)
+		retire_reap(dev);
+
+	return result;
+}
+
 VK_LAYER_EXPORT void VKAPI_CALL
 BCnLayer_DestroyFence(VkDevice device,
 					  VkFence fence,
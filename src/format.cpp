@@ -0,0 +1,137 @@
+#include "format.hpp"
+
+bool is_s3tc(VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool is_rgtc(VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+			return true;
+		default:
+		    return false;
+	}
+}
+
+bool is_bc6(VkFormat format) {
+	switch(format) {
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool is_bc7(VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+			return true;
+		default:
+			return false;
+	}
+}
+
+VkFormat get_format_for_bcn(VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+			return VK_FORMAT_R8G8B8A8_UNORM;
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+			return VK_FORMAT_R8G8B8A8_SNORM;
+		default:
+			return VK_FORMAT_R16G16B16A16_SFLOAT;
+	}
+}
+
+uint32_t get_block_size(VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+			return 8;
+		default:
+			return 16;
+	}
+}
+
+uint32_t get_texel_size(VkFormat format) {
+	return is_bc6(format) ? 8 : 4;
+}
+
+enum bcn_family get_bcn_family(VkFormat format) {
+	if (is_s3tc(format))
+		return BCN_FAMILY_S3TC;
+	else if (is_rgtc(format))
+		return BCN_FAMILY_RGTC;
+	else if (is_bc6(format))
+		return BCN_FAMILY_BC6;
+
+	return BCN_FAMILY_BC7;
+}
+
+const char *get_format_name(VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK: return "BC1_RGB_UNORM";
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK: return "BC1_RGB_SRGB";
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return "BC1_RGBA_UNORM";
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: return "BC1_RGBA_SRGB";
+		case VK_FORMAT_BC2_UNORM_BLOCK: return "BC2_UNORM";
+		case VK_FORMAT_BC2_SRGB_BLOCK: return "BC2_SRGB";
+		case VK_FORMAT_BC3_UNORM_BLOCK: return "BC3_UNORM";
+		case VK_FORMAT_BC3_SRGB_BLOCK: return "BC3_SRGB";
+		case VK_FORMAT_BC4_UNORM_BLOCK: return "BC4_UNORM";
+		case VK_FORMAT_BC4_SNORM_BLOCK: return "BC4_SNORM";
+		case VK_FORMAT_BC5_UNORM_BLOCK: return "BC5_UNORM";
+		case VK_FORMAT_BC5_SNORM_BLOCK: return "BC5_SNORM";
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK: return "BC6H_UFLOAT";
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK: return "BC6H_SFLOAT";
+		case VK_FORMAT_BC7_UNORM_BLOCK: return "BC7_UNORM";
+		case VK_FORMAT_BC7_SRGB_BLOCK: return "BC7_SRGB";
+		case VK_FORMAT_R8G8B8A8_UNORM: return "R8G8B8A8_UNORM";
+		case VK_FORMAT_R8G8B8A8_SRGB: return "R8G8B8A8_SRGB";
+		case VK_FORMAT_R8G8B8A8_SNORM: return "R8G8B8A8_SNORM";
+		case VK_FORMAT_R16G16B16A16_SFLOAT: return "R16G16B16A16_SFLOAT";
+		default: return "UNKNOWN";
+	}
+}
+
+const char *get_bcn_family_name(enum bcn_family family) {
+	switch (family) {
+		case BCN_FAMILY_S3TC: return "S3TC";
+		case BCN_FAMILY_RGTC: return "RGTC";
+		case BCN_FAMILY_BC6: return "BC6";
+		case BCN_FAMILY_BC7: return "BC7";
+		default: return "UNKNOWN";
+	}
+}
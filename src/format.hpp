@@ -0,0 +1,26 @@
+#ifndef __FORMAT_HPP
+#define __FORMAT_HPP
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+enum bcn_family {
+	BCN_FAMILY_S3TC,
+	BCN_FAMILY_RGTC,
+	BCN_FAMILY_BC6,
+	BCN_FAMILY_BC7,
+	BCN_FAMILY_COUNT
+};
+
+bool is_s3tc(VkFormat);
+bool is_rgtc(VkFormat);
+bool is_bc6(VkFormat);
+bool is_bc7(VkFormat);
+VkFormat get_format_for_bcn(VkFormat);
+uint32_t get_block_size(VkFormat);
+uint32_t get_texel_size(VkFormat);
+enum bcn_family get_bcn_family(VkFormat);
+const char *get_format_name(VkFormat);
+const char *get_bcn_family_name(enum bcn_family);
+
+#endif
@@ -0,0 +1,105 @@
+#include "hash.hpp"
+#include "format.hpp"
+
+#include <cstring>
+#include <vector>
+
+/* MurmurHash3 x64_128, by Austin Appleby (public domain). */
+
+static inline uint64_t rotl64(uint64_t x, int8_t r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t fmix64(uint64_t k) {
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdull;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ull;
+	k ^= k >> 33;
+	return k;
+}
+
+hash128
+hash_bytes(const void *data, size_t len, uint64_t seed)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	const size_t nblocks = len / 16;
+	const uint64_t c1 = 0x87c37b91114253d5ull;
+	const uint64_t c2 = 0x4cf5ad432745937full;
+	uint64_t h1 = seed;
+	uint64_t h2 = seed;
+
+	for (size_t i = 0; i < nblocks; i++) {
+		uint64_t k1, k2;
+		memcpy(&k1, bytes + i * 16, sizeof(k1));
+		memcpy(&k2, bytes + i * 16 + 8, sizeof(k2));
+
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	const uint8_t *tail = bytes + nblocks * 16;
+	uint64_t k1 = 0;
+	uint64_t k2 = 0;
+
+	switch (len & 15) {
+		case 15: k2 ^= (uint64_t)tail[14] << 48;
+		case 14: k2 ^= (uint64_t)tail[13] << 40;
+		case 13: k2 ^= (uint64_t)tail[12] << 32;
+		case 12: k2 ^= (uint64_t)tail[11] << 24;
+		case 11: k2 ^= (uint64_t)tail[10] << 16;
+		case 10: k2 ^= (uint64_t)tail[9] << 8;
+		case 9:  k2 ^= (uint64_t)tail[8];
+			k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		case 8:  k1 ^= (uint64_t)tail[7] << 56;
+		case 7:  k1 ^= (uint64_t)tail[6] << 48;
+		case 6:  k1 ^= (uint64_t)tail[5] << 40;
+		case 5:  k1 ^= (uint64_t)tail[4] << 32;
+		case 4:  k1 ^= (uint64_t)tail[3] << 24;
+		case 3:  k1 ^= (uint64_t)tail[2] << 16;
+		case 2:  k1 ^= (uint64_t)tail[1] << 8;
+		case 1:  k1 ^= (uint64_t)tail[0];
+			k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+		default:
+			break;
+	}
+
+	h1 ^= len;
+	h2 ^= len;
+	h1 += h2;
+	h2 += h1;
+	h1 = fmix64(h1);
+	h2 = fmix64(h2);
+	h1 += h2;
+	h2 += h1;
+
+	return (hash128) { .lo = h1, .hi = h2 };
+}
+
+/*
+ * Hashes the blocks of a width x height region whose block rows are rowPitch
+ * bytes apart. Rows are hashed as if tightly packed, so the key does not
+ * depend on how the application laid out its staging buffer. The seed
+ * folds in the source and decoded formats plus the region extent, the
+ * pre-transcode tool must build keys the same way.
+ */
+hash128
+hash_bcn_blocks(VkFormat format, uint32_t width, uint32_t height, const uint8_t *src, uint64_t rowPitch)
+{
+	uint64_t rowBytes = ((width + 3) / 4) * (uint64_t)get_block_size(format);
+	uint32_t rows = (height + 3) / 4;
+	uint64_t seed = ((uint64_t)format << 32 | (uint64_t)get_format_for_bcn(format)) ^
+					((uint64_t)width << 40 | (uint64_t)height << 8);
+
+	if (rowPitch == rowBytes)
+		return hash_bytes(src, rowBytes * rows, seed);
+
+	std::vector<uint8_t> packed(rowBytes * rows);
+	for (uint32_t row = 0; row < rows; row++)
+		memcpy(packed.data() + row * rowBytes, src + row * rowPitch, rowBytes);
+
+	return hash_bytes(packed.data(), packed.size(), seed);
+}
@@ -0,0 +1,26 @@
+#ifndef __HASH_HPP
+#define __HASH_HPP
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+
+struct hash128 {
+	uint64_t lo;
+	uint64_t hi;
+
+	bool operator==(const hash128 &other) const {
+		return lo == other.lo && hi == other.hi;
+	}
+};
+
+struct hash128_hasher {
+	size_t operator()(const hash128 &key) const {
+		return (size_t)(key.lo ^ (key.hi * 0x9e3779b97f4a7c15ull));
+	}
+};
+
+hash128 hash_bytes(const void *data, size_t len, uint64_t seed);
+hash128 hash_bcn_blocks(VkFormat format, uint32_t width, uint32_t height, const uint8_t *src, uint64_t rowPitch);
+
+#endif
@@ -1,4 +1,13 @@
 #include "image.hpp"
+#include "dedup.hpp"
+#include "bcn_fragment.hpp"
+#include "lazy.hpp"
+#include "command_buffer.hpp"
+#include "linear.hpp"
+#include "census.hpp"
+#include "capture.hpp"
+
+#include <algorithm>
 
 std::unordered_map<VkImage, std::unique_ptr<struct image>> imagesMap;
 
@@ -12,6 +21,59 @@ find_image(VkImage image) {
 	return it->second.get();
 }
 
+/*
+ * Number of top mips left out of the emulated image to keep its decoded size
+ * under the configured cap. Only mipmapped 2D images can drop levels, the
+ * remaining chain is the one the application would sample at lower LODs.
+ */
+static uint32_t
+get_mip_drop(struct device *dev, const VkImageCreateInfo *pCreateInfo)
+{
+	uint32_t maxExtent = dev->max_extent[get_bcn_family(pCreateInfo->format)];
+	uint32_t drop = 0;
+
+	if (!maxExtent || pCreateInfo->imageType != VK_IMAGE_TYPE_2D)
+		return 0;
+
+	while (drop + 1 < pCreateInfo->mipLevels &&
+		   std::max(pCreateInfo->extent.width >> drop, pCreateInfo->extent.height >> drop) > maxExtent)
+		drop++;
+
+	return drop;
+}
+
+/* Maps a mip level of the application image onto the emulated one, false for dropped levels. */
+bool
+image_remap_mip(const struct image *img, uint32_t *mipLevel)
+{
+	if (*mipLevel < img->mipDrop)
+		return false;
+
+	*mipLevel -= img->mipDrop;
+	return true;
+}
+
+/*
+ * Same for a range of levels, dropped levels are cut off. Returns false if
+ * nothing of the range is left.
+ */
+bool
+image_remap_range(const struct image *img, VkImageSubresourceRange *range)
+{
+	if (!img->mipDrop)
+		return true;
+
+	if (range->levelCount != VK_REMAINING_MIP_LEVELS) {
+		uint32_t end = range->baseMipLevel + range->levelCount;
+		if (end <= img->mipDrop)
+			return false;
+		range->levelCount = end - std::max(range->baseMipLevel, img->mipDrop);
+	}
+
+	range->baseMipLevel = std::max(range->baseMipLevel, img->mipDrop) - img->mipDrop;
+	return true;
+}
+
 VK_LAYER_EXPORT VkResult VKAPI_CALL
 BCnLayer_CreateImage(VkDevice device,
 					 const VkImageCreateInfo *pCreateInfo,
@@ -21,6 +83,9 @@ BCnLayer_CreateImage(VkDevice device,
 	VkResult result;
 	VkLayerDispatchTable table;
 	VkImageCreateInfo create_info = *pCreateInfo;
+	bool attachment = false;
+	uint32_t mipDrop = 0;
+	trace_span span(TRACE_CREATE_IMAGE, 0, pCreateInfo->format, pCreateInfo->extent.width, pCreateInfo->extent.height);
 
 	struct device *dev = get_device(device);
 	if (!dev)
@@ -29,9 +94,25 @@ BCnLayer_CreateImage(VkDevice device,
 	table = dev->table;
 
 	if (is_supported_bcn_format(dev, pCreateInfo->format)) {
+	    request_bcn_pipeline(dev, get_bcn_family(pCreateInfo->format));
 	    create_info.format = get_format_for_bcn(pCreateInfo->format);
-	    create_info.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+	    attachment = pCreateInfo->tiling == VK_IMAGE_TILING_OPTIMAL &&
+	    			 pCreateInfo->imageType == VK_IMAGE_TYPE_2D &&
+	    			 pCreateInfo->samples == VK_SAMPLE_COUNT_1_BIT &&
+	    			 fragment_decode_supported(dev, pCreateInfo->format);
+	    if (attachment)
+	    	create_info.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	    else if (dev->use_image_view && pCreateInfo->tiling == VK_IMAGE_TILING_OPTIMAL)
+	    	create_info.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
 	    create_info.flags &= ~VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
+	    if (dev->use_dedup)
+	    	create_info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	    mipDrop = get_mip_drop(dev, pCreateInfo);
+	    if (mipDrop) {
+	    	create_info.extent.width = std::max(pCreateInfo->extent.width >> mipDrop, 1u);
+	    	create_info.extent.height = std::max(pCreateInfo->extent.height >> mipDrop, 1u);
+	    	create_info.mipLevels -= mipDrop;
+	    }
 	}
 
 	result = table.CreateImage(device, &create_info, pAllocator, pImage);
@@ -41,11 +122,27 @@ BCnLayer_CreateImage(VkDevice device,
 		return result;
 	}
 
+    span.set_object((uint64_t)*pImage);
+
     auto image = std::make_unique<struct image>();
     image->handle = *pImage,
     image->format = pCreateInfo->format;
+    image->extent = create_info.extent;
     image->device = dev;
     image->alloc = pAllocator;
+    image->transfer_src = (create_info.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    image->attachment = attachment;
+    image->mipDrop = mipDrop;
+    image->shadowEpoch = shadow_new_generation();
+
+    if (is_supported_bcn_format(dev, pCreateInfo->format) && pCreateInfo->tiling == VK_IMAGE_TILING_LINEAR)
+    	linear_register_image(dev, *pImage, pCreateInfo);
+
+    if (dev->use_census && is_supported_bcn_format(dev, pCreateInfo->format))
+    	census_register_image(dev, image.get(), pCreateInfo, create_info.format);
+
+    if (dev->use_capture && is_supported_bcn_format(dev, pCreateInfo->format))
+    	capture_write_image(dev, *pImage, pCreateInfo);
 
     {
     	scoped_lock l(global_lock);
@@ -73,6 +170,13 @@ BCnLayer_CreateImageView(VkDevice device,
 
 	if (is_supported_bcn_format(dev, pCreateInfo->format)) {
 		create_info.format = get_format_for_bcn(pCreateInfo->format);
+
+		/* Views of dropped levels sample the largest level left. */
+		struct image *img = find_image(pCreateInfo->image);
+		if (img && img->mipDrop && !image_remap_range(img, &create_info.subresourceRange)) {
+			create_info.subresourceRange.baseMipLevel = 0;
+			create_info.subresourceRange.levelCount = 1;
+		}
 	}
 
 	result = table.CreateImageView(device, &create_info, pAllocator, pImageView);
@@ -81,9 +185,64 @@ BCnLayer_CreateImageView(VkDevice device,
 		return result;
 	}
 
+	if (dev->use_lazy && is_supported_bcn_format(dev, pCreateInfo->format))
+		lazy_track_view(dev, *pImageView, pCreateInfo->image);
+
 	return VK_SUCCESS;
 }
 
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_DestroyImageView(VkDevice device,
+						  VkImageView imageView,
+						  const VkAllocationCallbacks *pAllocator)
+{
+	struct device *dev = get_device(device);
+	if (!dev)
+		return;
+
+	if (dev->use_lazy)
+		lazy_forget_view(dev, imageView);
+
+	dev->table.DestroyImageView(device, imageView, pAllocator);
+}
+
+/* With lazy decode, sampling an image is what makes its pending uploads due. */
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_UpdateDescriptorSets(VkDevice device,
+							  uint32_t descriptorWriteCount,
+							  const VkWriteDescriptorSet *pDescriptorWrites,
+							  uint32_t descriptorCopyCount,
+							  const VkCopyDescriptorSet *pDescriptorCopies)
+{
+	struct device *dev = get_device(device);
+	if (!dev)
+		return;
+
+	if (dev->use_lazy)
+		lazy_want_images(dev, descriptorWriteCount, pDescriptorWrites);
+
+	dev->table.UpdateDescriptorSets(device, descriptorWriteCount, pDescriptorWrites,
+		descriptorCopyCount, pDescriptorCopies);
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_CmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer,
+								 VkPipelineBindPoint pipelineBindPoint,
+								 VkPipelineLayout layout,
+								 uint32_t set,
+								 uint32_t descriptorWriteCount,
+								 const VkWriteDescriptorSet *pDescriptorWrites)
+{
+	struct command_buffer *cb = get_command_buffer(commandBuffer);
+	struct device *dev = cb->device;
+
+	if (dev->use_lazy)
+		lazy_want_images(dev, descriptorWriteCount, pDescriptorWrites);
+
+	dev->table.CmdPushDescriptorSetKHR(commandBuffer, pipelineBindPoint, layout, set,
+		descriptorWriteCount, pDescriptorWrites);
+}
+
 VK_LAYER_EXPORT void VKAPI_CALL
 BCnLayer_DestroyImage(VkDevice device,
 					  VkImage image,
@@ -96,6 +255,94 @@ BCnLayer_DestroyImage(VkDevice device,
 	if (!dev || !img)
 		return;
 
+	dedup_invalidate_image(image);
+	if (dev->use_lazy)
+		lazy_forget_image(dev, image);
+	linear_forget_image(dev, image);
+	if (dev->use_census)
+		census_forget_image(dev, image);
+	if (dev->use_capture)
+		capture_write_destroy(dev, image);
 	dev->table.DestroyImage(device, image, pAllocator);	
 	imagesMap.erase(image);
 }
+
+/* Image names end up in the census report. */
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_SetDebugUtilsObjectNameEXT(VkDevice device,
+									const VkDebugUtilsObjectNameInfoEXT *pNameInfo)
+{
+	struct device *dev = get_device(device);
+	if (!dev)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	if (dev->use_census && pNameInfo->objectType == VK_OBJECT_TYPE_IMAGE)
+		census_set_name(dev, (VkImage)pNameInfo->objectHandle, pNameInfo->pObjectName);
+
+	return dev->table.SetDebugUtilsObjectNameEXT(device, pNameInfo);
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_GetImageSubresourceLayout(VkDevice device,
+								   VkImage image,
+								   const VkImageSubresource *pSubresource,
+								   VkSubresourceLayout *pLayout)
+{
+	struct device *dev = get_device(device);
+	if (!dev)
+		return;
+
+	if (linear_get_layout(dev, image, pLayout))
+		return;
+
+	dev->table.GetImageSubresourceLayout(device, image, pSubresource, pLayout);
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_BindImageMemory(VkDevice device,
+						 VkImage image,
+						 VkDeviceMemory memory,
+						 VkDeviceSize memoryOffset)
+{
+	VkResult result;
+
+	struct device *dev = get_device(device);
+	if (!dev)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	VkDeviceMemory bindMemory;
+	VkDeviceSize bindOffset;
+	linear_bind(dev, image, memory, memoryOffset, &bindMemory, &bindOffset);
+
+	result = dev->table.BindImageMemory(device, image, bindMemory, bindOffset);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to bind image memory, res %d", result);
+		return result;
+	}
+
+	return VK_SUCCESS;
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_BindImageMemory2(VkDevice device,
+						  uint32_t bindInfoCount,
+						  const VkBindImageMemoryInfo *pBindInfos)
+{
+	VkResult result;
+
+	struct device *dev = get_device(device);
+	if (!dev)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	std::vector<VkBindImageMemoryInfo> binds(pBindInfos, pBindInfos + bindInfoCount);
+	for (auto &bind : binds)
+		linear_bind(dev, bind.image, bind.memory, bind.memoryOffset, &bind.memory, &bind.memoryOffset);
+
+	result = dev->table.BindImageMemory2(device, bindInfoCount, binds.data());
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to bind image memory, res %d", result);
+		return result;
+	}
+
+	return VK_SUCCESS;
+}
@@ -3,14 +3,23 @@
 
 #include "bcn_layer.hpp"
 #include "bcn.hpp"
+#include "shadow.hpp"
 
 struct image {
 	VkImage handle;
 	VkFormat format;
+	VkExtent3D extent;
 	struct device *device;
 	const VkAllocationCallbacks *alloc;
+	bool transfer_src;
+	bool attachment;
+	uint32_t mipDrop;
+	uint64_t shadowEpoch;
+	std::unordered_map<uint64_t, struct shadow_subresource> shadows;
 };
 
 struct image *find_image(VkImage);
+bool image_remap_mip(const struct image *img, uint32_t *mipLevel);
+bool image_remap_range(const struct image *img, VkImageSubresourceRange *range);
 
 #endif
@@ -0,0 +1,687 @@
+#include "lazy.hpp"
+#include "image.hpp"
+#include "memory.hpp"
+#include "retire.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+/*
+ * Deferred decode: an upload only captures its compressed blocks into a
+ * compact layer buffer, the decode is recorded at the next submission once
+ * a descriptor write references the image, before or after the upload, or
+ * as far as the per submission budget reaches otherwise.
+ * Images that are never sampled never cost a decode. A recording that
+ * uses the image after the upload gets the decode in-line instead.
+ */
+struct lazy_upload {
+	std::unique_ptr<struct buffer> blocks;
+	VkBufferImageCopy region;
+	VkCommandBuffer recorder;
+	bool submitted;
+	uint64_t deferredNs;
+};
+
+/*
+ * layout is the one the image was left in by the submissions so far,
+ * layouts the one each recording leaves it in at its end.
+ */
+struct lazy_image {
+	struct image *img;
+	std::vector<struct lazy_upload> uploads;
+	VkImageLayout layout;
+	std::unordered_map<VkCommandBuffer, VkImageLayout> layouts;
+	bool wanted;
+};
+
+struct lazy_state {
+	std::unordered_map<VkImage, struct lazy_image> images;
+	std::unordered_map<VkImageView, VkImage> views;
+	std::unordered_set<VkImage> wanted;
+	std::unordered_map<uint32_t, VkCommandPool> pools;
+	std::vector<std::unique_ptr<struct command_buffer>> commandBuffers;
+	uint32_t budget;
+};
+
+static std::mutex lazy_lock;
+static std::unordered_map<struct device *, std::unique_ptr<struct lazy_state>> lazyMap;
+
+static struct lazy_state *
+get_lazy_state(struct device *dev)
+{
+	auto it = lazyMap.find(dev);
+
+	if (it == lazyMap.end())
+		return nullptr;
+
+	return it->second.get();
+}
+
+void
+lazy_init(struct device *dev)
+{
+	auto state = std::make_unique<struct lazy_state>();
+	state->budget = getenv("BCN_LAZY_BUDGET") ? atoi(getenv("BCN_LAZY_BUDGET")) : 8;
+
+	scoped_lock l(lazy_lock);
+	lazyMap[dev] = std::move(state);
+}
+
+/* Drops everything still pending, the device must be idle. */
+void
+lazy_destroy(struct device *dev)
+{
+	scoped_lock l(lazy_lock);
+
+	struct lazy_state *state = get_lazy_state(dev);
+	if (!state)
+		return;
+
+	for (auto &it : state->images) {
+		for (auto &upload : it.second.uploads)
+			release_staging_buffer(dev, std::move(upload.blocks));
+	}
+
+	for (const auto &it : state->pools)
+		dev->table.DestroyCommandPool(dev->handle, it.second, nullptr);
+
+	lazyMap.erase(dev);
+}
+
+/*
+ * Captures the blocks of a single layer 2D region from host visible source
+ * memory, tightly packed. Anything else is decoded right away.
+ */
+bool
+lazy_defer(struct command_buffer *cb,
+		   VkFormat format,
+		   const VkBufferImageCopy &copy_region,
+		   struct buffer *buf,
+		   struct image *img,
+		   VkImageLayout dstImageLayout)
+{
+	struct device *dev = cb->device;
+	VkBufferImageCopy region = copy_region;
+
+	auto blocks = snapshot_region_blocks(dev, buf, format, &region);
+	if (!blocks)
+		return false;
+
+	struct lazy_upload upload = {
+		.blocks = std::move(blocks),
+		.region = region,
+		.recorder = cb->handle,
+		.submitted = false,
+		.deferredNs = bcn_stats_segment ? stats_now_ns() : 0
+	};
+
+	scoped_lock l(lazy_lock);
+
+	struct lazy_state *state = get_lazy_state(dev);
+	if (!state) {
+		release_staging_buffer(dev, std::move(upload.blocks));
+		return false;
+	}
+
+	auto it = state->images.find(img->handle);
+	if (it == state->images.end()) {
+		it = state->images.emplace(img->handle, lazy_image{}).first;
+		it->second.img = img;
+		it->second.layout = dstImageLayout;
+		it->second.wanted = state->wanted.count(img->handle) != 0;
+	}
+
+	struct lazy_image &pending = it->second;
+	pending.layouts[cb->handle] = dstImageLayout;
+	pending.uploads.push_back(std::move(upload));
+
+	return true;
+}
+
+/*
+ * Records the decodes of the count oldest pending uploads of an image into
+ * cb, with the image in layout. The compact buffers become transients of cb.
+ */
+static void
+record_uploads(struct device *dev, struct command_buffer *cb, struct lazy_image &pending, VkImageLayout layout,
+			   size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		struct lazy_upload &upload = pending.uploads[i];
+
+		if (upload.deferredNs) {
+			uint64_t latency = stats_now_ns() - upload.deferredNs;
+			stats_add(BCN_STAT_LATENCY_COUNT, 1);
+			stats_add(BCN_STAT_LATENCY_NS, latency);
+			stats_max(BCN_STAT_LATENCY_MAX_NS, latency);
+		}
+
+		decode_region(dev, cb, pending.img->format, upload.region, upload.blocks.get(),
+			pending.img, layout, nullptr);
+		cb->transients.buffers.push_back(std::move(upload.blocks));
+	}
+
+	pending.uploads.erase(pending.uploads.begin(), pending.uploads.begin() + count);
+}
+
+static void
+record_image(struct device *dev, struct command_buffer *cb, struct lazy_image &pending, VkImageLayout layout)
+{
+	record_uploads(dev, cb, pending, layout, pending.uploads.size());
+}
+
+/*
+ * An upload that cannot be deferred must land after the pending ones of the
+ * same image: those are decoded inline first.
+ */
+void
+lazy_flush_image(struct command_buffer *cb, struct image *img, VkImageLayout dstImageLayout)
+{
+	scoped_lock l(lazy_lock);
+
+	struct lazy_state *state = get_lazy_state(cb->device);
+	if (!state)
+		return;
+
+	auto it = state->images.find(img->handle);
+	if (it == state->images.end())
+		return;
+
+	record_image(cb->device, cb, it->second, dstImageLayout);
+	state->images.erase(it);
+}
+
+/* Whether cb recorded one of the pending uploads. */
+static bool
+is_recorder(const struct lazy_image &pending, struct command_buffer *cb)
+{
+	for (const auto &upload : pending.uploads) {
+		if (upload.recorder == cb->handle)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Follows the layout each recording leaves pending images in. A barrier
+ * taking the image out of TRANSFER_DST in the recording that uploaded it
+ * means the recording goes on to use it: the decodes are recorded in-line,
+ * ahead of the barrier. Contents discarded by a transition from UNDEFINED
+ * no longer need decoding.
+ */
+void
+lazy_update_layout(struct command_buffer *cb,
+				   VkImage image,
+				   const VkImageSubresourceRange &range,
+				   VkImageLayout oldLayout,
+				   VkImageLayout newLayout)
+{
+	struct device *dev = cb->device;
+
+	scoped_lock l(lazy_lock);
+
+	struct lazy_state *state = get_lazy_state(dev);
+	if (!state)
+		return;
+
+	auto it = state->images.find(image);
+	if (it == state->images.end())
+		return;
+
+	struct lazy_image &pending = it->second;
+
+	if (oldLayout != VK_IMAGE_LAYOUT_UNDEFINED && newLayout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
+		is_recorder(pending, cb)) {
+		record_image(dev, cb, pending, oldLayout);
+		state->images.erase(it);
+		return;
+	}
+
+	pending.layouts[cb->handle] = newLayout;
+
+	if (oldLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+		return;
+
+	for (auto upload = pending.uploads.begin(); upload != pending.uploads.end();) {
+		const VkImageSubresourceLayers &sub = upload->region.imageSubresource;
+		bool covered = sub.mipLevel >= range.baseMipLevel &&
+					   (range.levelCount == VK_REMAINING_MIP_LEVELS || sub.mipLevel < range.baseMipLevel + range.levelCount) &&
+					   sub.baseArrayLayer >= range.baseArrayLayer &&
+					   (range.layerCount == VK_REMAINING_ARRAY_LAYERS || sub.baseArrayLayer < range.baseArrayLayer + range.layerCount);
+
+		if (!covered) {
+			++upload;
+			continue;
+		}
+
+		release_staging_buffer(dev, std::move(upload->blocks));
+		upload = pending.uploads.erase(upload);
+	}
+
+	if (pending.uploads.empty())
+		state->images.erase(it);
+}
+
+void
+lazy_forget_image(struct device *dev, VkImage image)
+{
+	scoped_lock l(lazy_lock);
+
+	struct lazy_state *state = get_lazy_state(dev);
+	if (!state)
+		return;
+
+	state->wanted.erase(image);
+
+	auto it = state->images.find(image);
+	if (it == state->images.end())
+		return;
+
+	for (auto &upload : it->second.uploads)
+		release_staging_buffer(dev, std::move(upload.blocks));
+
+	state->images.erase(it);
+}
+
+void
+lazy_track_view(struct device *dev, VkImageView view, VkImage image)
+{
+	scoped_lock l(lazy_lock);
+
+	struct lazy_state *state = get_lazy_state(dev);
+	if (state)
+		state->views[view] = image;
+}
+
+void
+lazy_forget_view(struct device *dev, VkImageView view)
+{
+	scoped_lock l(lazy_lock);
+
+	struct lazy_state *state = get_lazy_state(dev);
+	if (state)
+		state->views.erase(view);
+}
+
+/*
+ * The image is read by cb with the image in layout: decoded in-line when
+ * cb recorded one of its uploads, at the next submission otherwise.
+ */
+void
+lazy_want_image(struct command_buffer *cb, VkImage image, VkImageLayout layout)
+{
+	scoped_lock l(lazy_lock);
+
+	struct lazy_state *state = get_lazy_state(cb->device);
+	if (!state)
+		return;
+
+	auto it = state->images.find(image);
+	if (it == state->images.end())
+		return;
+
+	if (is_recorder(it->second, cb)) {
+		record_image(cb->device, cb, it->second, layout);
+		state->images.erase(it);
+		return;
+	}
+
+	it->second.wanted = true;
+}
+
+/*
+ * The recording is over. Uploads it never submitted will never happen, the
+ * submitted ones stay pending but no longer match a reused handle.
+ */
+void
+lazy_retire_command_buffer(struct command_buffer *cb)
+{
+	struct device *dev = cb->device;
+
+	scoped_lock l(lazy_lock);
+
+	struct lazy_state *state = get_lazy_state(dev);
+	if (!state)
+		return;
+
+	for (auto it = state->images.begin(); it != state->images.end();) {
+		struct lazy_image &pending = it->second;
+
+		for (auto upload = pending.uploads.begin(); upload != pending.uploads.end();) {
+			if (upload->recorder != cb->handle) {
+				++upload;
+				continue;
+			}
+
+			if (upload->submitted) {
+				upload->recorder = VK_NULL_HANDLE;
+				++upload;
+				continue;
+			}
+
+			release_staging_buffer(dev, std::move(upload->blocks));
+			upload = pending.uploads.erase(upload);
+		}
+
+		pending.layouts.erase(cb->handle);
+
+		if (pending.uploads.empty())
+			it = state->images.erase(it);
+		else
+			++it;
+	}
+}
+
+/*
+ * Marks the images behind the views a descriptor write references for
+ * decode at the next submission. Sets are often written before the image
+ * is uploaded, later uploads to these images are wanted from the start.
+ */
+void
+lazy_want_images(struct device *dev, uint32_t writeCount, const VkWriteDescriptorSet *pWrites)
+{
+	scoped_lock l(lazy_lock);
+
+	struct lazy_state *state = get_lazy_state(dev);
+	if (!state)
+		return;
+
+	for (uint32_t i = 0; i < writeCount; i++) {
+		const VkWriteDescriptorSet &write = pWrites[i];
+
+		switch (write.descriptorType) {
+			case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+			case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+			case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+			case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+				break;
+			default:
+				continue;
+		}
+
+		for (uint32_t j = 0; j < write.descriptorCount; j++) {
+			auto view = state->views.find(write.pImageInfo[j].imageView);
+			if (view == state->views.end())
+				continue;
+
+			state->wanted.insert(view->second);
+
+			auto it = state->images.find(view->second);
+			if (it != state->images.end())
+				it->second.wanted = true;
+		}
+	}
+}
+
+/* A layer command buffer for the queue family whose last submission has completed. */
+static std::unique_ptr<struct command_buffer>
+take_lazy_command_buffer(struct device *dev, struct lazy_state *state, uint32_t family)
+{
+	VkResult result;
+	VkCommandPool pool;
+
+	auto it = state->pools.find(family);
+	if (it == state->pools.end()) {
+		VkCommandPoolCreateInfo pool_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+			.queueFamilyIndex = family
+		};
+
+		result = dev->table.CreateCommandPool(dev->handle, &pool_info, nullptr, &pool);
+		if (result != VK_SUCCESS) {
+			Logger::log("error", "Failed to create lazy decode command pool, res %d", result);
+			return nullptr;
+		}
+
+		state->pools[family] = pool;
+	} else {
+		pool = it->second;
+	}
+
+	for (auto it = state->commandBuffers.begin(); it != state->commandBuffers.end(); ++it) {
+		if ((*it)->pool == pool && retire_completed(dev, (*it)->serial)) {
+			auto cb = std::move(*it);
+			state->commandBuffers.erase(it);
+			return cb;
+		}
+	}
+
+	VkCommandBufferAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.commandPool = pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1
+	};
+
+	VkCommandBuffer handle;
+	result = dev->table.AllocateCommandBuffers(dev->handle, &alloc_info, &handle);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to allocate lazy decode command buffer, res %d", result);
+		return nullptr;
+	}
+
+	/* Dispatchable objects created below the layer need the loader dispatch pointer. */
+	if (dev->setLoaderData)
+		dev->setLoaderData(dev->handle, handle);
+	else
+		*(void **)handle = *(void **)dev->handle;
+
+	auto cb = std::make_unique<struct command_buffer>();
+	cb->handle = handle;
+	cb->device = dev;
+	cb->pool = pool;
+	cb->family = family;
+	cb->serial = 0;
+
+	return cb;
+}
+
+/* Index in the batch of the primary that is or executes the recording command buffer, -1 if none. */
+static int
+find_recorder(const std::vector<VkCommandBuffer> &batch, VkCommandBuffer recorder)
+{
+	for (size_t i = 0; i < batch.size(); i++) {
+		if (batch[i] == recorder)
+			return i;
+
+		struct command_buffer *cb = get_command_buffer(batch[i]);
+		if (cb && std::find(cb->secondaries.begin(), cb->secondaries.end(), recorder) != cb->secondaries.end())
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * Layout the image is in after batch[0..end], the one it was in before the
+ * batch if none of those recordings transitions it.
+ */
+static VkImageLayout
+batch_layout(const struct lazy_image &pending, const std::vector<VkCommandBuffer> &batch, int end)
+{
+	VkImageLayout layout = pending.layout;
+
+	for (int i = 0; i <= end; i++) {
+		auto it = pending.layouts.find(batch[i]);
+		if (it != pending.layouts.end())
+			layout = it->second;
+
+		struct command_buffer *cb = get_command_buffer(batch[i]);
+		if (!cb)
+			continue;
+
+		for (VkCommandBuffer secondary : cb->secondaries) {
+			it = pending.layouts.find(secondary);
+			if (it != pending.layouts.end())
+				layout = it->second;
+		}
+	}
+
+	return layout;
+}
+
+/* The images still pending are left in the layouts the whole batch leaves them in. */
+static void
+submit_layouts(struct lazy_state *state, const std::vector<VkCommandBuffer> &batch)
+{
+	for (auto &it : state->images)
+		it.second.layout = batch_layout(it.second, batch, (int)batch.size() - 1);
+}
+
+/*
+ * Records the decodes due at a submission into a layer command buffer:
+ * every wanted image, then the oldest uploads of the others up to the
+ * budget, the rest of an image waiting for later submissions. Uploads whose
+ * recording command buffer has not been submitted yet wait for it, and so
+ * do the later ones of the same image. after receives the last such
+ * command buffer within the batch, the layer command buffer goes right
+ * after it, or first if it is VK_NULL_HANDLE.
+ */
+std::unique_ptr<struct command_buffer>
+lazy_record(struct device *dev,
+			struct queue *q,
+			const std::vector<VkCommandBuffer> &batch,
+			VkCommandBuffer *after)
+{
+	scoped_lock l(lazy_lock);
+
+	*after = VK_NULL_HANDLE;
+
+	struct lazy_state *state = get_lazy_state(dev);
+	if (!state || state->images.empty())
+		return nullptr;
+
+	VkQueueFlags flags = dev->queueFamilies[q->family].queueFlags;
+	bool capable = (flags & VK_QUEUE_COMPUTE_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT);
+	int after_index = -1;
+	size_t budget = state->budget;
+	std::vector<std::pair<VkImage, size_t>> due;
+
+	for (auto &it : state->images) {
+		struct lazy_image &pending = it.second;
+		std::vector<int> positions;
+
+		for (auto &upload : pending.uploads) {
+			int pos = find_recorder(batch, upload.recorder);
+			if (pos >= 0)
+				upload.submitted = true;
+			positions.push_back(pos);
+		}
+
+		if (!capable)
+			continue;
+
+		size_t count = 0;
+		while (count < pending.uploads.size() && pending.uploads[count].submitted)
+			count++;
+
+		if (!pending.wanted) {
+			count = std::min(count, budget);
+			budget -= count;
+		}
+
+		if (!count)
+			continue;
+
+		due.push_back({ it.first, count });
+		after_index = std::max(after_index, *std::max_element(positions.begin(), positions.begin() + count));
+	}
+
+	auto cb = due.empty() ? nullptr : take_lazy_command_buffer(dev, state, q->family);
+	if (!cb) {
+		submit_layouts(state, batch);
+		return nullptr;
+	}
+
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr
+	};
+
+	dev->table.ResetCommandBuffer(cb->handle, 0);
+	dev->table.BeginCommandBuffer(cb->handle, &begin_info);
+
+	for (const auto &it : due) {
+		VkImage image = it.first;
+		size_t count = it.second;
+		struct lazy_image &pending = state->images[image];
+		VkImageLayout layout = batch_layout(pending, batch, after_index);
+
+		for (size_t i = 0; i < count; i++) {
+			const VkImageSubresourceLayers &sub = pending.uploads[i].region.imageSubresource;
+			VkImageMemoryBarrier barrier = {
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.pNext = nullptr,
+				.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				.oldLayout = layout,
+				.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = image,
+				.subresourceRange = { sub.aspectMask, sub.mipLevel, 1, sub.baseArrayLayer, sub.layerCount }
+			};
+
+			dev->table.CmdPipelineBarrier(cb->handle, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			stats_add(BCN_STAT_BARRIERS, 1);
+		}
+
+		std::vector<VkImageSubresourceLayers> subresources;
+		for (size_t i = 0; i < count; i++)
+			subresources.push_back(pending.uploads[i].region.imageSubresource);
+
+		record_uploads(dev, cb.get(), pending, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, count);
+
+		for (const auto &sub : subresources) {
+			VkImageMemoryBarrier barrier = {
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.pNext = nullptr,
+				.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				.newLayout = layout,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = image,
+				.subresourceRange = { sub.aspectMask, sub.mipLevel, 1, sub.baseArrayLayer, sub.layerCount }
+			};
+
+			dev->table.CmdPipelineBarrier(cb->handle, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			stats_add(BCN_STAT_BARRIERS, 1);
+		}
+
+		if (pending.uploads.empty())
+			state->images.erase(image);
+	}
+
+	dev->table.EndCommandBuffer(cb->handle);
+
+	submit_layouts(state, batch);
+
+	if (after_index >= 0)
+		*after = batch[after_index];
+
+	return cb;
+}
+
+/* Takes back a layer command buffer once the submission carrying it is tagged with serial. */
+void
+lazy_submitted(struct device *dev, std::unique_ptr<struct command_buffer> cb, uint64_t serial)
+{
+	cb->serial = serial;
+	retire_resources(dev, serial, cb->transients);
+
+	scoped_lock l(lazy_lock);
+
+	struct lazy_state *state = get_lazy_state(dev);
+	if (state)
+		state->commandBuffers.push_back(std::move(cb));
+}
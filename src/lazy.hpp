@@ -0,0 +1,36 @@
+#ifndef __LAZY_HPP
+#define __LAZY_HPP
+
+#include "bcn_layer.hpp"
+#include "command_buffer.hpp"
+#include "queue.hpp"
+
+struct image;
+
+void lazy_init(struct device *dev);
+void lazy_destroy(struct device *dev);
+bool lazy_defer(struct command_buffer *cb,
+				VkFormat format,
+				const VkBufferImageCopy &copy_region,
+				struct buffer *buf,
+				struct image *img,
+				VkImageLayout dstImageLayout);
+void lazy_flush_image(struct command_buffer *cb, struct image *img, VkImageLayout dstImageLayout);
+void lazy_update_layout(struct command_buffer *cb,
+						VkImage image,
+						const VkImageSubresourceRange &range,
+						VkImageLayout oldLayout,
+						VkImageLayout newLayout);
+void lazy_forget_image(struct device *dev, VkImage image);
+void lazy_track_view(struct device *dev, VkImageView view, VkImage image);
+void lazy_forget_view(struct device *dev, VkImageView view);
+void lazy_want_image(struct command_buffer *cb, VkImage image, VkImageLayout layout);
+void lazy_retire_command_buffer(struct command_buffer *cb);
+void lazy_want_images(struct device *dev, uint32_t writeCount, const VkWriteDescriptorSet *pWrites);
+std::unique_ptr<struct command_buffer> lazy_record(struct device *dev,
+												   struct queue *q,
+												   const std::vector<VkCommandBuffer> &batch,
+												   VkCommandBuffer *after);
+void lazy_submitted(struct device *dev, std::unique_ptr<struct command_buffer> cb, uint64_t serial);
+
+#endif
@@ -0,0 +1,358 @@
+#include "linear.hpp"
+#include "format.hpp"
+#include "bcn_cpu.hpp"
+#include "allocator.hpp"
+#include "memory.hpp"
+
+#include <algorithm>
+
+/*
+ * Linear BC images are written by the application through a mapping. The
+ * emulated image holds decoded texels, so an image bound to host visible
+ * memory is bound to private layer memory instead. The range it was bound
+ * to in the application's memory holds the compressed blocks the
+ * application writes, and block rows that changed since the last sync are
+ * decoded on the host into the private memory at flush and unmap time, and
+ * at submit time for coherent memory. The work is bounded by the size of
+ * the images, the rest of the application's mappings is never looked at.
+ */
+struct linear_private {
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	uint32_t typeIndex;
+	void *data;
+};
+
+struct linear_image {
+	VkFormat format;
+	VkExtent3D extent;
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkSubresourceLayout layout;
+	VkDeviceSize rowPitch;
+	std::vector<uint8_t> committed;
+	struct linear_private backing;
+};
+
+struct linear_mapping {
+	void *data;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	bool coherent;
+};
+
+struct linear_state {
+	std::unordered_map<VkImage, struct linear_image> images;
+	std::unordered_map<VkDeviceMemory, struct linear_mapping> mappings;
+};
+
+static std::mutex linear_lock;
+static std::unordered_map<struct device *, std::unique_ptr<struct linear_state>> linearMap;
+
+static struct linear_state *
+get_linear_state(struct device *dev, bool create)
+{
+	auto it = linearMap.find(dev);
+
+	if (it != linearMap.end())
+		return it->second.get();
+
+	if (!create)
+		return nullptr;
+
+	auto state = std::make_unique<struct linear_state>();
+	struct linear_state *ret = state.get();
+	linearMap[dev] = std::move(state);
+
+	return ret;
+}
+
+void
+linear_register_image(struct device *dev, VkImage image, const VkImageCreateInfo *pCreateInfo)
+{
+	struct linear_image img = {};
+	img.format = pCreateInfo->format;
+	img.extent = pCreateInfo->extent;
+	img.memory = VK_NULL_HANDLE;
+	img.rowPitch = ((pCreateInfo->extent.width + 3) / 4) * (VkDeviceSize)get_block_size(pCreateInfo->format);
+
+	VkImageSubresource subresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+	dev->table.GetImageSubresourceLayout(dev->handle, image, &subresource, &img.layout);
+
+	scoped_lock l(linear_lock);
+	get_linear_state(dev, true)->images[image] = std::move(img);
+}
+
+static void
+free_backing(struct device *dev, struct linear_private &backing)
+{
+	if (backing.memory == VK_NULL_HANDLE)
+		return;
+
+	dev->table.UnmapMemory(dev->handle, backing.memory);
+	allocator_free(dev, backing.memory, backing.size, backing.typeIndex);
+	backing = {};
+}
+
+void
+linear_forget_image(struct device *dev, VkImage image)
+{
+	scoped_lock l(linear_lock);
+
+	struct linear_state *state = get_linear_state(dev, false);
+	if (!state)
+		return;
+
+	auto it = state->images.find(image);
+	if (it == state->images.end())
+		return;
+
+	free_backing(dev, it->second.backing);
+	state->images.erase(it);
+}
+
+/* The layout the application writes compressed blocks with, inside the footprint of the decoded image. */
+bool
+linear_get_layout(struct device *dev, VkImage image, VkSubresourceLayout *pLayout)
+{
+	scoped_lock l(linear_lock);
+
+	struct linear_state *state = get_linear_state(dev, false);
+	if (!state)
+		return false;
+
+	auto it = state->images.find(image);
+	if (it == state->images.end())
+		return false;
+
+	const struct linear_image &img = it->second;
+	VkDeviceSize size = img.rowPitch * ((img.extent.height + 3) / 4);
+
+	pLayout->offset = img.layout.offset;
+	pLayout->size = size;
+	pLayout->rowPitch = img.rowPitch;
+	pLayout->arrayPitch = size;
+	pLayout->depthPitch = size;
+
+	return true;
+}
+
+/* Host visible layer memory the image lives in while the application writes its blocks elsewhere. */
+static bool
+allocate_backing(struct device *dev, VkImage image, struct linear_private &backing)
+{
+	VkMemoryRequirements reqs;
+	dev->table.GetImageMemoryRequirements(dev->handle, image, &reqs);
+
+	VkResult result = allocator_allocate(dev, reqs, ALLOC_UPLOAD, &backing.memory, &backing.typeIndex);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to allocate linear image backing, res %d", result);
+		backing = {};
+		return false;
+	}
+
+	backing.size = reqs.size;
+
+	result = dev->table.MapMemory(dev->handle, backing.memory, 0, VK_WHOLE_SIZE, 0, &backing.data);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to map linear image backing, res %d", result);
+		allocator_free(dev, backing.memory, backing.size, backing.typeIndex);
+		backing = {};
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Called before the image is bound to memory at offset by the application.
+ * bindMemory and bindOffset receive what to actually bind it to: private
+ * layer memory when the application can write memory from the host.
+ */
+void
+linear_bind(struct device *dev, VkImage image, VkDeviceMemory memory, VkDeviceSize offset,
+			VkDeviceMemory *bindMemory, VkDeviceSize *bindOffset)
+{
+	VkMemoryPropertyFlags flags;
+
+	*bindMemory = memory;
+	*bindOffset = offset;
+
+	{
+		scoped_lock l(global_lock);
+		struct memory *mem = find_memory(memory);
+		flags = mem ? mem->flags : 0;
+	}
+
+	scoped_lock l(linear_lock);
+
+	struct linear_state *state = get_linear_state(dev, false);
+	if (!state)
+		return;
+
+	auto it = state->images.find(image);
+	if (it == state->images.end())
+		return;
+
+	struct linear_image &img = it->second;
+	img.memory = memory;
+	img.offset = offset;
+
+	if (!(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		return;
+
+	if (allocate_backing(dev, image, img.backing)) {
+		*bindMemory = img.backing.memory;
+		*bindOffset = 0;
+	}
+}
+
+/*
+ * Decodes the block rows of an image that changed in the mapping into its
+ * private backing.
+ */
+static bool
+sync_image(struct linear_image &img, const struct linear_mapping &mapping)
+{
+	VkDeviceSize start = img.offset + img.layout.offset;
+	uint32_t blockRows = (img.extent.height + 3) / 4;
+	VkDeviceSize compressedSize = img.rowPitch * blockRows;
+	bool changed = false;
+	bool all = img.committed.size() != compressedSize;
+
+	if (img.backing.memory == VK_NULL_HANDLE ||
+		start < mapping.offset || start + compressedSize > mapping.offset + mapping.size)
+		return false;
+
+	const uint8_t *src = (const uint8_t *)mapping.data + (start - mapping.offset);
+	uint8_t *dst = (uint8_t *)img.backing.data + img.layout.offset;
+
+	if (all)
+		img.committed.resize(compressedSize);
+
+	for (uint32_t row = 0; row < blockRows; row++) {
+		const uint8_t *blocks = src + row * img.rowPitch;
+		uint8_t *committed = img.committed.data() + row * img.rowPitch;
+
+		if (!all && !memcmp(blocks, committed, img.rowPitch))
+			continue;
+
+		uint32_t height = std::min(4u, img.extent.height - row * 4);
+		decode_bcn_region(img.format, blocks, img.rowPitch, img.extent.width, height,
+			dst + row * 4 * img.layout.rowPitch, img.layout.rowPitch);
+
+		memcpy(committed, blocks, img.rowPitch);
+		changed = true;
+	}
+
+	return changed;
+}
+
+static void
+flush_memory(struct device *dev, VkDeviceMemory memory, VkDeviceSize offset)
+{
+	VkMappedMemoryRange range = {
+		.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+		.pNext = nullptr,
+		.memory = memory,
+		.offset = offset,
+		.size = VK_WHOLE_SIZE
+	};
+	dev->table.FlushMappedMemoryRanges(dev->handle, 1, &range);
+}
+
+/* Decodes what changed in the images bound to memory. */
+static void
+sync_mapping(struct device *dev, struct linear_state *state, VkDeviceMemory memory, const struct linear_mapping &mapping)
+{
+	for (auto &it : state->images) {
+		struct linear_image &img = it.second;
+
+		if (img.memory == memory && sync_image(img, mapping))
+			flush_memory(dev, img.backing.memory, 0);
+	}
+}
+
+void
+linear_map(struct device *dev, VkDeviceMemory memory, void *data, VkDeviceSize offset, VkDeviceSize size, bool coherent)
+{
+	scoped_lock l(linear_lock);
+
+	struct linear_state *state = get_linear_state(dev, true);
+	state->mappings[memory] = { data, offset, size, coherent };
+}
+
+void
+linear_flush(struct device *dev, VkDeviceMemory memory)
+{
+	scoped_lock l(linear_lock);
+
+	struct linear_state *state = get_linear_state(dev, false);
+	if (!state)
+		return;
+
+	auto it = state->mappings.find(memory);
+	if (it != state->mappings.end())
+		sync_mapping(dev, state, memory, it->second);
+}
+
+void
+linear_unmap(struct device *dev, VkDeviceMemory memory)
+{
+	scoped_lock l(linear_lock);
+
+	struct linear_state *state = get_linear_state(dev, false);
+	if (!state)
+		return;
+
+	auto it = state->mappings.find(memory);
+	if (it == state->mappings.end())
+		return;
+
+	sync_mapping(dev, state, memory, it->second);
+	state->mappings.erase(it);
+}
+
+/*
+ * Coherent mappings are never flushed, every submission picks up their
+ * writes. Only the mapped images are looked at.
+ */
+void
+linear_flush_all(struct device *dev)
+{
+	scoped_lock l(linear_lock);
+
+	struct linear_state *state = get_linear_state(dev, false);
+	if (!state || state->images.empty())
+		return;
+
+	for (auto &it : state->images) {
+		struct linear_image &img = it.second;
+		if (img.backing.memory == VK_NULL_HANDLE)
+			continue;
+
+		auto mapping = state->mappings.find(img.memory);
+		if (mapping == state->mappings.end() || !mapping->second.coherent)
+			continue;
+
+		if (sync_image(img, mapping->second))
+			flush_memory(dev, img.backing.memory, 0);
+	}
+}
+
+void
+linear_forget_memory(struct device *dev, VkDeviceMemory memory)
+{
+	scoped_lock l(linear_lock);
+
+	struct linear_state *state = get_linear_state(dev, false);
+	if (!state)
+		return;
+
+	state->mappings.erase(memory);
+
+	for (auto &it : state->images) {
+		if (it.second.memory == memory)
+			it.second.memory = VK_NULL_HANDLE;
+	}
+}
@@ -0,0 +1,17 @@
+#ifndef __LINEAR_HPP
+#define __LINEAR_HPP
+
+#include "bcn_layer.hpp"
+
+void linear_register_image(struct device *dev, VkImage image, const VkImageCreateInfo *pCreateInfo);
+void linear_forget_image(struct device *dev, VkImage image);
+bool linear_get_layout(struct device *dev, VkImage image, VkSubresourceLayout *pLayout);
+void linear_bind(struct device *dev, VkImage image, VkDeviceMemory memory, VkDeviceSize offset,
+				 VkDeviceMemory *bindMemory, VkDeviceSize *bindOffset);
+void linear_map(struct device *dev, VkDeviceMemory memory, void *data, VkDeviceSize offset, VkDeviceSize size, bool coherent);
+void linear_flush(struct device *dev, VkDeviceMemory memory);
+void linear_unmap(struct device *dev, VkDeviceMemory memory);
+void linear_flush_all(struct device *dev);
+void linear_forget_memory(struct device *dev, VkDeviceMemory memory);
+
+#endif
@@ -1,63 +1,73 @@
 #include "logger.hpp"
+#include "trace.hpp"
+
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
 
 namespace Logger {
 	static struct bcn_layer_log bcn_layer_log_options[] = {
 	    {"info", BCN_LAYER_LOG_INFO},
 	    {"error", BCN_LAYER_LOG_ERROR},
-	    {"", 0}
+	    {nullptr, 0}
 	};
-	
+
 	uint64_t bcn_layer_log_mask;
+	static std::once_flag bcn_layer_log_once;
 
 	static unsigned long long get_debug_flag(const char *option) {
     	int index = 0;
 
-        while (!bcn_layer_log_options[index].name.empty()) {
-        	if (!std::strcmp(bcn_layer_log_options[index].name.c_str(), option))                      
+        while (bcn_layer_log_options[index].name) {
+        	if (!strcmp(bcn_layer_log_options[index].name, option))
          		return bcn_layer_log_options[index].value;
-                                                                                                   
+
          	index++;
         }
 
         return 0;
     }
-      
-	static bool get_bcn_layer_log_level(const std::string& option) {
-		uint64_t flag = get_debug_flag(option.c_str());
-
-		if (bcn_layer_log_mask & flag)
-			return true;
 
-		return false;
+	static const char *get_level_name(uint64_t flag) {
+		return flag == BCN_LAYER_LOG_ERROR ? "error" : "info";
 	}
-	
-	void log (const std::string& log_level, const char *format, ...) {
-		if (!get_bcn_layer_log_level(log_level.c_str()))
-			return;
-			
+
+	/* Messages go to the trace when one is being written, to stderr otherwise. */
+	void write(uint64_t flag, const char *format, ...) {
 		constexpr size_t BUFFER_SIZE = 1024;
 		char buffer[BUFFER_SIZE];
-		
+
 		va_list args;
 		va_start(args, format);
 		vsnprintf(buffer, BUFFER_SIZE, format, args);
 		va_end(args);
-		
-		std::cerr << "[" << log_level << "]: " << buffer << std::endl;
-	}
 
-	void init() {
-		char *bcn_layer_log_env = std::getenv("BCN_LAYER_LOG_LEVEL");
-		if (!bcn_layer_log_env) {
-			bcn_layer_log_mask = 0;
+		if (trace_enabled.load(std::memory_order_relaxed)) {
+			trace_message(flag, buffer);
 			return;
 		}
 
-		const char *option = std::strtok(bcn_layer_log_env, ",");
+		fprintf(stderr, "[%s]: %s\n", get_level_name(flag), buffer);
+	}
+
+	static void parse_env() {
+		const char *bcn_layer_log_env = getenv("BCN_LAYER_LOG_LEVEL");
+		if (!bcn_layer_log_env)
+			return;
+
+		std::string options = bcn_layer_log_env;
+		char *saveptr = nullptr;
+		const char *option = strtok_r(options.data(), ",", &saveptr);
 
 		while (option != nullptr) {
 			bcn_layer_log_mask |= get_debug_flag(option);
-			option = std::strtok(nullptr, ",");
+			option = strtok_r(nullptr, ",", &saveptr);
 		}
 	}
+
+	void init() {
+		std::call_once(bcn_layer_log_once, parse_env);
+	}
 }
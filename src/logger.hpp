@@ -1,21 +1,39 @@
 #ifndef __LOGGER_HPP
 #define __LOGGER_HPP
 
-#include <sstream>
+#include <cstdint>
+#include <cstdio>
 #include <string>
-#include <iostream>
-#include <stdarg.h>
 
 namespace Logger {
 	#define BCN_LAYER_LOG_INFO (1ull << 0)
 	#define BCN_LAYER_LOG_ERROR (1ull << 1)
-	
+
 	struct bcn_layer_log {
-	    std::string name;
+	    const char *name;
 	    unsigned long long value;
 	};
-	
-	void log (const std::string& log_level, const char *format, ...);
+
+	extern uint64_t bcn_layer_log_mask;
+
+	/* Folds to a constant for the literal levels every call site passes. */
+	static constexpr uint64_t get_level_flag(const char *level) {
+		return level[0] == 'i' ? BCN_LAYER_LOG_INFO : level[0] == 'e' ? BCN_LAYER_LOG_ERROR : 0;
+	}
+
+	void init();
+	void write(uint64_t flag, const char *format, ...);
+
+	/* A disabled level costs one branch, nothing is formatted. */
+	template <typename... Args>
+	static inline void log(const char *log_level, const char *format, Args... args) {
+		uint64_t flag = get_level_flag(log_level);
+
+		if (__builtin_expect(!(bcn_layer_log_mask & flag), 1))
+			return;
+
+		write(flag, format, args...);
+	}
 }
 
 #endif
@@ -0,0 +1,154 @@
+#include "memory.hpp"
+#include "buffer.hpp"
+#include "linear.hpp"
+#include "allocator.hpp"
+
+std::unordered_map<VkDeviceMemory, std::unique_ptr<struct memory>> memoryMap;
+
+struct memory *
+find_memory(VkDeviceMemory memory)
+{
+	auto it = memoryMap.find(memory);
+
+	if (it == memoryMap.end())
+		return nullptr;
+
+	return it->second.get();
+}
+
+/*
+ * Returns a host pointer to [offset, offset + size) of the buffer if the app
+ * currently has its backing memory mapped, nullptr otherwise.
+ */
+const void *
+get_buffer_host_pointer(struct buffer *buf, VkDeviceSize offset, VkDeviceSize size)
+{
+	scoped_lock l(global_lock);
+
+	struct memory *mem = find_memory(buf->memory);
+	if (!mem || !mem->mapped)
+		return nullptr;
+
+	VkDeviceSize start = buf->offset + offset;
+	if (start < mem->mapOffset || start + size > mem->mapOffset + mem->mapSize)
+		return nullptr;
+
+	return (const uint8_t *)mem->mapped + (start - mem->mapOffset);
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_AllocateMemory(VkDevice device,
+						const VkMemoryAllocateInfo *pAllocateInfo,
+						const VkAllocationCallbacks *pAllocator,
+						VkDeviceMemory *pMemory)
+{
+	VkResult result;
+
+	struct device *dev = get_device(device);
+	if (!dev)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	result = dev->table.AllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+	if (result != VK_SUCCESS)
+		return result;
+
+	auto mem = std::make_unique<struct memory>();
+	mem->handle = *pMemory;
+	mem->size = pAllocateInfo->allocationSize;
+	mem->typeIndex = pAllocateInfo->memoryTypeIndex;
+	mem->flags = allocator_memory_flags(dev, pAllocateInfo->memoryTypeIndex);
+	mem->mapped = nullptr;
+	mem->mapOffset = 0;
+	mem->mapSize = 0;
+	mem->device = dev;
+
+	{
+		scoped_lock l(global_lock);
+		memoryMap[*pMemory] = std::move(mem);
+	}
+
+	return VK_SUCCESS;
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_FreeMemory(VkDevice device,
+					VkDeviceMemory memory,
+					const VkAllocationCallbacks *pAllocator)
+{
+	scoped_lock l(global_lock);
+
+	struct device *dev = get_device(device);
+	if (!dev)
+		return;
+
+	linear_forget_memory(dev, memory);
+	dev->table.FreeMemory(device, memory, pAllocator);
+	memoryMap.erase(memory);
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_MapMemory(VkDevice device,
+				   VkDeviceMemory memory,
+				   VkDeviceSize offset,
+				   VkDeviceSize size,
+				   VkMemoryMapFlags flags,
+				   void **ppData)
+{
+	VkResult result;
+
+	struct device *dev = get_device(device);
+	if (!dev)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	result = dev->table.MapMemory(device, memory, offset, size, flags, ppData);
+	if (result != VK_SUCCESS)
+		return result;
+
+	scoped_lock l(global_lock);
+
+	struct memory *mem = find_memory(memory);
+	if (mem) {
+		mem->mapOffset = offset;
+		mem->mapSize = (size == VK_WHOLE_SIZE) ? mem->size - offset : size;
+		linear_map(dev, memory, *ppData, offset, mem->mapSize, mem->flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		mem->mapped = *ppData;
+	}
+
+	return VK_SUCCESS;
+}
+
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_UnmapMemory(VkDevice device,
+					 VkDeviceMemory memory)
+{
+	scoped_lock l(global_lock);
+
+	struct device *dev = get_device(device);
+	if (!dev)
+		return;
+
+	linear_unmap(dev, memory);
+	dev->table.UnmapMemory(device, memory);
+
+	struct memory *mem = find_memory(memory);
+	if (mem) {
+		mem->mapped = nullptr;
+		mem->mapOffset = 0;
+		mem->mapSize = 0;
+	}
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_FlushMappedMemoryRanges(VkDevice device,
+								 uint32_t memoryRangeCount,
+								 const VkMappedMemoryRange *pMemoryRanges)
+{
+	struct device *dev = get_device(device);
+	if (!dev)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	for (uint32_t i = 0; i < memoryRangeCount; i++)
+		linear_flush(dev, pMemoryRanges[i].memory);
+
+	return dev->table.FlushMappedMemoryRanges(device, memoryRangeCount, pMemoryRanges);
+}
@@ -0,0 +1,22 @@
+#ifndef __MEMORY_HPP
+#define __MEMORY_HPP
+
+#include "bcn_layer.hpp"
+
+struct buffer;
+
+struct memory {
+	VkDeviceMemory handle;
+	VkDeviceSize size;
+	uint32_t typeIndex;
+	VkMemoryPropertyFlags flags;
+	void *mapped;
+	VkDeviceSize mapOffset;
+	VkDeviceSize mapSize;
+	struct device *device;
+};
+
+struct memory *find_memory(VkDeviceMemory);
+const void *get_buffer_host_pointer(struct buffer *buf, VkDeviceSize offset, VkDeviceSize size);
+
+#endif
@@ -0,0 +1,92 @@
+#include "pack.hpp"
+#include "logger.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <mutex>
+
+static std::once_flag pack_once;
+static const uint8_t *pack_map = nullptr;
+static size_t pack_map_size = 0;
+static const struct pack_index_entry *pack_index = nullptr;
+static uint64_t pack_count = 0;
+
+static void
+pack_map_file(const char *path)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		Logger::log("error", "Failed to open texture pack %s", path);
+		return;
+	}
+
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(struct pack_header)) {
+		Logger::log("error", "Invalid texture pack %s", path);
+		close(fd);
+		return;
+	}
+
+	void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		Logger::log("error", "Failed to map texture pack %s", path);
+		return;
+	}
+
+	const struct pack_header *header = (const struct pack_header *)map;
+	size_t indexEnd = sizeof(*header) + header->count * sizeof(struct pack_index_entry);
+
+	if (header->magic != BCN_PACK_MAGIC || header->version != BCN_PACK_VERSION ||
+		header->count > (size_t)st.st_size / sizeof(struct pack_index_entry) || indexEnd > (size_t)st.st_size) {
+		Logger::log("error", "Invalid texture pack %s", path);
+		munmap(map, st.st_size);
+		return;
+	}
+
+	pack_map = (const uint8_t *)map;
+	pack_map_size = st.st_size;
+	pack_index = (const struct pack_index_entry *)(pack_map + sizeof(*header));
+	pack_count = header->count;
+
+	Logger::log("info", "Loaded texture pack %s with %llu entries", path, (unsigned long long)pack_count);
+}
+
+/*
+ * The pack stays mapped for the lifetime of the process and is shared by
+ * every device, so it is only mapped once.
+ */
+bool
+pack_open(const char *path)
+{
+	std::call_once(pack_once, pack_map_file, path);
+
+	return pack_map != nullptr;
+}
+
+bool
+pack_lookup(const hash128 &key, const void **data, size_t *size)
+{
+	if (!pack_map)
+		return false;
+
+	const struct pack_index_entry *end = pack_index + pack_count;
+	const struct pack_index_entry *it = std::lower_bound(pack_index, end, key,
+		[](const struct pack_index_entry &entry, const hash128 &k) {
+			return entry.key_hi < k.hi || (entry.key_hi == k.hi && entry.key_lo < k.lo);
+		});
+
+	if (it == end || it->key_lo != key.lo || it->key_hi != key.hi)
+		return false;
+
+	if (it->offset > pack_map_size || it->size > pack_map_size - it->offset)
+		return false;
+
+	*data = pack_map + it->offset;
+	*size = it->size;
+	return true;
+}
@@ -0,0 +1,30 @@
+#ifndef __PACK_HPP
+#define __PACK_HPP
+
+#include "hash.hpp"
+
+#define BCN_PACK_MAGIC 0x4b504342
+#define BCN_PACK_VERSION 1
+
+/*
+ * A pack is a header, an index sorted by key and the decoded payloads,
+ * each one starting on a 16 byte boundary. Keys are computed the same way
+ * hash_bcn_region does it, so an upload can be looked up without decoding.
+ */
+struct pack_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t count;
+};
+
+struct pack_index_entry {
+	uint64_t key_lo;
+	uint64_t key_hi;
+	uint64_t offset;
+	uint64_t size;
+};
+
+bool pack_open(const char *path);
+bool pack_lookup(const hash128 &key, const void **data, size_t *size);
+
+#endif
@@ -0,0 +1,221 @@
+#include "pipeline_cache.hpp"
+#include "bcn.hpp"
+#include "cache.hpp"
+#include "hash.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string>
+
+#define BCN_PIPELINE_CACHE_MAGIC 0x50434342
+#define BCN_PIPELINE_CACHE_VERSION 1
+
+/*
+ * The file holds the shader module identifiers of the decode shaders
+ * followed by the VkPipelineCache data. Identifiers are only reused when
+ * the SPIR-V and the identifier algorithm both match.
+ */
+struct pipeline_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint8_t cacheUUID[VK_UUID_SIZE];
+	uint8_t identifierAlgorithm[VK_UUID_SIZE];
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint32_t use_image_view;
+	uint64_t spirv_lo;
+	uint64_t spirv_hi;
+	uint32_t identifierSizes[BCN_FAMILY_COUNT];
+	uint64_t cacheSize;
+};
+
+static hash128
+get_spirv_hash(struct device *dev)
+{
+	hash128 hash = { 0, 0 };
+
+	for (int family = 0; family < BCN_FAMILY_COUNT; family++) {
+		const uint32_t *code;
+		size_t size;
+
+		get_bcn_spirv(dev, (enum bcn_family)family, &code, &size);
+		hash = hash_bytes(code, size, hash.lo ^ hash.hi);
+	}
+
+	return hash;
+}
+
+/* Named after the cache UUID and driver version, a driver update starts a new file. */
+static std::string
+get_pipeline_cache_path(struct device *dev)
+{
+	const VkPhysicalDeviceProperties &props = dev->props2.properties;
+	std::string dir = get_cache_dir();
+	char name[64];
+
+	if (dir.empty())
+		return "";
+
+	std::string path = dir + "/pipelines_";
+	for (int i = 0; i < VK_UUID_SIZE; i++) {
+		snprintf(name, sizeof(name), "%02x", props.pipelineCacheUUID[i]);
+		path += name;
+	}
+
+	snprintf(name, sizeof(name), "_%08x_%d.bin", props.driverVersion, dev->use_image_view);
+	return path + name;
+}
+
+static void
+create_pipeline_cache(struct device *dev, const void *data, size_t size)
+{
+	VkPipelineCacheCreateInfo create_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.initialDataSize = size,
+		.pInitialData = data
+	};
+
+	VkResult result = dev->table.CreatePipelineCache(dev->handle, &create_info, nullptr, &dev->pipelineCache);
+
+	/* Drivers may reject stale data, start empty then. */
+	if (result != VK_SUCCESS && size) {
+		create_info.initialDataSize = 0;
+		create_info.pInitialData = nullptr;
+		result = dev->table.CreatePipelineCache(dev->handle, &create_info, nullptr, &dev->pipelineCache);
+	}
+
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to create pipeline cache, res %d", result);
+		dev->pipelineCache = VK_NULL_HANDLE;
+	}
+}
+
+void
+pipeline_cache_load(struct device *dev)
+{
+	const VkPhysicalDeviceProperties &props = dev->props2.properties;
+	struct stat st;
+
+	dev->pipelineCache = VK_NULL_HANDLE;
+	if (!dev->use_pipeline_cache)
+		return;
+
+	std::string path = get_pipeline_cache_path(dev);
+	int fd = path.empty() ? -1 : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0 || fstat(fd, &st) || (size_t)st.st_size < sizeof(struct pipeline_cache_header)) {
+		if (fd >= 0)
+			close(fd);
+		create_pipeline_cache(dev, nullptr, 0);
+		return;
+	}
+
+	void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		create_pipeline_cache(dev, nullptr, 0);
+		return;
+	}
+
+	const struct pipeline_cache_header *header = (const struct pipeline_cache_header *)map;
+	const uint8_t *payload = (const uint8_t *)map + sizeof(*header);
+	size_t payloadSize = st.st_size - sizeof(*header);
+	size_t identifiersSize = 0;
+	bool valid = true;
+
+	for (int family = 0; family < BCN_FAMILY_COUNT; family++) {
+		valid &= header->identifierSizes[family] <= VK_MAX_SHADER_MODULE_IDENTIFIER_SIZE_EXT;
+		identifiersSize += header->identifierSizes[family];
+	}
+
+	valid = valid && header->magic == BCN_PIPELINE_CACHE_MAGIC &&
+				 header->version == BCN_PIPELINE_CACHE_VERSION &&
+				 !memcmp(header->cacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) &&
+				 header->vendorID == props.vendorID &&
+				 header->deviceID == props.deviceID &&
+				 header->driverVersion == props.driverVersion &&
+				 header->use_image_view == (uint32_t)dev->use_image_view &&
+				 identifiersSize + header->cacheSize == payloadSize;
+
+	if (!valid) {
+		munmap(map, st.st_size);
+		create_pipeline_cache(dev, nullptr, 0);
+		return;
+	}
+
+	hash128 spirv = get_spirv_hash(dev);
+	bool identifiers = dev->use_module_identifiers &&
+					   header->spirv_lo == spirv.lo && header->spirv_hi == spirv.hi &&
+					   !memcmp(header->identifierAlgorithm, dev->identifierAlgorithm, VK_UUID_SIZE);
+
+	for (int family = 0; family < BCN_FAMILY_COUNT; family++) {
+		uint32_t size = header->identifierSizes[family];
+
+		if (identifiers)
+			dev->moduleIdentifiers[family].assign(payload, payload + size);
+		payload += size;
+	}
+
+	create_pipeline_cache(dev, payload, header->cacheSize);
+	munmap(map, st.st_size);
+}
+
+/*
+ * Written through write_file_atomic, so concurrent processes sharing the
+ * cache directory never observe a torn file.
+ */
+void
+pipeline_cache_save(struct device *dev)
+{
+	const VkPhysicalDeviceProperties &props = dev->props2.properties;
+	size_t size = 0;
+
+	if (!dev->use_pipeline_cache || dev->pipelineCache == VK_NULL_HANDLE)
+		return;
+
+	std::string path = get_pipeline_cache_path(dev);
+	if (path.empty())
+		return;
+
+	if (dev->table.GetPipelineCacheData(dev->handle, dev->pipelineCache, &size, nullptr) != VK_SUCCESS)
+		return;
+
+	std::vector<uint8_t> payload;
+	struct pipeline_cache_header header = {};
+
+	header.magic = BCN_PIPELINE_CACHE_MAGIC;
+	header.version = BCN_PIPELINE_CACHE_VERSION;
+	memcpy(header.cacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+	memcpy(header.identifierAlgorithm, dev->identifierAlgorithm, VK_UUID_SIZE);
+	header.vendorID = props.vendorID;
+	header.deviceID = props.deviceID;
+	header.driverVersion = props.driverVersion;
+	header.use_image_view = dev->use_image_view;
+
+	hash128 spirv = get_spirv_hash(dev);
+	header.spirv_lo = spirv.lo;
+	header.spirv_hi = spirv.hi;
+
+	for (int family = 0; family < BCN_FAMILY_COUNT; family++) {
+		const auto &identifier = dev->moduleIdentifiers[family];
+
+		header.identifierSizes[family] = identifier.size();
+		payload.insert(payload.end(), identifier.begin(), identifier.end());
+	}
+
+	size_t identifiersSize = payload.size();
+	payload.resize(identifiersSize + size);
+
+	if (dev->table.GetPipelineCacheData(dev->handle, dev->pipelineCache, &size, payload.data() + identifiersSize) != VK_SUCCESS)
+		return;
+
+	payload.resize(identifiersSize + size);
+	header.cacheSize = size;
+
+	if (!write_file_atomic(path, &header, sizeof(header), payload.data(), payload.size()))
+		Logger::log("error", "Failed to write pipeline cache %s", path.c_str());
+}
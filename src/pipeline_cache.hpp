@@ -0,0 +1,9 @@
+#ifndef __PIPELINE_CACHE_HPP
+#define __PIPELINE_CACHE_HPP
+
+#include "bcn_layer.hpp"
+
+void pipeline_cache_load(struct device *dev);
+void pipeline_cache_save(struct device *dev);
+
+#endif
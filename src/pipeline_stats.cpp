@@ -0,0 +1,196 @@
+#include "pipeline_stats.hpp"
+#include "logger.hpp"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Pipelines of several devices can finish building at the same time. */
+static std::mutex output_lock;
+
+/* Pipelines only keep what VK_KHR_pipeline_executable_properties reports when asked at creation. */
+VkPipelineCreateFlags
+pipeline_stats_flags(struct device *dev)
+{
+	switch (dev->pipeline_stats) {
+		case BCN_PIPELINE_STATS_STATISTICS:
+			return VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR;
+		case BCN_PIPELINE_STATS_INTERNAL:
+			return VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR |
+				VK_PIPELINE_CREATE_CAPTURE_INTERNAL_REPRESENTATIONS_BIT_KHR;
+		default:
+			return 0;
+	}
+}
+
+static void
+append_line(std::string &out, const char *format, ...)
+{
+	char buffer[1024];
+
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	out += buffer;
+	out += '\n';
+}
+
+/*
+ * Asking for BCN_PIPELINE_STATS is asking for the output, so it does not go
+ * through the log levels. It is appended to BCN_PIPELINE_STATS_FILE when
+ * set, bcn_bench reads it back from there, and goes to stderr otherwise.
+ */
+static void
+write_output(const std::string &out)
+{
+	std::lock_guard<std::mutex> l(output_lock);
+	const char *path = getenv("BCN_PIPELINE_STATS_FILE");
+	FILE *file = path ? fopen(path, "a") : stderr;
+
+	if (!file) {
+		Logger::log("error", "Failed to open pipeline stats file %s", path);
+		return;
+	}
+
+	fputs(out.c_str(), file);
+
+	if (file != stderr)
+		fclose(file);
+	else
+		fflush(file);
+}
+
+static std::string
+format_statistic(const VkPipelineExecutableStatisticKHR &statistic)
+{
+	switch (statistic.format) {
+		case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_BOOL32_KHR:
+			return statistic.value.b32 ? "true" : "false";
+		case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR:
+			return std::to_string(statistic.value.i64);
+		case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR:
+			return std::to_string(statistic.value.u64);
+		case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_FLOAT64_KHR:
+			return std::to_string(statistic.value.f64);
+		default:
+			return "?";
+	}
+}
+
+/* Split into lines so every line of the shader disassembly is indented under its executable. */
+static void
+append_internal_representations(struct device *dev, const char *name, const VkPipelineExecutableInfoKHR &info,
+								std::string &out)
+{
+	VkLayerDispatchTable &table = dev->table;
+	uint32_t count = 0;
+
+	if (table.GetPipelineExecutableInternalRepresentationsKHR(dev->handle, &info, &count, nullptr) != VK_SUCCESS)
+		return;
+
+	std::vector<VkPipelineExecutableInternalRepresentationKHR> representations(count,
+		{ VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INTERNAL_REPRESENTATION_KHR });
+
+	/* Sizes first, then the data. */
+	table.GetPipelineExecutableInternalRepresentationsKHR(dev->handle, &info, &count, representations.data());
+
+	std::vector<std::vector<char>> data(count);
+	for (uint32_t i = 0; i < count; i++) {
+		data[i].resize(representations[i].dataSize + 1);
+		representations[i].pData = data[i].data();
+	}
+
+	if (table.GetPipelineExecutableInternalRepresentationsKHR(dev->handle, &info, &count, representations.data()) < 0)
+		return;
+
+	for (uint32_t i = 0; i < count; i++) {
+		append_line(out, "%s executable %u %s:", name, info.executableIndex, representations[i].name);
+
+		if (!representations[i].isText) {
+			append_line(out, "  (%zu bytes of binary data)", representations[i].dataSize);
+			continue;
+		}
+
+		std::string text(data[i].data(), strnlen(data[i].data(), representations[i].dataSize));
+		size_t start = 0;
+
+		while (start < text.size()) {
+			size_t end = text.find('\n', start);
+			if (end == std::string::npos)
+				end = text.size();
+
+			out += "  ";
+			out.append(text, start, end - start);
+			out += '\n';
+			start = end + 1;
+		}
+	}
+}
+
+/*
+ * Writes out what the compiler reports for every executable of a decode
+ * pipeline: register counts, spills, subgroup size, instruction counts,
+ * whichever statistics the driver exposes under its own names.
+ */
+void
+pipeline_stats_log(struct device *dev, const char *name, VkPipeline pipeline)
+{
+	VkLayerDispatchTable &table = dev->table;
+	uint32_t count = 0;
+	std::string out;
+
+	if (dev->pipeline_stats == BCN_PIPELINE_STATS_OFF || pipeline == VK_NULL_HANDLE)
+		return;
+
+	VkPipelineInfoKHR pipeline_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR,
+		.pNext = nullptr,
+		.pipeline = pipeline
+	};
+
+	if (table.GetPipelineExecutablePropertiesKHR(dev->handle, &pipeline_info, &count, nullptr) != VK_SUCCESS)
+		return;
+
+	std::vector<VkPipelineExecutablePropertiesKHR> executables(count,
+		{ VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR });
+
+	if (table.GetPipelineExecutablePropertiesKHR(dev->handle, &pipeline_info, &count, executables.data()) < 0) {
+		Logger::log("error", "Failed to get the executables of the %s pipeline", name);
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		VkPipelineExecutableInfoKHR info = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR,
+			.pNext = nullptr,
+			.pipeline = pipeline,
+			.executableIndex = i
+		};
+
+		append_line(out, "%s executable %u: %s, subgroup size %u", name, i, executables[i].name,
+			executables[i].subgroupSize);
+
+		uint32_t statisticCount = 0;
+		if (table.GetPipelineExecutableStatisticsKHR(dev->handle, &info, &statisticCount, nullptr) != VK_SUCCESS)
+			continue;
+
+		std::vector<VkPipelineExecutableStatisticKHR> statistics(statisticCount,
+			{ VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR });
+		table.GetPipelineExecutableStatisticsKHR(dev->handle, &info, &statisticCount, statistics.data());
+
+		for (uint32_t j = 0; j < statisticCount; j++)
+			append_line(out, "  %s: %s", statistics[j].name, format_statistic(statistics[j]).c_str());
+
+		if (dev->pipeline_stats == BCN_PIPELINE_STATS_INTERNAL)
+			append_internal_representations(dev, name, info, out);
+	}
+
+	/* One write per pipeline, families built concurrently do not interleave. */
+	write_output(out);
+}
@@ -0,0 +1,9 @@
+#ifndef __PIPELINE_STATS_HPP
+#define __PIPELINE_STATS_HPP
+
+#include "bcn_layer.hpp"
+
+VkPipelineCreateFlags pipeline_stats_flags(struct device *dev);
+void pipeline_stats_log(struct device *dev, const char *name, VkPipeline pipeline);
+
+#endif
@@ -0,0 +1,303 @@
+#include "profile.hpp"
+#include "command_buffer.hpp"
+#include "format.hpp"
+#include "census.hpp"
+
+#include <chrono>
+#include <map>
+
+/*
+ * Every decode the layer records is bracketed by a pair of timestamps from
+ * a ring of queries, and by a debug utils label when the application has
+ * them enabled. Results are read when the submission retires and folded
+ * into per format and per image statistics.
+ */
+#define PROFILE_PAIRS 512
+#define PROFILE_BUCKETS 16
+
+struct profile_pair {
+	VkFormat format;
+	VkExtent3D extent;
+	VkImage image;
+	uint64_t mask;
+};
+
+struct profile_stats {
+	uint64_t count;
+	uint64_t totalNs;
+	uint64_t maxNs;
+	uint64_t histogram[PROFILE_BUCKETS];
+};
+
+struct profile_image_stats {
+	VkFormat format;
+	VkExtent3D extent;
+	struct profile_stats stats;
+};
+
+struct profile_state {
+	VkQueryPool pool;
+	struct profile_pair pairs[PROFILE_PAIRS];
+	std::vector<uint32_t> freePairs;
+	double period;
+	std::map<VkFormat, struct profile_stats> formats;
+	std::unordered_map<VkImage, struct profile_image_stats> images;
+	const char *file;
+	std::chrono::steady_clock::time_point lastDump;
+};
+
+static std::mutex profile_lock;
+static std::unordered_map<struct device *, std::unique_ptr<struct profile_state>> profileMap;
+
+static struct profile_state *
+get_profile_state(struct device *dev)
+{
+	auto it = profileMap.find(dev);
+
+	if (it == profileMap.end())
+		return nullptr;
+
+	return it->second.get();
+}
+
+void
+profile_init(struct device *dev)
+{
+	VkResult result;
+	uint32_t validBits = 0;
+
+	/* Each decode still checks the family it is recorded for. */
+	for (const auto &family : dev->queueFamilies)
+		validBits = std::max(validBits, family.timestampValidBits);
+
+	if (!validBits) {
+		Logger::log("info", "Timestamps not supported, decode profiling disabled");
+		return;
+	}
+
+	auto state = std::make_unique<struct profile_state>();
+	state->period = dev->props2.properties.limits.timestampPeriod;
+	state->file = getenv("BCN_PROFILE_FILE");
+	state->lastDump = std::chrono::steady_clock::now();
+
+	VkQueryPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = PROFILE_PAIRS * 2,
+		.pipelineStatistics = 0
+	};
+
+	result = dev->table.CreateQueryPool(dev->handle, &pool_info, nullptr, &state->pool);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to create timestamp query pool, res %d", result);
+		return;
+	}
+
+	for (uint32_t i = 0; i < PROFILE_PAIRS; i++)
+		state->freePairs.push_back(PROFILE_PAIRS - 1 - i);
+
+	scoped_lock l(profile_lock);
+	profileMap[dev] = std::move(state);
+}
+
+static void
+add_sample(struct profile_stats &stats, uint64_t ns)
+{
+	uint32_t bucket = 0;
+
+	/* Power of two buckets starting at 1 us. */
+	for (uint64_t us = ns / 1000; us > 1 && bucket < PROFILE_BUCKETS - 1; us >>= 1)
+		bucket++;
+
+	stats.count++;
+	stats.totalNs += ns;
+	stats.maxNs = std::max(stats.maxNs, ns);
+	stats.histogram[bucket]++;
+}
+
+static void
+write_stats(FILE *f, const struct profile_stats &stats)
+{
+	fprintf(f, "count %llu total %.3f ms avg %.1f us max %.1f us |",
+		(unsigned long long)stats.count, stats.totalNs / 1e6,
+		stats.count ? stats.totalNs / 1e3 / stats.count : 0.0, stats.maxNs / 1e3);
+
+	for (uint32_t i = 0; i < PROFILE_BUCKETS; i++)
+		fprintf(f, " %llu", (unsigned long long)stats.histogram[i]);
+
+	fprintf(f, "\n");
+}
+
+static void
+dump_stats(struct profile_state *state, FILE *f)
+{
+	fprintf(f, "# histogram buckets: <2us, <4us, ... power of two\n");
+	fprintf(f, "[formats]\n");
+	for (const auto &it : state->formats) {
+		fprintf(f, "%-16s ", get_format_name(it.first));
+		write_stats(f, it.second);
+	}
+
+	fprintf(f, "[images]\n");
+	for (const auto &it : state->images) {
+		fprintf(f, "%p %-16s %ux%u ", (void *)it.first, get_format_name(it.second.format),
+			it.second.extent.width, it.second.extent.height);
+		write_stats(f, it.second.stats);
+	}
+}
+
+static void
+dump_file(struct profile_state *state)
+{
+	FILE *f = fopen(state->file, "w");
+	if (!f) {
+		Logger::log("error", "Failed to open profile file %s", state->file);
+		return;
+	}
+
+	dump_stats(state, f);
+	fclose(f);
+}
+
+/* Dumps the totals, to BCN_PROFILE_FILE if set, to the log otherwise. */
+void
+profile_destroy(struct device *dev)
+{
+	scoped_lock l(profile_lock);
+
+	struct profile_state *state = get_profile_state(dev);
+	if (!state)
+		return;
+
+	if (state->file) {
+		dump_file(state);
+	} else {
+		for (const auto &it : state->formats) {
+			const struct profile_stats &stats = it.second;
+			Logger::log("info", "Decode %s: %llu regions, %.3f ms GPU, max %.1f us", get_format_name(it.first),
+				(unsigned long long)stats.count, stats.totalNs / 1e6, stats.maxNs / 1e3);
+		}
+	}
+
+	dev->table.DestroyQueryPool(dev->handle, state->pool, nullptr);
+	profileMap.erase(dev);
+}
+
+/*
+ * Opens the label and writes the first timestamp of a decode. Returns the
+ * query pair to close it with, PROFILE_NO_QUERY if profiling is off or the
+ * ring is exhausted.
+ */
+uint32_t
+profile_begin(struct command_buffer *cb, VkFormat format, const VkExtent3D &extent, VkImage image)
+{
+	struct device *dev = cb->device;
+	uint32_t pair = PROFILE_NO_QUERY;
+
+	if (dev->table.CmdBeginDebugUtilsLabelEXT) {
+		char name[128];
+		snprintf(name, sizeof(name), "BCn decode %s %ux%u image %p", get_format_name(format),
+			extent.width, extent.height, (void *)image);
+
+		VkDebugUtilsLabelEXT label = {
+			.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,
+			.pNext = nullptr,
+			.pLabelName = name,
+			.color = { 0.0f, 0.5f, 1.0f, 1.0f }
+		};
+		dev->table.CmdBeginDebugUtilsLabelEXT(cb->handle, &label);
+	}
+
+	if (!dev->use_profile)
+		return pair;
+
+	{
+		scoped_lock l(profile_lock);
+
+		/*
+		 * Timestamps only exist on families with valid bits, and query
+		 * resets need a graphics or compute queue.
+		 */
+		const VkQueueFamilyProperties *family = command_buffer_queue_family(cb);
+		bool resettable = family && (family->queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+		uint32_t validBits = resettable ? family->timestampValidBits : 0;
+
+		struct profile_state *state = get_profile_state(dev);
+		if (!state || state->freePairs.empty() || !validBits)
+			return pair;
+
+		pair = state->freePairs.back();
+		state->freePairs.pop_back();
+		state->pairs[pair] = { format, extent, image, validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1 };
+
+		dev->table.CmdResetQueryPool(cb->handle, state->pool, pair * 2, 2);
+		dev->table.CmdWriteTimestamp(cb->handle, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, state->pool, pair * 2);
+	}
+
+	return pair;
+}
+
+void
+profile_end(struct command_buffer *cb, uint32_t pair)
+{
+	struct device *dev = cb->device;
+
+	if (pair != PROFILE_NO_QUERY) {
+		scoped_lock l(profile_lock);
+
+		struct profile_state *state = get_profile_state(dev);
+		if (state) {
+			dev->table.CmdWriteTimestamp(cb->handle, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, state->pool, pair * 2 + 1);
+			cb->transients.queries.push_back(pair);
+		}
+	}
+
+	if (dev->table.CmdEndDebugUtilsLabelEXT)
+		dev->table.CmdEndDebugUtilsLabelEXT(cb->handle);
+}
+
+/*
+ * Reads the timestamps of retired decodes and gives their pairs back to the
+ * ring. Pairs of recordings that were never submitted have no results.
+ */
+void
+profile_collect(struct device *dev, std::vector<uint32_t> &pairs)
+{
+	scoped_lock l(profile_lock);
+
+	struct profile_state *state = get_profile_state(dev);
+	if (!state)
+		return;
+
+	for (uint32_t pair : pairs) {
+		uint64_t results[2];
+		VkResult result = dev->table.GetQueryPoolResults(dev->handle, state->pool, pair * 2, 2,
+			sizeof(results), results, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+		if (result == VK_SUCCESS) {
+			const struct profile_pair &info = state->pairs[pair];
+			uint64_t ns = (uint64_t)(((results[1] - results[0]) & info.mask) * state->period);
+
+			add_sample(state->formats[info.format], ns);
+
+			struct profile_image_stats &image = state->images[info.image];
+			image.format = info.format;
+			image.extent = info.extent;
+			add_sample(image.stats, ns);
+
+			if (dev->use_census)
+				census_record_time(dev, info.image, ns);
+		}
+
+		state->freePairs.push_back(pair);
+	}
+
+	pairs.clear();
+
+	if (state->file && std::chrono::steady_clock::now() - state->lastDump > std::chrono::seconds(1)) {
+		dump_file(state);
+		state->lastDump = std::chrono::steady_clock::now();
+	}
+}
@@ -0,0 +1,16 @@
+#ifndef __PROFILE_HPP
+#define __PROFILE_HPP
+
+#include "bcn_layer.hpp"
+
+struct command_buffer;
+
+#define PROFILE_NO_QUERY UINT32_MAX
+
+void profile_init(struct device *dev);
+void profile_destroy(struct device *dev);
+uint32_t profile_begin(struct command_buffer *cb, VkFormat format, const VkExtent3D &extent, VkImage image);
+void profile_end(struct command_buffer *cb, uint32_t pair);
+void profile_collect(struct device *dev, std::vector<uint32_t> &pairs);
+
+#endif
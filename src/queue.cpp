@@ -1,5 +1,11 @@
 #include "queue.hpp"
 #include "command_buffer.hpp"
+#include "retire.hpp"
+#include "lazy.hpp"
+#include "linear.hpp"
+#include "capture.hpp"
+
+#include <algorithm>
 
 std::unordered_map<VkQueue, std::shared_ptr<struct queue>> queuesMap;
 
@@ -12,6 +18,20 @@ get_queue(VkQueue queue) {
 	return it->second.get();
 }
 
+static void
+register_queue(struct device *dev, VkQueue handle, uint32_t family)
+{
+	if (handle == VK_NULL_HANDLE)
+		return;
+
+	auto queue = std::make_shared<struct queue>();
+	queue->handle = handle;
+	queue->device = dev;
+	queue->family = family;
+
+	queuesMap[handle] = queue;
+}
+
 VK_LAYER_EXPORT void VKAPI_CALL
 BCnLayer_GetDeviceQueue(VkDevice device,
 						uint32_t queueFamilyIndex,
@@ -23,11 +43,135 @@ BCnLayer_GetDeviceQueue(VkDevice device,
 	struct device *dev = get_device(device);
 	dev->table.GetDeviceQueue(device, queueFamilyIndex, queueIndex, pQueue);
 
-	auto queue = std::make_shared<struct queue>();
-	queue->handle = *pQueue;
-	queue->device = dev;
+	register_queue(dev, *pQueue, queueFamilyIndex);
+}
+
+/* Protected queues only come from here, they are submitted to like any other. */
+VK_LAYER_EXPORT void VKAPI_CALL
+BCnLayer_GetDeviceQueue2(VkDevice device,
+						 const VkDeviceQueueInfo2 *pQueueInfo,
+						 VkQueue *pQueue)
+{
+	scoped_lock l(global_lock);
+
+	struct device *dev = get_device(device);
+	dev->table.GetDeviceQueue2(device, pQueueInfo, pQueue);
+
+	register_queue(dev, *pQueue, pQueueInfo->queueFamilyIndex);
+}
+
+/*
+ * Places the layer command buffer right after the given one of the batch,
+ * or at the start of the first submission when it is VK_NULL_HANDLE.
+ */
+static void
+insert_command_buffer(uint32_t submitInfoCount,
+					  const VkSubmitInfo *pSubmitInfos,
+					  VkCommandBuffer after,
+					  const VkCommandBuffer *layerCommandBuffer,
+					  std::vector<VkSubmitInfo> &submits,
+					  std::vector<VkCommandBuffer> &commandBuffers)
+{
+	submits.assign(pSubmitInfos, pSubmitInfos + submitInfoCount);
+
+	if (submits.empty()) {
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = layerCommandBuffer;
+		submits.push_back(submit);
+		return;
+	}
+
+	uint32_t index = 0;
+	size_t position = 0;
+
+	for (uint32_t i = 0; i < submitInfoCount && after != VK_NULL_HANDLE; i++) {
+		const VkCommandBuffer *begin = pSubmitInfos[i].pCommandBuffers;
+		const VkCommandBuffer *end = begin + pSubmitInfos[i].commandBufferCount;
+		const VkCommandBuffer *it = std::find(begin, end, after);
+
+		if (it != end) {
+			index = i;
+			position = it - begin + 1;
+		}
+	}
+
+	commandBuffers.assign(submits[index].pCommandBuffers, submits[index].pCommandBuffers + submits[index].commandBufferCount);
+	commandBuffers.insert(commandBuffers.begin() + position, *layerCommandBuffer);
+	submits[index].commandBufferCount = commandBuffers.size();
+	submits[index].pCommandBuffers = commandBuffers.data();
+}
+
+static void
+insert_command_buffer2(uint32_t submitCount,
+					   const VkSubmitInfo2 *pSubmits,
+					   VkCommandBuffer after,
+					   const VkCommandBufferSubmitInfo *layerCommandBuffer,
+					   std::vector<VkSubmitInfo2> &submits,
+					   std::vector<VkCommandBufferSubmitInfo> &commandBuffers)
+{
+	submits.assign(pSubmits, pSubmits + submitCount);
+
+	if (submits.empty()) {
+		VkSubmitInfo2 submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO_2 };
+		submit.commandBufferInfoCount = 1;
+		submit.pCommandBufferInfos = layerCommandBuffer;
+		submits.push_back(submit);
+		return;
+	}
 
-	queuesMap[*pQueue] = queue;
+	uint32_t index = 0;
+	size_t position = 0;
+
+	for (uint32_t i = 0; i < submitCount && after != VK_NULL_HANDLE; i++) {
+		for (uint32_t j = 0; j < pSubmits[i].commandBufferInfoCount; j++) {
+			if (pSubmits[i].pCommandBufferInfos[j].commandBuffer == after) {
+				index = i;
+				position = j + 1;
+			}
+		}
+	}
+
+	commandBuffers.assign(submits[index].pCommandBufferInfos, submits[index].pCommandBufferInfos + submits[index].commandBufferInfoCount);
+	commandBuffers.insert(commandBuffers.begin() + position, *layerCommandBuffer);
+	submits[index].commandBufferInfoCount = commandBuffers.size();
+	submits[index].pCommandBufferInfos = commandBuffers.data();
+}
+
+/*
+ * An empty batch at the end of the submission signals the queue timeline
+ * of the retire signal. A signal covers everything earlier in submission
+ * order, the batches before it in the same call included.
+ */
+static void
+append_timeline_batch(const struct retire_signal &signal,
+					  VkTimelineSemaphoreSubmitInfo *timeline,
+					  std::vector<VkSubmitInfo> &submits)
+{
+	*timeline = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+	timeline->signalSemaphoreValueCount = 1;
+	timeline->pSignalSemaphoreValues = &signal.serial;
+
+	VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO, timeline };
+	submit.signalSemaphoreCount = 1;
+	submit.pSignalSemaphores = &signal.semaphore;
+	submits.push_back(submit);
+}
+
+static void
+append_timeline_batch2(const struct retire_signal &signal,
+					   VkSemaphoreSubmitInfo *semaphore,
+					   std::vector<VkSubmitInfo2> &submits)
+{
+	*semaphore = { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO };
+	semaphore->semaphore = signal.semaphore;
+	semaphore->value = signal.serial;
+	semaphore->stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+	VkSubmitInfo2 submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO_2 };
+	submit.signalSemaphoreInfoCount = 1;
+	submit.pSignalSemaphoreInfos = semaphore;
+	submits.push_back(submit);
 }
 
 VK_LAYER_EXPORT VkResult VKAPI_CALL
@@ -36,18 +180,196 @@ BCnLayer_QueueSubmit(VkQueue queue,
 					 const VkSubmitInfo *pSubmitInfos,
 					 VkFence fence)
 {
+	VkResult result;
+	bool transients = false;
+	trace_span span(TRACE_QUEUE_SUBMIT, (uint64_t)queue, submitInfoCount);
+
 	scoped_lock l(global_lock);
 
+	/* Queues the layer did not hand out are passed through untouched. */
 	struct queue *q = get_queue(queue);
-	struct fence *f = get_fence(fence);
+	if (!q)
+		return get_queue_device(queue)->table.QueueSubmit(queue, submitInfoCount, pSubmitInfos, fence);
+
+	struct device *dev = q->device;
+
+	retire_reap(dev);
+	linear_flush_all(dev);
+
+	std::vector<VkCommandBuffer> batch;
 
 	for (uint32_t i = 0; i < submitInfoCount; i++) {
-		VkSubmitInfo submit_info = pSubmitInfos[i];
-		for (uint32_t j = 0; j < submit_info.commandBufferCount; j++) {
-			struct command_buffer *cb = get_command_buffer(submit_info.pCommandBuffers[j]);
-			cb->fence = f;
+		for (uint32_t j = 0; j < pSubmitInfos[i].commandBufferCount; j++) {
+			struct command_buffer *cb = get_command_buffer(pSubmitInfos[i].pCommandBuffers[j]);
+			transients |= cb && command_buffer_has_transients(cb);
+			batch.push_back(pSubmitInfos[i].pCommandBuffers[j]);
+		}
+	}
+
+	std::unique_ptr<struct command_buffer> lazy;
+	std::vector<VkSubmitInfo> submits;
+	std::vector<VkCommandBuffer> commandBuffers;
+	VkTimelineSemaphoreSubmitInfo timeline;
+	struct retire_signal signal = {};
+	VkCommandBuffer after;
+
+	if (dev->use_lazy)
+		lazy = lazy_record(dev, q, batch, &after);
+
+	if (transients || lazy)
+		retire_prepare(dev, queue, fence, &signal);
+
+	if (lazy || signal.semaphore) {
+		if (lazy)
+			insert_command_buffer(submitInfoCount, pSubmitInfos, after, &lazy->handle, submits, commandBuffers);
+		else
+			submits.assign(pSubmitInfos, pSubmitInfos + submitInfoCount);
+
+		if (signal.semaphore)
+			append_timeline_batch(signal, &timeline, submits);
+
+		result = dev->table.QueueSubmit(queue, submits.size(), submits.data(), signal.fence ? signal.fence : fence);
+	} else {
+		result = dev->table.QueueSubmit(queue, submitInfoCount, pSubmitInfos, signal.fence ? signal.fence : fence);
+	}
+
+	if (lazy && result != VK_SUCCESS)
+		lazy_submitted(dev, std::move(lazy), 0);
+
+	uint64_t serial = retire_submitted(dev, queue, signal, result == VK_SUCCESS);
+
+	if (result != VK_SUCCESS)
+		return result;
+
+	if (lazy)
+		lazy_submitted(dev, std::move(lazy), serial);
+
+	for (VkCommandBuffer handle : batch) {
+		struct command_buffer *cb = get_command_buffer(handle);
+		if (cb)
+			command_buffer_submitted(cb, serial);
+	}
+
+	return result;
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_QueueSubmit2(VkQueue queue,
+					  uint32_t submitCount,
+					  const VkSubmitInfo2 *pSubmits,
+					  VkFence fence)
+{
+	VkResult result;
+	bool transients = false;
+	trace_span span(TRACE_QUEUE_SUBMIT, (uint64_t)queue, submitCount);
+
+	scoped_lock l(global_lock);
+
+	struct queue *q = get_queue(queue);
+	if (!q)
+		return get_queue_device(queue)->table.QueueSubmit2(queue, submitCount, pSubmits, fence);
+
+	struct device *dev = q->device;
+
+	retire_reap(dev);
+	linear_flush_all(dev);
+
+	std::vector<VkCommandBuffer> batch;
+
+	for (uint32_t i = 0; i < submitCount; i++) {
+		for (uint32_t j = 0; j < pSubmits[i].commandBufferInfoCount; j++) {
+			struct command_buffer *cb = get_command_buffer(pSubmits[i].pCommandBufferInfos[j].commandBuffer);
+			transients |= cb && command_buffer_has_transients(cb);
+			batch.push_back(pSubmits[i].pCommandBufferInfos[j].commandBuffer);
+		}
+	}
+
+	std::unique_ptr<struct command_buffer> lazy;
+	std::vector<VkSubmitInfo2> submits;
+	std::vector<VkCommandBufferSubmitInfo> commandBuffers;
+	VkCommandBufferSubmitInfo info = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO };
+	VkSemaphoreSubmitInfo timeline;
+	struct retire_signal signal = {};
+	VkCommandBuffer after;
+
+	if (dev->use_lazy)
+		lazy = lazy_record(dev, q, batch, &after);
+
+	if (transients || lazy)
+		retire_prepare(dev, queue, fence, &signal);
+
+	if (lazy || signal.semaphore) {
+		if (lazy) {
+			info.commandBuffer = lazy->handle;
+			insert_command_buffer2(submitCount, pSubmits, after, &info, submits, commandBuffers);
+		} else {
+			submits.assign(pSubmits, pSubmits + submitCount);
 		}
+
+		if (signal.semaphore)
+			append_timeline_batch2(signal, &timeline, submits);
+
+		result = dev->table.QueueSubmit2(queue, submits.size(), submits.data(), signal.fence ? signal.fence : fence);
+	} else {
+		result = dev->table.QueueSubmit2(queue, submitCount, pSubmits, signal.fence ? signal.fence : fence);
+	}
+
+	if (lazy && result != VK_SUCCESS)
+		lazy_submitted(dev, std::move(lazy), 0);
+
+	uint64_t serial = retire_submitted(dev, queue, signal, result == VK_SUCCESS);
+
+	if (result != VK_SUCCESS)
+		return result;
+
+	if (lazy)
+		lazy_submitted(dev, std::move(lazy), serial);
+
+	for (VkCommandBuffer handle : batch) {
+		struct command_buffer *cb = get_command_buffer(handle);
+		if (cb)
+			command_buffer_submitted(cb, serial);
 	}
 
-	return q->device->table.QueueSubmit(queue, submitInfoCount, pSubmitInfos, fence);
+	return result;
+}
+
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_QueueWaitIdle(VkQueue queue)
+{
+	VkResult result;
+
+	/* Found through the dispatch key, queues the layer did not hand out are waited on too. */
+	struct device *dev;
+	{
+		scoped_lock l(global_lock);
+		dev = get_queue_device(queue);
+	}
+
+	result = dev->table.QueueWaitIdle(queue);
+	if (result == VK_SUCCESS)
+		retire_reap(dev);
+
+	return result;
+}
+
+/* Only intercepted while capturing, presents mark the frame boundaries. */
+VK_LAYER_EXPORT VkResult VKAPI_CALL
+BCnLayer_QueuePresentKHR(VkQueue queue,
+						 const VkPresentInfoKHR *pPresentInfo)
+{
+	struct queue *q;
+	struct device *dev;
+	{
+		scoped_lock l(global_lock);
+		q = get_queue(queue);
+		dev = get_queue_device(queue);
+	}
+
+	if (!q)
+		return dev->table.QueuePresentKHR(queue, pPresentInfo);
+
+	capture_write_frame(q->device);
+
+	return q->device->table.QueuePresentKHR(queue, pPresentInfo);
 }
@@ -2,11 +2,11 @@
 #define __QUEUE_HPP
 
 #include "bcn_layer.hpp"
-#include "fence.hpp"
 
 struct queue {
 	VkQueue handle;
 	struct device *device;
+	uint32_t family;
 };
 
 struct queue *get_queue(VkQueue queue);
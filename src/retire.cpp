@@ -0,0 +1,354 @@
+#include "retire.hpp"
+#include "bcn.hpp"
+#include "cache.hpp"
+#include "profile.hpp"
+
+#include <deque>
+
+/* A submission carrying layer work, with the layer fence or queue timeline that signals its completion. */
+struct retire_point {
+	uint64_t serial;
+	VkFence fence;
+	VkSemaphore semaphore;
+};
+
+/* Resources waiting for a submission serial to complete. */
+struct retire_garbage {
+	uint64_t serial;
+	struct transient_resources res;
+};
+
+struct retire_state {
+	uint64_t nextSerial;
+	uint64_t completed;
+	std::deque<struct retire_point> pending;
+	std::vector<struct retire_garbage> garbage;
+	std::vector<VkFence> freeFences;
+	std::unordered_map<VkQueue, VkSemaphore> timelines;
+};
+
+static std::mutex retire_lock;
+static std::unordered_map<struct device *, std::unique_ptr<struct retire_state>> retireMap;
+
+static struct retire_state *
+get_retire_state(struct device *dev)
+{
+	auto it = retireMap.find(dev);
+
+	if (it == retireMap.end())
+		return nullptr;
+
+	return it->second.get();
+}
+
+/* Hands a decoded staging buffer to the texture cache once the GPU is done with it, the cache copies it and writes it out in the background. */
+static void
+store_staging_buffer(struct device *dev, struct buffer *buf)
+{
+	void *data;
+
+	if (dev->table.MapMemory(dev->handle, buf->memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+		return;
+
+	VkMappedMemoryRange range = {
+		.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+		.pNext = nullptr,
+		.memory = buf->memory,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	};
+	dev->table.InvalidateMappedMemoryRanges(dev->handle, 1, &range);
+
+	cache_store(buf->cache_key, data, buf->size);
+	dev->table.UnmapMemory(dev->handle, buf->memory);
+}
+
+static void
+free_resources(struct device *dev, struct transient_resources &res)
+{
+	for (auto &buf : res.buffers) {
+		if (buf->cache_pending)
+			store_staging_buffer(dev, buf.get());
+		release_staging_buffer(dev, std::move(buf));
+	}
+
+	if (!res.descriptorSets.empty())
+		free_bcn_descriptor_sets(dev, res.descriptorSets);
+
+	for (VkImageView view : res.imageViews)
+		dev->table.DestroyImageView(dev->handle, view, nullptr);
+
+	if (!res.queries.empty())
+		profile_collect(dev, res.queries);
+
+	res.buffers.clear();
+	res.sharedBuffers.clear();
+	res.descriptorSets.clear();
+	res.imageViews.clear();
+}
+
+/*
+ * Advances the completed serial past every signalled layer fence, in
+ * submission order, then frees all the garbage it covers in one go.
+ */
+static void
+reap_locked(struct device *dev, struct retire_state *state)
+{
+	while (!state->pending.empty()) {
+		struct retire_point &point = state->pending.front();
+
+		if (point.semaphore) {
+			uint64_t value = 0;
+
+			if (dev->table.GetSemaphoreCounterValue(dev->handle, point.semaphore, &value) != VK_SUCCESS ||
+				value < point.serial)
+				break;
+		} else {
+			if (dev->table.GetFenceStatus(dev->handle, point.fence) != VK_SUCCESS)
+				break;
+
+			dev->table.ResetFences(dev->handle, 1, &point.fence);
+			state->freeFences.push_back(point.fence);
+		}
+
+		state->completed = point.serial;
+		state->pending.pop_front();
+	}
+
+	for (auto it = state->garbage.begin(); it != state->garbage.end();) {
+		if (it->serial > state->completed) {
+			++it;
+			continue;
+		}
+
+		free_resources(dev, it->res);
+		it = state->garbage.erase(it);
+	}
+}
+
+void
+retire_init(struct device *dev)
+{
+	auto state = std::make_unique<struct retire_state>();
+	state->nextSerial = 1;
+	state->completed = 0;
+
+	scoped_lock l(retire_lock);
+	retireMap[dev] = std::move(state);
+}
+
+/* Frees everything left, the device must be idle. */
+void
+retire_destroy(struct device *dev)
+{
+	scoped_lock l(retire_lock);
+
+	struct retire_state *state = get_retire_state(dev);
+	if (!state)
+		return;
+
+	reap_locked(dev, state);
+
+	for (auto &garbage : state->garbage)
+		free_resources(dev, garbage.res);
+
+	for (const auto &point : state->pending) {
+		if (point.fence)
+			dev->table.DestroyFence(dev->handle, point.fence, nullptr);
+	}
+
+	for (VkFence fence : state->freeFences)
+		dev->table.DestroyFence(dev->handle, fence, nullptr);
+
+	for (const auto &timeline : state->timelines)
+		dev->table.DestroySemaphore(dev->handle, timeline.second, nullptr);
+
+	retireMap.erase(dev);
+}
+
+static VkFence
+take_fence(struct device *dev, struct retire_state *state)
+{
+	VkFence fence;
+
+	if (!state->freeFences.empty()) {
+		fence = state->freeFences.back();
+		state->freeFences.pop_back();
+		return fence;
+	}
+
+	VkFenceCreateInfo fence_info = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0
+	};
+
+	VkResult result = dev->table.CreateFence(dev->handle, &fence_info, nullptr, &fence);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to create retirement fence, res %d", result);
+		return VK_NULL_HANDLE;
+	}
+
+	return fence;
+}
+
+/*
+ * One timeline per queue: serials only grow in submission order, which
+ * is execution order for the signals of a single queue only.
+ */
+static VkSemaphore
+get_timeline(struct device *dev, struct retire_state *state, VkQueue queue)
+{
+	auto it = state->timelines.find(queue);
+	if (it != state->timelines.end())
+		return it->second;
+
+	VkSemaphoreTypeCreateInfo type_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.pNext = nullptr,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0
+	};
+
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &type_info,
+		.flags = 0
+	};
+
+	VkSemaphore semaphore;
+	VkResult result = dev->table.CreateSemaphore(dev->handle, &semaphore_info, nullptr, &semaphore);
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to create retirement timeline, res %d", result);
+		return VK_NULL_HANDLE;
+	}
+
+	state->timelines[queue] = semaphore;
+
+	return semaphore;
+}
+
+/*
+ * Called right before the application's submission of work that references
+ * layer resources, with the fence the application passes. Without one the
+ * layer fence takes its place, with one the caller appends a batch that
+ * signals the queue timeline to signal->serial. Both are part of the
+ * application's own vkQueueSubmit.
+ */
+void
+retire_prepare(struct device *dev, VkQueue queue, VkFence fence, struct retire_signal *signal)
+{
+	scoped_lock l(retire_lock);
+
+	*signal = {};
+
+	struct retire_state *state = get_retire_state(dev);
+	if (!state)
+		return;
+
+	signal->serial = state->nextSerial++;
+
+	if (fence == VK_NULL_HANDLE)
+		signal->fence = take_fence(dev, state);
+	else if (dev->use_timeline)
+		signal->semaphore = get_timeline(dev, state, queue);
+}
+
+/*
+ * Called once the submission returned, returns the serial to tag the
+ * submitted command buffers with, 0 if nothing was submitted. When neither
+ * a fence nor a timeline could ride along, an empty submission with a layer
+ * fence signals once everything before it on the queue has completed.
+ */
+uint64_t
+retire_submitted(struct device *dev, VkQueue queue, const struct retire_signal &signal, bool submitted)
+{
+	VkResult result;
+
+	scoped_lock l(retire_lock);
+
+	struct retire_state *state = get_retire_state(dev);
+	if (!state || !signal.serial)
+		return 0;
+
+	if (!submitted) {
+		if (signal.fence)
+			state->freeFences.push_back(signal.fence);
+		return 0;
+	}
+
+	if (signal.fence || signal.semaphore) {
+		state->pending.push_back({ signal.serial, signal.fence, signal.semaphore });
+		return signal.serial;
+	}
+
+	VkFence fence = take_fence(dev, state);
+
+	result = fence ? dev->table.QueueSubmit(queue, 0, nullptr, fence) : VK_ERROR_OUT_OF_HOST_MEMORY;
+	if (result != VK_SUCCESS) {
+		Logger::log("error", "Failed to submit retirement fence, res %d", result);
+		if (fence)
+			state->freeFences.push_back(fence);
+
+		/* Nothing will tell when this one completes, wait for it here. */
+		dev->table.QueueWaitIdle(queue);
+		if (state->pending.empty())
+			state->completed = signal.serial;
+		return signal.serial;
+	}
+
+	state->pending.push_back({ signal.serial, fence, VK_NULL_HANDLE });
+
+	return signal.serial;
+}
+
+/*
+ * Hands over the resources of a command buffer recording that is being
+ * reset or freed. They are freed right away if the recording was never
+ * submitted, once submission serial completes otherwise.
+ */
+void
+retire_resources(struct device *dev, uint64_t serial, struct transient_resources &res)
+{
+	if (transient_resources_empty(res))
+		return;
+
+	scoped_lock l(retire_lock);
+
+	struct retire_state *state = get_retire_state(dev);
+	if (!state)
+		return;
+
+	if (serial <= state->completed) {
+		free_resources(dev, res);
+		return;
+	}
+
+	state->garbage.push_back({ serial, std::move(res) });
+	res = {};
+}
+
+void
+retire_reap(struct device *dev)
+{
+	scoped_lock l(retire_lock);
+
+	struct retire_state *state = get_retire_state(dev);
+	if (state)
+		reap_locked(dev, state);
+}
+
+/* Whether the submission tagged with serial has completed on the GPU. */
+bool
+retire_completed(struct device *dev, uint64_t serial)
+{
+	scoped_lock l(retire_lock);
+
+	struct retire_state *state = get_retire_state(dev);
+	if (!state)
+		return true;
+
+	reap_locked(dev, state);
+
+	return serial <= state->completed;
+}
@@ -0,0 +1,47 @@
+#ifndef __RETIRE_HPP
+#define __RETIRE_HPP
+
+#include "bcn_layer.hpp"
+#include "buffer.hpp"
+
+/*
+ * Layer owned objects a command buffer recording refers to. They live as
+ * long as the recording and are freed once the last submission of it has
+ * completed.
+ */
+struct transient_resources {
+	std::vector<std::unique_ptr<struct buffer>> buffers;
+	std::vector<std::shared_ptr<struct buffer>> sharedBuffers;
+	std::vector<std::pair<VkDescriptorPool, VkDescriptorSet>> descriptorSets;
+	std::vector<VkImageView> imageViews;
+	std::vector<uint32_t> queries;
+};
+
+static inline bool
+transient_resources_empty(const struct transient_resources &res)
+{
+	return res.buffers.empty() && res.sharedBuffers.empty() && res.descriptorSets.empty() &&
+		res.imageViews.empty() && res.queries.empty();
+}
+
+/*
+ * How the layer learns that a submission carrying layer work completed,
+ * decided before the submission is made: a layer fence passed in place of
+ * the application's missing one, or a timeline semaphore signalled to the
+ * serial by a batch appended to the submission.
+ */
+struct retire_signal {
+	uint64_t serial;
+	VkFence fence;
+	VkSemaphore semaphore;
+};
+
+void retire_init(struct device *dev);
+void retire_destroy(struct device *dev);
+void retire_prepare(struct device *dev, VkQueue queue, VkFence fence, struct retire_signal *signal);
+uint64_t retire_submitted(struct device *dev, VkQueue queue, const struct retire_signal &signal, bool submitted);
+void retire_resources(struct device *dev, uint64_t serial, struct transient_resources &res);
+void retire_reap(struct device *dev);
+bool retire_completed(struct device *dev, uint64_t serial);
+
+#endif
@@ -0,0 +1,278 @@
+#include "shadow.hpp"
+#include "image.hpp"
+#include "command_buffer.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+/* Uploads to one image may be recorded from several threads. */
+static std::mutex shadow_lock;
+static std::atomic<uint64_t> shadow_generation(1);
+
+static uint64_t
+get_shadow_key(uint32_t mipLevel, uint32_t arrayLayer)
+{
+	return (uint64_t)mipLevel << 32 | arrayLayer;
+}
+
+/* Generations and image epochs come from one counter, 0 means no shadow. */
+uint64_t
+shadow_new_generation()
+{
+	return shadow_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * The shadow a recording works against: the submitted one as it was when
+ * the recording first touched the subresource, plus its own uploads. The
+ * two share the rows the recording leaves alone.
+ */
+static struct shadow_staged &
+get_staged(struct command_buffer *cb, struct image *img, uint64_t key)
+{
+	auto it = cb->shadows.find({ img->handle, key });
+	if (it != cb->shadows.end() && it->second.epoch == img->shadowEpoch)
+		return it->second;
+
+	struct shadow_staged &staged = cb->shadows[{ img->handle, key }];
+	staged = {};
+	staged.epoch = img->shadowEpoch;
+
+	std::lock_guard<std::mutex> l(shadow_lock);
+
+	auto committed = img->shadows.find(key);
+	if (committed != img->shadows.end()) {
+		staged.shadow = committed->second;
+		staged.base = committed->second.generation;
+	}
+
+	return staged;
+}
+
+/*
+ * Coalesces the changed blocks into rectangles: runs of changed blocks on
+ * each block row, merged with the run right above when they span the same
+ * columns.
+ */
+static void
+coalesce(const std::vector<uint8_t> &changed, uint32_t blocksX, uint32_t blocksY, std::vector<VkRect2D> *dirty)
+{
+	std::vector<size_t> open;
+
+	for (uint32_t y = 0; y < blocksY; y++) {
+		std::vector<size_t> next;
+		uint32_t x = 0;
+
+		while (x < blocksX) {
+			if (!changed[y * blocksX + x]) {
+				x++;
+				continue;
+			}
+
+			uint32_t start = x;
+			while (x < blocksX && changed[y * blocksX + x])
+				x++;
+
+			auto it = std::find_if(open.begin(), open.end(), [&](size_t i) {
+				const VkRect2D &r = (*dirty)[i];
+				return (uint32_t)r.offset.x == start && r.extent.width == x - start;
+			});
+
+			if (it != open.end()) {
+				(*dirty)[*it].extent.height++;
+				next.push_back(*it);
+			}
+			else {
+				dirty->push_back({ { (int32_t)start, (int32_t)y }, { x - start, 1 } });
+				next.push_back(dirty->size() - 1);
+			}
+		}
+
+		open = std::move(next);
+	}
+}
+
+/*
+ * Compares the uploaded blocks against the shadow the recording works
+ * against and records them there. Returns true when every block of the
+ * region is held by the image by the time the copy runs, in which case
+ * dirty receives the changed blocks as rectangles in block units relative
+ * to the region. Otherwise the region has to be decoded in full.
+ */
+bool
+shadow_diff(struct command_buffer *cb, struct image *img, const VkBufferImageCopy &region, const uint8_t *src,
+			VkDeviceSize srcRowPitch, std::vector<VkRect2D> *dirty)
+{
+	uint32_t mipLevel = region.imageSubresource.mipLevel;
+	uint32_t blockSize = get_block_size(img->format);
+	uint32_t regionX = region.imageOffset.x / 4;
+	uint32_t regionY = region.imageOffset.y / 4;
+	uint32_t regionW = (region.imageExtent.width + 3) / 4;
+	uint32_t regionH = (region.imageExtent.height + 3) / 4;
+	bool complete = true;
+
+	std::vector<uint8_t> changed(regionW * regionH);
+
+	struct shadow_staged &staged = get_staged(cb, img, get_shadow_key(mipLevel, region.imageSubresource.baseArrayLayer));
+	struct shadow_subresource &shadow = staged.shadow;
+
+	if (shadow.rows.empty()) {
+		shadow.blocksX = (std::max(img->extent.width >> mipLevel, 1u) + 3) / 4;
+		shadow.blocksY = (std::max(img->extent.height >> mipLevel, 1u) + 3) / 4;
+
+		auto blank = std::make_shared<struct shadow_row>();
+		blank->blocks.resize((size_t)shadow.blocksX * blockSize);
+		blank->valid.resize(shadow.blocksX);
+		shadow.rows.assign(shadow.blocksY, blank);
+	}
+
+	if (regionX + regionW > shadow.blocksX || regionY + regionH > shadow.blocksY)
+		return false;
+
+	for (uint32_t y = 0; y < regionH; y++) {
+		const uint8_t *srcRow = src + y * srcRowPitch;
+		std::shared_ptr<struct shadow_row> &row = shadow.rows[regionY + y];
+		const uint8_t *shadowRow = row->blocks.data() + (size_t)regionX * blockSize;
+		const uint8_t *valid = row->valid.data() + regionX;
+		bool rowValid = true;
+
+		/* Fast path for rows that did not change at all. */
+		bool same = !memcmp(shadowRow, srcRow, (size_t)regionW * blockSize);
+
+		for (uint32_t x = 0; x < regionW; x++) {
+			if (!same)
+				changed[y * regionW + x] = memcmp(shadowRow + x * blockSize, srcRow + x * blockSize, blockSize) != 0;
+			rowValid &= valid[x] != 0;
+		}
+
+		complete &= rowValid;
+		if (same && rowValid)
+			continue;
+
+		/* Rows still shared with other shadows are copied before the first change. */
+		if (row.use_count() > 1)
+			row = std::make_shared<struct shadow_row>(*row);
+
+		if (!same)
+			memcpy(row->blocks.data() + (size_t)regionX * blockSize, srcRow, (size_t)regionW * blockSize);
+		memset(row->valid.data() + regionX, 1, regionW);
+	}
+
+	if (!complete)
+		return false;
+
+	coalesce(changed, regionW, regionH, dirty);
+	return true;
+}
+
+static bool
+in_range(uint64_t key, const VkImageSubresourceRange &range)
+{
+	uint32_t levelEnd = range.levelCount == VK_REMAINING_MIP_LEVELS ? UINT32_MAX : range.baseMipLevel + range.levelCount;
+	uint32_t layerEnd = range.layerCount == VK_REMAINING_ARRAY_LAYERS ? UINT32_MAX : range.baseArrayLayer + range.layerCount;
+	uint32_t mipLevel = key >> 32;
+	uint32_t arrayLayer = key & 0xffffffff;
+
+	return mipLevel >= range.baseMipLevel && mipLevel < levelEnd &&
+		arrayLayer >= range.baseArrayLayer && arrayLayer < layerEnd;
+}
+
+/*
+ * The decoded contents of these subresources are no longer known once the
+ * recording runs. The submitted shadows are dropped right away as well, so
+ * recordings made in the meantime do not build on them.
+ */
+void
+shadow_discard(struct command_buffer *cb, struct image *img, const VkImageSubresourceRange &range)
+{
+	std::vector<uint64_t> keys;
+
+	{
+		std::lock_guard<std::mutex> l(shadow_lock);
+
+		for (auto it = img->shadows.begin(); it != img->shadows.end();) {
+			if (in_range(it->first, range)) {
+				keys.push_back(it->first);
+				it = img->shadows.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	for (auto &it : cb->shadows) {
+		if (it.first.first == img->handle && in_range(it.first.second, range))
+			keys.push_back(it.first.second);
+	}
+
+	for (uint64_t key : keys) {
+		struct shadow_staged &staged = cb->shadows[{ img->handle, key }];
+		staged = {};
+		staged.epoch = img->shadowEpoch;
+		staged.replace = true;
+	}
+}
+
+void
+shadow_discard_layers(struct command_buffer *cb, struct image *img, const VkImageSubresourceLayers &subresource)
+{
+	VkImageSubresourceRange range = {
+		.aspectMask = subresource.aspectMask,
+		.baseMipLevel = subresource.mipLevel,
+		.levelCount = 1,
+		.baseArrayLayer = subresource.baseArrayLayer,
+		.layerCount = subresource.layerCount
+	};
+
+	shadow_discard(cb, img, range);
+}
+
+/*
+ * Called when the recording is submitted, with the global lock held.
+ * Staged shadows become the submitted ones if nothing else was submitted
+ * for their subresource since the recording started from it. Otherwise the
+ * recording's partial decodes may have been applied on other contents:
+ * the shadow is dropped so the next upload decodes in full, and so is the
+ * staged one for later submissions of the same recording.
+ */
+void
+shadow_commit(struct command_buffer *cb)
+{
+	std::lock_guard<std::mutex> l(shadow_lock);
+
+	for (auto &it : cb->shadows) {
+		struct shadow_staged &staged = it.second;
+		struct image *img = find_image(it.first.first);
+		uint64_t key = it.first.second;
+
+		if (!img || img->shadowEpoch != staged.epoch)
+			continue;
+
+		auto committed = img->shadows.find(key);
+		uint64_t current = committed != img->shadows.end() ? committed->second.generation : 0;
+
+		if (!staged.replace && current != staged.base) {
+			staged.shadow = {};
+			staged.replace = true;
+		}
+
+		if (staged.shadow.rows.empty()) {
+			if (committed != img->shadows.end())
+				img->shadows.erase(committed);
+			staged.base = 0;
+			continue;
+		}
+
+		staged.shadow.generation = shadow_new_generation();
+		staged.base = staged.shadow.generation;
+		img->shadows[key] = staged.shadow;
+	}
+}
+
+/* The recording is gone, so is what it would have left in the shadows. */
+void
+shadow_reset(struct command_buffer *cb)
+{
+	cb->shadows.clear();
+}
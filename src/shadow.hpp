@@ -0,0 +1,47 @@
+#ifndef __SHADOW_HPP
+#define __SHADOW_HPP
+
+#include "bcn_layer.hpp"
+
+struct image;
+struct command_buffer;
+
+/* One row of blocks, shared between shadows until one of them changes it. */
+struct shadow_row {
+	std::vector<uint8_t> blocks;
+	std::vector<uint8_t> valid;
+};
+
+/*
+ * Compressed copy of one emulated subresource as the layer last uploaded
+ * it, with a flag per block telling whether the decoded image holds it.
+ * The generation changes with every submitted update.
+ */
+struct shadow_subresource {
+	uint32_t blocksX;
+	uint32_t blocksY;
+	uint64_t generation;
+	std::vector<std::shared_ptr<struct shadow_row>> rows;
+};
+
+/*
+ * What a command buffer's uploads leave in one subresource once it runs.
+ * It starts as a copy of the submitted shadow of generation base, or from
+ * nothing when replace is set (the recording discarded the contents).
+ */
+struct shadow_staged {
+	uint64_t epoch;
+	uint64_t base;
+	bool replace;
+	struct shadow_subresource shadow;
+};
+
+uint64_t shadow_new_generation();
+bool shadow_diff(struct command_buffer *cb, struct image *img, const VkBufferImageCopy &region, const uint8_t *src,
+				 VkDeviceSize srcRowPitch, std::vector<VkRect2D> *dirty);
+void shadow_discard(struct command_buffer *cb, struct image *img, const VkImageSubresourceRange &range);
+void shadow_discard_layers(struct command_buffer *cb, struct image *img, const VkImageSubresourceLayers &subresource);
+void shadow_commit(struct command_buffer *cb);
+void shadow_reset(struct command_buffer *cb);
+
+#endif
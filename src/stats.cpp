@@ -0,0 +1,86 @@
+#include "stats.hpp"
+#include "logger.hpp"
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+
+/*
+ * The segment is created once per process when BCN_STATS is set, named
+ * BCN_STATS_NAME.<pid> unless BCN_STATS_SHM overrides it, and unlinked at
+ * exit. Counters are only ever touched with relaxed atomics so readers can
+ * poll them at any time.
+ */
+struct bcn_stats *bcn_stats_segment;
+
+static std::once_flag stats_once;
+static std::string stats_name;
+
+uint64_t
+stats_now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void
+create_segment()
+{
+	if (!getenv("BCN_STATS") || !atoi(getenv("BCN_STATS")))
+		return;
+
+	stats_name = getenv("BCN_STATS_SHM") ? getenv("BCN_STATS_SHM") :
+		std::string(BCN_STATS_NAME) + "." + std::to_string(getpid());
+
+	int fd = shm_open(stats_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd < 0) {
+		Logger::log("error", "Failed to create stats segment %s", stats_name.c_str());
+		return;
+	}
+
+	if (ftruncate(fd, sizeof(struct bcn_stats))) {
+		Logger::log("error", "Failed to size stats segment %s", stats_name.c_str());
+		close(fd);
+		shm_unlink(stats_name.c_str());
+		return;
+	}
+
+	void *data = mmap(nullptr, sizeof(struct bcn_stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		Logger::log("error", "Failed to map stats segment %s", stats_name.c_str());
+		shm_unlink(stats_name.c_str());
+		return;
+	}
+
+	/* A fresh segment is zero filled, which is a valid state for every counter. */
+	struct bcn_stats *stats = (struct bcn_stats *)data;
+	stats->version = BCN_STATS_VERSION;
+	stats->pid = getpid();
+	std::atomic_thread_fence(std::memory_order_release);
+	stats->magic = BCN_STATS_MAGIC;
+
+	bcn_stats_segment = stats;
+	atexit(stats_destroy);
+
+	Logger::log("info", "Publishing live counters in %s", stats_name.c_str());
+}
+
+void
+stats_init()
+{
+	std::call_once(stats_once, create_segment);
+}
+
+/* Only the name goes away, threads still running keep a valid mapping until exit. */
+void
+stats_destroy()
+{
+	if (bcn_stats_segment)
+		shm_unlink(stats_name.c_str());
+}
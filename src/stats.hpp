@@ -0,0 +1,117 @@
+#ifndef __STATS_HPP
+#define __STATS_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Live counters published in a POSIX shared memory segment, one per
+ * process. The layout is shared with tools/bcn_stat and does not depend on
+ * the Vulkan headers, bump BCN_STATS_VERSION when it changes.
+ */
+#define BCN_STATS_MAGIC 0x5354415453434e42ull
+#define BCN_STATS_VERSION 1
+#define BCN_STATS_FORMATS 16
+#define BCN_STATS_NAME "/bcn_stats"
+
+/* Indexed by VkFormat - VK_FORMAT_BC1_RGB_UNORM_BLOCK. */
+static const char *const bcn_stats_format_names[BCN_STATS_FORMATS] = {
+	"BC1_RGB_UNORM", "BC1_RGB_SRGB", "BC1_RGBA_UNORM", "BC1_RGBA_SRGB",
+	"BC2_UNORM", "BC2_SRGB", "BC3_UNORM", "BC3_SRGB",
+	"BC4_UNORM", "BC4_SNORM", "BC5_UNORM", "BC5_SNORM",
+	"BC6H_UFLOAT", "BC6H_SFLOAT", "BC7_UNORM", "BC7_SRGB"
+};
+
+enum bcn_stat {
+	BCN_STAT_REGIONS,
+	BCN_STAT_DISPATCHES,
+	BCN_STAT_DRAWS,
+	BCN_STAT_BARRIERS,
+	BCN_STAT_STAGING_BUFFERS,
+	BCN_STAT_STAGING_BYTES,
+	BCN_STAT_STAGING_PEAK,
+	BCN_STAT_DESCRIPTOR_SETS,
+	BCN_STAT_DESCRIPTOR_PEAK,
+	BCN_STAT_DESCRIPTOR_POOLS,
+	BCN_STAT_LOCK_WAITS,
+	BCN_STAT_LOCK_WAIT_NS,
+	BCN_STAT_LATENCY_COUNT,
+	BCN_STAT_LATENCY_NS,
+	BCN_STAT_LATENCY_MAX_NS,
+	BCN_STAT_COUNT
+};
+
+static const char *const bcn_stat_names[BCN_STAT_COUNT] = {
+	"regions", "dispatches", "draws", "barriers",
+	"staging_buffers", "staging_bytes", "staging_peak",
+	"descriptor_sets", "descriptor_peak", "descriptor_pools",
+	"lock_waits", "lock_wait_ns",
+	"latency_count", "latency_ns", "latency_max_ns"
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "stats counters must be lock free");
+
+struct bcn_stats {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t pid;
+	std::atomic<uint64_t> texels[BCN_STATS_FORMATS];
+	std::atomic<uint64_t> bytes[BCN_STATS_FORMATS];
+	std::atomic<uint64_t> counters[BCN_STAT_COUNT];
+};
+
+extern struct bcn_stats *bcn_stats_segment;
+
+void stats_init();
+void stats_destroy();
+uint64_t stats_now_ns();
+
+static inline void
+stats_add(enum bcn_stat stat, uint64_t value)
+{
+	if (bcn_stats_segment)
+		bcn_stats_segment->counters[stat].fetch_add(value, std::memory_order_relaxed);
+}
+
+static inline void
+stats_sub(enum bcn_stat stat, uint64_t value)
+{
+	if (bcn_stats_segment)
+		bcn_stats_segment->counters[stat].fetch_sub(value, std::memory_order_relaxed);
+}
+
+static inline void
+stats_max(enum bcn_stat stat, uint64_t value)
+{
+	if (!bcn_stats_segment)
+		return;
+
+	std::atomic<uint64_t> &counter = bcn_stats_segment->counters[stat];
+	uint64_t current = counter.load(std::memory_order_relaxed);
+
+	while (current < value && !counter.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		;
+}
+
+/* Adds to a gauge and raises its high-water mark. */
+static inline void
+stats_gauge_add(enum bcn_stat stat, enum bcn_stat peak, uint64_t value)
+{
+	if (!bcn_stats_segment)
+		return;
+
+	uint64_t current = bcn_stats_segment->counters[stat].fetch_add(value, std::memory_order_relaxed) + value;
+	stats_max(peak, current);
+}
+
+static inline void
+stats_add_format(uint32_t index, uint64_t texels, uint64_t bytes)
+{
+	if (!bcn_stats_segment || index >= BCN_STATS_FORMATS)
+		return;
+
+	bcn_stats_segment->texels[index].fetch_add(texels, std::memory_order_relaxed);
+	bcn_stats_segment->bytes[index].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+#endif
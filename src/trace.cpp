@@ -0,0 +1,285 @@
+#include "trace.hpp"
+#include "logger.hpp"
+#include "format.hpp"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Every thread that traces gets a single producer ring, records are dropped
+ * rather than waited for when it is full. The drain thread is the only
+ * consumer, it wakes up every TRACE_DRAIN_MS and when the layer shuts down.
+ * The ring of a thread that exits is recycled for the next new thread once
+ * it has been drained.
+ */
+#define TRACE_RING_SIZE 4096
+#define TRACE_DRAIN_MS 20
+
+struct trace_ring {
+	std::atomic<uint32_t> head;
+	std::atomic<uint32_t> tail;
+	std::atomic<uint64_t> dropped;
+	std::atomic<bool> retired;
+	uint32_t tid;
+	struct trace_record records[TRACE_RING_SIZE];
+};
+
+std::atomic<bool> trace_enabled;
+
+static const char *const trace_event_names[TRACE_EVENT_COUNT] = {
+	"CreateImage",
+	"CmdCopyBufferToImage",
+	"Decode",
+	"QueueSubmit",
+	"log"
+};
+
+static std::once_flag trace_once;
+static std::mutex trace_lock;
+static std::condition_variable trace_cond;
+static std::vector<std::unique_ptr<struct trace_ring>> rings;
+static std::vector<std::unique_ptr<struct trace_ring>> free_rings;
+static uint64_t retired_dropped;
+static std::thread drain_thread;
+static FILE *trace_file;
+static bool trace_first;
+static bool trace_stop;
+/* Hands the ring over to the drain thread when the thread exits. */
+struct trace_ring_owner {
+	struct trace_ring *ring;
+
+	~trace_ring_owner()
+	{
+		if (ring)
+			ring->retired.store(true, std::memory_order_release);
+	}
+};
+
+static thread_local struct trace_ring_owner local_ring;
+
+uint64_t
+trace_now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static struct trace_ring *
+get_ring()
+{
+	if (local_ring.ring)
+		return local_ring.ring;
+
+	std::lock_guard<std::mutex> l(trace_lock);
+	std::unique_ptr<struct trace_ring> ring;
+
+	if (!free_rings.empty()) {
+		ring = std::move(free_rings.back());
+		free_rings.pop_back();
+	} else {
+		ring = std::make_unique<struct trace_ring>();
+	}
+
+	ring->tid = syscall(SYS_gettid);
+	ring->retired.store(false, std::memory_order_relaxed);
+	local_ring.ring = ring.get();
+	rings.push_back(std::move(ring));
+
+	return local_ring.ring;
+}
+
+void
+trace_push(const struct trace_record &record)
+{
+	struct trace_ring *ring = get_ring();
+	uint32_t head = ring->head.load(std::memory_order_relaxed);
+
+	if (head - ring->tail.load(std::memory_order_acquire) >= TRACE_RING_SIZE) {
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ring->records[head % TRACE_RING_SIZE] = record;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void
+trace_message(uint64_t flag, const char *message)
+{
+	struct trace_record record;
+
+	record.start = trace_now();
+	record.duration = 0;
+	record.object = 0;
+	record.event = TRACE_LOG;
+	record.args[0] = flag;
+	record.args[1] = 0;
+	record.args[2] = 0;
+	strncpy(record.message, message, sizeof(record.message) - 1);
+	record.message[sizeof(record.message) - 1] = '\0';
+
+	trace_push(record);
+}
+
+static std::string
+json_escape(const char *str)
+{
+	std::string out;
+
+	for (const unsigned char *c = (const unsigned char *)str; *c; c++) {
+		if (*c == '"' || *c == '\\') {
+			out += '\\';
+			out += *c;
+		} else if (*c < 0x20) {
+			out += ' ';
+		} else {
+			out += *c;
+		}
+	}
+
+	return out;
+}
+
+static void
+write_record(uint32_t tid, const struct trace_record &record)
+{
+	fprintf(trace_file, trace_first ? "\n" : ",\n");
+	trace_first = false;
+
+	if (record.event == TRACE_LOG) {
+		fprintf(trace_file, "{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %.3f, \"pid\": %d, \"tid\": %u, "
+			"\"args\": {\"message\": \"%s\"}}",
+			record.args[0] == BCN_LAYER_LOG_ERROR ? "error" : "info", record.start / 1e3, getpid(), tid,
+			json_escape(record.message).c_str());
+		return;
+	}
+
+	fprintf(trace_file, "{\"name\": \"%s\", \"cat\": \"bcn\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+		"\"pid\": %d, \"tid\": %u, \"args\": {", trace_event_names[record.event],
+		record.start / 1e3, record.duration / 1e3, getpid(), tid);
+
+	switch (record.event) {
+		case TRACE_CREATE_IMAGE:
+		case TRACE_DECODE:
+			fprintf(trace_file, "\"image\": \"0x%llx\", \"format\": \"%s\", \"width\": %u, \"height\": %u",
+				(unsigned long long)record.object, get_format_name((VkFormat)record.args[0]),
+				record.args[1], record.args[2]);
+			break;
+		case TRACE_COPY_BUFFER_TO_IMAGE:
+			fprintf(trace_file, "\"image\": \"0x%llx\", \"format\": \"%s\", \"regions\": %u",
+				(unsigned long long)record.object, get_format_name((VkFormat)record.args[0]), record.args[1]);
+			break;
+		case TRACE_QUEUE_SUBMIT:
+			fprintf(trace_file, "\"queue\": \"0x%llx\", \"submits\": %u",
+				(unsigned long long)record.object, record.args[0]);
+			break;
+	}
+
+	fprintf(trace_file, "}}");
+}
+
+/* Called with trace_lock held. */
+static void
+drain_rings()
+{
+	for (auto it = rings.begin(); it != rings.end();) {
+		struct trace_ring *ring = it->get();
+		bool retired = ring->retired.load(std::memory_order_acquire);
+		uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+		uint32_t head = ring->head.load(std::memory_order_acquire);
+
+		for (; tail != head; tail++)
+			write_record(ring->tid, ring->records[tail % TRACE_RING_SIZE]);
+
+		ring->tail.store(tail, std::memory_order_release);
+
+		if (!retired) {
+			++it;
+			continue;
+		}
+
+		retired_dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+		free_rings.push_back(std::move(*it));
+		it = rings.erase(it);
+	}
+
+	fflush(trace_file);
+}
+
+static void
+drain_loop()
+{
+	std::unique_lock<std::mutex> l(trace_lock);
+
+	while (!trace_stop) {
+		trace_cond.wait_for(l, std::chrono::milliseconds(TRACE_DRAIN_MS));
+		drain_rings();
+	}
+}
+
+static void
+open_trace()
+{
+	const char *file = getenv("BCN_TRACE_FILE");
+	if (!file)
+		return;
+
+	trace_file = fopen(file, "w");
+	if (!trace_file) {
+		Logger::log("error", "Failed to open trace file %s", file);
+		return;
+	}
+
+	/* The array form of the format, a missing closing bracket is tolerated after a crash. */
+	fprintf(trace_file, "[");
+	trace_first = true;
+	trace_enabled.store(true, std::memory_order_relaxed);
+	drain_thread = std::thread(drain_loop);
+	atexit(trace_shutdown);
+}
+
+void
+trace_init()
+{
+	std::call_once(trace_once, open_trace);
+}
+
+void
+trace_shutdown()
+{
+	if (!trace_file)
+		return;
+
+	{
+		std::lock_guard<std::mutex> l(trace_lock);
+		trace_stop = true;
+	}
+
+	trace_cond.notify_all();
+	drain_thread.join();
+
+	trace_enabled.store(false, std::memory_order_relaxed);
+
+	drain_rings();
+
+	uint64_t dropped = retired_dropped;
+	for (auto &ring : rings)
+		dropped += ring->dropped.load(std::memory_order_relaxed);
+
+	fprintf(trace_file, "\n]\n");
+	fclose(trace_file);
+	trace_file = nullptr;
+
+	if (dropped)
+		Logger::log("info", "Trace dropped %llu records on full rings", (unsigned long long)dropped);
+}
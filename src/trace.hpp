@@ -0,0 +1,76 @@
+#ifndef __TRACE_HPP
+#define __TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Binary trace: typed fixed size records go into a ring per thread and a
+ * background thread drains them to BCN_TRACE_FILE in the Chrome trace event
+ * format, which Perfetto also loads. With tracing off a span costs one
+ * branch.
+ */
+enum trace_event {
+	TRACE_CREATE_IMAGE,
+	TRACE_COPY_BUFFER_TO_IMAGE,
+	TRACE_DECODE,
+	TRACE_QUEUE_SUBMIT,
+	TRACE_LOG,
+	TRACE_EVENT_COUNT
+};
+
+struct trace_record {
+	uint64_t start;
+	uint64_t duration;
+	uint64_t object;
+	uint32_t event;
+	uint32_t args[3];
+	char message[96];
+};
+
+extern std::atomic<bool> trace_enabled;
+
+void trace_init();
+void trace_shutdown();
+uint64_t trace_now();
+void trace_push(const struct trace_record &record);
+void trace_message(uint64_t flag, const char *message);
+
+struct trace_span {
+	trace_span(enum trace_event event, uint64_t object = 0, uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0)
+		: active(trace_enabled.load(std::memory_order_relaxed))
+	{
+		if (!active)
+			return;
+
+		record.event = event;
+		record.object = object;
+		record.args[0] = arg0;
+		record.args[1] = arg1;
+		record.args[2] = arg2;
+		record.message[0] = '\0';
+		record.start = trace_now();
+	}
+
+	~trace_span()
+	{
+		if (!active)
+			return;
+
+		record.duration = trace_now() - record.start;
+		trace_push(record);
+	}
+
+	void set_object(uint64_t object)
+	{
+		record.object = object;
+	}
+
+	trace_span(const trace_span &) = delete;
+	trace_span &operator=(const trace_span &) = delete;
+
+	bool active;
+	struct trace_record record;
+};
+
+#endif
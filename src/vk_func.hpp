@@ -17,11 +17,52 @@ BCnLayer_CreateImageView(VkDevice device,
                          const VkAllocationCallbacks *pAllocator,
                          VkImageView *pImageView);
 
+void VKAPI_CALL
+BCnLayer_GetImageSubresourceLayout(VkDevice device,
+                                   VkImage image,
+                                   const VkImageSubresource *pSubresource,
+                                   VkSubresourceLayout *pLayout);
+
+VkResult VKAPI_CALL
+BCnLayer_BindImageMemory(VkDevice device,
+                         VkImage image,
+                         VkDeviceMemory memory,
+                         VkDeviceSize memoryOffset);
+
+VkResult VKAPI_CALL
+BCnLayer_BindImageMemory2(VkDevice device,
+                          uint32_t bindInfoCount,
+                          const VkBindImageMemoryInfo *pBindInfos);
+
+void VKAPI_CALL
+BCnLayer_DestroyImageView(VkDevice device,
+                          VkImageView imageView,
+                          const VkAllocationCallbacks *pAllocator);
+
+void VKAPI_CALL
+BCnLayer_UpdateDescriptorSets(VkDevice device,
+                              uint32_t descriptorWriteCount,
+                              const VkWriteDescriptorSet *pDescriptorWrites,
+                              uint32_t descriptorCopyCount,
+                              const VkCopyDescriptorSet *pDescriptorCopies);
+
+void VKAPI_CALL
+BCnLayer_CmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer,
+                                 VkPipelineBindPoint pipelineBindPoint,
+                                 VkPipelineLayout layout,
+                                 uint32_t set,
+                                 uint32_t descriptorWriteCount,
+                                 const VkWriteDescriptorSet *pDescriptorWrites);
+
 void VKAPI_CALL
 BCnLayer_DestroyImage(VkDevice device,
 					  VkImage image,
                       const VkAllocationCallbacks *pAllocator);
 
+VkResult VKAPI_CALL
+BCnLayer_SetDebugUtilsObjectNameEXT(VkDevice device,
+                                    const VkDebugUtilsObjectNameInfoEXT *pNameInfo);
+
 VkResult VKAPI_CALL
 BCnLayer_CreateBuffer(VkDevice device,
                       const VkBufferCreateInfo *pCreateInfo,
@@ -39,6 +80,40 @@ BCnLayer_DestroyBuffer(VkDevice device,
 					   VkBuffer buffer,
                        const VkAllocationCallbacks *pAllocator);
 
+VkResult VKAPI_CALL
+BCnLayer_AllocateMemory(VkDevice device,
+                        const VkMemoryAllocateInfo *pAllocateInfo,
+                        const VkAllocationCallbacks *pAllocator,
+                        VkDeviceMemory *pMemory);
+
+void VKAPI_CALL
+BCnLayer_FreeMemory(VkDevice device,
+                    VkDeviceMemory memory,
+                    const VkAllocationCallbacks *pAllocator);
+
+VkResult VKAPI_CALL
+BCnLayer_MapMemory(VkDevice device,
+                   VkDeviceMemory memory,
+                   VkDeviceSize offset,
+                   VkDeviceSize size,
+                   VkMemoryMapFlags flags,
+                   void **ppData);
+
+void VKAPI_CALL
+BCnLayer_UnmapMemory(VkDevice device,
+                     VkDeviceMemory memory);
+
+VkResult VKAPI_CALL
+BCnLayer_FlushMappedMemoryRanges(VkDevice device,
+                                 uint32_t memoryRangeCount,
+                                 const VkMappedMemoryRange *pMemoryRanges);
+
+VkResult VKAPI_CALL
+BCnLayer_CreateCommandPool(VkDevice device,
+                           const VkCommandPoolCreateInfo *pCreateInfo,
+                           const VkAllocationCallbacks *pAllocator,
+                           VkCommandPool *pCommandPool);
+
 VkResult VKAPI_CALL
 BCnLayer_AllocateCommandBuffers(VkDevice device,
                                 const VkCommandBufferAllocateInfo *pAllocateInfo,
@@ -58,18 +133,137 @@ BCnLayer_CmdCopyBufferToImage(VkCommandBuffer commandBuffer,
                               uint32_t regionCount,
                               const VkBufferImageCopy *pRegions);
 
+VkResult VKAPI_CALL
+BCnLayer_ResetCommandBuffer(VkCommandBuffer commandBuffer,
+                            VkCommandBufferResetFlags flags);
+
+VkResult VKAPI_CALL
+BCnLayer_ResetCommandPool(VkDevice device,
+                          VkCommandPool commandPool,
+                          VkCommandPoolResetFlags flags);
+
+void VKAPI_CALL
+BCnLayer_DestroyCommandPool(VkDevice device,
+                            VkCommandPool commandPool,
+                            const VkAllocationCallbacks *pAllocator);
+
+VkResult VKAPI_CALL
+BCnLayer_BeginCommandBuffer(VkCommandBuffer commandBuffer,
+                            const VkCommandBufferBeginInfo *pBeginInfo);
+
+VkResult VKAPI_CALL
+BCnLayer_EndCommandBuffer(VkCommandBuffer commandBuffer);
+
+void VKAPI_CALL
+BCnLayer_CmdPipelineBarrier(VkCommandBuffer commandBuffer,
+                            VkPipelineStageFlags srcStageMask,
+                            VkPipelineStageFlags dstStageMask,
+                            VkDependencyFlags dependencyFlags,
+                            uint32_t memoryBarrierCount,
+                            const VkMemoryBarrier *pMemoryBarriers,
+                            uint32_t bufferMemoryBarrierCount,
+                            const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+                            uint32_t imageMemoryBarrierCount,
+                            const VkImageMemoryBarrier *pImageMemoryBarriers);
+
+void VKAPI_CALL
+BCnLayer_CmdPipelineBarrier2(VkCommandBuffer commandBuffer,
+                             const VkDependencyInfo *pDependencyInfo);
+
+void VKAPI_CALL
+BCnLayer_CmdWaitEvents(VkCommandBuffer commandBuffer,
+                       uint32_t eventCount,
+                       const VkEvent *pEvents,
+                       VkPipelineStageFlags srcStageMask,
+                       VkPipelineStageFlags dstStageMask,
+                       uint32_t memoryBarrierCount,
+                       const VkMemoryBarrier *pMemoryBarriers,
+                       uint32_t bufferMemoryBarrierCount,
+                       const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+                       uint32_t imageMemoryBarrierCount,
+                       const VkImageMemoryBarrier *pImageMemoryBarriers);
+
+void VKAPI_CALL
+BCnLayer_CmdCopyImage(VkCommandBuffer commandBuffer,
+                      VkImage srcImage,
+                      VkImageLayout srcImageLayout,
+                      VkImage dstImage,
+                      VkImageLayout dstImageLayout,
+                      uint32_t regionCount,
+                      const VkImageCopy *pRegions);
+
+void VKAPI_CALL
+BCnLayer_CmdCopyImageToBuffer(VkCommandBuffer commandBuffer,
+                              VkImage srcImage,
+                              VkImageLayout srcImageLayout,
+                              VkBuffer dstBuffer,
+                              uint32_t regionCount,
+                              const VkBufferImageCopy *pRegions);
+
+void VKAPI_CALL
+BCnLayer_CmdBlitImage(VkCommandBuffer commandBuffer,
+                      VkImage srcImage,
+                      VkImageLayout srcImageLayout,
+                      VkImage dstImage,
+                      VkImageLayout dstImageLayout,
+                      uint32_t regionCount,
+                      const VkImageBlit *pRegions,
+                      VkFilter filter);
+
+void VKAPI_CALL
+BCnLayer_CmdCopyBufferToImage2(VkCommandBuffer commandBuffer,
+                               const VkCopyBufferToImageInfo2 *pCopyBufferToImageInfo);
+
+void VKAPI_CALL
+BCnLayer_CmdCopyImageToBuffer2(VkCommandBuffer commandBuffer,
+                               const VkCopyImageToBufferInfo2 *pCopyImageToBufferInfo);
+
+void VKAPI_CALL
+BCnLayer_CmdCopyImage2(VkCommandBuffer commandBuffer,
+                       const VkCopyImageInfo2 *pCopyImageInfo);
+
+void VKAPI_CALL
+BCnLayer_CmdBlitImage2(VkCommandBuffer commandBuffer,
+                       const VkBlitImageInfo2 *pBlitImageInfo);
+
+void VKAPI_CALL
+BCnLayer_CmdExecuteCommands(VkCommandBuffer commandBuffer,
+                            uint32_t commandBufferCount,
+                            const VkCommandBuffer *pCommandBuffers);
+
 void VKAPI_CALL
 BCnLayer_GetDeviceQueue(VkDevice device,
                         uint32_t queueFamilyIndex,
                         uint32_t queueIndex,
                         VkQueue *pQueue);
 
+void VKAPI_CALL
+BCnLayer_GetDeviceQueue2(VkDevice device,
+                         const VkDeviceQueueInfo2 *pQueueInfo,
+                         VkQueue *pQueue);
+
 VkResult VKAPI_CALL
 BCnLayer_QueueSubmit(VkQueue queue,
                      uint32_t submitInfoCount,
                      const VkSubmitInfo *pSubmitInfos,
                      VkFence fence);
 
+VkResult VKAPI_CALL
+BCnLayer_QueueSubmit2(VkQueue queue,
+                      uint32_t submitCount,
+                      const VkSubmitInfo2 *pSubmits,
+                      VkFence fence);
+
+VkResult VKAPI_CALL
+BCnLayer_QueueWaitIdle(VkQueue queue);
+
+VkResult VKAPI_CALL
+BCnLayer_QueuePresentKHR(VkQueue queue,
+                         const VkPresentInfoKHR *pPresentInfo);
+
+VkResult VKAPI_CALL
+BCnLayer_DeviceWaitIdle(VkDevice device);
+
 VkResult VKAPI_CALL
 BCnLayer_CreateFence(VkDevice device,
                      const VkFenceCreateInfo *pCreateInfo,
@@ -83,6 +277,15 @@ BCnLayer_WaitForFences(VkDevice device,
                        VkBool32 waitAll,
                        uint64_t timeout);
 
+VkResult VKAPI_CALL
+BCnLayer_GetFenceStatus(VkDevice device,
+                        VkFence fence);
+
+VkResult VKAPI_CALL
+BCnLayer_WaitSemaphores(VkDevice device,
+                        const VkSemaphoreWaitInfo *pWaitInfo,
+                        uint64_t timeout);
+
 void VKAPI_CALL
 BCnLayer_DestroyFence(VkDevice device,
                       VkFence fence,
@@ -44,6 +44,7 @@ typedef struct VkLayerDispatchTable_ {
     PFN_vkQueueSubmit2 QueueSubmit2;
     PFN_vkQueueWaitIdle QueueWaitIdle;
     PFN_vkDeviceWaitIdle DeviceWaitIdle;
+    PFN_vkWaitSemaphores WaitSemaphores;
     PFN_vkAllocateMemory AllocateMemory;
     PFN_vkFreeMemory FreeMemory;
     PFN_vkMapMemory MapMemory;
@@ -55,6 +56,7 @@ typedef struct VkLayerDispatchTable_ {
     PFN_vkGetImageMemoryRequirements GetImageMemoryRequirements;
     PFN_vkGetBufferMemoryRequirements GetBufferMemoryRequirements;
     PFN_vkBindImageMemory BindImageMemory;
+    PFN_vkBindImageMemory2 BindImageMemory2;
     PFN_vkBindBufferMemory BindBufferMemory;
     PFN_vkQueueBindSparse QueueBindSparse;
     PFN_vkCreateFence CreateFence;
@@ -149,6 +151,11 @@ typedef struct VkLayerDispatchTable_ {
     PFN_vkCmdResetEvent CmdResetEvent;
     PFN_vkCmdWaitEvents CmdWaitEvents;
     PFN_vkCmdPipelineBarrier CmdPipelineBarrier;
+    PFN_vkCmdPipelineBarrier2 CmdPipelineBarrier2;
+    PFN_vkGetShaderModuleIdentifierEXT GetShaderModuleIdentifierEXT;
+    PFN_vkGetPipelineExecutablePropertiesKHR GetPipelineExecutablePropertiesKHR;
+    PFN_vkGetPipelineExecutableStatisticsKHR GetPipelineExecutableStatisticsKHR;
+    PFN_vkGetPipelineExecutableInternalRepresentationsKHR GetPipelineExecutableInternalRepresentationsKHR;
     PFN_vkCmdBeginQuery CmdBeginQuery;
     PFN_vkCmdEndQuery CmdEndQuery;
     PFN_vkCmdResetQueryPool CmdResetQueryPool;
@@ -158,7 +165,13 @@ typedef struct VkLayerDispatchTable_ {
     PFN_vkCmdBeginRenderPass CmdBeginRenderPass;
     PFN_vkCmdNextSubpass CmdNextSubpass;
     PFN_vkCmdEndRenderPass CmdEndRenderPass;
+    PFN_vkCmdBeginRendering CmdBeginRendering;
+    PFN_vkCmdEndRendering CmdEndRendering;
     PFN_vkCmdExecuteCommands CmdExecuteCommands;
+    PFN_vkCmdPushDescriptorSetKHR CmdPushDescriptorSetKHR;
+    PFN_vkCmdBeginDebugUtilsLabelEXT CmdBeginDebugUtilsLabelEXT;
+    PFN_vkCmdEndDebugUtilsLabelEXT CmdEndDebugUtilsLabelEXT;
+    PFN_vkSetDebugUtilsObjectNameEXT SetDebugUtilsObjectNameEXT;
     PFN_vkCreateSwapchainKHR CreateSwapchainKHR;
     PFN_vkDestroySwapchainKHR DestroySwapchainKHR;
     PFN_vkGetSwapchainImagesKHR GetSwapchainImagesKHR;
@@ -195,6 +208,7 @@ typedef struct VkLayerInstanceDispatchTable_ {
     PFN_vkGetPhysicalDeviceQueueFamilyProperties
         GetPhysicalDeviceQueueFamilyProperties;
     PFN_vkGetPhysicalDeviceMemoryProperties GetPhysicalDeviceMemoryProperties;
+    PFN_vkGetPhysicalDeviceMemoryProperties2 GetPhysicalDeviceMemoryProperties2;
     PFN_vkEnumerateDeviceExtensionProperties EnumerateDeviceExtensionProperties;
     PFN_vkEnumerateDeviceLayerProperties EnumerateDeviceLayerProperties;
     PFN_vkDestroySurfaceKHR DestroySurfaceKHR;
@@ -0,0 +1,511 @@
+/*
+ * bcn_bench: times the whole upload path of the layer, recording, submit
+ * and wait, on generated BC1-BC7 textures of several sizes, mip counts and
+ * region splits. It runs on whatever ICD the loader picks, lavapipe in CI,
+ * with the layer enabled through its enable_environment. Counters come from
+ * the layer's own stats segment, so the layer must be built from the same
+ * tree. The compiler statistics of the decode pipelines come from the
+ * layer's BCN_PIPELINE_STATS output, redirected to a private file.
+ *
+ * usage: bcn_bench [-n iterations] [-d device] [-f format] [-s sizes] [-o json]
+ */
+
+#include "../src/format.hpp"
+#include "../src/stats.hpp"
+#include "common.hpp"
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const VkFormat bench_formats[] = {
+	VK_FORMAT_BC1_RGBA_UNORM_BLOCK,
+	VK_FORMAT_BC2_UNORM_BLOCK,
+	VK_FORMAT_BC3_UNORM_BLOCK,
+	VK_FORMAT_BC4_UNORM_BLOCK,
+	VK_FORMAT_BC5_UNORM_BLOCK,
+	VK_FORMAT_BC6H_UFLOAT_BLOCK,
+	VK_FORMAT_BC7_UNORM_BLOCK
+};
+
+/* Regions per mip level are splits * splits tiles. */
+static const uint32_t bench_splits[] = { 1, 4 };
+
+struct bench_case {
+	VkFormat format;
+	uint32_t size;
+	uint32_t mipLevels;
+	uint32_t splits;
+};
+
+struct bench_result {
+	struct bench_case c;
+	uint32_t regions;
+	uint64_t texels;
+	double totalMs;
+	double minMs;
+	double recordUs;
+	double mtexels;
+	uint64_t dispatches;
+	uint64_t draws;
+	uint64_t barriers;
+	uint64_t stagingPeak;
+	uint64_t descriptorPeak;
+};
+
+/* One executable of a decode pipeline, as the layer wrote it out. */
+struct bench_executable {
+	std::string pipeline;
+	uint32_t index;
+	std::string name;
+	uint32_t subgroupSize;
+	std::vector<std::pair<std::string, std::string>> statistics;
+};
+
+static uint64_t
+xorshift(uint64_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+/* Same seed, same blocks, results are comparable between runs and machines. */
+static void
+fill_blocks(uint8_t *dst, VkDeviceSize size, uint64_t seed)
+{
+	uint64_t state = seed * 0x9e3779b97f4a7c15ull + 1;
+
+	for (VkDeviceSize i = 0; i < size; i += 8) {
+		uint64_t value = xorshift(state);
+		memcpy(dst + i, &value, std::min((VkDeviceSize)8, size - i));
+	}
+}
+
+static uint32_t
+mip_extent(uint32_t size, uint32_t level)
+{
+	return std::max(size >> level, 1u);
+}
+
+static VkDeviceSize
+level_bytes(VkFormat format, uint32_t extent)
+{
+	VkDeviceSize blocks = (extent + 3) / 4;
+	return blocks * blocks * get_block_size(format);
+}
+
+/*
+ * Builds the copy regions of a case over a tightly packed mip chain. Tiles
+ * are cut on block boundaries, levels too small to split take one region.
+ */
+static void
+build_regions(const struct bench_case &c, std::vector<VkBufferImageCopy> &regions, uint64_t *texels)
+{
+	VkDeviceSize offset = 0;
+	uint32_t blockSize = get_block_size(c.format);
+
+	*texels = 0;
+
+	for (uint32_t level = 0; level < c.mipLevels; level++) {
+		uint32_t extent = mip_extent(c.size, level);
+		uint32_t blocks = (extent + 3) / 4;
+		uint32_t splits = blocks >= c.splits ? c.splits : 1;
+		uint32_t tile = blocks / splits;
+
+		for (uint32_t ty = 0; ty < splits; ty++) {
+			for (uint32_t tx = 0; tx < splits; tx++) {
+				uint32_t bx = tx * tile, by = ty * tile;
+				uint32_t bw = tx == splits - 1 ? blocks - bx : tile;
+				uint32_t bh = ty == splits - 1 ? blocks - by : tile;
+
+				VkBufferImageCopy region = {
+					.bufferOffset = offset + ((VkDeviceSize)by * blocks + bx) * blockSize,
+					.bufferRowLength = blocks * 4,
+					.bufferImageHeight = blocks * 4,
+					.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 },
+					.imageOffset = { (int32_t)(bx * 4), (int32_t)(by * 4), 0 },
+					.imageExtent = { std::min(bw * 4, extent - bx * 4), std::min(bh * 4, extent - by * 4), 1 }
+				};
+
+				regions.push_back(region);
+				*texels += (uint64_t)region.imageExtent.width * region.imageExtent.height;
+			}
+		}
+
+		offset += level_bytes(c.format, extent);
+	}
+}
+
+/*
+ * The bench maps the layer's segment writable, it resets the high-water
+ * marks to the current gauges before every case so peaks are per case.
+ */
+static struct bcn_stats *
+open_stats(const std::string &name)
+{
+	int fd = shm_open(name.c_str(), O_RDWR, 0);
+	if (fd < 0)
+		return nullptr;
+
+	void *data = mmap(nullptr, sizeof(struct bcn_stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return nullptr;
+
+	struct bcn_stats *stats = (struct bcn_stats *)data;
+	if (stats->magic != BCN_STATS_MAGIC || stats->version != BCN_STATS_VERSION) {
+		munmap(data, sizeof(struct bcn_stats));
+		return nullptr;
+	}
+
+	return stats;
+}
+
+static uint64_t
+read_stat(const struct bcn_stats *stats, enum bcn_stat stat)
+{
+	return stats ? stats->counters[stat].load(std::memory_order_relaxed) : 0;
+}
+
+static void
+reset_peaks(struct bcn_stats *stats)
+{
+	if (!stats)
+		return;
+
+	stats->counters[BCN_STAT_STAGING_PEAK].store(read_stat(stats, BCN_STAT_STAGING_BYTES), std::memory_order_relaxed);
+	stats->counters[BCN_STAT_DESCRIPTOR_PEAK].store(read_stat(stats, BCN_STAT_DESCRIPTOR_SETS), std::memory_order_relaxed);
+}
+
+static bool
+run_case(const struct vk_context *ctx, struct bcn_stats *stats, const struct bench_case &c, uint32_t iterations,
+		 struct bench_result *result)
+{
+	std::vector<VkBufferImageCopy> regions;
+	VkDeviceSize size = 0;
+
+	for (uint32_t level = 0; level < c.mipLevels; level++)
+		size += level_bytes(c.format, mip_extent(c.size, level));
+
+	memset(result, 0, sizeof(*result));
+	result->c = c;
+	build_regions(c, regions, &result->texels);
+	result->regions = regions.size();
+
+	struct vk_buffer staging;
+	if (!vk_buffer_create(ctx, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true, &staging)) {
+		fprintf(stderr, "bcn_bench: failed to allocate %llu staging bytes\n", (unsigned long long)size);
+		return false;
+	}
+
+	fill_blocks((uint8_t *)staging.mapped, size, ((uint64_t)c.format << 32) | c.size);
+
+	VkImageCreateInfo image_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = c.format,
+		.extent = { c.size, c.size, 1 },
+		.mipLevels = c.mipLevels,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 0,
+		.pQueueFamilyIndices = nullptr,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+
+	struct vk_image image;
+	if (!vk_image_create(ctx, image_info, &image)) {
+		fprintf(stderr, "bcn_bench: failed to create %ux%u %s image\n", c.size, c.size, get_format_name(c.format));
+		vk_buffer_destroy(ctx, &staging);
+		return false;
+	}
+
+	std::vector<double> totals, records;
+	bool ok = true;
+
+	/* The first round builds the pipelines and is not counted. */
+	for (uint32_t i = 0; i <= iterations && ok; i++) {
+		if (i == 1) {
+			reset_peaks(stats);
+			result->dispatches = read_stat(stats, BCN_STAT_DISPATCHES);
+			result->draws = read_stat(stats, BCN_STAT_DRAWS);
+			result->barriers = read_stat(stats, BCN_STAT_BARRIERS);
+		}
+
+		uint64_t start = now_ns();
+		VkCommandBuffer cmd = vk_begin(ctx);
+
+		vk_transition(cmd, image.handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, c.mipLevels, 1);
+
+		uint64_t recordStart = now_ns();
+		for (const VkBufferImageCopy &region : regions)
+			vkCmdCopyBufferToImage(cmd, staging.handle, image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		uint64_t recordEnd = now_ns();
+
+		ok = vk_submit_wait(ctx, cmd);
+
+		if (i) {
+			totals.push_back((now_ns() - start) / 1e6);
+			records.push_back((recordEnd - recordStart) / 1e3 / regions.size());
+		}
+	}
+
+	if (ok) {
+		result->totalMs = percentile(totals, 0.5);
+		result->minMs = percentile(totals, 0.0);
+		result->recordUs = percentile(records, 0.5);
+		result->mtexels = result->texels / (result->totalMs * 1e3);
+		result->dispatches = (read_stat(stats, BCN_STAT_DISPATCHES) - result->dispatches) / iterations;
+		result->draws = (read_stat(stats, BCN_STAT_DRAWS) - result->draws) / iterations;
+		result->barriers = (read_stat(stats, BCN_STAT_BARRIERS) - result->barriers) / iterations;
+		result->stagingPeak = read_stat(stats, BCN_STAT_STAGING_PEAK);
+		result->descriptorPeak = read_stat(stats, BCN_STAT_DESCRIPTOR_PEAK);
+	}
+
+	vk_image_destroy(ctx, &image);
+	vk_buffer_destroy(ctx, &staging);
+
+	return ok;
+}
+
+/*
+ * Reads back what the layer wrote for BCN_PIPELINE_STATS=1: a
+ * "<pipeline> executable <n>: <name>, subgroup size <n>" line per
+ * executable, followed by an indented "<statistic>: <value>" line per
+ * statistic.
+ */
+static std::vector<struct bench_executable>
+read_pipeline_stats(const std::string &path)
+{
+	std::vector<struct bench_executable> executables;
+	FILE *file = fopen(path.c_str(), "r");
+	char buffer[1024];
+
+	if (!file)
+		return executables;
+
+	while (fgets(buffer, sizeof(buffer), file)) {
+		std::string line = buffer;
+		while (!line.empty() && line.back() == '\n')
+			line.pop_back();
+
+		if (line.compare(0, 2, "  ") == 0) {
+			size_t colon = line.rfind(": ");
+			if (!executables.empty() && colon != std::string::npos)
+				executables.back().statistics.emplace_back(line.substr(2, colon - 2), line.substr(colon + 2));
+			continue;
+		}
+
+		size_t marker = line.find(" executable ");
+		size_t colon = line.find(": ", marker);
+		size_t subgroup = line.rfind(", subgroup size ");
+		if (marker == std::string::npos || colon == std::string::npos || subgroup == std::string::npos || subgroup < colon)
+			continue;
+
+		struct bench_executable executable;
+		executable.pipeline = line.substr(0, marker);
+		executable.index = atoi(line.c_str() + marker + strlen(" executable "));
+		executable.name = line.substr(colon + 2, subgroup - colon - 2);
+		executable.subgroupSize = atoi(line.c_str() + subgroup + strlen(", subgroup size "));
+		executables.push_back(executable);
+	}
+
+	fclose(file);
+	return executables;
+}
+
+static void
+write_json(FILE *file, const char *deviceName, uint32_t iterations, const std::vector<struct bench_result> &results,
+		   bool counters, const std::vector<struct bench_executable> &executables)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	fprintf(file, "{\n  \"device\": \"%s\",\n  \"iterations\": %u,\n  \"counters\": %s,\n  \"max_rss_kb\": %ld,\n"
+		"  \"cases\": [", deviceName, iterations, counters ? "true" : "false", usage.ru_maxrss);
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const struct bench_result &r = results[i];
+
+		fprintf(file, "%s\n    {\"format\": \"%s\", \"size\": %u, \"mips\": %u, \"splits\": %u, \"regions\": %u, "
+			"\"texels\": %llu, \"total_ms\": %.4f, \"min_ms\": %.4f, \"mtexels_per_s\": %.3f, "
+			"\"record_us_per_region\": %.3f, \"dispatches\": %llu, \"draws\": %llu, \"barriers\": %llu, "
+			"\"staging_peak_bytes\": %llu, \"descriptor_peak\": %llu}",
+			i ? "," : "", get_format_name(r.c.format), r.c.size, r.c.mipLevels, r.c.splits, r.regions,
+			(unsigned long long)r.texels, r.totalMs, r.minMs, r.mtexels, r.recordUs,
+			(unsigned long long)r.dispatches, (unsigned long long)r.draws, (unsigned long long)r.barriers,
+			(unsigned long long)r.stagingPeak, (unsigned long long)r.descriptorPeak);
+	}
+
+	fprintf(file, "\n  ],\n  \"pipelines\": [");
+
+	for (size_t i = 0; i < executables.size(); i++) {
+		const struct bench_executable &e = executables[i];
+
+		fprintf(file, "%s\n    {\"pipeline\": \"%s\", \"executable\": %u, \"name\": \"%s\", \"subgroup_size\": %u, "
+			"\"statistics\": {", i ? "," : "", e.pipeline.c_str(), e.index, e.name.c_str(), e.subgroupSize);
+
+		/* Values are numbers or booleans, the layer writes ? for a format it does not know. */
+		for (size_t j = 0; j < e.statistics.size(); j++) {
+			fprintf(file, "%s\"%s\": %s", j ? ", " : "", e.statistics[j].first.c_str(),
+				e.statistics[j].second == "?" ? "null" : e.statistics[j].second.c_str());
+		}
+
+		fprintf(file, "}}");
+	}
+
+	fprintf(file, "\n  ]\n}\n");
+}
+
+static std::vector<uint32_t>
+parse_sizes(const char *arg)
+{
+	std::vector<uint32_t> sizes;
+	std::string list = arg;
+	size_t pos = 0;
+
+	while (pos < list.size()) {
+		size_t end = list.find(',', pos);
+		if (end == std::string::npos)
+			end = list.size();
+
+		uint32_t size = atoi(list.substr(pos, end - pos).c_str());
+		if (size)
+			sizes.push_back(size);
+
+		pos = end + 1;
+	}
+
+	return sizes;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *deviceFilter = nullptr;
+	const char *formatFilter = nullptr;
+	const char *jsonPath = nullptr;
+	std::vector<uint32_t> sizes = { 256, 1024, 2048 };
+	uint32_t iterations = 5;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:d:f:s:o:")) != -1) {
+		switch (opt) {
+			case 'n':
+				iterations = std::max(1, atoi(optarg));
+				break;
+			case 'd':
+				deviceFilter = optarg;
+				break;
+			case 'f':
+				formatFilter = optarg;
+				break;
+			case 's':
+				sizes = parse_sizes(optarg);
+				break;
+			case 'o':
+				jsonPath = optarg;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-n iterations] [-d device] [-f format] [-s sizes] [-o json]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	/* A private segment, so concurrent benches and bcn_stat do not mix up. */
+	std::string statsName = std::string("/bcn_bench.") + std::to_string(getpid());
+	setenv("BCN_STATS", "1", 1);
+	setenv("BCN_STATS_SHM", statsName.c_str(), 1);
+
+	/* Statistics only unless asked for more, the layer appends so a stale file is removed first. */
+	std::string pipelineStatsPath = std::string("/tmp/bcn_bench.") + std::to_string(getpid()) + ".pipelines";
+	setenv("BCN_PIPELINE_STATS", "1", 0);
+	setenv("BCN_PIPELINE_STATS_FILE", pipelineStatsPath.c_str(), 1);
+	unlink(pipelineStatsPath.c_str());
+
+	struct vk_context ctx;
+	if (!vk_context_create(&ctx, deviceFilter, true))
+		return 1;
+
+	struct bcn_stats *stats = open_stats(statsName);
+	if (!stats)
+		fprintf(stderr, "bcn_bench: layer counters unavailable, is the layer installed and enabled?\n");
+
+	printf("device: %s, %u iterations\n", ctx.props.deviceName, iterations);
+	printf("%-16s %6s %5s %7s %11s %10s %10s %8s %8s %12s\n", "format", "size", "mips", "regions",
+		"Mtexel/s", "total ms", "rec us/rg", "disp", "barriers", "staging peak");
+
+	std::vector<struct bench_result> results;
+	bool ok = true;
+
+	for (VkFormat format : bench_formats) {
+		if (formatFilter && !strcasestr(get_format_name(format), formatFilter))
+			continue;
+
+		for (uint32_t size : sizes) {
+			uint32_t fullChain = 32 - __builtin_clz(size);
+
+			for (uint32_t mipLevels : { 1u, fullChain }) {
+				for (uint32_t splits : bench_splits) {
+					struct bench_case c = { format, size, mipLevels, splits };
+					struct bench_result result;
+
+					if (!run_case(&ctx, stats, c, iterations, &result)) {
+						ok = false;
+						continue;
+					}
+
+					printf("%-16s %6u %5u %7u %11.2f %10.3f %10.2f %8llu %8llu %12llu\n",
+						get_format_name(format), size, mipLevels, result.regions, result.mtexels, result.totalMs,
+						result.recordUs, (unsigned long long)(result.dispatches + result.draws),
+						(unsigned long long)result.barriers, (unsigned long long)result.stagingPeak);
+					fflush(stdout);
+
+					results.push_back(result);
+				}
+
+				if (fullChain == 1)
+					break;
+			}
+		}
+	}
+
+	if (stats)
+		munmap(stats, sizeof(struct bcn_stats));
+
+	/* The layer writes the statistics once a pipeline is built, it has finished by the time the device is gone. */
+	std::string deviceName = ctx.props.deviceName;
+	vk_context_destroy(&ctx);
+
+	std::vector<struct bench_executable> executables = read_pipeline_stats(pipelineStatsPath);
+	unlink(pipelineStatsPath.c_str());
+
+	if (jsonPath) {
+		FILE *file = strcmp(jsonPath, "-") ? fopen(jsonPath, "w") : stdout;
+		if (file) {
+			write_json(file, deviceName.c_str(), iterations, results, stats != nullptr, executables);
+			if (file != stdout)
+				fclose(file);
+		} else {
+			fprintf(stderr, "bcn_bench: cannot write %s\n", jsonPath);
+			ok = false;
+		}
+	}
+
+	return ok ? 0 : 1;
+}
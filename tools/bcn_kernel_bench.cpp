@@ -0,0 +1,657 @@
+/*
+ * bcn_kernel_bench: dispatches the buffer variants of the decode shaders
+ * directly, without the layer, on inputs made of a single block variant:
+ * one BC7 mode, one BC6H mode, one BC1 color mode and so on. Every dispatch
+ * is timed with timestamps, results are in ns per block with their spread,
+ * so kernel changes can be judged mode by mode. Where the driver has
+ * VK_KHR_pipeline_executable_properties, the compiler statistics of every
+ * kernel (registers, spills, instruction counts...) are reported with the
+ * timings, and -i also prints the internal representations.
+ *
+ * usage: bcn_kernel_bench [-n repetitions] [-d device] [-s size] [-f case] [-o json] [-i]
+ */
+
+#include "../src/format.hpp"
+#include "../src/s3tc_spv.h"
+#include "../src/rgtc_spv.h"
+#include "../src/bc6_spv.h"
+#include "../src/bc7_spv.h"
+#include "common.hpp"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/* Mirrors struct push_constants in src/bcn.hpp. */
+struct kernel_registers {
+	int format;
+	int width;
+	int height;
+	int offset;
+	int bufferRowLength;
+	int offsetX;
+	int offsetY;
+	int use_image_view;
+};
+
+/* Matches local_size in the shaders. */
+#define KERNEL_GROUP_SIZE 8
+
+enum block_variant {
+	VARIANT_BC1_4COLOR,
+	VARIANT_BC1_3COLOR,
+	VARIANT_BC2,
+	VARIANT_BC3_8ALPHA,
+	VARIANT_BC3_6ALPHA,
+	VARIANT_BC4_8ALPHA,
+	VARIANT_BC4_6ALPHA,
+	VARIANT_BC5,
+	VARIANT_BC6H,
+	VARIANT_BC7
+};
+
+struct kernel_case {
+	std::string name;
+	VkFormat format;
+	enum bcn_family family;
+	enum block_variant variant;
+	uint32_t mode;
+};
+
+struct kernel_result {
+	double meanNs;
+	double minNs;
+	double medianNs;
+	double stddevNs;
+};
+
+static uint64_t
+xorshift(uint64_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+/* Two distinct 16 bit values, the larger first when descending is set. */
+static void
+ordered_pair(uint64_t &state, bool descending, uint16_t *a, uint16_t *b)
+{
+	uint16_t x = xorshift(state), y = xorshift(state);
+
+	if (x == y)
+		y ^= 1;
+
+	*a = descending ? std::max(x, y) : std::min(x, y);
+	*b = descending ? std::min(x, y) : std::max(x, y);
+}
+
+static void
+color_block(uint64_t &state, bool fourColor, uint8_t *dst)
+{
+	uint16_t c0, c1;
+	uint32_t indices = xorshift(state);
+
+	ordered_pair(state, fourColor, &c0, &c1);
+	memcpy(dst, &c0, 2);
+	memcpy(dst + 2, &c1, 2);
+	memcpy(dst + 4, &indices, 4);
+}
+
+/* The 8 value mode has the first endpoint strictly greater. */
+static void
+alpha_block(uint64_t &state, bool eightAlpha, uint8_t *dst)
+{
+	uint64_t bits = xorshift(state);
+	uint8_t a0 = bits, a1 = bits >> 8;
+
+	if (a0 == a1)
+		a1 ^= 1;
+
+	dst[0] = eightAlpha ? std::max(a0, a1) : std::min(a0, a1);
+	dst[1] = eightAlpha ? std::min(a0, a1) : std::max(a0, a1);
+	memcpy(dst + 2, (uint8_t *)&bits + 2, 6);
+}
+
+static void
+generate_block(const struct kernel_case &c, uint64_t &state, uint8_t *dst)
+{
+	uint64_t lo = xorshift(state), hi = xorshift(state);
+
+	switch (c.variant) {
+		case VARIANT_BC1_4COLOR:
+		case VARIANT_BC1_3COLOR:
+			color_block(state, c.variant == VARIANT_BC1_4COLOR, dst);
+			break;
+		case VARIANT_BC2:
+			memcpy(dst, &lo, 8);
+			color_block(state, true, dst + 8);
+			break;
+		case VARIANT_BC3_8ALPHA:
+		case VARIANT_BC3_6ALPHA:
+			alpha_block(state, c.variant == VARIANT_BC3_8ALPHA, dst);
+			color_block(state, true, dst + 8);
+			break;
+		case VARIANT_BC4_8ALPHA:
+		case VARIANT_BC4_6ALPHA:
+			alpha_block(state, c.variant == VARIANT_BC4_8ALPHA, dst);
+			break;
+		case VARIANT_BC5:
+			alpha_block(state, true, dst);
+			alpha_block(state, true, dst + 8);
+			break;
+		case VARIANT_BC6H:
+			/* Two bit mode codes have bit 1 clear, the others take five bits. */
+			memcpy(dst, &lo, 8);
+			memcpy(dst + 8, &hi, 8);
+			dst[0] = (c.mode & 2) ? (dst[0] & ~0x1f) | c.mode : (dst[0] & ~0x3) | c.mode;
+			break;
+		case VARIANT_BC7:
+			/* The mode is the position of the lowest set bit. */
+			memcpy(dst, &lo, 8);
+			memcpy(dst + 8, &hi, 8);
+			dst[0] = (dst[0] & ~((2u << c.mode) - 1)) | (1u << c.mode);
+			break;
+	}
+}
+
+static void
+build_cases(std::vector<struct kernel_case> &cases)
+{
+	cases.push_back({ "BC1_4COLOR", VK_FORMAT_BC1_RGBA_UNORM_BLOCK, BCN_FAMILY_S3TC, VARIANT_BC1_4COLOR, 0 });
+	cases.push_back({ "BC1_3COLOR", VK_FORMAT_BC1_RGBA_UNORM_BLOCK, BCN_FAMILY_S3TC, VARIANT_BC1_3COLOR, 0 });
+	cases.push_back({ "BC2", VK_FORMAT_BC2_UNORM_BLOCK, BCN_FAMILY_S3TC, VARIANT_BC2, 0 });
+	cases.push_back({ "BC3_8ALPHA", VK_FORMAT_BC3_UNORM_BLOCK, BCN_FAMILY_S3TC, VARIANT_BC3_8ALPHA, 0 });
+	cases.push_back({ "BC3_6ALPHA", VK_FORMAT_BC3_UNORM_BLOCK, BCN_FAMILY_S3TC, VARIANT_BC3_6ALPHA, 0 });
+	cases.push_back({ "BC4_8ALPHA", VK_FORMAT_BC4_UNORM_BLOCK, BCN_FAMILY_RGTC, VARIANT_BC4_8ALPHA, 0 });
+	cases.push_back({ "BC4_6ALPHA", VK_FORMAT_BC4_UNORM_BLOCK, BCN_FAMILY_RGTC, VARIANT_BC4_6ALPHA, 0 });
+	cases.push_back({ "BC5", VK_FORMAT_BC5_UNORM_BLOCK, BCN_FAMILY_RGTC, VARIANT_BC5, 0 });
+
+	/* Mode codes as the shader switches on them, the reserved ones are left out. */
+	static const uint32_t bc6_modes[] = { 0, 1, 2, 3, 6, 7, 10, 11, 14, 15, 18, 22, 26, 30 };
+	for (uint32_t mode : bc6_modes)
+		cases.push_back({ "BC6H_MODE" + std::to_string(mode), VK_FORMAT_BC6H_UFLOAT_BLOCK, BCN_FAMILY_BC6, VARIANT_BC6H, mode });
+
+	for (uint32_t mode = 0; mode < 8; mode++)
+		cases.push_back({ "BC7_MODE" + std::to_string(mode), VK_FORMAT_BC7_UNORM_BLOCK, BCN_FAMILY_BC7, VARIANT_BC7, mode });
+}
+
+struct kernel_pipelines {
+	VkDescriptorSetLayout setLayout;
+	VkPipelineLayout layout;
+	VkPipeline pipelines[BCN_FAMILY_COUNT];
+	std::vector<struct vk_executable> executables[BCN_FAMILY_COUNT];
+	VkDescriptorPool pool;
+	VkDescriptorSet set;
+};
+
+static bool
+create_pipelines(const struct vk_context *ctx, bool internal, struct kernel_pipelines *kp)
+{
+	*kp = {};
+
+	VkDescriptorSetLayoutBinding bindings[2] = {
+		{ 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+		{ 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }
+	};
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.bindingCount = 2,
+		.pBindings = bindings
+	};
+
+	if (vkCreateDescriptorSetLayout(ctx->device, &set_layout_info, nullptr, &kp->setLayout) != VK_SUCCESS)
+		return false;
+
+	VkPushConstantRange push_constant = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(struct kernel_registers)
+	};
+
+	VkPipelineLayoutCreateInfo layout_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.setLayoutCount = 1,
+		.pSetLayouts = &kp->setLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constant
+	};
+
+	if (vkCreatePipelineLayout(ctx->device, &layout_info, nullptr, &kp->layout) != VK_SUCCESS)
+		return false;
+
+	const unsigned char *code[BCN_FAMILY_COUNT] = { s3tc_spv, rgtc_spv, bc6_spv, bc7_spv };
+	size_t size[BCN_FAMILY_COUNT] = { s3tc_spv_len, rgtc_spv_len, bc6_spv_len, bc7_spv_len };
+
+	for (uint32_t family = 0; family < BCN_FAMILY_COUNT; family++) {
+		VkShaderModule module;
+
+		VkShaderModuleCreateInfo shader_info = {
+			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.codeSize = size[family],
+			.pCode = (const uint32_t *)code[family]
+		};
+
+		if (vkCreateShaderModule(ctx->device, &shader_info, nullptr, &module) != VK_SUCCESS)
+			return false;
+
+		VkPipelineCreateFlags flags = 0;
+		if (ctx->executable_properties) {
+			flags = VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR |
+				(internal ? VK_PIPELINE_CREATE_CAPTURE_INTERNAL_REPRESENTATIONS_BIT_KHR : 0);
+		}
+
+		VkComputePipelineCreateInfo pipeline_info = {
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = flags,
+			.stage = {
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.pNext = nullptr,
+				.flags = 0,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = module,
+				.pName = "main",
+				.pSpecializationInfo = nullptr
+			},
+			.layout = kp->layout,
+			.basePipelineHandle = VK_NULL_HANDLE,
+			.basePipelineIndex = -1
+		};
+
+		VkResult result = vkCreateComputePipelines(ctx->device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
+			&kp->pipelines[family]);
+		vkDestroyShaderModule(ctx->device, module, nullptr);
+
+		if (result != VK_SUCCESS) {
+			fprintf(stderr, "bcn_kernel_bench: failed to create pipeline %u, res %d\n", family, result);
+			return false;
+		}
+
+		vk_pipeline_executables(ctx, kp->pipelines[family], internal, kp->executables[family]);
+	}
+
+	VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 };
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.maxSets = 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size
+	};
+
+	if (vkCreateDescriptorPool(ctx->device, &pool_info, nullptr, &kp->pool) != VK_SUCCESS)
+		return false;
+
+	VkDescriptorSetAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = kp->pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &kp->setLayout
+	};
+
+	return vkAllocateDescriptorSets(ctx->device, &alloc_info, &kp->set) == VK_SUCCESS;
+}
+
+static void
+destroy_pipelines(const struct vk_context *ctx, struct kernel_pipelines *kp)
+{
+	for (uint32_t family = 0; family < BCN_FAMILY_COUNT; family++) {
+		if (kp->pipelines[family])
+			vkDestroyPipeline(ctx->device, kp->pipelines[family], nullptr);
+	}
+
+	if (kp->pool)
+		vkDestroyDescriptorPool(ctx->device, kp->pool, nullptr);
+	if (kp->layout)
+		vkDestroyPipelineLayout(ctx->device, kp->layout, nullptr);
+	if (kp->setLayout)
+		vkDestroyDescriptorSetLayout(ctx->device, kp->setLayout, nullptr);
+}
+
+/*
+ * Uploads the blocks of a case to a device local input buffer, then times
+ * repetitions + 1 dispatches in one submission. The first one warms the
+ * caches and is dropped. Dispatches are serialized with barriers so every
+ * timestamp pair covers a single one.
+ */
+static bool
+run_case(const struct vk_context *ctx, const struct kernel_pipelines *kp, VkQueryPool queries, uint64_t timestampMask,
+		 const struct kernel_case &c, uint32_t size, uint32_t repetitions, struct kernel_result *result)
+{
+	uint32_t blocks = (size / 4) * (size / 4);
+	VkDeviceSize blockSize = get_block_size(c.format);
+	VkDeviceSize inputSize = blocks * blockSize;
+	VkDeviceSize outputSize = (VkDeviceSize)size * size * (c.family == BCN_FAMILY_BC6 ? 8 : 4);
+	struct vk_buffer staging, input, output;
+	bool ok = false;
+
+	if (!vk_buffer_create(ctx, inputSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true, &staging))
+		return false;
+
+	if (!vk_buffer_create(ctx, inputSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			false, &input)) {
+		vk_buffer_destroy(ctx, &staging);
+		return false;
+	}
+
+	if (!vk_buffer_create(ctx, outputSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false, &output)) {
+		vk_buffer_destroy(ctx, &input);
+		vk_buffer_destroy(ctx, &staging);
+		return false;
+	}
+
+	uint64_t state = 0x2545f4914f6cdd1dull ^ ((uint64_t)c.format << 8) ^ c.mode;
+	for (uint32_t i = 0; i < blocks; i++)
+		generate_block(c, state, (uint8_t *)staging.mapped + i * blockSize);
+
+	VkDescriptorBufferInfo buffer_infos[2] = {
+		{ output.handle, 0, VK_WHOLE_SIZE },
+		{ input.handle, 0, VK_WHOLE_SIZE }
+	};
+
+	VkWriteDescriptorSet writes[2];
+	for (uint32_t i = 0; i < 2; i++) {
+		writes[i] = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = nullptr,
+			.dstSet = kp->set,
+			.dstBinding = i,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pImageInfo = nullptr,
+			.pBufferInfo = &buffer_infos[i],
+			.pTexelBufferView = nullptr
+		};
+	}
+
+	vkUpdateDescriptorSets(ctx->device, 2, writes, 0, nullptr);
+
+	struct kernel_registers registers = {
+		.format = c.format,
+		.width = (int)size,
+		.height = (int)size,
+		.offset = 0,
+		.bufferRowLength = (int)size,
+		.offsetX = 0,
+		.offsetY = 0,
+		.use_image_view = 0
+	};
+
+	VkCommandBuffer cmd = vk_begin(ctx);
+
+	VkBufferCopy copy = { 0, 0, inputSize };
+	vkCmdCopyBuffer(cmd, staging.handle, input.handle, 1, &copy);
+	vkCmdResetQueryPool(cmd, queries, 0, 2 * (repetitions + 1));
+
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, kp->pipelines[c.family]);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, kp->layout, 0, 1, &kp->set, 0, nullptr);
+	vkCmdPushConstants(cmd, kp->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(registers), &registers);
+
+	uint32_t groups = (size + KERNEL_GROUP_SIZE - 1) / KERNEL_GROUP_SIZE;
+
+	for (uint32_t i = 0; i <= repetitions; i++) {
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries, 2 * i);
+		vkCmdDispatch(cmd, groups, groups, 1);
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries, 2 * i + 1);
+	}
+
+	if (vk_submit_wait(ctx, cmd)) {
+		std::vector<uint64_t> stamps(2 * (repetitions + 1));
+
+		if (vkGetQueryPoolResults(ctx->device, queries, 0, stamps.size(), stamps.size() * sizeof(uint64_t),
+				stamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) == VK_SUCCESS) {
+			std::vector<double> perBlock;
+			double sum = 0.0, squares = 0.0;
+
+			for (uint32_t i = 1; i <= repetitions; i++) {
+				uint64_t ticks = (stamps[2 * i + 1] - stamps[2 * i]) & timestampMask;
+				double ns = ticks * (double)ctx->props.limits.timestampPeriod / blocks;
+
+				perBlock.push_back(ns);
+				sum += ns;
+				squares += ns * ns;
+			}
+
+			result->meanNs = sum / repetitions;
+			result->stddevNs = sqrt(std::max(0.0, squares / repetitions - result->meanNs * result->meanNs));
+			result->minNs = percentile(perBlock, 0.0);
+			result->medianNs = percentile(perBlock, 0.5);
+			ok = true;
+		}
+	}
+
+	vk_buffer_destroy(ctx, &output);
+	vk_buffer_destroy(ctx, &input);
+	vk_buffer_destroy(ctx, &staging);
+
+	return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *deviceFilter = nullptr;
+	const char *caseFilter = nullptr;
+	const char *jsonPath = nullptr;
+	uint32_t repetitions = 20;
+	uint32_t size = 2048;
+	bool internal = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:d:s:f:o:i")) != -1) {
+		switch (opt) {
+			case 'n':
+				repetitions = std::max(1, atoi(optarg));
+				break;
+			case 'd':
+				deviceFilter = optarg;
+				break;
+			case 's':
+				size = std::max(8, atoi(optarg)) & ~3u;
+				break;
+			case 'f':
+				caseFilter = optarg;
+				break;
+			case 'o':
+				jsonPath = optarg;
+				break;
+			case 'i':
+				internal = true;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-n repetitions] [-d device] [-s size] [-f case] [-o json] [-i]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	struct vk_context ctx;
+	if (!vk_context_create(&ctx, deviceFilter, false))
+		return 1;
+
+	uint32_t count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(ctx.physical, &count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(count);
+	vkGetPhysicalDeviceQueueFamilyProperties(ctx.physical, &count, families.data());
+
+	uint32_t validBits = families[ctx.family].timestampValidBits;
+	if (!validBits) {
+		fprintf(stderr, "bcn_kernel_bench: %s has no timestamps on queue family %u\n", ctx.props.deviceName, ctx.family);
+		vk_context_destroy(&ctx);
+		return 1;
+	}
+
+	uint64_t timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	VkPhysicalDeviceSubgroupProperties subgroup = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+		.pNext = nullptr
+	};
+
+	VkPhysicalDeviceProperties2 props2 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &subgroup
+	};
+
+	vkGetPhysicalDeviceProperties2(ctx.physical, &props2);
+
+	VkQueryPoolCreateInfo query_info = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = 2 * (repetitions + 1),
+		.pipelineStatistics = 0
+	};
+
+	VkQueryPool queries;
+	struct kernel_pipelines kp;
+
+	if (vkCreateQueryPool(ctx.device, &query_info, nullptr, &queries) != VK_SUCCESS) {
+		vk_context_destroy(&ctx);
+		return 1;
+	}
+
+	if (!create_pipelines(&ctx, internal, &kp)) {
+		destroy_pipelines(&ctx, &kp);
+		vkDestroyQueryPool(ctx.device, queries, nullptr);
+		vk_context_destroy(&ctx);
+		return 1;
+	}
+
+	/*
+	 * Occupancy hints: every invocation decodes one texel, so a workgroup
+	 * covers 2x2 blocks and spans this many subgroups.
+	 */
+	uint32_t groupInvocations = KERNEL_GROUP_SIZE * KERNEL_GROUP_SIZE;
+	uint32_t subgroupsPerGroup = (groupInvocations + subgroup.subgroupSize - 1) / std::max(subgroup.subgroupSize, 1u);
+	uint32_t groups = ((size + KERNEL_GROUP_SIZE - 1) / KERNEL_GROUP_SIZE) * ((size + KERNEL_GROUP_SIZE - 1) / KERNEL_GROUP_SIZE);
+
+	printf("device: %s, %ux%u texels, %u blocks, %u repetitions\n", ctx.props.deviceName, size, size,
+		(size / 4) * (size / 4), repetitions);
+	printf("workgroup: %u invocations, 16 per block, subgroup size %u, %u subgroups per workgroup, %u workgroups\n",
+		groupInvocations, subgroup.subgroupSize, subgroupsPerGroup, groups);
+
+	if (!ctx.executable_properties)
+		printf("compiler statistics: not reported by the driver\n");
+
+	for (uint32_t family = 0; family < BCN_FAMILY_COUNT; family++) {
+		for (const struct vk_executable &executable : kp.executables[family]) {
+			printf("%s %s, subgroup size %u:", get_bcn_family_name((enum bcn_family)family), executable.name.c_str(),
+				executable.subgroupSize);
+
+			for (size_t i = 0; i < executable.statistics.size(); i++) {
+				printf("%s %s %s", i ? "," : "", executable.statistics[i].first.c_str(),
+					executable.statistics[i].second.c_str());
+			}
+			printf("\n");
+
+			for (const auto &representation : executable.representations)
+				printf("--- %s ---\n%s\n", representation.first.c_str(), representation.second.c_str());
+		}
+	}
+
+	printf("%-14s %12s %12s %12s %12s %8s\n", "case", "mean ns/blk", "min ns/blk", "p50 ns/blk", "stddev", "cv %");
+
+	std::vector<struct kernel_case> cases;
+	std::vector<std::pair<const struct kernel_case *, struct kernel_result>> results;
+	bool ok = true;
+
+	build_cases(cases);
+
+	for (const struct kernel_case &c : cases) {
+		if (caseFilter && !strcasestr(c.name.c_str(), caseFilter))
+			continue;
+
+		struct kernel_result result;
+		if (!run_case(&ctx, &kp, queries, timestampMask, c, size, repetitions, &result)) {
+			fprintf(stderr, "bcn_kernel_bench: %s failed\n", c.name.c_str());
+			ok = false;
+			continue;
+		}
+
+		printf("%-14s %12.4f %12.4f %12.4f %12.4f %8.2f\n", c.name.c_str(), result.meanNs, result.minNs,
+			result.medianNs, result.stddevNs, result.meanNs > 0.0 ? 100.0 * result.stddevNs / result.meanNs : 0.0);
+		fflush(stdout);
+
+		results.push_back({ &c, result });
+	}
+
+	if (jsonPath) {
+		FILE *file = strcmp(jsonPath, "-") ? fopen(jsonPath, "w") : stdout;
+
+		if (file) {
+			fprintf(file, "{\n  \"device\": \"%s\",\n  \"size\": %u,\n  \"repetitions\": %u,\n"
+				"  \"workgroup_invocations\": %u,\n  \"subgroup_size\": %u,\n  \"subgroups_per_workgroup\": %u,\n"
+				"  \"workgroups\": %u,\n  \"cases\": [", ctx.props.deviceName, size, repetitions, groupInvocations,
+				subgroup.subgroupSize, subgroupsPerGroup, groups);
+
+			for (size_t i = 0; i < results.size(); i++) {
+				const struct kernel_result &r = results[i].second;
+
+				fprintf(file, "%s\n    {\"case\": \"%s\", \"format\": \"%s\", \"mean_ns_per_block\": %.5f, "
+					"\"min_ns_per_block\": %.5f, \"median_ns_per_block\": %.5f, \"stddev_ns_per_block\": %.5f}",
+					i ? "," : "", results[i].first->name.c_str(), get_format_name(results[i].first->format),
+					r.meanNs, r.minNs, r.medianNs, r.stddevNs);
+			}
+
+			fprintf(file, "\n  ],\n  \"pipelines\": [");
+
+			bool first = true;
+			for (uint32_t family = 0; family < BCN_FAMILY_COUNT; family++) {
+				for (const struct vk_executable &executable : kp.executables[family]) {
+					fprintf(file, "%s\n    {\"family\": \"%s\", \"executable\": \"%s\", \"subgroup_size\": %u, \"statistics\": {",
+						first ? "" : ",", get_bcn_family_name((enum bcn_family)family), executable.name.c_str(),
+						executable.subgroupSize);
+
+					for (size_t i = 0; i < executable.statistics.size(); i++) {
+						fprintf(file, "%s\"%s\": %s", i ? ", " : "", executable.statistics[i].first.c_str(),
+							executable.statistics[i].second.c_str());
+					}
+
+					fprintf(file, "}}");
+					first = false;
+				}
+			}
+
+			fprintf(file, "\n  ]\n}\n");
+			if (file != stdout)
+				fclose(file);
+		} else {
+			fprintf(stderr, "bcn_kernel_bench: cannot write %s\n", jsonPath);
+			ok = false;
+		}
+	}
+
+	destroy_pipelines(&ctx, &kp);
+	vkDestroyQueryPool(ctx.device, queries, nullptr);
+	vk_context_destroy(&ctx);
+
+	return ok ? 0 : 1;
+}
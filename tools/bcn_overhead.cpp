@@ -0,0 +1,1046 @@
+/*
+ * bcn_overhead: measures the CPU cost of the layer's entry points without
+ * a GPU. The layer is loaded with dlopen and chained, the way the loader
+ * does it, over a stub driver implemented here whose functions return
+ * immediately. Each operation is hammered from 1 to N threads, every thread
+ * with its own queue, command pool and objects, and reported in ns per call
+ * with the scaling efficiency against the single thread run.
+ *
+ * usage: bcn_overhead [-t max threads] [-n calls per thread] [-l layer library]
+ */
+
+#include <vulkan/vulkan.h>
+#include "../src/vulkan/vk_layer.h"
+
+#include <dlfcn.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/* Stub driver. Dispatchable objects start with the key the layer looks them up by. */
+
+struct stub_dispatchable {
+	void *key;
+};
+
+struct stub_buffer {
+	VkDeviceSize size;
+};
+
+struct stub_image {
+	VkExtent3D extent;
+	VkDeviceSize size;
+};
+
+#define STUB_QUEUES 64
+
+static void *stub_instance_key = &stub_instance_key;
+static void *stub_device_key = &stub_device_key;
+static struct stub_dispatchable stub_instance = { &stub_instance_key };
+static struct stub_dispatchable stub_physical = { &stub_instance_key };
+static struct stub_dispatchable stub_device = { &stub_device_key };
+static struct stub_dispatchable stub_queues[STUB_QUEUES];
+static std::atomic<uint64_t> stub_handles(0x1000);
+
+template <typename T>
+static T
+stub_handle()
+{
+	return (T)stub_handles.fetch_add(1, std::memory_order_relaxed);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_CreateInstance(const VkInstanceCreateInfo *, const VkAllocationCallbacks *, VkInstance *pInstance)
+{
+	*pInstance = (VkInstance)&stub_instance;
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_DestroyInstance(VkInstance, const VkAllocationCallbacks *)
+{
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_EnumeratePhysicalDevices(VkInstance, uint32_t *pCount, VkPhysicalDevice *pPhysicalDevices)
+{
+	if (pPhysicalDevices && *pCount)
+		pPhysicalDevices[0] = (VkPhysicalDevice)&stub_physical;
+
+	*pCount = 1;
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetPhysicalDeviceFeatures(VkPhysicalDevice, VkPhysicalDeviceFeatures *pFeatures)
+{
+	memset(pFeatures, 0, sizeof(*pFeatures));
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetPhysicalDeviceFeatures2(VkPhysicalDevice, VkPhysicalDeviceFeatures2 *pFeatures)
+{
+	memset(&pFeatures->features, 0, sizeof(pFeatures->features));
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties *pProperties)
+{
+	memset(pProperties, 0, sizeof(*pProperties));
+	pProperties->apiVersion = VK_API_VERSION_1_3;
+	pProperties->deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+	strcpy(pProperties->deviceName, "bcn_overhead stub");
+	pProperties->limits.maxImageDimension1D = 16384;
+	pProperties->limits.maxImageDimension2D = 16384;
+	pProperties->limits.maxImageDimension3D = 2048;
+	pProperties->limits.maxImageDimensionCube = 16384;
+	pProperties->limits.maxImageArrayLayers = 2048;
+	pProperties->limits.maxStorageBufferRange = UINT32_MAX;
+	pProperties->limits.maxPushConstantsSize = 128;
+	pProperties->limits.maxComputeWorkGroupCount[0] = 65535;
+	pProperties->limits.maxComputeWorkGroupCount[1] = 65535;
+	pProperties->limits.maxComputeWorkGroupCount[2] = 65535;
+	pProperties->limits.minStorageBufferOffsetAlignment = 16;
+	pProperties->limits.optimalBufferCopyOffsetAlignment = 16;
+	pProperties->limits.optimalBufferCopyRowPitchAlignment = 16;
+	pProperties->limits.nonCoherentAtomSize = 64;
+	pProperties->limits.timestampPeriod = 1.0f;
+	pProperties->limits.timestampComputeAndGraphics = VK_TRUE;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetPhysicalDeviceProperties2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2 *pProperties)
+{
+	stub_GetPhysicalDeviceProperties(physicalDevice, &pProperties->properties);
+
+	for (auto *s = (VkBaseOutStructure *)pProperties->pNext; s; s = s->pNext) {
+		if (s->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DRIVER_PROPERTIES)
+			((VkPhysicalDeviceDriverProperties *)s)->driverID = VK_DRIVER_ID_MESA_LLVMPIPE;
+	}
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties *pProperties)
+{
+	memset(pProperties, 0, sizeof(*pProperties));
+	pProperties->memoryTypeCount = 1;
+	pProperties->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	pProperties->memoryTypes[0].heapIndex = 0;
+	pProperties->memoryHeapCount = 1;
+	pProperties->memoryHeaps[0].size = 8ull << 30;
+	pProperties->memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetPhysicalDeviceMemoryProperties2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties2 *pProperties)
+{
+	stub_GetPhysicalDeviceMemoryProperties(physicalDevice, &pProperties->memoryProperties);
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetPhysicalDeviceFormatProperties(VkPhysicalDevice, VkFormat format, VkFormatProperties *pProperties)
+{
+	bool bc = format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+	VkFormatFeatureFlags features = bc ? 0 : VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+		VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+
+	pProperties->linearTilingFeatures = features;
+	pProperties->optimalTilingFeatures = features;
+	pProperties->bufferFeatures = 0;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_GetPhysicalDeviceImageFormatProperties(VkPhysicalDevice, VkFormat, VkImageType, VkImageTiling, VkImageUsageFlags,
+											VkImageCreateFlags, VkImageFormatProperties *pProperties)
+{
+	*pProperties = { { 16384, 16384, 1 }, 15, 2048, VK_SAMPLE_COUNT_1_BIT, 1ull << 32 };
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_GetPhysicalDeviceImageFormatProperties2(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceImageFormatInfo2 *pInfo,
+											 VkImageFormatProperties2 *pProperties)
+{
+	return stub_GetPhysicalDeviceImageFormatProperties(physicalDevice, pInfo->format, pInfo->type, pInfo->tiling,
+		pInfo->usage, pInfo->flags, &pProperties->imageFormatProperties);
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice, uint32_t *pCount, VkQueueFamilyProperties *pProperties)
+{
+	if (pProperties && *pCount) {
+		pProperties[0] = {
+			VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, STUB_QUEUES, 64, { 1, 1, 1 }
+		};
+	}
+
+	*pCount = 1;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_EnumerateDeviceExtensionProperties(VkPhysicalDevice, const char *, uint32_t *pCount, VkExtensionProperties *)
+{
+	*pCount = 0;
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_CreateDevice(VkPhysicalDevice, const VkDeviceCreateInfo *, const VkAllocationCallbacks *, VkDevice *pDevice)
+{
+	for (uint32_t i = 0; i < STUB_QUEUES; i++)
+		stub_queues[i].key = &stub_device_key;
+
+	*pDevice = (VkDevice)&stub_device;
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_DestroyDevice(VkDevice, const VkAllocationCallbacks *)
+{
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetDeviceQueue(VkDevice, uint32_t, uint32_t queueIndex, VkQueue *pQueue)
+{
+	*pQueue = (VkQueue)&stub_queues[queueIndex % STUB_QUEUES];
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_AllocateMemory(VkDevice, const VkMemoryAllocateInfo *pInfo, const VkAllocationCallbacks *, VkDeviceMemory *pMemory)
+{
+	void *data = calloc(1, pInfo->allocationSize);
+	if (!data)
+		return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+	*pMemory = (VkDeviceMemory)(uintptr_t)data;
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_FreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks *)
+{
+	free((void *)(uintptr_t)memory);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_MapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags, void **ppData)
+{
+	*ppData = (uint8_t *)(uintptr_t)memory + offset;
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_UnmapMemory(VkDevice, VkDeviceMemory)
+{
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_MappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange *)
+{
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_CreateBuffer(VkDevice, const VkBufferCreateInfo *pInfo, const VkAllocationCallbacks *, VkBuffer *pBuffer)
+{
+	*pBuffer = (VkBuffer)(uintptr_t)new stub_buffer{ pInfo->size };
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_DestroyBuffer(VkDevice, VkBuffer buffer, const VkAllocationCallbacks *)
+{
+	delete (struct stub_buffer *)(uintptr_t)buffer;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetBufferMemoryRequirements(VkDevice, VkBuffer buffer, VkMemoryRequirements *pRequirements)
+{
+	pRequirements->size = (((struct stub_buffer *)(uintptr_t)buffer)->size + 255) & ~255ull;
+	pRequirements->alignment = 256;
+	pRequirements->memoryTypeBits = 1;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_BindMemory(VkDevice, uint64_t, VkDeviceMemory, VkDeviceSize)
+{
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_BindImageMemory2(VkDevice, uint32_t, const VkBindImageMemoryInfo *)
+{
+	return VK_SUCCESS;
+}
+
+/* Sized for 16 bytes per texel with a full mip chain, enough for any emulated format. */
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_CreateImage(VkDevice, const VkImageCreateInfo *pInfo, const VkAllocationCallbacks *, VkImage *pImage)
+{
+	VkDeviceSize size = (VkDeviceSize)pInfo->extent.width * pInfo->extent.height * pInfo->extent.depth *
+		pInfo->arrayLayers * 16 * 4 / 3;
+
+	*pImage = (VkImage)(uintptr_t)new stub_image{ pInfo->extent, (size + 255) & ~255ull };
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_DestroyImage(VkDevice, VkImage image, const VkAllocationCallbacks *)
+{
+	delete (struct stub_image *)(uintptr_t)image;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetImageMemoryRequirements(VkDevice, VkImage image, VkMemoryRequirements *pRequirements)
+{
+	pRequirements->size = ((struct stub_image *)(uintptr_t)image)->size;
+	pRequirements->alignment = 256;
+	pRequirements->memoryTypeBits = 1;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_GetImageSubresourceLayout(VkDevice, VkImage image, const VkImageSubresource *, VkSubresourceLayout *pLayout)
+{
+	const struct stub_image *img = (const struct stub_image *)(uintptr_t)image;
+
+	pLayout->offset = 0;
+	pLayout->rowPitch = img->extent.width * 16;
+	pLayout->depthPitch = pLayout->rowPitch * img->extent.height;
+	pLayout->arrayPitch = pLayout->depthPitch * img->extent.depth;
+	pLayout->size = img->size;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_AllocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo *pInfo, VkCommandBuffer *pCommandBuffers)
+{
+	for (uint32_t i = 0; i < pInfo->commandBufferCount; i++)
+		pCommandBuffers[i] = (VkCommandBuffer)new stub_dispatchable{ &stub_device_key };
+
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+stub_FreeCommandBuffers(VkDevice, VkCommandPool, uint32_t count, const VkCommandBuffer *pCommandBuffers)
+{
+	for (uint32_t i = 0; i < count; i++)
+		delete (struct stub_dispatchable *)pCommandBuffers[i];
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_SetDeviceLoaderData(VkDevice device, void *object)
+{
+	*(void **)object = *(void **)device;
+	return VK_SUCCESS;
+}
+
+/* Non-dispatchable objects with nothing behind them share these. */
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_Create(VkDevice, const void *, const VkAllocationCallbacks *, uint64_t *pHandle)
+{
+	*pHandle = stub_handle<uint64_t>();
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_CreatePipelines(VkDevice, VkPipelineCache, uint32_t count, const void *, const VkAllocationCallbacks *,
+					 VkPipeline *pPipelines)
+{
+	for (uint32_t i = 0; i < count; i++)
+		pPipelines[i] = stub_handle<VkPipeline>();
+
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_AllocateDescriptorSets(VkDevice, const VkDescriptorSetAllocateInfo *pInfo, VkDescriptorSet *pSets)
+{
+	for (uint32_t i = 0; i < pInfo->descriptorSetCount; i++)
+		pSets[i] = stub_handle<VkDescriptorSet>();
+
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_GetPipelineCacheData(VkDevice, VkPipelineCache, size_t *pSize, void *)
+{
+	*pSize = 0;
+	return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_GetQueryPoolResults(VkDevice, VkQueryPool, uint32_t, uint32_t, size_t size, void *pData, VkDeviceSize,
+						 VkQueryResultFlags)
+{
+	memset(pData, 0, size);
+	return VK_SUCCESS;
+}
+
+/*
+ * Everything else either returns nothing or VK_SUCCESS with nothing to
+ * fill in. The callers always pass arguments in registers or on a stack
+ * they clean up, so these ignore them.
+ */
+static VKAPI_ATTR void VKAPI_CALL
+stub_void()
+{
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+stub_success()
+{
+	return VK_SUCCESS;
+}
+
+struct stub_entry {
+	const char *name;
+	PFN_vkVoidFunction function;
+};
+
+#define STUB(name, function) { "vk" name, (PFN_vkVoidFunction)&function }
+
+static const struct stub_entry stub_entries[] = {
+	STUB("CreateInstance", stub_CreateInstance),
+	STUB("DestroyInstance", stub_DestroyInstance),
+	STUB("EnumeratePhysicalDevices", stub_EnumeratePhysicalDevices),
+	STUB("GetPhysicalDeviceFeatures", stub_GetPhysicalDeviceFeatures),
+	STUB("GetPhysicalDeviceFeatures2", stub_GetPhysicalDeviceFeatures2),
+	STUB("GetPhysicalDeviceProperties", stub_GetPhysicalDeviceProperties),
+	STUB("GetPhysicalDeviceProperties2", stub_GetPhysicalDeviceProperties2),
+	STUB("GetPhysicalDeviceMemoryProperties", stub_GetPhysicalDeviceMemoryProperties),
+	STUB("GetPhysicalDeviceMemoryProperties2", stub_GetPhysicalDeviceMemoryProperties2),
+	STUB("GetPhysicalDeviceFormatProperties", stub_GetPhysicalDeviceFormatProperties),
+	STUB("GetPhysicalDeviceImageFormatProperties", stub_GetPhysicalDeviceImageFormatProperties),
+	STUB("GetPhysicalDeviceImageFormatProperties2", stub_GetPhysicalDeviceImageFormatProperties2),
+	STUB("GetPhysicalDeviceQueueFamilyProperties", stub_GetPhysicalDeviceQueueFamilyProperties),
+	STUB("EnumerateDeviceExtensionProperties", stub_EnumerateDeviceExtensionProperties),
+	STUB("CreateDevice", stub_CreateDevice),
+	STUB("DestroyDevice", stub_DestroyDevice),
+	STUB("GetDeviceQueue", stub_GetDeviceQueue),
+	STUB("AllocateMemory", stub_AllocateMemory),
+	STUB("FreeMemory", stub_FreeMemory),
+	STUB("MapMemory", stub_MapMemory),
+	STUB("UnmapMemory", stub_UnmapMemory),
+	STUB("FlushMappedMemoryRanges", stub_MappedMemoryRanges),
+	STUB("InvalidateMappedMemoryRanges", stub_MappedMemoryRanges),
+	STUB("CreateBuffer", stub_CreateBuffer),
+	STUB("DestroyBuffer", stub_DestroyBuffer),
+	STUB("GetBufferMemoryRequirements", stub_GetBufferMemoryRequirements),
+	STUB("BindBufferMemory", stub_BindMemory),
+	STUB("BindImageMemory", stub_BindMemory),
+	STUB("BindImageMemory2", stub_BindImageMemory2),
+	STUB("CreateImage", stub_CreateImage),
+	STUB("DestroyImage", stub_DestroyImage),
+	STUB("GetImageMemoryRequirements", stub_GetImageMemoryRequirements),
+	STUB("GetImageSubresourceLayout", stub_GetImageSubresourceLayout),
+	STUB("AllocateCommandBuffers", stub_AllocateCommandBuffers),
+	STUB("FreeCommandBuffers", stub_FreeCommandBuffers),
+	STUB("CreateImageView", stub_Create),
+	STUB("CreateCommandPool", stub_Create),
+	STUB("CreateFence", stub_Create),
+	STUB("CreateDescriptorSetLayout", stub_Create),
+	STUB("CreateShaderModule", stub_Create),
+	STUB("CreatePipelineLayout", stub_Create),
+	STUB("CreateDescriptorPool", stub_Create),
+	STUB("CreatePipelineCache", stub_Create),
+	STUB("CreateQueryPool", stub_Create),
+	STUB("CreateComputePipelines", stub_CreatePipelines),
+	STUB("CreateGraphicsPipelines", stub_CreatePipelines),
+	STUB("AllocateDescriptorSets", stub_AllocateDescriptorSets),
+	STUB("GetPipelineCacheData", stub_GetPipelineCacheData),
+	STUB("GetQueryPoolResults", stub_GetQueryPoolResults),
+	STUB("DestroyImageView", stub_void),
+	STUB("DestroyCommandPool", stub_void),
+	STUB("DestroyFence", stub_void),
+	STUB("DestroyDescriptorSetLayout", stub_void),
+	STUB("DestroyShaderModule", stub_void),
+	STUB("DestroyPipelineLayout", stub_void),
+	STUB("DestroyDescriptorPool", stub_void),
+	STUB("DestroyPipelineCache", stub_void),
+	STUB("DestroyPipeline", stub_void),
+	STUB("DestroyQueryPool", stub_void),
+	STUB("UpdateDescriptorSets", stub_void),
+	STUB("CmdBindPipeline", stub_void),
+	STUB("CmdPushConstants", stub_void),
+	STUB("CmdBindDescriptorSets", stub_void),
+	STUB("CmdDispatch", stub_void),
+	STUB("CmdCopyBufferToImage", stub_void),
+	STUB("CmdCopyBuffer", stub_void),
+	STUB("CmdCopyImage", stub_void),
+	STUB("CmdPipelineBarrier", stub_void),
+	STUB("CmdWaitEvents", stub_void),
+	STUB("CmdExecuteCommands", stub_void),
+	STUB("CmdSetViewport", stub_void),
+	STUB("CmdSetScissor", stub_void),
+	STUB("CmdDraw", stub_void),
+	STUB("CmdResetQueryPool", stub_void),
+	STUB("CmdWriteTimestamp", stub_void),
+	STUB("FreeDescriptorSets", stub_success),
+	STUB("ResetFences", stub_success),
+	STUB("GetFenceStatus", stub_success),
+	STUB("WaitForFences", stub_success),
+	STUB("DeviceWaitIdle", stub_success),
+	STUB("QueueWaitIdle", stub_success),
+	STUB("QueueSubmit", stub_success),
+	STUB("BeginCommandBuffer", stub_success),
+	STUB("EndCommandBuffer", stub_success),
+	STUB("ResetCommandBuffer", stub_success),
+	STUB("ResetCommandPool", stub_success)
+};
+
+static PFN_vkVoidFunction
+stub_lookup(const char *pName)
+{
+	for (const struct stub_entry &entry : stub_entries) {
+		if (!strcmp(entry.name, pName))
+			return entry.function;
+	}
+
+	return nullptr;
+}
+
+static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL stub_GetDeviceProcAddr(VkDevice, const char *pName);
+
+static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+stub_GetInstanceProcAddr(VkInstance, const char *pName)
+{
+	if (!strcmp(pName, "vkGetInstanceProcAddr"))
+		return (PFN_vkVoidFunction)&stub_GetInstanceProcAddr;
+
+	return stub_lookup(pName);
+}
+
+static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+stub_GetDeviceProcAddr(VkDevice, const char *pName)
+{
+	if (!strcmp(pName, "vkGetDeviceProcAddr"))
+		return (PFN_vkVoidFunction)&stub_GetDeviceProcAddr;
+
+	return stub_lookup(pName);
+}
+
+/* Harness. */
+
+struct layer_device {
+	VkInstance instance;
+	VkPhysicalDevice physical;
+	VkDevice device;
+	PFN_vkGetDeviceProcAddr gdpa;
+	PFN_vkDestroyInstance DestroyInstance;
+	PFN_vkDestroyDevice DestroyDevice;
+	PFN_vkGetDeviceQueue GetDeviceQueue;
+	PFN_vkCreateBuffer CreateBuffer;
+	PFN_vkDestroyBuffer DestroyBuffer;
+	PFN_vkAllocateMemory AllocateMemory;
+	PFN_vkFreeMemory FreeMemory;
+	PFN_vkBindBufferMemory BindBufferMemory;
+	PFN_vkGetBufferMemoryRequirements GetBufferMemoryRequirements;
+	PFN_vkCreateImage CreateImage;
+	PFN_vkDestroyImage DestroyImage;
+	PFN_vkBindImageMemory BindImageMemory;
+	PFN_vkGetImageMemoryRequirements GetImageMemoryRequirements;
+	PFN_vkCreateCommandPool CreateCommandPool;
+	PFN_vkDestroyCommandPool DestroyCommandPool;
+	PFN_vkAllocateCommandBuffers AllocateCommandBuffers;
+	PFN_vkFreeCommandBuffers FreeCommandBuffers;
+	PFN_vkBeginCommandBuffer BeginCommandBuffer;
+	PFN_vkEndCommandBuffer EndCommandBuffer;
+	PFN_vkCmdCopyBufferToImage CmdCopyBufferToImage;
+	PFN_vkQueueSubmit QueueSubmit;
+	PFN_vkQueueWaitIdle QueueWaitIdle;
+};
+
+static bool
+create_layer_device(void *library, uint32_t threads, struct layer_device *ld)
+{
+	auto gipa = (PFN_vkGetInstanceProcAddr)dlsym(library, "BCnLayer_GetInstanceProcAddr");
+	ld->gdpa = (PFN_vkGetDeviceProcAddr)dlsym(library, "BCnLayer_GetDeviceProcAddr");
+
+	if (!gipa || !ld->gdpa) {
+		fprintf(stderr, "bcn_overhead: the library does not export the layer entry points\n");
+		return false;
+	}
+
+	VkLayerInstanceLink instance_link = { nullptr, &stub_GetInstanceProcAddr };
+	VkLayerInstanceCreateInfo instance_layer_info = {
+		.sType = VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO,
+		.pNext = nullptr,
+		.function = VK_LAYER_LINK_INFO,
+		.u = { .pLayerInfo = &instance_link }
+	};
+
+	VkInstanceCreateInfo instance_info = {
+		.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+		.pNext = &instance_layer_info
+	};
+
+	auto createInstance = (PFN_vkCreateInstance)gipa(VK_NULL_HANDLE, "vkCreateInstance");
+	if (createInstance(&instance_info, nullptr, &ld->instance) != VK_SUCCESS)
+		return false;
+
+	ld->DestroyInstance = (PFN_vkDestroyInstance)gipa(ld->instance, "vkDestroyInstance");
+
+	uint32_t count = 1;
+	auto enumeratePhysicalDevices = (PFN_vkEnumeratePhysicalDevices)gipa(ld->instance, "vkEnumeratePhysicalDevices");
+	enumeratePhysicalDevices(ld->instance, &count, &ld->physical);
+
+	std::vector<float> priorities(threads, 1.0f);
+	VkDeviceQueueCreateInfo queue_info = {
+		.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.queueFamilyIndex = 0,
+		.queueCount = threads,
+		.pQueuePriorities = priorities.data()
+	};
+
+	VkLayerDeviceLink device_link = { nullptr, &stub_GetInstanceProcAddr, &stub_GetDeviceProcAddr };
+	VkLayerDeviceCreateInfo loader_data_info = {
+		.sType = VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO,
+		.pNext = nullptr,
+		.function = VK_LOADER_DATA_CALLBACK,
+		.u = { .pfnSetDeviceLoaderData = &stub_SetDeviceLoaderData }
+	};
+	VkLayerDeviceCreateInfo device_layer_info = {
+		.sType = VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO,
+		.pNext = &loader_data_info,
+		.function = VK_LAYER_LINK_INFO,
+		.u = { .pLayerInfo = &device_link }
+	};
+
+	VkPhysicalDeviceFeatures features = {};
+	features.textureCompressionBC = VK_TRUE;
+
+	VkDeviceCreateInfo device_info = {
+		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+		.pNext = &device_layer_info,
+		.flags = 0,
+		.queueCreateInfoCount = 1,
+		.pQueueCreateInfos = &queue_info,
+		.enabledLayerCount = 0,
+		.ppEnabledLayerNames = nullptr,
+		.enabledExtensionCount = 0,
+		.ppEnabledExtensionNames = nullptr,
+		.pEnabledFeatures = &features
+	};
+
+	auto createDevice = (PFN_vkCreateDevice)gipa(ld->instance, "vkCreateDevice");
+	if (createDevice(ld->physical, &device_info, nullptr, &ld->device) != VK_SUCCESS) {
+		ld->DestroyInstance(ld->instance, nullptr);
+		return false;
+	}
+
+#define LOAD(func) ld->func = (PFN_vk##func)ld->gdpa(ld->device, "vk" #func)
+	LOAD(DestroyDevice);
+	LOAD(GetDeviceQueue);
+	LOAD(CreateBuffer);
+	LOAD(DestroyBuffer);
+	LOAD(AllocateMemory);
+	LOAD(FreeMemory);
+	LOAD(BindBufferMemory);
+	LOAD(GetBufferMemoryRequirements);
+	LOAD(CreateImage);
+	LOAD(DestroyImage);
+	LOAD(BindImageMemory);
+	LOAD(GetImageMemoryRequirements);
+	LOAD(CreateCommandPool);
+	LOAD(DestroyCommandPool);
+	LOAD(AllocateCommandBuffers);
+	LOAD(FreeCommandBuffers);
+	LOAD(BeginCommandBuffer);
+	LOAD(EndCommandBuffer);
+	LOAD(CmdCopyBufferToImage);
+	LOAD(QueueSubmit);
+	LOAD(QueueWaitIdle);
+#undef LOAD
+
+	return true;
+}
+
+#define BENCH_EXTENT 256
+#define BENCH_FORMAT VK_FORMAT_BC7_UNORM_BLOCK
+#define BENCH_BATCH 64
+
+/* What one thread owns: a queue, a pool, an upload source and a BC image. */
+struct thread_objects {
+	VkQueue queue;
+	VkCommandPool pool;
+	VkCommandBuffer cmd;
+	VkBuffer buffer;
+	VkDeviceMemory bufferMemory;
+	VkImage image;
+	VkDeviceMemory imageMemory;
+};
+
+static const VkImageCreateInfo bench_image_info = {
+	.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+	.pNext = nullptr,
+	.flags = 0,
+	.imageType = VK_IMAGE_TYPE_2D,
+	.format = BENCH_FORMAT,
+	.extent = { BENCH_EXTENT, BENCH_EXTENT, 1 },
+	.mipLevels = 1,
+	.arrayLayers = 1,
+	.samples = VK_SAMPLE_COUNT_1_BIT,
+	.tiling = VK_IMAGE_TILING_OPTIMAL,
+	.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+	.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+	.queueFamilyIndexCount = 0,
+	.pQueueFamilyIndices = nullptr,
+	.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+};
+
+static const VkBufferCreateInfo bench_buffer_info = {
+	.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+	.pNext = nullptr,
+	.flags = 0,
+	.size = (BENCH_EXTENT / 4) * (BENCH_EXTENT / 4) * 16,
+	.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+	.queueFamilyIndexCount = 0,
+	.pQueueFamilyIndices = nullptr
+};
+
+static const VkBufferImageCopy bench_region = {
+	.bufferOffset = 0,
+	.bufferRowLength = 0,
+	.bufferImageHeight = 0,
+	.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+	.imageOffset = { 0, 0, 0 },
+	.imageExtent = { BENCH_EXTENT, BENCH_EXTENT, 1 }
+};
+
+static const VkCommandBufferBeginInfo bench_begin_info = {
+	.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+	.pNext = nullptr,
+	.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+	.pInheritanceInfo = nullptr
+};
+
+static bool
+bind_memory(const struct layer_device *ld, const VkMemoryRequirements &reqs, VkDeviceMemory *memory)
+{
+	VkMemoryAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.allocationSize = reqs.size,
+		.memoryTypeIndex = 0
+	};
+
+	return ld->AllocateMemory(ld->device, &alloc_info, nullptr, memory) == VK_SUCCESS;
+}
+
+static bool
+create_thread_objects(const struct layer_device *ld, uint32_t index, struct thread_objects *obj)
+{
+	VkMemoryRequirements reqs;
+
+	memset(obj, 0, sizeof(*obj));
+	ld->GetDeviceQueue(ld->device, 0, index, &obj->queue);
+
+	VkCommandPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = 0
+	};
+
+	if (ld->CreateCommandPool(ld->device, &pool_info, nullptr, &obj->pool) != VK_SUCCESS)
+		return false;
+
+	VkCommandBufferAllocateInfo cmd_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.commandPool = obj->pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1
+	};
+
+	if (ld->AllocateCommandBuffers(ld->device, &cmd_info, &obj->cmd) != VK_SUCCESS ||
+		ld->CreateBuffer(ld->device, &bench_buffer_info, nullptr, &obj->buffer) != VK_SUCCESS)
+		return false;
+
+	ld->GetBufferMemoryRequirements(ld->device, obj->buffer, &reqs);
+	if (!bind_memory(ld, reqs, &obj->bufferMemory) ||
+		ld->BindBufferMemory(ld->device, obj->buffer, obj->bufferMemory, 0) != VK_SUCCESS)
+		return false;
+
+	if (ld->CreateImage(ld->device, &bench_image_info, nullptr, &obj->image) != VK_SUCCESS)
+		return false;
+
+	ld->GetImageMemoryRequirements(ld->device, obj->image, &reqs);
+	if (!bind_memory(ld, reqs, &obj->imageMemory) ||
+		ld->BindImageMemory(ld->device, obj->image, obj->imageMemory, 0) != VK_SUCCESS)
+		return false;
+
+	return true;
+}
+
+static void
+destroy_thread_objects(const struct layer_device *ld, struct thread_objects *obj)
+{
+	if (obj->image)
+		ld->DestroyImage(ld->device, obj->image, nullptr);
+	if (obj->imageMemory)
+		ld->FreeMemory(ld->device, obj->imageMemory, nullptr);
+	if (obj->buffer)
+		ld->DestroyBuffer(ld->device, obj->buffer, nullptr);
+	if (obj->bufferMemory)
+		ld->FreeMemory(ld->device, obj->bufferMemory, nullptr);
+	if (obj->cmd)
+		ld->FreeCommandBuffers(ld->device, obj->pool, 1, &obj->cmd);
+	if (obj->pool)
+		ld->DestroyCommandPool(ld->device, obj->pool, nullptr);
+}
+
+static uint64_t
+now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Runs calls iterations, returns the ns spent in the measured calls only. */
+typedef std::function<uint64_t(const struct layer_device *, struct thread_objects *, uint32_t calls)> bench_op;
+
+static uint64_t
+op_create_buffer(const struct layer_device *ld, struct thread_objects *, uint32_t calls)
+{
+	uint64_t start = now_ns();
+
+	for (uint32_t i = 0; i < calls; i++) {
+		VkBuffer buffer;
+		ld->CreateBuffer(ld->device, &bench_buffer_info, nullptr, &buffer);
+		ld->DestroyBuffer(ld->device, buffer, nullptr);
+	}
+
+	return now_ns() - start;
+}
+
+static uint64_t
+op_create_image(const struct layer_device *ld, struct thread_objects *, uint32_t calls)
+{
+	uint64_t start = now_ns();
+
+	for (uint32_t i = 0; i < calls; i++) {
+		VkImage image;
+		ld->CreateImage(ld->device, &bench_image_info, nullptr, &image);
+		ld->DestroyImage(ld->device, image, nullptr);
+	}
+
+	return now_ns() - start;
+}
+
+static uint64_t
+op_allocate_command_buffers(const struct layer_device *ld, struct thread_objects *obj, uint32_t calls)
+{
+	VkCommandBufferAllocateInfo cmd_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.commandPool = obj->pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1
+	};
+	uint64_t start = now_ns();
+
+	for (uint32_t i = 0; i < calls; i++) {
+		VkCommandBuffer cmd;
+		ld->AllocateCommandBuffers(ld->device, &cmd_info, &cmd);
+		ld->FreeCommandBuffers(ld->device, obj->pool, 1, &cmd);
+	}
+
+	return now_ns() - start;
+}
+
+/*
+ * Recording is timed in batches. Between batches the command buffer is
+ * submitted and the queue drained, so the decode resources of the batch
+ * retire and memory stays bounded; that part is not counted.
+ */
+static uint64_t
+op_copy_buffer_to_image(const struct layer_device *ld, struct thread_objects *obj, uint32_t calls)
+{
+	uint64_t elapsed = 0;
+
+	for (uint32_t done = 0; done < calls; done += BENCH_BATCH) {
+		uint32_t batch = std::min((uint32_t)BENCH_BATCH, calls - done);
+
+		ld->BeginCommandBuffer(obj->cmd, &bench_begin_info);
+
+		uint64_t start = now_ns();
+		for (uint32_t i = 0; i < batch; i++)
+			ld->CmdCopyBufferToImage(obj->cmd, obj->buffer, obj->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bench_region);
+		elapsed += now_ns() - start;
+
+		ld->EndCommandBuffer(obj->cmd);
+
+		VkSubmitInfo submit_info = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO, .commandBufferCount = 1, .pCommandBuffers = &obj->cmd };
+		ld->QueueSubmit(obj->queue, 1, &submit_info, VK_NULL_HANDLE);
+		ld->QueueWaitIdle(obj->queue);
+	}
+
+	return elapsed;
+}
+
+/* Submits a command buffer holding one upload, the queue is drained every batch. */
+static uint64_t
+op_queue_submit(const struct layer_device *ld, struct thread_objects *obj, uint32_t calls)
+{
+	ld->BeginCommandBuffer(obj->cmd, &bench_begin_info);
+	ld->CmdCopyBufferToImage(obj->cmd, obj->buffer, obj->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bench_region);
+	ld->EndCommandBuffer(obj->cmd);
+
+	VkSubmitInfo submit_info = { .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO, .commandBufferCount = 1, .pCommandBuffers = &obj->cmd };
+	uint64_t elapsed = 0;
+
+	for (uint32_t done = 0; done < calls; done += BENCH_BATCH) {
+		uint32_t batch = std::min((uint32_t)BENCH_BATCH, calls - done);
+
+		uint64_t start = now_ns();
+		for (uint32_t i = 0; i < batch; i++)
+			ld->QueueSubmit(obj->queue, 1, &submit_info, VK_NULL_HANDLE);
+		elapsed += now_ns() - start;
+
+		ld->QueueWaitIdle(obj->queue);
+	}
+
+	return elapsed;
+}
+
+struct bench_entry {
+	const char *name;
+	bench_op op;
+};
+
+/* Wall time of all threads running calls each, they start together. */
+static double
+run_threads(const struct layer_device *ld, std::vector<struct thread_objects> &objects, uint32_t threads,
+			const bench_op &op, uint32_t calls)
+{
+	std::atomic<uint32_t> ready(0);
+	std::atomic<bool> go(false);
+	std::vector<std::thread> workers;
+	std::vector<uint64_t> busy(threads);
+
+	for (uint32_t t = 0; t < threads; t++) {
+		workers.emplace_back([&, t]() {
+			ready.fetch_add(1);
+			while (!go.load(std::memory_order_acquire))
+				;
+			busy[t] = op(ld, &objects[t], calls);
+		});
+	}
+
+	while (ready.load() != threads)
+		;
+	go.store(true, std::memory_order_release);
+
+	for (auto &worker : workers)
+		worker.join();
+
+	/* Per call cost as a thread sees it, averaged over the threads. */
+	uint64_t total = 0;
+	for (uint64_t ns : busy)
+		total += ns;
+
+	return (double)total / threads / calls;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *libraryPath = "./libbcn_layer.so";
+	uint32_t maxThreads = std::max(1u, std::min(std::thread::hardware_concurrency(), 16u));
+	uint32_t calls = 20000;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:n:l:")) != -1) {
+		switch (opt) {
+			case 't':
+				maxThreads = std::max(1, std::min(atoi(optarg), STUB_QUEUES));
+				break;
+			case 'n':
+				calls = std::max(BENCH_BATCH, atoi(optarg));
+				break;
+			case 'l':
+				libraryPath = optarg;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-t max threads] [-n calls per thread] [-l layer library]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	/* Nothing on disk: no pipeline cache to load or save. */
+	setenv("BCN_PIPELINE_CACHE", "0", 0);
+
+	void *library = dlopen(libraryPath, RTLD_NOW | RTLD_LOCAL);
+	if (!library) {
+		fprintf(stderr, "bcn_overhead: %s\n", dlerror());
+		return 1;
+	}
+
+	struct layer_device ld;
+	if (!create_layer_device(library, maxThreads, &ld)) {
+		fprintf(stderr, "bcn_overhead: failed to create a device through the layer\n");
+		return 1;
+	}
+
+	std::vector<struct thread_objects> objects(maxThreads);
+	for (uint32_t t = 0; t < maxThreads; t++) {
+		if (!create_thread_objects(&ld, t, &objects[t])) {
+			fprintf(stderr, "bcn_overhead: failed to create the objects of thread %u\n", t);
+			return 1;
+		}
+	}
+
+	const struct bench_entry entries[] = {
+		{ "CreateBuffer+DestroyBuffer", op_create_buffer },
+		{ "CreateImage+DestroyImage", op_create_image },
+		{ "AllocateCommandBuffers+Free", op_allocate_command_buffers },
+		{ "CmdCopyBufferToImage", op_copy_buffer_to_image },
+		{ "QueueSubmit", op_queue_submit }
+	};
+
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	printf("%-28s %8s %12s %12s %10s\n", "entry point", "threads", "ns/call", "Mcalls/s", "scaling");
+
+	for (const struct bench_entry &entry : entries) {
+		double single = 0.0;
+
+		/* A short run first, so first use allocations are not measured. */
+		run_threads(&ld, objects, 1, entry.op, BENCH_BATCH);
+
+		for (uint32_t threads : threadCounts) {
+			double ns = run_threads(&ld, objects, threads, entry.op, calls);
+			if (threads == 1)
+				single = ns;
+
+			/* Aggregate throughput over threads times the single thread one, 100% is linear scaling. */
+			double scaling = ns > 0.0 ? 100.0 * single / ns : 0.0;
+
+			printf("%-28s %8u %12.1f %12.3f %9.1f%%\n", entry.name, threads, ns, threads * 1e3 / ns, scaling);
+			fflush(stdout);
+		}
+	}
+
+	for (struct thread_objects &obj : objects)
+		destroy_thread_objects(&ld, &obj);
+
+	ld.DestroyDevice(ld.device, nullptr);
+	ld.DestroyInstance(ld.instance, nullptr);
+
+	return 0;
+}
@@ -0,0 +1,489 @@
+/*
+ * bcn_pack: decodes every BCn mip found in a directory of DDS/KTX/KTX2
+ * files into a texture pack. Point BCN_PACK_FILE at the result and the
+ * layer serves matching uploads from it instead of dispatching a decode.
+ *
+ * usage: bcn_pack [-j threads] <input directory> <output pack>
+ */
+
+#include "../src/bcn_cpu.hpp"
+#include "../src/format.hpp"
+#include "../src/hash.hpp"
+#include "../src/pack.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+struct input_file {
+	std::string path;
+	const uint8_t *data;
+	size_t size;
+};
+
+struct pack_job {
+	hash128 key;
+	VkFormat format;
+	uint32_t width;
+	uint32_t height;
+	const uint8_t *blocks;
+	uint64_t offset;
+	uint64_t size;
+};
+
+static std::vector<struct pack_job> jobs;
+static std::unordered_set<hash128, hash128_hasher> seen;
+
+template <typename T>
+static T
+read_le(const uint8_t *p)
+{
+	T value;
+	memcpy(&value, p, sizeof(T));
+	return value;
+}
+
+static uint64_t
+get_mip_size(VkFormat format, uint32_t width, uint32_t height)
+{
+	return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * get_block_size(format);
+}
+
+/*
+ * Legacy containers do not say whether the data is meant to be sampled as
+ * sRGB and BC1 may be created with or without alpha, so every format the
+ * application could pick for the same blocks gets an entry.
+ */
+static std::vector<VkFormat>
+get_format_variants(VkFormat format)
+{
+	switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			return { VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_UNORM_BLOCK,
+					 VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK };
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+			return { VK_FORMAT_BC2_UNORM_BLOCK, VK_FORMAT_BC2_SRGB_BLOCK };
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+			return { VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK };
+		default:
+			return { format };
+	}
+}
+
+static void
+add_mip(const std::vector<VkFormat> &formats, uint32_t width, uint32_t height, const uint8_t *blocks)
+{
+	for (VkFormat format : formats) {
+		struct pack_job job;
+
+		job.format = format;
+		job.width = width;
+		job.height = height;
+		job.blocks = blocks;
+		job.size = (uint64_t)width * height * get_texel_size(format);
+		job.key = hash_bcn_blocks(format, width, height, blocks, ((width + 3) / 4) * get_block_size(format));
+
+		if (seen.insert(job.key).second)
+			jobs.push_back(job);
+	}
+}
+
+static VkFormat
+get_dxgi_format(uint32_t dxgi)
+{
+	switch (dxgi) {
+		case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+		case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+		case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+		case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+		case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+		case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+		case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+		case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+		case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+		case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+		case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+		case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+		default: return VK_FORMAT_UNDEFINED;
+	}
+}
+
+static VkFormat
+get_fourcc_format(uint32_t fourcc)
+{
+	char cc[5] = {};
+	memcpy(cc, &fourcc, 4);
+
+	if (!strcmp(cc, "DXT1"))
+		return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	if (!strcmp(cc, "DXT2") || !strcmp(cc, "DXT3"))
+		return VK_FORMAT_BC2_UNORM_BLOCK;
+	if (!strcmp(cc, "DXT4") || !strcmp(cc, "DXT5"))
+		return VK_FORMAT_BC3_UNORM_BLOCK;
+	if (!strcmp(cc, "ATI1") || !strcmp(cc, "BC4U"))
+		return VK_FORMAT_BC4_UNORM_BLOCK;
+	if (!strcmp(cc, "BC4S"))
+		return VK_FORMAT_BC4_SNORM_BLOCK;
+	if (!strcmp(cc, "ATI2") || !strcmp(cc, "BC5U"))
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	if (!strcmp(cc, "BC5S"))
+		return VK_FORMAT_BC5_SNORM_BLOCK;
+
+	return VK_FORMAT_UNDEFINED;
+}
+
+static VkFormat
+get_gl_format(uint32_t internal)
+{
+	switch (internal) {
+		case 0x83F0: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case 0x83F1: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case 0x83F2: return VK_FORMAT_BC2_UNORM_BLOCK;
+		case 0x83F3: return VK_FORMAT_BC3_UNORM_BLOCK;
+		case 0x8C4C: return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+		case 0x8C4D: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+		case 0x8C4E: return VK_FORMAT_BC2_SRGB_BLOCK;
+		case 0x8C4F: return VK_FORMAT_BC3_SRGB_BLOCK;
+		case 0x8DBB: return VK_FORMAT_BC4_UNORM_BLOCK;
+		case 0x8DBC: return VK_FORMAT_BC4_SNORM_BLOCK;
+		case 0x8DBD: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case 0x8DBE: return VK_FORMAT_BC5_SNORM_BLOCK;
+		case 0x8E8C: return VK_FORMAT_BC7_UNORM_BLOCK;
+		case 0x8E8D: return VK_FORMAT_BC7_SRGB_BLOCK;
+		case 0x8E8E: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+		case 0x8E8F: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+		default: return VK_FORMAT_UNDEFINED;
+	}
+}
+
+static bool
+is_bcn(VkFormat format)
+{
+	return is_s3tc(format) || is_rgtc(format) || is_bc6(format) || is_bc7(format);
+}
+
+/* Mips are stored per image: every mip of layer 0, then every mip of layer 1... */
+static bool
+scan_dds(const struct input_file &file)
+{
+	const uint8_t *p = file.data;
+	size_t offset = 128;
+
+	if (file.size < 128 || memcmp(p, "DDS ", 4))
+		return false;
+
+	uint32_t height = read_le<uint32_t>(p + 12);
+	uint32_t width = read_le<uint32_t>(p + 16);
+	uint32_t depth = read_le<uint32_t>(p + 24);
+	uint32_t mips = std::max(read_le<uint32_t>(p + 28), 1u);
+	uint32_t pfFlags = read_le<uint32_t>(p + 80);
+	uint32_t fourcc = read_le<uint32_t>(p + 84);
+	uint32_t caps2 = read_le<uint32_t>(p + 112);
+	uint32_t images = (caps2 & 0x200) ? 6 : 1;
+	bool legacy = true;
+	VkFormat format;
+
+	if (!(pfFlags & 0x4))
+		return false;
+
+	if (!memcmp(&fourcc, "DX10", 4)) {
+		if (file.size < 148)
+			return false;
+
+		format = get_dxgi_format(read_le<uint32_t>(p + 128));
+		uint32_t misc = read_le<uint32_t>(p + 136);
+		uint32_t arraySize = std::max(read_le<uint32_t>(p + 140), 1u);
+		images = arraySize * ((misc & 0x4) ? 6 : 1);
+		legacy = false;
+		offset = 148;
+	}
+	else
+		format = get_fourcc_format(fourcc);
+
+	if (!is_bcn(format) || (depth > 1 && (caps2 & 0x200000)))
+		return false;
+
+	std::vector<VkFormat> formats = legacy ? get_format_variants(format) : std::vector<VkFormat>{ format };
+
+	for (uint32_t image = 0; image < images; image++) {
+		for (uint32_t mip = 0; mip < mips; mip++) {
+			uint32_t w = std::max(width >> mip, 1u);
+			uint32_t h = std::max(height >> mip, 1u);
+			uint64_t size = get_mip_size(format, w, h);
+
+			if (offset + size > file.size)
+				return false;
+
+			add_mip(formats, w, h, p + offset);
+			offset += size;
+		}
+	}
+
+	return true;
+}
+
+/* KTX1 stores each mip as imageSize followed by every face/layer of that level. */
+static bool
+scan_ktx(const struct input_file &file)
+{
+	static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+	const uint8_t *p = file.data;
+
+	if (file.size < 64 || memcmp(p, identifier, 12) || read_le<uint32_t>(p + 12) != 0x04030201)
+		return false;
+
+	VkFormat format = get_gl_format(read_le<uint32_t>(p + 28));
+	uint32_t width = read_le<uint32_t>(p + 36);
+	uint32_t height = std::max(read_le<uint32_t>(p + 40), 1u);
+	uint32_t depth = read_le<uint32_t>(p + 44);
+	uint32_t layers = std::max(read_le<uint32_t>(p + 48), 1u);
+	uint32_t faces = std::max(read_le<uint32_t>(p + 52), 1u);
+	uint32_t mips = std::max(read_le<uint32_t>(p + 56), 1u);
+	size_t offset = 64 + read_le<uint32_t>(p + 60);
+
+	if (!is_bcn(format) || depth > 1)
+		return false;
+
+	std::vector<VkFormat> formats = { format };
+
+	for (uint32_t mip = 0; mip < mips; mip++) {
+		uint32_t w = std::max(width >> mip, 1u);
+		uint32_t h = std::max(height >> mip, 1u);
+		uint64_t size = get_mip_size(format, w, h);
+
+		if (offset + 4 > file.size)
+			return false;
+		offset += 4;
+
+		for (uint32_t image = 0; image < layers * faces; image++) {
+			if (offset + size > file.size)
+				return false;
+
+			add_mip(formats, w, h, p + offset);
+			offset += (size + 3) & ~3ull;
+		}
+	}
+
+	return true;
+}
+
+/* KTX2 has a level index; each level holds every layer/face tightly packed. */
+static bool
+scan_ktx2(const struct input_file &file)
+{
+	static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	const uint8_t *p = file.data;
+
+	if (file.size < 80 || memcmp(p, identifier, 12))
+		return false;
+
+	VkFormat format = (VkFormat)read_le<uint32_t>(p + 12);
+	uint32_t width = read_le<uint32_t>(p + 20);
+	uint32_t height = std::max(read_le<uint32_t>(p + 24), 1u);
+	uint32_t depth = read_le<uint32_t>(p + 28);
+	uint32_t layers = std::max(read_le<uint32_t>(p + 32), 1u);
+	uint32_t faces = std::max(read_le<uint32_t>(p + 36), 1u);
+	uint32_t mips = std::max(read_le<uint32_t>(p + 40), 1u);
+	uint32_t supercompression = read_le<uint32_t>(p + 44);
+
+	if (!is_bcn(format) || depth > 1 || supercompression != 0 || 80 + mips * 24ull > file.size)
+		return false;
+
+	std::vector<VkFormat> formats = { format };
+
+	for (uint32_t mip = 0; mip < mips; mip++) {
+		uint32_t w = std::max(width >> mip, 1u);
+		uint32_t h = std::max(height >> mip, 1u);
+		uint64_t size = get_mip_size(format, w, h);
+		uint64_t offset = read_le<uint64_t>(p + 80 + mip * 24);
+
+		for (uint32_t image = 0; image < layers * faces; image++) {
+			if (offset + size > file.size)
+				return false;
+
+			add_mip(formats, w, h, p + offset);
+			offset += size;
+		}
+	}
+
+	return true;
+}
+
+static bool
+map_file(const std::string &path, struct input_file *file)
+{
+	struct stat st;
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return false;
+
+	file->path = path;
+	file->data = (const uint8_t *)map;
+	file->size = st.st_size;
+	return true;
+}
+
+static bool
+write_pack(const std::string &path, unsigned threads)
+{
+	std::string tmp = path + ".tmp." + std::to_string(getpid());
+	int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (fd < 0) {
+		fprintf(stderr, "bcn_pack: failed to create %s\n", tmp.c_str());
+		return false;
+	}
+
+	std::sort(jobs.begin(), jobs.end(), [](const struct pack_job &a, const struct pack_job &b) {
+		return a.key.hi < b.key.hi || (a.key.hi == b.key.hi && a.key.lo < b.key.lo);
+	});
+
+	struct pack_header header = { BCN_PACK_MAGIC, BCN_PACK_VERSION, jobs.size() };
+	std::vector<struct pack_index_entry> index(jobs.size());
+	uint64_t offset = sizeof(header) + index.size() * sizeof(struct pack_index_entry);
+
+	for (size_t i = 0; i < jobs.size(); i++) {
+		offset = (offset + 15) & ~15ull;
+		jobs[i].offset = offset;
+		index[i] = { jobs[i].key.lo, jobs[i].key.hi, offset, jobs[i].size };
+		offset += jobs[i].size;
+	}
+
+	bool ok = ftruncate(fd, offset) == 0 &&
+			  pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+			  pwrite(fd, index.data(), index.size() * sizeof(index[0]), sizeof(header)) == (ssize_t)(index.size() * sizeof(index[0]));
+
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+	std::vector<std::thread> workers;
+
+	for (unsigned t = 0; ok && t < threads; t++) {
+		workers.emplace_back([&]() {
+			std::vector<uint8_t> decoded;
+
+			for (size_t i = next++; i < jobs.size() && !failed; i = next++) {
+				const struct pack_job &job = jobs[i];
+				uint32_t texel_size = get_texel_size(job.format);
+
+				decoded.resize(job.size);
+				decode_bcn_region(job.format, job.blocks, ((job.width + 3) / 4) * get_block_size(job.format),
+								  job.width, job.height, decoded.data(), job.width * texel_size);
+
+				if (pwrite(fd, decoded.data(), job.size, job.offset) != (ssize_t)job.size)
+					failed = true;
+			}
+		});
+	}
+
+	for (auto &worker : workers)
+		worker.join();
+
+	ok = ok && !failed && fsync(fd) == 0;
+	close(fd);
+
+	if (!ok || rename(tmp.c_str(), path.c_str())) {
+		fprintf(stderr, "bcn_pack: failed to write %s\n", path.c_str());
+		unlink(tmp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+	int opt;
+
+	while ((opt = getopt(argc, argv, "j:")) != -1) {
+		if (opt == 'j')
+			threads = std::max(atoi(optarg), 1);
+		else
+			break;
+	}
+
+	if (argc - optind != 2) {
+		fprintf(stderr, "usage: %s [-j threads] <input directory> <output pack>\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<struct input_file> files;
+	std::error_code ec;
+
+	for (auto it = std::filesystem::recursive_directory_iterator(argv[optind], ec);
+		 !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+		if (!it->is_regular_file())
+			continue;
+
+		std::string ext = it->path().extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+		if (ext != ".dds" && ext != ".ktx" && ext != ".ktx2")
+			continue;
+
+		struct input_file file;
+		if (!map_file(it->path().string(), &file))
+			continue;
+
+		/* A scan can fail partway through, the mips it queued before that go with the file. */
+		size_t queued = jobs.size();
+
+		if (!scan_dds(file) && !scan_ktx(file) && !scan_ktx2(file)) {
+			fprintf(stderr, "bcn_pack: skipping %s, not a supported BCn texture\n", file.path.c_str());
+
+			for (size_t i = queued; i < jobs.size(); i++)
+				seen.erase(jobs[i].key);
+			jobs.erase(jobs.begin() + queued, jobs.end());
+
+			munmap((void *)file.data, file.size);
+			continue;
+		}
+
+		files.push_back(file);
+	}
+
+	if (ec) {
+		fprintf(stderr, "bcn_pack: failed to scan %s: %s\n", argv[optind], ec.message().c_str());
+		return 1;
+	}
+
+	uint64_t total = 0;
+	for (const auto &job : jobs)
+		total += job.size;
+
+	printf("bcn_pack: %zu files, %zu mips, %llu MiB decoded, %u threads\n",
+		   files.size(), jobs.size(), (unsigned long long)(total >> 20), threads);
+
+	if (!write_pack(argv[optind + 1], threads))
+		return 1;
+
+	for (const auto &file : files)
+		munmap((void *)file.data, file.size);
+
+	return 0;
+}
@@ -0,0 +1,312 @@
+/*
+ * bcn_replay: replays a capture written with BCN_CAPTURE_FILE through the
+ * layer, frame by frame, and reports how long the uploads and their
+ * decodes took. Images live for the frame they are used in, every loop
+ * starts from fresh images so the layer caches are exercised like on a
+ * first run, unless -w keeps them across loops.
+ *
+ * usage: bcn_replay [-n loops] [-d device] [-w] <capture>
+ */
+
+#include "../src/capture.hpp"
+#include "../src/format.hpp"
+#include "common.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+struct replay_frame {
+	std::vector<const struct capture_image *> images;
+	std::vector<const struct capture_upload *> uploads;
+	std::vector<uint64_t> destroyed;
+};
+
+struct replay_image {
+	struct vk_image image;
+	const struct capture_image *info;
+};
+
+static const uint8_t *
+map_capture(const char *path, size_t *size)
+{
+	struct stat st;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "bcn_replay: cannot open %s\n", path);
+		return nullptr;
+	}
+
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(struct capture_header)) {
+		fprintf(stderr, "bcn_replay: %s is not a capture\n", path);
+		close(fd);
+		return nullptr;
+	}
+
+	void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return nullptr;
+
+	*size = st.st_size;
+	return (const uint8_t *)data;
+}
+
+/*
+ * Splits the record stream into frames and gathers the blobs in upload
+ * order. A capture cut short is read up to its last complete record.
+ */
+static bool
+parse_capture(const uint8_t *data, size_t size, std::vector<struct replay_frame> &frames,
+			  std::unordered_map<hash128, std::pair<const uint8_t *, size_t>, hash128_hasher> &blobs)
+{
+	const struct capture_header *header = (const struct capture_header *)data;
+
+	if (header->magic != BCN_CAPTURE_MAGIC || header->version != BCN_CAPTURE_VERSION) {
+		fprintf(stderr, "bcn_replay: unsupported capture, magic 0x%x version %u\n", header->magic, header->version);
+		return false;
+	}
+
+	size_t offset = sizeof(*header);
+	frames.emplace_back();
+
+	while (offset + sizeof(struct capture_record) <= size) {
+		const struct capture_record *record = (const struct capture_record *)(data + offset);
+		const uint8_t *payload = data + offset + sizeof(*record);
+
+		if (offset + sizeof(*record) + record->size > size)
+			break;
+
+		offset += sizeof(*record) + record->size;
+
+		switch (record->type) {
+			case CAPTURE_IMAGE:
+				frames.back().images.push_back((const struct capture_image *)payload);
+				break;
+			case CAPTURE_BLOB: {
+				const struct capture_blob *blob = (const struct capture_blob *)payload;
+				hash128 key = { blob->key_lo, blob->key_hi };
+				blobs[key] = { payload + sizeof(*blob), record->size - sizeof(*blob) };
+				break;
+			}
+			case CAPTURE_UPLOAD:
+				frames.back().uploads.push_back((const struct capture_upload *)payload);
+				break;
+			case CAPTURE_DESTROY:
+				frames.back().destroyed.push_back(((const struct capture_destroy *)payload)->id);
+				break;
+			case CAPTURE_FRAME:
+				frames.emplace_back();
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (frames.back().images.empty() && frames.back().uploads.empty())
+		frames.pop_back();
+
+	return true;
+}
+
+static bool
+create_image(const struct vk_context *ctx, const struct capture_image *info, struct replay_image *out)
+{
+	VkImageCreateInfo image_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = info->flags,
+		.imageType = (VkImageType)info->imageType,
+		.format = (VkFormat)info->format,
+		.extent = { info->width, info->height, info->depth },
+		.mipLevels = info->mipLevels,
+		.arrayLayers = info->arrayLayers,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 0,
+		.pQueueFamilyIndices = nullptr,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+
+	out->info = info;
+
+	if (!vk_image_create(ctx, image_info, &out->image)) {
+		fprintf(stderr, "bcn_replay: failed to create %ux%u %s image\n", info->width, info->height,
+			get_format_name((VkFormat)info->format));
+		return false;
+	}
+
+	return true;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *deviceFilter = nullptr;
+	uint32_t loops = 1;
+	bool warm = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:d:w")) != -1) {
+		switch (opt) {
+			case 'n':
+				loops = std::max(1, atoi(optarg));
+				break;
+			case 'd':
+				deviceFilter = optarg;
+				break;
+			case 'w':
+				warm = true;
+				break;
+			default:
+				fprintf(stderr, "usage: bcn_replay [-n loops] [-d device] [-w] <capture>\n");
+				return 1;
+		}
+	}
+
+	if (optind >= argc) {
+		fprintf(stderr, "usage: bcn_replay [-n loops] [-d device] [-w] <capture>\n");
+		return 1;
+	}
+
+	size_t size;
+	const uint8_t *data = map_capture(argv[optind], &size);
+	if (!data)
+		return 1;
+
+	std::vector<struct replay_frame> frames;
+	std::unordered_map<hash128, std::pair<const uint8_t *, size_t>, hash128_hasher> blobs;
+
+	if (!parse_capture(data, size, frames, blobs))
+		return 1;
+
+	struct vk_context ctx;
+	if (!vk_context_create(&ctx, deviceFilter, true))
+		return 1;
+
+	printf("device: %s\n", ctx.props.deviceName);
+
+	/* All the blobs go in one staging buffer, uploads copy from their offset in it. */
+	VkDeviceSize total = 0;
+	std::unordered_map<hash128, VkDeviceSize, hash128_hasher> offsets;
+
+	for (auto &blob : blobs) {
+		offsets[blob.first] = total;
+		total += (blob.second.second + 15) & ~(VkDeviceSize)15;
+	}
+
+	struct vk_buffer staging;
+	if (!vk_buffer_create(&ctx, std::max(total, (VkDeviceSize)16), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true, &staging)) {
+		fprintf(stderr, "bcn_replay: failed to allocate %llu staging bytes\n", (unsigned long long)total);
+		vk_context_destroy(&ctx);
+		return 1;
+	}
+
+	for (auto &blob : blobs)
+		memcpy((uint8_t *)staging.mapped + offsets[blob.first], blob.second.first, blob.second.second);
+
+	std::unordered_map<uint64_t, struct replay_image> images;
+	std::vector<double> frameMs;
+	uint64_t texels = 0;
+	uint64_t bytes = 0;
+	uint64_t missing = 0;
+	uint64_t start = now_ns();
+
+	for (uint32_t loop = 0; loop < loops; loop++) {
+		for (auto &frame : frames) {
+			uint64_t frameStart = now_ns();
+			VkCommandBuffer cmd = vk_begin(&ctx);
+
+			for (const struct capture_image *info : frame.images) {
+				if (images.count(info->id))
+					continue;
+
+				struct replay_image image;
+				if (!create_image(&ctx, info, &image))
+					continue;
+
+				vk_transition(cmd, image.image.handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					info->mipLevels, info->arrayLayers);
+				images[info->id] = image;
+			}
+
+			for (const struct capture_upload *upload : frame.uploads) {
+				hash128 key = { upload->key_lo, upload->key_hi };
+				auto image = images.find(upload->id);
+				auto blob = blobs.find(key);
+
+				if (image == images.end() || blob == blobs.end()) {
+					missing++;
+					continue;
+				}
+
+				VkBufferImageCopy region = {
+					.bufferOffset = offsets[key],
+					.bufferRowLength = 0,
+					.bufferImageHeight = 0,
+					.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, upload->mipLevel, upload->arrayLayer, 1 },
+					.imageOffset = { upload->x, upload->y, 0 },
+					.imageExtent = { upload->width, upload->height, 1 }
+				};
+
+				vkCmdCopyBufferToImage(cmd, staging.handle, image->second.image.handle,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+				texels += (uint64_t)upload->width * upload->height;
+				bytes += blob->second.second;
+			}
+
+			if (!vk_submit_wait(&ctx, cmd))
+				break;
+
+			frameMs.push_back((now_ns() - frameStart) / 1e6);
+
+			for (uint64_t id : frame.destroyed) {
+				auto it = images.find(id);
+				if (it == images.end())
+					continue;
+
+				vk_image_destroy(&ctx, &it->second.image);
+				images.erase(it);
+			}
+		}
+
+		if (!warm) {
+			for (auto &image : images)
+				vk_image_destroy(&ctx, &image.second.image);
+			images.clear();
+		}
+	}
+
+	double seconds = (now_ns() - start) / 1e9;
+
+	for (auto &image : images)
+		vk_image_destroy(&ctx, &image.second.image);
+
+	vk_buffer_destroy(&ctx, &staging);
+	vk_context_destroy(&ctx);
+	munmap((void *)data, size);
+
+	double sum = 0.0;
+	for (double ms : frameMs)
+		sum += ms;
+
+	printf("frames: %zu x %u loops, %zu unique blobs, %llu uploads missing\n", frames.size(), loops, blobs.size(),
+		(unsigned long long)missing);
+	printf("throughput: %.1f Mtexel/s, %.1f MB/s compressed\n", texels / seconds / 1e6, bytes / seconds / 1e6);
+	printf("frame ms: avg %.3f p50 %.3f p95 %.3f max %.3f\n", frameMs.empty() ? 0.0 : sum / frameMs.size(),
+		percentile(frameMs, 0.5), percentile(frameMs, 0.95), percentile(frameMs, 1.0));
+
+	return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * bcn_stat: polls the live counters a process running the layer with
+ * BCN_STATS=1 publishes, and prints them with per second rates. Without a
+ * target it attaches to the only segment found in /dev/shm.
+ *
+ * usage: bcn_stat [-i interval ms] [-1] [pid | segment name]
+ */
+
+#include "../src/stats.hpp"
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct snapshot {
+	uint64_t texels[BCN_STATS_FORMATS];
+	uint64_t bytes[BCN_STATS_FORMATS];
+	uint64_t counters[BCN_STAT_COUNT];
+};
+
+static std::string
+find_segment()
+{
+	std::vector<std::string> found;
+	std::error_code ec;
+	std::string prefix = std::string(BCN_STATS_NAME + 1) + ".";
+
+	for (const auto &entry : std::filesystem::directory_iterator("/dev/shm", ec)) {
+		std::string name = entry.path().filename().string();
+		if (!name.compare(0, prefix.size(), prefix))
+			found.push_back("/" + name);
+	}
+
+	if (found.size() == 1)
+		return found[0];
+
+	if (found.empty())
+		fprintf(stderr, "bcn_stat: no process is publishing counters, run it with BCN_STATS=1\n");
+	else
+		fprintf(stderr, "bcn_stat: %zu segments found, pick one by pid\n", found.size());
+
+	return "";
+}
+
+static const struct bcn_stats *
+open_segment(const std::string &name)
+{
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		fprintf(stderr, "bcn_stat: cannot open %s\n", name.c_str());
+		return nullptr;
+	}
+
+	void *data = mmap(nullptr, sizeof(struct bcn_stats), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "bcn_stat: cannot map %s\n", name.c_str());
+		return nullptr;
+	}
+
+	const struct bcn_stats *stats = (const struct bcn_stats *)data;
+	if (stats->magic != BCN_STATS_MAGIC || stats->version != BCN_STATS_VERSION) {
+		fprintf(stderr, "bcn_stat: %s is not a version %d segment\n", name.c_str(), BCN_STATS_VERSION);
+		munmap(data, sizeof(struct bcn_stats));
+		return nullptr;
+	}
+
+	return stats;
+}
+
+static void
+take_snapshot(const struct bcn_stats *stats, struct snapshot &snap)
+{
+	for (uint32_t i = 0; i < BCN_STATS_FORMATS; i++) {
+		snap.texels[i] = stats->texels[i].load(std::memory_order_relaxed);
+		snap.bytes[i] = stats->bytes[i].load(std::memory_order_relaxed);
+	}
+
+	for (uint32_t i = 0; i < BCN_STAT_COUNT; i++)
+		snap.counters[i] = stats->counters[i].load(std::memory_order_relaxed);
+}
+
+static void
+print_snapshot(uint32_t pid, const struct snapshot &cur, const struct snapshot &prev, double seconds)
+{
+	printf("pid %u\n", pid);
+	printf("%-16s %16s %14s %16s %14s\n", "format", "texels", "Mtexel/s", "bytes", "MiB/s");
+
+	for (uint32_t i = 0; i < BCN_STATS_FORMATS; i++) {
+		if (!cur.texels[i])
+			continue;
+
+		printf("%-16s %16llu %14.2f %16llu %14.2f\n", bcn_stats_format_names[i],
+			(unsigned long long)cur.texels[i], (cur.texels[i] - prev.texels[i]) / seconds / 1e6,
+			(unsigned long long)cur.bytes[i], (cur.bytes[i] - prev.bytes[i]) / seconds / (1 << 20));
+	}
+
+	for (uint32_t i = 0; i < BCN_STAT_COUNT; i++)
+		printf("%-16s %16llu\n", bcn_stat_names[i], (unsigned long long)cur.counters[i]);
+
+	uint64_t latencies = cur.counters[BCN_STAT_LATENCY_COUNT];
+	if (latencies)
+		printf("%-16s %16.1f us\n", "latency_avg", cur.counters[BCN_STAT_LATENCY_NS] / 1e3 / latencies);
+
+	printf("\n");
+	fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned interval = 1000;
+	bool once = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:1")) != -1) {
+		if (opt == 'i') {
+			interval = std::max(atoi(optarg), 1);
+		} else if (opt == '1') {
+			once = true;
+		} else {
+			fprintf(stderr, "usage: %s [-i interval ms] [-1] [pid | segment name]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::string name;
+	if (optind < argc) {
+		name = argv[optind];
+		if (name.find_first_not_of("0123456789") == std::string::npos)
+			name = std::string(BCN_STATS_NAME) + "." + name;
+		else if (name[0] != '/')
+			name = "/" + name;
+	} else {
+		name = find_segment();
+	}
+
+	if (name.empty())
+		return 1;
+
+	const struct bcn_stats *stats = open_segment(name);
+	if (!stats)
+		return 1;
+
+	struct snapshot prev = {}, cur;
+	take_snapshot(stats, prev);
+
+	if (once) {
+		print_snapshot(stats->pid, prev, prev, 1.0);
+		return 0;
+	}
+
+	for (;;) {
+		usleep(interval * 1000);
+		take_snapshot(stats, cur);
+		print_snapshot(stats->pid, cur, prev, interval / 1000.0);
+		prev = cur;
+
+		/* The segment name goes away when the process exits. */
+		if (access(("/dev/shm" + name).c_str(), F_OK))
+			break;
+	}
+
+	return 0;
+}
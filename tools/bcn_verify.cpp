@@ -0,0 +1,606 @@
+/*
+ * bcn_verify: uploads generated textures of every BCn format through the
+ * layer, once per layer configuration, reads the emulated images back and
+ * compares them with the CPU reference decoder in src/bcn_cpu.cpp. Every
+ * configuration gets a fresh device, the layer reads its settings there.
+ *
+ * Readback copies the BC image into an image of the decoded format with
+ * vkCmdCopyImage, the driver only ever sees the decoded formats, then into
+ * a host buffer. Each case is uploaded twice, the second pass hits the
+ * cache and dedup paths where they are enabled.
+ *
+ * The mip_drop mode caps the decoded extent and compares the levels left,
+ * the linear mode writes a single level linear image through a mapping
+ * instead of copying to it. Texture packs (BCN_PACK_FILE) are not covered,
+ * a pack is built by bcn_pack from texture files ahead of time and only
+ * serves uploads of the exact blocks it was built from.
+ *
+ * Tolerances, in units of the decoded format, per channel:
+ *   BC7 UNORM                  0, integer weights on both sides
+ *   BC1-BC5, BC7 SRGB          1, float interpolation and sRGB decode
+ *                                 round differently on some GPUs
+ *   BC6H                       1 ulp of the half float result
+ * -t overrides all of them, -t 0 asks for bit exact output.
+ *
+ * On a mismatch the reference, the layer output and a diff are written as
+ * PAM images to the dump directory.
+ *
+ * usage: bcn_verify [-d device] [-m mode] [-f format] [-t tolerance] [-o dump directory]
+ */
+
+#include "../src/bcn_cpu.hpp"
+#include "../src/format.hpp"
+#include "common.hpp"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/* maxExtent repeats BCN_MAX_EXTENT, the levels the layer drops are not compared. */
+struct verify_mode {
+	const char *name;
+	const char *env[3];
+	uint32_t maxExtent;
+	VkImageTiling tiling;
+};
+
+/* Settings not listed in a mode are unset, every mode starts from the defaults. */
+static const char *const verify_variables[] = {
+	"BCN_DECODE_PATH", "BCN_COMPUTE_IMAGE_VIEW", "BCN_BUFFER_STORAGE", "BCN_CACHE",
+	"BCN_DEDUP", "BCN_INCREMENTAL", "BCN_LAZY", "BCN_PACK_FILE", "BCN_COMPUTE_AUTO",
+	"BCN_MAX_EXTENT", "BCN_MAX_EXTENT_S3TC", "BCN_MAX_EXTENT_RGTC", "BCN_MAX_EXTENT_BC6", "BCN_MAX_EXTENT_BC7"
+};
+
+static const struct verify_mode verify_modes[] = {
+	{ "compute", { "BCN_DECODE_PATH=compute", "BCN_COMPUTE_IMAGE_VIEW=0", nullptr } },
+	{ "compute_view", { "BCN_DECODE_PATH=compute", "BCN_COMPUTE_IMAGE_VIEW=1", nullptr } },
+	{ "staging", { "BCN_DECODE_PATH=compute", "BCN_BUFFER_STORAGE=none", nullptr } },
+	{ "fragment", { "BCN_DECODE_PATH=fragment", nullptr } },
+	{ "cache", { "BCN_DECODE_PATH=compute", "BCN_CACHE=1", nullptr } },
+	{ "dedup", { "BCN_DECODE_PATH=compute", "BCN_DEDUP=1", nullptr } },
+	{ "incremental", { "BCN_DECODE_PATH=compute", "BCN_INCREMENTAL=1", nullptr } },
+	{ "lazy", { "BCN_DECODE_PATH=compute", "BCN_LAZY=1", nullptr } },
+	{ "mip_drop", { "BCN_DECODE_PATH=compute", "BCN_MAX_EXTENT=32", nullptr }, 32 },
+	{ "linear", { "BCN_DECODE_PATH=compute", nullptr }, 0, VK_IMAGE_TILING_LINEAR }
+};
+
+static const VkFormat verify_formats[] = {
+	VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK,
+	VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK,
+	VK_FORMAT_BC2_UNORM_BLOCK, VK_FORMAT_BC2_SRGB_BLOCK,
+	VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK,
+	VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC4_SNORM_BLOCK,
+	VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC5_SNORM_BLOCK,
+	VK_FORMAT_BC6H_UFLOAT_BLOCK, VK_FORMAT_BC6H_SFLOAT_BLOCK,
+	VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK
+};
+
+/* A power of two chain, and an odd one that ends in partial blocks. Levels of the second are uploaded in 2x2 tiles. */
+struct verify_case {
+	uint32_t width;
+	uint32_t height;
+	uint32_t splits;
+};
+
+static const struct verify_case verify_cases[] = {
+	{ 64, 64, 1 },
+	{ 100, 60, 2 }
+};
+
+struct verify_level {
+	uint32_t width;
+	uint32_t height;
+	VkDeviceSize blockOffset;
+	VkDeviceSize texelOffset;
+};
+
+static uint64_t
+xorshift(uint64_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+static uint32_t
+texel_size(VkFormat format)
+{
+	return is_bc6(format) ? 8 : 4;
+}
+
+static uint32_t
+get_tolerance(VkFormat format)
+{
+	return format == VK_FORMAT_BC7_UNORM_BLOCK ? 0 : 1;
+}
+
+/*
+ * Random bits cover the block modes: every BC7 mode and BC6H mode code,
+ * reserved ones included, both BC1 color modes and both alpha modes show
+ * up many times in a few hundred blocks.
+ */
+static void
+fill_blocks(uint8_t *dst, VkDeviceSize size, uint64_t seed)
+{
+	uint64_t state = seed * 0x9e3779b97f4a7c15ull + 1;
+
+	for (VkDeviceSize i = 0; i < size; i += 8) {
+		uint64_t value = xorshift(state);
+		memcpy(dst + i, &value, std::min((VkDeviceSize)8, size - i));
+	}
+}
+
+static int
+half_order(uint16_t half)
+{
+	return (half & 0x8000) ? -(int)(half & 0x7fff) : (int)half;
+}
+
+/* Largest per channel difference at one texel. */
+static uint32_t
+texel_diff(VkFormat format, const uint8_t *a, const uint8_t *b)
+{
+	uint32_t diff = 0;
+
+	if (is_bc6(format)) {
+		for (uint32_t c = 0; c < 4; c++) {
+			uint16_t x, y;
+			memcpy(&x, a + 2 * c, 2);
+			memcpy(&y, b + 2 * c, 2);
+			diff = std::max(diff, (uint32_t)abs(half_order(x) - half_order(y)));
+		}
+	} else {
+		for (uint32_t c = 0; c < 4; c++)
+			diff = std::max(diff, (uint32_t)abs((int)a[c] - (int)b[c]));
+	}
+
+	return diff;
+}
+
+static uint8_t
+to_display(VkFormat format, const uint8_t *texel, uint32_t c)
+{
+	if (!is_bc6(format))
+		return texel[c];
+
+	/* Sign and top exponent bits are enough to see structure in a dump. */
+	uint16_t half;
+	memcpy(&half, texel + 2 * c, 2);
+	return (half & 0x8000) ? 0 : std::min(255, (half & 0x7fff) >> 7);
+}
+
+static bool
+write_pam(const std::string &path, uint32_t width, uint32_t height, const std::vector<uint8_t> &rgba)
+{
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+
+	fprintf(file, "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", width, height);
+	fwrite(rgba.data(), 1, rgba.size(), file);
+	fclose(file);
+
+	return true;
+}
+
+static void
+dump_level(const std::string &dir, const std::string &name, VkFormat format, uint32_t width, uint32_t height,
+		   const uint8_t *reference, const uint8_t *output, uint32_t tolerance)
+{
+	std::vector<uint8_t> ref(width * height * 4), out(width * height * 4), diff(width * height * 4);
+	uint32_t size = texel_size(format);
+
+	for (uint32_t i = 0; i < width * height; i++) {
+		for (uint32_t c = 0; c < 4; c++) {
+			ref[4 * i + c] = to_display(format, reference + i * size, c);
+			out[4 * i + c] = to_display(format, output + i * size, c);
+		}
+
+		/* Red marks texels out of tolerance, grey ones within it but not exact. */
+		uint32_t d = texel_diff(format, reference + i * size, output + i * size);
+		uint8_t value = d > tolerance ? 255 : d ? 96 : 0;
+		diff[4 * i + 0] = value;
+		diff[4 * i + 1] = d > tolerance ? 0 : value;
+		diff[4 * i + 2] = d > tolerance ? 0 : value;
+		diff[4 * i + 3] = 255;
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(dir, ec);
+
+	if (!write_pam(dir + "/" + name + "_ref.pam", width, height, ref) ||
+		!write_pam(dir + "/" + name + "_out.pam", width, height, out) ||
+		!write_pam(dir + "/" + name + "_diff.pam", width, height, diff))
+		fprintf(stderr, "bcn_verify: cannot write dumps to %s\n", dir.c_str());
+}
+
+static void
+build_levels(VkFormat format, const struct verify_case &c, uint32_t mipLevels, std::vector<struct verify_level> &levels,
+			 VkDeviceSize *blockBytes, VkDeviceSize *texelBytes)
+{
+	*blockBytes = 0;
+	*texelBytes = 0;
+
+	for (uint32_t level = 0; level < mipLevels; level++) {
+		struct verify_level l = {
+			.width = std::max(c.width >> level, 1u),
+			.height = std::max(c.height >> level, 1u),
+			.blockOffset = *blockBytes,
+			.texelOffset = *texelBytes
+		};
+
+		*blockBytes += (VkDeviceSize)((l.width + 3) / 4) * ((l.height + 3) / 4) * get_block_size(format);
+		*texelBytes += (VkDeviceSize)l.width * l.height * texel_size(format);
+		levels.push_back(l);
+	}
+}
+
+static void
+record_upload(VkCommandBuffer cmd, VkFormat format, const struct verify_case &c, VkBuffer src, VkImage dst,
+			  const std::vector<struct verify_level> &levels)
+{
+	for (uint32_t level = 0; level < levels.size(); level++) {
+		const struct verify_level &l = levels[level];
+		uint32_t blocksX = (l.width + 3) / 4, blocksY = (l.height + 3) / 4;
+		uint32_t splits = std::min({ c.splits, blocksX, blocksY });
+		uint32_t tileX = blocksX / splits, tileY = blocksY / splits;
+
+		for (uint32_t ty = 0; ty < splits; ty++) {
+			for (uint32_t tx = 0; tx < splits; tx++) {
+				uint32_t bx = tx * tileX, by = ty * tileY;
+				uint32_t x = bx * 4, y = by * 4;
+				uint32_t w = tx == splits - 1 ? l.width - x : tileX * 4;
+				uint32_t h = ty == splits - 1 ? l.height - y : tileY * 4;
+
+				VkBufferImageCopy region = {
+					.bufferOffset = l.blockOffset + ((VkDeviceSize)by * blocksX + bx) * get_block_size(format),
+					.bufferRowLength = blocksX * 4,
+					.bufferImageHeight = blocksY * 4,
+					.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 },
+					.imageOffset = { (int32_t)x, (int32_t)y, 0 },
+					.imageExtent = { w, h, 1 }
+				};
+
+				vkCmdCopyBufferToImage(cmd, src, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+			}
+		}
+	}
+}
+
+/* Same levels as the layer drops for the mode, see get_mip_drop in src/image.cpp. */
+static uint32_t
+get_mip_drop(const struct verify_mode &mode, const struct verify_case &c, uint32_t mipLevels)
+{
+	uint32_t drop = 0;
+
+	if (!mode.maxExtent)
+		return 0;
+
+	while (drop + 1 < mipLevels && std::max(c.width >> drop, c.height >> drop) > mode.maxExtent)
+		drop++;
+
+	return drop;
+}
+
+/*
+ * A linear image in host visible memory, written through a mapping the way
+ * an application streams textures. The layer reports the compressed layout
+ * and decodes what was written when the memory is unmapped.
+ */
+static bool
+create_linear_image(const struct vk_context *ctx, const VkImageCreateInfo &info, const uint8_t *blocks,
+					struct vk_image *img)
+{
+	VkMemoryRequirements reqs;
+	VkSubresourceLayout layout;
+	void *data;
+
+	memset(img, 0, sizeof(*img));
+
+	if (vkCreateImage(ctx->device, &info, nullptr, &img->handle) != VK_SUCCESS)
+		return false;
+
+	vkGetImageMemoryRequirements(ctx->device, img->handle, &reqs);
+
+	VkMemoryAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.allocationSize = reqs.size,
+		.memoryTypeIndex = vk_find_memory_type(ctx, reqs.memoryTypeBits,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+	};
+
+	if (alloc_info.memoryTypeIndex == UINT32_MAX ||
+		vkAllocateMemory(ctx->device, &alloc_info, nullptr, &img->memory) != VK_SUCCESS ||
+		vkBindImageMemory(ctx->device, img->handle, img->memory, 0) != VK_SUCCESS ||
+		vkMapMemory(ctx->device, img->memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+		vk_image_destroy(ctx, img);
+		return false;
+	}
+
+	VkImageSubresource subresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+	vkGetImageSubresourceLayout(ctx->device, img->handle, &subresource, &layout);
+
+	VkDeviceSize pitch = (VkDeviceSize)((info.extent.width + 3) / 4) * get_block_size(info.format);
+	for (uint32_t by = 0; by < (info.extent.height + 3) / 4; by++)
+		memcpy((uint8_t *)data + layout.offset + by * layout.rowPitch, blocks + by * pitch, pitch);
+
+	vkUnmapMemory(ctx->device, img->memory);
+
+	return true;
+}
+
+static void
+record_readback(VkCommandBuffer cmd, VkImage src, VkImage readback, VkBuffer dst,
+				const std::vector<struct verify_level> &levels, uint32_t firstLevel)
+{
+	uint32_t mipLevels = levels.size();
+
+	vk_transition(cmd, readback, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, 1);
+
+	for (uint32_t level = firstLevel; level < mipLevels; level++) {
+		VkImageCopy region = {
+			.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 },
+			.srcOffset = { 0, 0, 0 },
+			.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 },
+			.dstOffset = { 0, 0, 0 },
+			.extent = { levels[level].width, levels[level].height, 1 }
+		};
+
+		vkCmdCopyImage(cmd, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+
+	vk_transition(cmd, readback, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mipLevels, 1);
+
+	for (uint32_t level = firstLevel; level < mipLevels; level++) {
+		VkBufferImageCopy region = {
+			.bufferOffset = levels[level].texelOffset,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 },
+			.imageOffset = { 0, 0, 0 },
+			.imageExtent = { levels[level].width, levels[level].height, 1 }
+		};
+
+		vkCmdCopyImageToBuffer(cmd, readback, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, 1, &region);
+	}
+}
+
+struct verify_totals {
+	uint32_t passed;
+	uint32_t failed;
+};
+
+/*
+ * Upload and readback go in separate submissions, lazily decoded images are
+ * only decoded once a later submission wants them.
+ */
+static bool
+run_case(const struct vk_context *ctx, const struct verify_mode &mode, VkFormat format, const struct verify_case &c,
+		 int tolerance, const char *dumpDir, struct verify_totals *totals)
+{
+	bool linear = mode.tiling == VK_IMAGE_TILING_LINEAR;
+	uint32_t mipLevels = linear ? 1 : 32 - __builtin_clz(std::max(c.width, c.height));
+	uint32_t mipDrop = get_mip_drop(mode, c, mipLevels);
+	std::vector<struct verify_level> levels;
+	VkDeviceSize blockBytes, texelBytes;
+
+	build_levels(format, c, mipLevels, levels, &blockBytes, &texelBytes);
+
+	struct vk_buffer blocks, texels;
+	if (!vk_buffer_create(ctx, blockBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true, &blocks))
+		return false;
+
+	if (!vk_buffer_create(ctx, texelBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, true, &texels)) {
+		vk_buffer_destroy(ctx, &blocks);
+		return false;
+	}
+
+	fill_blocks((uint8_t *)blocks.mapped, blockBytes, ((uint64_t)format << 32) | (c.width << 16) | c.height);
+
+	std::vector<uint8_t> reference(texelBytes);
+	for (const struct verify_level &l : levels) {
+		decode_bcn_region(format, (const uint8_t *)blocks.mapped + l.blockOffset, ((l.width + 3) / 4) * get_block_size(format),
+			l.width, l.height, reference.data() + l.texelOffset, l.width * texel_size(format));
+	}
+
+	uint32_t limit = tolerance >= 0 ? tolerance : get_tolerance(format);
+	bool ok = true;
+
+	for (uint32_t pass = 0; pass < 2 && ok; pass++) {
+		VkImageCreateInfo image_info = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = format,
+			.extent = { c.width, c.height, 1 },
+			.mipLevels = mipLevels,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = mode.tiling,
+			.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.queueFamilyIndexCount = 0,
+			.pQueueFamilyIndices = nullptr,
+			.initialLayout = linear ? VK_IMAGE_LAYOUT_PREINITIALIZED : VK_IMAGE_LAYOUT_UNDEFINED
+		};
+
+		struct vk_image image, readback;
+		if (linear ? !create_linear_image(ctx, image_info, (const uint8_t *)blocks.mapped, &image) :
+			!vk_image_create(ctx, image_info, &image)) {
+			ok = false;
+			break;
+		}
+
+		image_info.format = get_format_for_bcn(format);
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		if (!vk_image_create(ctx, image_info, &readback)) {
+			vk_image_destroy(ctx, &image);
+			ok = false;
+			break;
+		}
+
+		VkCommandBuffer cmd = vk_begin(ctx);
+		if (linear) {
+			vk_transition(cmd, image.handle, VK_IMAGE_LAYOUT_PREINITIALIZED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 1, 1);
+		} else {
+			vk_transition(cmd, image.handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, 1);
+			record_upload(cmd, format, c, blocks.handle, image.handle, levels);
+			vk_transition(cmd, image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mipLevels, 1);
+		}
+		ok = vk_submit_wait(ctx, cmd);
+
+		if (ok) {
+			memset(texels.mapped, 0xcd, texelBytes);
+			cmd = vk_begin(ctx);
+			record_readback(cmd, image.handle, readback.handle, texels.handle, levels, mipDrop);
+			ok = vk_submit_wait(ctx, cmd);
+		}
+
+		vk_image_destroy(ctx, &readback);
+		vk_image_destroy(ctx, &image);
+
+		if (!ok)
+			break;
+
+		for (uint32_t level = mipDrop; level < mipLevels; level++) {
+			const struct verify_level &l = levels[level];
+			const uint8_t *ref = reference.data() + l.texelOffset;
+			const uint8_t *out = (const uint8_t *)texels.mapped + l.texelOffset;
+			uint32_t size = texel_size(format);
+			uint32_t maxDiff = 0, bad = 0;
+
+			for (uint32_t i = 0; i < l.width * l.height; i++) {
+				uint32_t d = texel_diff(format, ref + i * size, out + i * size);
+				maxDiff = std::max(maxDiff, d);
+				bad += d > limit;
+			}
+
+			if (!bad)
+				continue;
+
+			char name[128];
+			snprintf(name, sizeof(name), "%s_%s_%ux%u_mip%u_pass%u", mode.name, get_format_name(format),
+				c.width, c.height, level, pass);
+
+			printf("FAIL %s: %u of %u texels off by up to %u, tolerance %u\n", name, bad, l.width * l.height,
+				maxDiff, limit);
+
+			if (dumpDir)
+				dump_level(dumpDir, name, format, l.width, l.height, ref, out, limit);
+
+			ok = false;
+		}
+	}
+
+	vk_buffer_destroy(ctx, &texels);
+	vk_buffer_destroy(ctx, &blocks);
+
+	if (ok)
+		totals->passed++;
+	else
+		totals->failed++;
+
+	return ok;
+}
+
+static void
+apply_mode(const struct verify_mode &mode)
+{
+	for (const char *variable : verify_variables)
+		unsetenv(variable);
+
+	for (const char *const *env = mode.env; *env; env++)
+		putenv((char *)*env);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *deviceFilter = nullptr;
+	const char *modeFilter = nullptr;
+	const char *formatFilter = nullptr;
+	const char *dumpDir = "bcn_verify_dumps";
+	int tolerance = -1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:m:f:t:o:")) != -1) {
+		switch (opt) {
+			case 'd':
+				deviceFilter = optarg;
+				break;
+			case 'm':
+				modeFilter = optarg;
+				break;
+			case 'f':
+				formatFilter = optarg;
+				break;
+			case 't':
+				tolerance = std::max(0, atoi(optarg));
+				break;
+			case 'o':
+				dumpDir = optarg;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-d device] [-m mode] [-f format] [-t tolerance] [-o dump directory]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	/* The cache mode must not read or pollute the user's cache. */
+	char cacheDir[] = "/tmp/bcn_verify.XXXXXX";
+	if (!mkdtemp(cacheDir)) {
+		fprintf(stderr, "bcn_verify: cannot create a cache directory\n");
+		return 1;
+	}
+
+	setenv("XDG_CACHE_HOME", cacheDir, 1);
+
+	struct verify_totals totals = {};
+	bool ok = true;
+
+	for (const struct verify_mode &mode : verify_modes) {
+		if (modeFilter && strcmp(mode.name, modeFilter))
+			continue;
+
+		apply_mode(mode);
+
+		struct vk_context ctx;
+		if (!vk_context_create(&ctx, deviceFilter, true)) {
+			ok = false;
+			break;
+		}
+
+		printf("mode %s on %s\n", mode.name, ctx.props.deviceName);
+
+		for (VkFormat format : verify_formats) {
+			if (formatFilter && !strcasestr(get_format_name(format), formatFilter))
+				continue;
+
+			for (const struct verify_case &c : verify_cases)
+				ok &= run_case(&ctx, mode, format, c, tolerance, dumpDir, &totals);
+		}
+
+		fflush(stdout);
+		vk_context_destroy(&ctx);
+	}
+
+	std::error_code ec;
+	std::filesystem::remove_all(cacheDir, ec);
+
+	printf("%u passed, %u failed\n", totals.passed, totals.failed);
+	if (totals.failed)
+		printf("dumps in %s\n", dumpDir);
+
+	return ok ? 0 : 1;
+}
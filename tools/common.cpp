@@ -0,0 +1,489 @@
+#include "common.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+bool
+vk_context_create(struct vk_context *ctx, const char *deviceFilter, bool layer)
+{
+	VkResult result;
+
+	memset(ctx, 0, sizeof(*ctx));
+
+	if (layer) {
+		setenv("ENABLE_BCN_COMPUTE", "1", 0);
+		unsetenv("DISABLE_BCN_COMPUTE");
+	} else {
+		setenv("DISABLE_BCN_COMPUTE", "1", 1);
+	}
+
+	VkApplicationInfo app_info = {
+		.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+		.pNext = nullptr,
+		.pApplicationName = "bcn_tools",
+		.applicationVersion = 1,
+		.pEngineName = nullptr,
+		.engineVersion = 0,
+		.apiVersion = VK_API_VERSION_1_1
+	};
+
+	VkInstanceCreateInfo instance_info = {
+		.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.pApplicationInfo = &app_info,
+		.enabledLayerCount = 0,
+		.ppEnabledLayerNames = nullptr,
+		.enabledExtensionCount = 0,
+		.ppEnabledExtensionNames = nullptr
+	};
+
+	result = vkCreateInstance(&instance_info, nullptr, &ctx->instance);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Failed to create instance, res %d\n", result);
+		return false;
+	}
+
+	uint32_t count = 0;
+	vkEnumeratePhysicalDevices(ctx->instance, &count, nullptr);
+	std::vector<VkPhysicalDevice> physicals(count);
+	vkEnumeratePhysicalDevices(ctx->instance, &count, physicals.data());
+
+	for (VkPhysicalDevice physical : physicals) {
+		VkPhysicalDeviceProperties props;
+		vkGetPhysicalDeviceProperties(physical, &props);
+
+		if (deviceFilter && !strstr(props.deviceName, deviceFilter))
+			continue;
+
+		ctx->physical = physical;
+		ctx->props = props;
+		break;
+	}
+
+	if (!ctx->physical) {
+		fprintf(stderr, "No device matching %s\n", deviceFilter ? deviceFilter : "anything");
+		vkDestroyInstance(ctx->instance, nullptr);
+		return false;
+	}
+
+	vkGetPhysicalDeviceMemoryProperties(ctx->physical, &ctx->memProps);
+
+	vkGetPhysicalDeviceQueueFamilyProperties(ctx->physical, &count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(count);
+	vkGetPhysicalDeviceQueueFamilyProperties(ctx->physical, &count, families.data());
+
+	ctx->family = UINT32_MAX;
+	for (uint32_t i = 0; i < count; i++) {
+		if (families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) {
+			ctx->family = i;
+			break;
+		}
+	}
+
+	if (ctx->family == UINT32_MAX) {
+		fprintf(stderr, "No compute queue on %s\n", ctx->props.deviceName);
+		vkDestroyInstance(ctx->instance, nullptr);
+		return false;
+	}
+
+	float priority = 1.0f;
+	VkDeviceQueueCreateInfo queue_info = {
+		.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.queueFamilyIndex = ctx->family,
+		.queueCount = 1,
+		.pQueuePriorities = &priority
+	};
+
+	/* The layer reports BC support, the driver does not need to. */
+	VkPhysicalDeviceFeatures features = {};
+	features.textureCompressionBC = layer;
+
+	/* Compiler statistics for the pipelines the tools build, where the driver has them. */
+	const char *extensions[] = { VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME };
+	VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR executable_features = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR,
+		.pNext = nullptr
+	};
+
+	vkEnumerateDeviceExtensionProperties(ctx->physical, nullptr, &count, nullptr);
+	std::vector<VkExtensionProperties> available(count);
+	vkEnumerateDeviceExtensionProperties(ctx->physical, nullptr, &count, available.data());
+
+	for (const VkExtensionProperties &extension : available) {
+		if (!strcmp(extension.extensionName, extensions[0])) {
+			VkPhysicalDeviceFeatures2 features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &executable_features };
+			vkGetPhysicalDeviceFeatures2(ctx->physical, &features2);
+			ctx->executable_properties = executable_features.pipelineExecutableInfo;
+			break;
+		}
+	}
+
+	VkDeviceCreateInfo device_info = {
+		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+		.pNext = ctx->executable_properties ? &executable_features : nullptr,
+		.flags = 0,
+		.queueCreateInfoCount = 1,
+		.pQueueCreateInfos = &queue_info,
+		.enabledLayerCount = 0,
+		.ppEnabledLayerNames = nullptr,
+		.enabledExtensionCount = ctx->executable_properties ? 1u : 0u,
+		.ppEnabledExtensionNames = extensions,
+		.pEnabledFeatures = &features
+	};
+
+	result = vkCreateDevice(ctx->physical, &device_info, nullptr, &ctx->device);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Failed to create device, res %d\n", result);
+		vkDestroyInstance(ctx->instance, nullptr);
+		return false;
+	}
+
+	vkGetDeviceQueue(ctx->device, ctx->family, 0, &ctx->queue);
+
+	VkCommandPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = ctx->family
+	};
+
+	result = vkCreateCommandPool(ctx->device, &pool_info, nullptr, &ctx->pool);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Failed to create command pool, res %d\n", result);
+		vk_context_destroy(ctx);
+		return false;
+	}
+
+	return true;
+}
+
+void
+vk_context_destroy(struct vk_context *ctx)
+{
+	if (ctx->device) {
+		vkDeviceWaitIdle(ctx->device);
+		if (ctx->pool)
+			vkDestroyCommandPool(ctx->device, ctx->pool, nullptr);
+		vkDestroyDevice(ctx->device, nullptr);
+	}
+
+	if (ctx->instance)
+		vkDestroyInstance(ctx->instance, nullptr);
+
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+static std::string
+format_statistic(const VkPipelineExecutableStatisticKHR &statistic)
+{
+	switch (statistic.format) {
+		case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_BOOL32_KHR:
+			return statistic.value.b32 ? "true" : "false";
+		case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR:
+			return std::to_string(statistic.value.i64);
+		case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR:
+			return std::to_string(statistic.value.u64);
+		default:
+			return std::to_string(statistic.value.f64);
+	}
+}
+
+bool
+vk_pipeline_executables(const struct vk_context *ctx, VkPipeline pipeline, bool internal,
+						std::vector<struct vk_executable> &executables)
+{
+	executables.clear();
+
+	if (!ctx->executable_properties)
+		return false;
+
+	auto getProperties = (PFN_vkGetPipelineExecutablePropertiesKHR)
+		vkGetDeviceProcAddr(ctx->device, "vkGetPipelineExecutablePropertiesKHR");
+	auto getStatistics = (PFN_vkGetPipelineExecutableStatisticsKHR)
+		vkGetDeviceProcAddr(ctx->device, "vkGetPipelineExecutableStatisticsKHR");
+	auto getRepresentations = (PFN_vkGetPipelineExecutableInternalRepresentationsKHR)
+		vkGetDeviceProcAddr(ctx->device, "vkGetPipelineExecutableInternalRepresentationsKHR");
+
+	if (!getProperties || !getStatistics || !getRepresentations)
+		return false;
+
+	VkPipelineInfoKHR pipeline_info = { VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR, nullptr, pipeline };
+	uint32_t count = 0;
+
+	if (getProperties(ctx->device, &pipeline_info, &count, nullptr) != VK_SUCCESS)
+		return false;
+
+	std::vector<VkPipelineExecutablePropertiesKHR> properties(count, { VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR });
+	if (getProperties(ctx->device, &pipeline_info, &count, properties.data()) < 0)
+		return false;
+
+	for (uint32_t i = 0; i < count; i++) {
+		VkPipelineExecutableInfoKHR info = { VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR, nullptr, pipeline, i };
+		struct vk_executable executable;
+		uint32_t entries = 0;
+
+		executable.name = properties[i].name;
+		executable.subgroupSize = properties[i].subgroupSize;
+
+		if (getStatistics(ctx->device, &info, &entries, nullptr) == VK_SUCCESS) {
+			std::vector<VkPipelineExecutableStatisticKHR> statistics(entries, { VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR });
+			getStatistics(ctx->device, &info, &entries, statistics.data());
+
+			for (uint32_t j = 0; j < entries; j++)
+				executable.statistics.push_back({ statistics[j].name, format_statistic(statistics[j]) });
+		}
+
+		entries = 0;
+		if (internal && getRepresentations(ctx->device, &info, &entries, nullptr) == VK_SUCCESS) {
+			std::vector<VkPipelineExecutableInternalRepresentationKHR> representations(entries,
+				{ VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INTERNAL_REPRESENTATION_KHR });
+			getRepresentations(ctx->device, &info, &entries, representations.data());
+
+			std::vector<std::vector<char>> data(entries);
+			for (uint32_t j = 0; j < entries; j++) {
+				data[j].resize(representations[j].dataSize + 1);
+				representations[j].pData = data[j].data();
+			}
+
+			getRepresentations(ctx->device, &info, &entries, representations.data());
+
+			for (uint32_t j = 0; j < entries; j++) {
+				if (representations[j].isText)
+					executable.representations.push_back({ representations[j].name, data[j].data() });
+			}
+		}
+
+		executables.push_back(executable);
+	}
+
+	return true;
+}
+
+uint32_t
+vk_find_memory_type(const struct vk_context *ctx, uint32_t typeBits, VkMemoryPropertyFlags flags)
+{
+	for (uint32_t i = 0; i < ctx->memProps.memoryTypeCount; i++) {
+		if ((typeBits & (1u << i)) && (ctx->memProps.memoryTypes[i].propertyFlags & flags) == flags)
+			return i;
+	}
+
+	return UINT32_MAX;
+}
+
+static bool
+allocate_memory(const struct vk_context *ctx, const VkMemoryRequirements &reqs, VkMemoryPropertyFlags flags,
+				VkDeviceMemory *memory)
+{
+	uint32_t typeIndex = vk_find_memory_type(ctx, reqs.memoryTypeBits, flags);
+	if (typeIndex == UINT32_MAX)
+		typeIndex = vk_find_memory_type(ctx, reqs.memoryTypeBits, 0);
+
+	VkMemoryAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.allocationSize = reqs.size,
+		.memoryTypeIndex = typeIndex
+	};
+
+	return vkAllocateMemory(ctx->device, &alloc_info, nullptr, memory) == VK_SUCCESS;
+}
+
+bool
+vk_buffer_create(const struct vk_context *ctx, VkDeviceSize size, VkBufferUsageFlags usage, bool host, struct vk_buffer *buf)
+{
+	VkMemoryRequirements reqs;
+
+	memset(buf, 0, sizeof(*buf));
+	buf->size = size;
+
+	VkBufferCreateInfo buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.size = size,
+		.usage = usage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 0,
+		.pQueueFamilyIndices = nullptr
+	};
+
+	if (vkCreateBuffer(ctx->device, &buffer_info, nullptr, &buf->handle) != VK_SUCCESS)
+		return false;
+
+	vkGetBufferMemoryRequirements(ctx->device, buf->handle, &reqs);
+
+	VkMemoryPropertyFlags flags = host ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT :
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	if (!allocate_memory(ctx, reqs, flags, &buf->memory) ||
+		vkBindBufferMemory(ctx->device, buf->handle, buf->memory, 0) != VK_SUCCESS ||
+		(host && vkMapMemory(ctx->device, buf->memory, 0, VK_WHOLE_SIZE, 0, &buf->mapped) != VK_SUCCESS)) {
+		vk_buffer_destroy(ctx, buf);
+		return false;
+	}
+
+	return true;
+}
+
+void
+vk_buffer_destroy(const struct vk_context *ctx, struct vk_buffer *buf)
+{
+	if (buf->handle)
+		vkDestroyBuffer(ctx->device, buf->handle, nullptr);
+	if (buf->memory)
+		vkFreeMemory(ctx->device, buf->memory, nullptr);
+
+	memset(buf, 0, sizeof(*buf));
+}
+
+bool
+vk_image_create(const struct vk_context *ctx, const VkImageCreateInfo &info, struct vk_image *img)
+{
+	VkMemoryRequirements reqs;
+
+	memset(img, 0, sizeof(*img));
+
+	if (vkCreateImage(ctx->device, &info, nullptr, &img->handle) != VK_SUCCESS)
+		return false;
+
+	vkGetImageMemoryRequirements(ctx->device, img->handle, &reqs);
+
+	if (!allocate_memory(ctx, reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &img->memory) ||
+		vkBindImageMemory(ctx->device, img->handle, img->memory, 0) != VK_SUCCESS) {
+		vk_image_destroy(ctx, img);
+		return false;
+	}
+
+	return true;
+}
+
+void
+vk_image_destroy(const struct vk_context *ctx, struct vk_image *img)
+{
+	if (img->handle)
+		vkDestroyImage(ctx->device, img->handle, nullptr);
+	if (img->memory)
+		vkFreeMemory(ctx->device, img->memory, nullptr);
+
+	memset(img, 0, sizeof(*img));
+}
+
+VkCommandBuffer
+vk_begin(const struct vk_context *ctx)
+{
+	VkCommandBuffer cmd;
+
+	VkCommandBufferAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.commandPool = ctx->pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1
+	};
+
+	if (vkAllocateCommandBuffers(ctx->device, &alloc_info, &cmd) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr
+	};
+
+	vkBeginCommandBuffer(cmd, &begin_info);
+
+	return cmd;
+}
+
+/* Ends, submits and waits for a command buffer from vk_begin, then frees it. */
+bool
+vk_submit_wait(const struct vk_context *ctx, VkCommandBuffer cmd)
+{
+	VkFence fence;
+	VkResult result;
+
+	vkEndCommandBuffer(cmd);
+
+	VkFenceCreateInfo fence_info = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0
+	};
+
+	result = vkCreateFence(ctx->device, &fence_info, nullptr, &fence);
+	if (result != VK_SUCCESS) {
+		vkFreeCommandBuffers(ctx->device, ctx->pool, 1, &cmd);
+		return false;
+	}
+
+	VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = nullptr,
+		.pWaitDstStageMask = nullptr,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &cmd,
+		.signalSemaphoreCount = 0,
+		.pSignalSemaphores = nullptr
+	};
+
+	result = vkQueueSubmit(ctx->queue, 1, &submit_info, fence);
+	if (result == VK_SUCCESS)
+		result = vkWaitForFences(ctx->device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+	vkDestroyFence(ctx->device, fence, nullptr);
+	vkFreeCommandBuffers(ctx->device, ctx->pool, 1, &cmd);
+
+	if (result != VK_SUCCESS)
+		fprintf(stderr, "Submission failed, res %d\n", result);
+
+	return result == VK_SUCCESS;
+}
+
+void
+vk_transition(VkCommandBuffer cmd, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+			  uint32_t mipLevels, uint32_t arrayLayers)
+{
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+		.oldLayout = oldLayout,
+		.newLayout = newLayout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, arrayLayers }
+	};
+
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+uint64_t
+now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double
+percentile(std::vector<double> values, double p)
+{
+	if (values.empty())
+		return 0.0;
+
+	std::sort(values.begin(), values.end());
+	size_t index = std::min(values.size() - 1, (size_t)(p * (values.size() - 1) + 0.5));
+
+	return values[index];
+}
@@ -0,0 +1,68 @@
+#ifndef __TOOLS_COMMON_HPP
+#define __TOOLS_COMMON_HPP
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Minimal headless Vulkan setup shared by the offline tools: one device,
+ * one queue family with compute and transfer, one command pool. With
+ * layer set, the BCn layer is enabled through its enable_environment so
+ * the images the tools create are emulated like an application's.
+ */
+struct vk_context {
+	VkInstance instance;
+	VkPhysicalDevice physical;
+	VkDevice device;
+	VkQueue queue;
+	uint32_t family;
+	VkCommandPool pool;
+	VkPhysicalDeviceProperties props;
+	VkPhysicalDeviceMemoryProperties memProps;
+	bool executable_properties;
+};
+
+struct vk_buffer {
+	VkBuffer handle;
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	void *mapped;
+};
+
+struct vk_image {
+	VkImage handle;
+	VkDeviceMemory memory;
+};
+
+/*
+ * What VK_KHR_pipeline_executable_properties reports for one executable of
+ * a pipeline created with VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR.
+ * Statistic names are the driver's own, values are formatted as numbers.
+ */
+struct vk_executable {
+	std::string name;
+	uint32_t subgroupSize;
+	std::vector<std::pair<std::string, std::string>> statistics;
+	std::vector<std::pair<std::string, std::string>> representations;
+};
+
+bool vk_context_create(struct vk_context *ctx, const char *deviceFilter, bool layer);
+void vk_context_destroy(struct vk_context *ctx);
+uint32_t vk_find_memory_type(const struct vk_context *ctx, uint32_t typeBits, VkMemoryPropertyFlags flags);
+bool vk_buffer_create(const struct vk_context *ctx, VkDeviceSize size, VkBufferUsageFlags usage, bool host, struct vk_buffer *buf);
+void vk_buffer_destroy(const struct vk_context *ctx, struct vk_buffer *buf);
+bool vk_image_create(const struct vk_context *ctx, const VkImageCreateInfo &info, struct vk_image *img);
+void vk_image_destroy(const struct vk_context *ctx, struct vk_image *img);
+bool vk_pipeline_executables(const struct vk_context *ctx, VkPipeline pipeline, bool internal,
+							 std::vector<struct vk_executable> &executables);
+VkCommandBuffer vk_begin(const struct vk_context *ctx);
+bool vk_submit_wait(const struct vk_context *ctx, VkCommandBuffer cmd);
+void vk_transition(VkCommandBuffer cmd, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+				   uint32_t mipLevels, uint32_t arrayLayers);
+uint64_t now_ns();
+double percentile(std::vector<double> values, double p);
+
+#endif